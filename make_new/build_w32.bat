@@ -268,6 +268,7 @@ call :Compile src/rule
 call :Compile src/shuffle
 call :Compile src/signame
 call :Compile src/strcache
+call :Compile src/submake
 call :Compile src/variable
 call :Compile src/version
 call :Compile src/vpath
@@ -21,6 +21,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "variable.h"
 #include "job.h"
 #include "commands.h"
+#include "submake.h"
 #ifdef WINDOWS32
 #include <windows.h>
 #include "w32err.h"
@@ -55,6 +56,12 @@ dep_hash_cmp (const void *x, const void *y)
   return strcmp (dep_name (dx), dep_name (dy));
 }
 
+/* The name of a file as the recipes of FILE see it: the files of an inlined
+   sub-make are named relative to its directory.  */
+
+#define LOCAL_NAME(file, name) \
+  ((file)->submake ? submake_local_name ((file)->submake, name) : (name))
+
 /* Set FILE's automatic variables up.
  * Use STEM to set $*.
  * If STEM is 0, then set FILE->STEM and $* to the target name with any
@@ -65,6 +72,9 @@ set_file_variables (struct file *file, const char *stem)
 {
   struct dep *d;
   const char *at, *percent, *star, *less;
+  struct file *sfile = file->submake ? file->submake->suffix_file : NULL;
+  struct file *dfile = file->submake ? file->submake->default_file
+                                     : default_file;
 
 #ifndef NO_ARCHIVES
   /* If the target is an archive member 'lib(member)',
@@ -116,7 +126,9 @@ set_file_variables (struct file *file, const char *stem)
           len = strlen (name);
         }
 
-      for (d = enter_file (strcache_add (".SUFFIXES"))->deps; d ; d = d->next)
+      if (sfile == NULL)
+        sfile = enter_file (strcache_add (".SUFFIXES"));
+      for (d = sfile->deps; d ; d = d->next)
         {
           const char *dn = dep_name (d);
           size_t slen = strlen (dn);
@@ -129,18 +141,19 @@ set_file_variables (struct file *file, const char *stem)
       if (d == 0)
         file->stem = stem = "";
     }
-  star = stem;
+  star = *stem != '\0' ? LOCAL_NAME (file, stem) : stem;
+  at = LOCAL_NAME (file, at);
 
   /* $< is the first not order-only dependency.  */
   less = "";
   for (d = file->deps; d != 0; d = d->next)
     if (!d->ignore_mtime && !d->ignore_automatic_vars && !d->need_2nd_expansion)
       {
-        less = dep_name (d);
+        less = LOCAL_NAME (file, dep_name (d));
         break;
       }
 
-  if (file->cmds != 0 && file->cmds == default_file->cmds)
+  if (file->cmds != 0 && file->cmds == dfile->cmds)
     /* This file got its commands from .DEFAULT.
        In this case $< is the same as $@.  */
     less = at;
@@ -180,10 +193,11 @@ set_file_variables (struct file *file, const char *stem)
       {
         if (!d->need_2nd_expansion && !d->ignore_automatic_vars)
           {
+            size_t dlen = strlen (LOCAL_NAME (file, dep_name (d))) + 1;
             if (d->ignore_mtime)
-              bar_len += strlen (dep_name (d)) + 1;
+              bar_len += dlen;
             else
-              plus_len += strlen (dep_name (d)) + 1;
+              plus_len += dlen;
           }
       }
 
@@ -202,7 +216,7 @@ set_file_variables (struct file *file, const char *stem)
     for (d = file->deps; d != 0; d = d->next)
       if (! d->ignore_mtime && ! d->need_2nd_expansion && ! d->ignore_automatic_vars)
         {
-          const char *c = dep_name (d);
+          const char *c = LOCAL_NAME (file, dep_name (d));
 
 #ifndef NO_ARCHIVES
           if (ar_name (c))
@@ -271,7 +285,7 @@ set_file_variables (struct file *file, const char *stem)
         if (d->need_2nd_expansion || d->ignore_automatic_vars || hash_find_item (&dep_hash, d) != d)
           continue;
 
-        c = dep_name (d);
+        c = LOCAL_NAME (file, dep_name (d));
 #ifndef NO_ARCHIVES
         if (ar_name (c))
           {
@@ -396,6 +410,7 @@ chop_commands (struct commands *cmds)
 
   cmds->ncommand_lines = nlines;
   cmds->command_lines = lines;
+  cmds->command_expansions = xcalloc (nlines * sizeof (struct expansion *));
 
   cmds->any_recurse = 0;
   cmds->lines_flags = xmalloc (nlines);
@@ -444,9 +459,10 @@ execute_file_commands (struct file *file)
   for (p = file->cmds->commands; *p != '\0'; ++p)
     if (!ISSPACE (*p) && *p != '-' && *p != '@' && *p != '+')
       break;
-  if (*p == '\0')
+  if (*p == '\0' || file->inlined)
     {
-      /* If there are no commands, assume everything worked.  */
+      /* If there are no commands, or they were a sub-make whose goals
+         were made as prerequisites, assume everything worked.  */
       set_command_state (file, cs_running);
       file->update_status = us_success;
       notice_finished_file (file);
@@ -22,6 +22,7 @@ struct commands
     floc fileinfo;              /* Where commands were defined.  */
     char *commands;             /* Commands text.  */
     char **command_lines;       /* Commands chopped up into lines.  */
+    struct expansion **command_expansions; /* The lines compiled, if run.  */
     unsigned char *lines_flags; /* One set of flag bits for each line.  */
     unsigned short ncommand_lines;/* Number of command lines.  */
     char recipe_prefix;         /* Recipe prefix for this command set.  */
@@ -24,6 +24,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "dep.h"
 #include "job.h"
 #include "commands.h"
+#include "submake.h"
 
 /* Define GCC_IS_NATIVE if gcc is the native development environment on
    your system (gcc/bison/flex vs cc/yacc/lex).  */
@@ -686,8 +687,12 @@ set_default_suffixes (void)
     {
       struct dep *d;
       const char *p = default_suffixes;
+      /* The suffixes are not names of files of a sub-make.  */
+      int names = submake_names;
+      submake_names = 0;
       suffix_file->deps = enter_prereqs (PARSE_SIMPLE_SEQ ((char **)&p, struct dep),
                                          NULL);
+      submake_names = names;
       for (d = suffix_file->deps; d; d = d->next)
         d->file->builtin = 1;
 
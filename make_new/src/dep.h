@@ -104,7 +104,12 @@ struct nameseq *ar_glob (const char *arname, const char *member_pattern, size_t
 
 #define dep_name(d)       ((d)->name ? (d)->name : (d)->file->name)
 
-#define alloc_seq_elt(_t) xcalloc (sizeof (_t))
+/* These records come from a pool in misc.c, not from malloc: release them
+   with free_ns() and friends, never with free().  */
+void *alloc_seq (size_t size);
+void free_seq (void *ptr);
+
+#define alloc_seq_elt(_t) alloc_seq (sizeof (_t))
 void free_ns_chain (struct nameseq *n);
 
 #if defined(MAKE_MAINTAINER_MODE) && defined(__GNUC__) && !defined(__STRICT_ANSI__)
@@ -114,7 +119,7 @@ SI struct nameseq *alloc_ns (void)    { return alloc_seq_elt (struct nameseq); }
 SI struct dep *alloc_dep (void)       { return alloc_seq_elt (struct dep); }
 SI struct goaldep *alloc_goaldep (void) { return alloc_seq_elt (struct goaldep); }
 
-SI void free_ns (struct nameseq *n)      { free (n); }
+SI void free_ns (struct nameseq *n)      { free_seq (n); }
 SI void free_dep (struct dep *d)         { free_ns ((struct nameseq *)d); }
 SI void free_goaldep (struct goaldep *g) { free_dep ((struct dep *)g); }
 SI void free_dep_chain (struct dep *d)   { free_ns_chain((struct nameseq *)d); }
@@ -124,7 +129,7 @@ SI void free_goal_chain (struct goaldep *g) { free_dep_chain((struct dep *)g); }
 # define alloc_dep()         alloc_seq_elt (struct dep)
 # define alloc_goaldep()     alloc_seq_elt (struct goaldep)
 
-# define free_ns(_n)         free (_n)
+# define free_ns(_n)         free_seq (_n)
 # define free_dep(_d)        free_ns (_d)
 # define free_goaldep(_g)    free_dep (_g)
 
@@ -135,5 +140,6 @@ SI void free_goal_chain (struct goaldep *g) { free_dep_chain((struct dep *)g); }
 struct dep *copy_dep_chain (const struct dep *d);
 
 struct goaldep *read_all_makefiles (const char **makefiles);
+struct goaldep *swap_read_files (struct goaldep *chain);
 void eval_buffer (char *buffer, const floc *floc);
 enum update_status update_goal_chain (struct goaldep *goals);
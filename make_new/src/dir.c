@@ -20,6 +20,8 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "dep.h"
 #include "debug.h"
 
+#include <fnmatch.h>
+
 #ifdef  HAVE_DIRENT_H
 # include <dirent.h>
 # define NAMLEN(dirent) strlen((dirent)->d_name)
@@ -882,6 +884,9 @@ file_exists_p (const char *name)
   return dir_file_exists_p (dirname, slash);
 }
 
+/* Incremented every time a file is marked impossible.  */
+static unsigned long impossible_count = 0;
+
 /* Mark FILENAME as 'impossible' for 'file_impossible_p'.
    This means an attempt has been made to search for FILENAME
    as an intermediate file, and it has failed.  */
@@ -983,6 +988,9 @@ file_impossible (const char *filename)
 #endif
   new->impossible = 1;
   hash_insert (&dir->contents->dirfiles, new);
+
+  /* Cached glob results might include FILENAME.  */
+  ++impossible_count;
 }
 
 /* Return nonzero if FILENAME has been marked impossible.  */
@@ -1365,6 +1373,362 @@ dir_setup_glob (glob_t *gl)
   gl->gl_stat = local_stat;
 }
 
+/* Globbing on the directory cache.
+
+   dir_glob matches patterns made of literal directory components followed
+   only by components with wildcards directly against the cached contents
+   of the directories, and remembers the result for as long as the cache is
+   valid: until a command runs or a file is marked impossible.  Anything
+   else is left to glob().  The results are the ones glob() would give with
+   dir_setup_glob, sorted the same way.  */
+
+#if !defined(VMS) && !defined(_AMIGA) && !defined(HAVE_DOS_PATHS) \
+    && !defined(HAVE_CASE_INSENSITIVE_FS)
+# define DIR_GLOB
+#endif
+
+#ifdef DIR_GLOB
+
+/* How a component of a pattern is matched: the common shapes "*.c",
+   "lib*" and "*" without calling fnmatch.  */
+enum glob_match
+  {
+    gm_any,                     /* "*" */
+    gm_suffix,                  /* "*" followed by literal text.  */
+    gm_prefix,                  /* Literal text followed by "*".  */
+    gm_fnmatch                  /* Anything else.  */
+  };
+
+struct glob_component
+  {
+    char *pattern;              /* This component, nul-terminated.  */
+    const char *text;           /* The literal text of a prefix or suffix. */
+    size_t length;              /* Length of TEXT.  */
+    enum glob_match match;
+  };
+
+struct glob_result
+  {
+    const char *pattern;        /* The pattern, in the strcache.  */
+    unsigned long counter;      /* command_count when computed.  */
+    unsigned long impossible;   /* impossible_count when computed.  */
+    int count;
+    const char **names;         /* The matches, in the strcache.  */
+  };
+
+static struct hash_table glob_results;
+
+static unsigned long glob_hits = 0;
+static unsigned long glob_misses = 0;
+static unsigned long glob_fallbacks = 0;
+
+static unsigned long
+glob_result_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((const struct glob_result *) key)->pattern);
+}
+
+static unsigned long
+glob_result_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((const struct glob_result *) key)->pattern);
+}
+
+static int
+glob_result_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((const struct glob_result *) x)->pattern,
+                         ((const struct glob_result *) y)->pattern);
+}
+
+/* Return nonzero if the LENGTH chars at P are a pattern for glob.  */
+
+static int
+glob_wild_p (const char *p, size_t length)
+{
+  const char *end = p + length;
+  const char *bracket = NULL;
+
+  for (; p < end; ++p)
+    if (*p == '*' || *p == '?')
+      return 1;
+    else if (*p == '[')
+      bracket = p;
+    else if (*p == ']' && bracket)
+      return 1;
+
+  return 0;
+}
+
+/* Fill in GC to match the LENGTH chars at P.  */
+
+static void
+compile_glob_component (struct glob_component *gc, const char *p,
+                        size_t length)
+{
+  const char *star = memchr (p, '*', length);
+
+  gc->pattern = xstrndup (p, length);
+  gc->match = gm_fnmatch;
+  gc->text = NULL;
+  gc->length = 0;
+
+  /* Only a single '*' is matched without fnmatch.  */
+  if (!star || memchr (star + 1, '*', length - (star - p) - 1)
+      || memchr (p, '?', length) || memchr (p, '[', length))
+    return;
+
+  if (length == 1)
+    gc->match = gm_any;
+  else if (star == p)
+    {
+      gc->match = gm_suffix;
+      gc->text = gc->pattern + 1;
+      gc->length = length - 1;
+    }
+  else if (star == p + length - 1)
+    {
+      gc->match = gm_prefix;
+      gc->text = gc->pattern;
+      gc->length = length - 1;
+    }
+}
+
+/* Return nonzero if the directory entry DF matches GC, as fnmatch would
+   with FNM_PERIOD.  */
+
+static int
+glob_component_matches (const struct glob_component *gc,
+                        const struct dirfile *df)
+{
+  switch (gc->match)
+    {
+    case gm_any:
+      return df->name[0] != '.';
+    case gm_suffix:
+      return df->name[0] != '.' && df->length >= gc->length
+        && memcmp (df->name + df->length - gc->length, gc->text,
+                   gc->length) == 0;
+    case gm_prefix:
+      return df->length >= gc->length
+        && memcmp (df->name, gc->text, gc->length) == 0;
+    default:
+      return fnmatch (gc->pattern, df->name, FNM_PERIOD) == 0;
+    }
+}
+
+/* Add to *NAMES the matches of the components GC[0..N) in the directory
+   whose name, as it should prefix the matches, is in PATH[0..PLEN).  */
+
+static void
+glob_in_directory (char **path, size_t *psize, size_t plen,
+                   const struct glob_component *gc, unsigned int n,
+                   const char ***names, int *count, int *max)
+{
+  struct directory *dir;
+  struct dirfile **slot;
+  struct dirfile **end;
+
+  /* Open PATH without the trailing slash, unless it is the root.  */
+  if (plen == 0)
+    dir = find_directory (".");
+  else if (plen == 1)
+    dir = find_directory ("/");
+  else
+    {
+      (*path)[plen - 1] = '\0';
+      dir = find_directory (*path);
+      (*path)[plen - 1] = '/';
+    }
+
+  if (dir->contents == 0 || dir->contents->dirfiles.ht_vec == 0)
+    return;
+  dir_contents_file_exists_p (dir->contents, 0);
+
+  slot = (struct dirfile **) dir->contents->dirfiles.ht_vec;
+  end = slot + dir->contents->dirfiles.ht_size;
+  for (; slot < end; ++slot)
+    {
+      struct dirfile *df = *slot;
+      size_t len;
+
+      if (HASH_VACANT (df) || df->impossible
+          || !glob_component_matches (gc, df))
+        continue;
+
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+      /* Like glob, only look into what might be a directory.  */
+      if (n > 1 && df->type != DT_DIR && df->type != DT_LNK
+          && df->type != DT_UNKNOWN)
+        continue;
+#endif
+
+      len = plen + df->length + 1;
+      if (len + 1 > *psize)
+        {
+          *psize = len * 2;
+          *path = xrealloc (*path, *psize);
+        }
+      memcpy (*path + plen, df->name, df->length);
+
+      if (n > 1)
+        {
+          (*path)[len - 1] = '/';
+          glob_in_directory (path, psize, len, gc + 1, n - 1,
+                             names, count, max);
+        }
+      else
+        {
+          if (*count == *max)
+            {
+              *max = *max ? *max * 2 : 16;
+              *names = xrealloc (*names, *max * sizeof (const char *));
+            }
+          (*names)[(*count)++] = strcache_add_len (*path, len - 1);
+        }
+    }
+}
+
+static int
+glob_name_compare (const void *x, const void *y)
+{
+  return strcoll (*(const char **) x, *(const char **) y);
+}
+
+#endif /* DIR_GLOB */
+
+/* Find the files matching PATTERN, as glob would with dir_setup_glob.
+   Return zero if PATTERN is not one we can match ourselves.  Otherwise
+   set *PATHV to the matches, which stay valid until the next call, and
+   *PATHC to their number, and return nonzero.  */
+
+int
+dir_glob (const char *pattern, const char ***pathv, int *pathc)
+{
+#ifdef DIR_GLOB
+  struct glob_result key;
+  struct glob_result **slot;
+  struct glob_result *r;
+  struct glob_component gc[32];
+  unsigned int n = 0;
+  const char *wild;
+  const char *p;
+  char *path;
+  size_t psize;
+  size_t plen;
+  int max = 0;
+  unsigned int i;
+
+  if (glob_results.ht_vec == 0)
+    hash_init (&glob_results, DIRECTORY_BUCKETS, glob_result_hash_1,
+               glob_result_hash_2, glob_result_hash_cmp);
+
+  key.pattern = pattern;
+  slot = (struct glob_result **) hash_find_slot (&glob_results, &key);
+  r = *slot;
+  if (!HASH_VACANT (r))
+    {
+      if (r->counter == command_count && r->impossible == impossible_count)
+        {
+          ++glob_hits;
+          *pathv = r->names;
+          *pathc = r->count;
+          return 1;
+        }
+    }
+  else
+    {
+      /* Find the first component with a wildcard; there must be one and
+         all the components after it must have one too.  Escapes and
+         empty components are left to glob.  */
+      if (strchr (pattern, '\\'))
+        goto fallback;
+
+      wild = NULL;
+      for (p = pattern; ; )
+        {
+          const char *slash = strchr (p, '/');
+          size_t len = slash ? (size_t) (slash - p) : strlen (p);
+          int w = glob_wild_p (p, len);
+
+          if (w && !wild)
+            wild = p;
+          if (wild && (!w || len == 0 || ++n > sizeof (gc) / sizeof (gc[0])))
+            goto fallback;
+          if (!slash)
+            break;
+          p = slash + 1;
+        }
+      if (!wild)
+        goto fallback;
+
+      r = xcalloc (sizeof (struct glob_result));
+      r->pattern = strcache_add (pattern);
+      hash_insert_at (&glob_results, r, slot);
+    }
+
+  ++glob_misses;
+  n = 0;
+  free (r->names);
+  r->names = NULL;
+  r->count = 0;
+  r->counter = command_count;
+  r->impossible = impossible_count;
+
+  /* Compile the components after the literal directory prefix.  */
+  wild = pattern;
+  for (p = pattern; !glob_wild_p (p, strcspn (p, "/")); )
+    wild = p = strchr (p, '/') + 1;
+  for (p = wild; ; )
+    {
+      const char *slash = strchr (p, '/');
+      size_t len = slash ? (size_t) (slash - p) : strlen (p);
+      compile_glob_component (&gc[n++], p, len);
+      if (!slash)
+        break;
+      p = slash + 1;
+    }
+
+  plen = wild - pattern;
+  psize = plen + 256;
+  path = xmalloc (psize);
+  memcpy (path, pattern, plen);
+
+  glob_in_directory (&path, &psize, plen, gc, n, &r->names, &r->count, &max);
+
+  if (r->count > 1)
+    qsort (r->names, r->count, sizeof (const char *), glob_name_compare);
+
+  free (path);
+  for (i = 0; i < n; ++i)
+    free (gc[i].pattern);
+
+  *pathv = r->names;
+  *pathc = r->count;
+  return 1;
+
+ fallback:
+  ++glob_fallbacks;
+#else
+  (void) pattern;
+  (void) pathv;
+  (void) pathc;
+#endif /* DIR_GLOB */
+  return 0;
+}
+
+/* Print how well dir_glob did.  */
+
+void
+print_glob_stats (void)
+{
+#ifdef DIR_GLOB
+  DB (DB_VERBOSE,
+      (_("Glob cache: %lu hits, %lu misses, %lu patterns left to glob()\n"),
+       glob_hits, glob_misses, glob_fallbacks));
+#endif
+}
+
 void
 hash_init_directories (void)
 {
@@ -1374,3 +1738,46 @@ hash_init_directories (void)
              directory_contents_hash_1, directory_contents_hash_2,
              directory_contents_hash_cmp);
 }
+
+/* The tables that map names to directories and cache wildcard matches are
+   only valid for one working directory.  --inline-submake keeps a set for
+   the directory of each sub-make and swaps it in while that directory is
+   the current one; the contents of the directories are shared.  */
+
+struct dir_tables
+  {
+    struct hash_table directories;
+#ifdef DIR_GLOB
+    struct hash_table glob_results;
+#endif
+  };
+
+/* Return a new, empty set of tables for dir_swap_tables.  */
+
+void *
+dir_new_tables (void)
+{
+  struct dir_tables *t = xcalloc (sizeof (struct dir_tables));
+
+  hash_init (&t->directories, DIRECTORY_BUCKETS,
+             directory_hash_1, directory_hash_2, directory_hash_cmp);
+  return t;
+}
+
+/* Exchange the current tables with the ones in TABLES.  */
+
+void
+dir_swap_tables (void *tables)
+{
+  struct dir_tables *t = tables;
+  struct hash_table tmp;
+
+  tmp = directories;
+  directories = t->directories;
+  t->directories = tmp;
+#ifdef DIR_GLOB
+  tmp = glob_results;
+  glob_results = t->glob_results;
+  t->glob_results = tmp;
+#endif
+}
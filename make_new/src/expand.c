@@ -89,9 +89,186 @@ initialize_variable_output ()
   return variable_buffer;
 }
 
+/* Built-in functions whose result depends only on their arguments.  */
+
+static const char *const pure_functions[] =
+  {
+    "addprefix", "addsuffix", "and", "basename", "dir", "eq", "filter",
+    "filter-out", "findstring", "firstword", "if", "intcmp", "join",
+    "lastword", "not", "notdir", "or", "patsubst", "sort", "strip", "subst",
+    "suffix", "word", "wordlist", "words", NULL
+  };
+
+/* Deeper chains of variable references are not worth analyzing.  */
+#define MAX_PURE_DEPTH 64
+
+static int variable_is_pure (struct variable *v, unsigned int depth);
+
+/* Return nonzero if a reference to the variable NAME, LENGTH chars long,
+   expands the same way for every target.  */
+
+static int
+reference_is_pure (const char *name, size_t length, unsigned int depth)
+{
+  struct variable *v;
+
+  if (variable_defined_locally (name, length))
+    return 0;
+
+  observe_variable (name, length);
+  v = lookup_variable (name, length);
+  if (v == 0)
+    /* Each expansion warns about it.  */
+    return !warn_undefined_variables_flag;
+
+  return variable_is_pure (v, depth + 1);
+}
+
+/* Return nonzero if expanding the LENGTH chars at TEXT gives the same
+   result for every target, as long as no variable changes.  That holds if
+   TEXT only refers to variables that are pure in turn and never defined
+   outside the global set (which rules out automatic and target-specific
+   variables), and only calls functions in pure_functions.  Computed
+   variable names rule it out too, as their footprint is not known.  */
+
+static int
+text_is_pure (const char *text, size_t length, unsigned int depth)
+{
+  const char *end = text + length;
+  const char *p = text;
+
+  while ((p = memchr (p, '$', end - p)) != 0)
+    {
+      ++p;
+      if (p == end)
+        break;
+
+      if (*p == '$')
+        ++p;
+      else if (*p == '(' || *p == '{')
+        {
+          char openparen = *p;
+          char closeparen = (openparen == '(') ? ')' : '}';
+          const char *beg = p + 1;
+          const char *name_end;
+          int count = 0;
+
+          for (p = beg; p < end; ++p)
+            if (*p == openparen)
+              ++count;
+            else if (*p == closeparen && --count < 0)
+              break;
+          if (p == end)
+            /* Unterminated; let the expansion complain about it.  */
+            return 0;
+
+          name_end = beg;
+          while (name_end < p && !ISSPACE (*name_end) && *name_end != ':'
+                 && *name_end != '$')
+            ++name_end;
+
+          if (name_end < p && ISSPACE (*name_end))
+            {
+              /* A function call.  Its arguments must be pure too.  */
+              const char *const *f;
+              for (f = pure_functions; *f; ++f)
+                if (strlen (*f) == (size_t) (name_end - beg)
+                    && memcmp (*f, beg, name_end - beg) == 0)
+                  break;
+              if (!*f || !text_is_pure (name_end, p - name_end, depth))
+                return 0;
+            }
+          else if (name_end < p && *name_end == '$')
+            {
+              /* A computed name, as in $(am__v_lt_$(V)).  If the text
+                 making up the reference is pure, so is the name; expand it
+                 to find out which variable it refers to.  */
+              char *ref;
+              const char *colon;
+              int pure;
+              if (!text_is_pure (beg, p - beg, depth))
+                return 0;
+              ref = expand_argument (beg, p);
+              colon = strchr (ref, ':');
+              if (colon && !strchr (colon, '='))
+                colon = NULL;
+              pure = reference_is_pure (ref, colon ? (size_t) (colon - ref)
+                                                   : strlen (ref),
+                                        depth);
+              free (ref);
+              if (!pure)
+                return 0;
+            }
+          else
+            {
+              /* A reference, possibly a substitution reference, to the
+                 variable named up to NAME_END.  */
+              if (name_end == beg)
+                return 0;
+              /* Without an '=' the colon is part of the name.  */
+              if (name_end < p && !memchr (name_end, '=', p - name_end))
+                return 0;
+              if (!text_is_pure (name_end, p - name_end, depth)
+                  || !reference_is_pure (beg, name_end - beg, depth))
+                return 0;
+            }
+          ++p;
+        }
+      else if (ISSPACE (*p))
+        /* A '$' before a blank expands to nothing.  */
+        ++p;
+      else
+        {
+          /* A one-character variable name.  */
+          if (!reference_is_pure (p, 1, depth))
+            return 0;
+          ++p;
+        }
+    }
+
+  return 1;
+}
+
+/* Return nonzero if V expands the same way for every target in the current
+   variable_generation.  The answer is kept in V until the generation
+   changes.  */
+
+static int
+variable_is_pure (struct variable *v, unsigned int depth)
+{
+  if (v->exp_gen == variable_generation)
+    return v->exp_pure;
+
+  free (v->exp_cache);
+  v->exp_cache = NULL;
+  v->exp_gen = variable_generation;
+  observe_variable (v->name, v->length);
+
+  /* Until we know better: this also stops reference cycles.  */
+  v->exp_pure = 0;
+
+  if (v->special || v->append || depth > MAX_PURE_DEPTH)
+    return 0;
+
+  v->exp_pure = !v->recursive
+                || text_is_pure (v->value, strlen (v->value), depth);
+  return v->exp_pure;
+}
+
+/* Return nonzero if V expands the same way for every target, as long as
+   variable_generation does not change.  */
+
+int
+variable_expansion_is_pure (struct variable *v)
+{
+  return variable_is_pure (v, 0);
+}
+
 /* Recursively expand V.  The returned string is malloc'd.  */
 
 static char *allocated_variable_append (const struct variable *v);
+static struct expansion *expansion_of (struct expansion **ep,
+                                       const char *text);
 
 char *
 recursively_expand_for_file (struct variable *v, struct file *file)
@@ -101,6 +278,9 @@ recursively_expand_for_file (struct variable *v, struct file *file)
   const floc **saved_varp;
   struct variable_set_list *save = 0;
   int set_reading = 0;
+  unsigned long generation;
+  const char *defined_value;
+  int pure;
 
   /* If we're expanding to put into the environment of a shell function then
      ignore any recursion issues: for backward-compatibility we will use
@@ -125,6 +305,11 @@ recursively_expand_for_file (struct variable *v, struct file *file)
       return xstrdup ("");
     }
 
+  /* Reuse the value from the last expansion if it could not have changed;
+     see variable_is_pure.  */
+  if (v->exp_cache && v->exp_gen == variable_generation)
+    return xstrdup (v->exp_cache);
+
   /* Don't install a new location if this location is empty.
      This can happen for command-line variables, builtin variables, etc.  */
   saved_varp = expanding_var;
@@ -157,13 +342,25 @@ recursively_expand_for_file (struct variable *v, struct file *file)
       current_variable_set_list = file->variables;
     }
 
+  /* Decide on the value being expanded: the expansion may redefine V.
+     Checking it also observes V, so that doing so bumps the generation.  */
+  pure = variable_is_pure (v, 0);
+  defined_value = v->value;
+  generation = variable_generation;
   v->expanding = 1;
   if (v->append)
     value = allocated_variable_append (v);
   else
-    value = allocated_variable_expand (v->value);
+    value = allocated_expansion (expansion_of (&v->exp_prog, v->value));
   v->expanding = 0;
 
+  if (pure && generation == variable_generation && !v->exp_count
+      && v->value == defined_value && v->exp_gen == generation)
+    {
+      free (v->exp_cache);
+      v->exp_cache = xstrdup (value);
+    }
+
   if (set_reading)
     reading_file = 0;
 
@@ -205,6 +402,92 @@ reference_variable (char *o, const char *name, size_t length)
   return o;
 }
 
+/* Expand the reference made up of the text from BEG to END, once any
+   variable references in it are expanded: either a substitution reference
+   like $(FOO:A=B) or a reference to the variable it names.  */
+
+static char *
+expand_reference (char *o, const char *beg, const char *end)
+{
+  struct variable *v;
+  const char *colon = lindex (beg, end, ':');
+
+  if (colon)
+    {
+      /* This looks like a substitution reference: $(FOO:A=B).  */
+      const char *subst_beg = colon + 1;
+      const char *subst_end = lindex (subst_beg, end, '=');
+      if (subst_end != 0)
+        {
+          const char *replace_beg = subst_end + 1;
+          const char *replace_end = end;
+
+          /* Extract the variable name before the colon
+             and look up that variable.  */
+          v = lookup_variable (beg, colon - beg);
+          if (v == 0)
+            warn_undefined (beg, colon - beg);
+
+          /* If the variable is not empty, perform the
+             substitution.  */
+          if (v != 0 && *v->value != '\0')
+            {
+              char *pattern, *replace, *ppercent, *rpercent;
+              char *value = (v->recursive
+                             ? recursively_expand (v)
+                             : v->value);
+
+              /* Copy the pattern and the replacement.  Add in an
+                 extra % at the beginning to use in case there
+                 isn't one in the pattern.  */
+              pattern = alloca (subst_end - subst_beg + 2);
+              *(pattern++) = '%';
+              memcpy (pattern, subst_beg, subst_end - subst_beg);
+              pattern[subst_end - subst_beg] = '\0';
+
+              replace = alloca (replace_end - replace_beg + 2);
+              *(replace++) = '%';
+              memcpy (replace, replace_beg,
+                     replace_end - replace_beg);
+              replace[replace_end - replace_beg] = '\0';
+
+              /* Look for %.  Set the percent pointers properly
+                 based on whether we find one or not.  */
+              ppercent = find_percent (pattern);
+              if (ppercent)
+                {
+                  ++ppercent;
+                  rpercent = find_percent (replace);
+                  if (rpercent)
+                    ++rpercent;
+                }
+              else
+                {
+                  ppercent = pattern;
+                  rpercent = replace;
+                  --pattern;
+                  --replace;
+                }
+
+              o = patsubst_expand_pat (o, value, pattern, replace,
+                                       ppercent, rpercent);
+
+              if (v->recursive)
+                free (value);
+            }
+
+          return o;
+        }
+
+      /* There is no = in sight.  Punt on the substitution reference and
+         treat this as a variable name containing a colon.  */
+    }
+
+  /* This is an ordinary variable reference.
+     Look up the value of the variable.  */
+  return reference_variable (o, beg, end - beg);
+}
+
 /* Scan STRING for variable references and expansion-function calls.  Only
    LENGTH bytes of STRING are actually scanned.  If LENGTH is -1, scan until
    a null byte is found.
@@ -217,7 +500,6 @@ reference_variable (char *o, const char *name, size_t length)
 char *
 variable_expand_string (char *line, const char *string, size_t length)
 {
-  struct variable *v;
   const char *p, *p1;
   char *save;
   char *o;
@@ -275,7 +557,7 @@ variable_expand_string (char *line, const char *string, size_t length)
             const char *beg = p + 1;
             char *op;
             char *abeg = NULL;
-            const char *end, *colon;
+            const char *end;
 
             op = o;
             begp = p;
@@ -323,85 +605,8 @@ variable_expand_string (char *line, const char *string, size_t length)
               p = end;
 
             /* This is not a reference to a built-in function and
-               any variable references inside are now expanded.
-               Is the resultant text a substitution reference?  */
-
-            colon = lindex (beg, end, ':');
-            if (colon)
-              {
-                /* This looks like a substitution reference: $(FOO:A=B).  */
-                const char *subst_beg = colon + 1;
-                const char *subst_end = lindex (subst_beg, end, '=');
-                if (subst_end == 0)
-                  /* There is no = in sight.  Punt on the substitution
-                     reference and treat this as a variable name containing
-                     a colon, in the code below.  */
-                  colon = 0;
-                else
-                  {
-                    const char *replace_beg = subst_end + 1;
-                    const char *replace_end = end;
-
-                    /* Extract the variable name before the colon
-                       and look up that variable.  */
-                    v = lookup_variable (beg, colon - beg);
-                    if (v == 0)
-                      warn_undefined (beg, colon - beg);
-
-                    /* If the variable is not empty, perform the
-                       substitution.  */
-                    if (v != 0 && *v->value != '\0')
-                      {
-                        char *pattern, *replace, *ppercent, *rpercent;
-                        char *value = (v->recursive
-                                       ? recursively_expand (v)
-                                       : v->value);
-
-                        /* Copy the pattern and the replacement.  Add in an
-                           extra % at the beginning to use in case there
-                           isn't one in the pattern.  */
-                        pattern = alloca (subst_end - subst_beg + 2);
-                        *(pattern++) = '%';
-                        memcpy (pattern, subst_beg, subst_end - subst_beg);
-                        pattern[subst_end - subst_beg] = '\0';
-
-                        replace = alloca (replace_end - replace_beg + 2);
-                        *(replace++) = '%';
-                        memcpy (replace, replace_beg,
-                               replace_end - replace_beg);
-                        replace[replace_end - replace_beg] = '\0';
-
-                        /* Look for %.  Set the percent pointers properly
-                           based on whether we find one or not.  */
-                        ppercent = find_percent (pattern);
-                        if (ppercent)
-                          {
-                            ++ppercent;
-                            rpercent = find_percent (replace);
-                            if (rpercent)
-                              ++rpercent;
-                          }
-                        else
-                          {
-                            ppercent = pattern;
-                            rpercent = replace;
-                            --pattern;
-                            --replace;
-                          }
-
-                        o = patsubst_expand_pat (o, value, pattern, replace,
-                                                 ppercent, rpercent);
-
-                        if (v->recursive)
-                          free (value);
-                      }
-                  }
-              }
-
-            if (colon == 0)
-              /* This is an ordinary variable reference.
-                 Look up the value of the variable.  */
-                o = reference_variable (o, beg, end - beg);
+               any variable references inside are now expanded.  */
+            o = expand_reference (o, beg, end);
 
             free (abeg);
           }
@@ -474,6 +679,333 @@ expand_argument (const char *str, const char *end)
   return r;
 }
 
+/* Compiled expansions.
+
+   Recursive variables and recipe lines are expanded over and over, and
+   variable_expand_string parses their text again each time.  Instead,
+   compile_expansion parses the text once into a list of steps: literal
+   text, references to variables whose name is known, and calls of built-in
+   functions, with the function looked up and the arguments split and
+   compiled in turn.  Anything out of the ordinary, like an unterminated
+   reference, leaves the text to variable_expand_string, so that errors are
+   still reported the same way and at the same time.  */
+
+enum expansion_op
+  {
+    EXP_TEXT,           /* Output TEXT.  */
+    EXP_VARIABLE,       /* Reference the variable named TEXT.  */
+    EXP_REFERENCE,      /* Expand the reference TEXT; see expand_reference.  */
+    EXP_COMPUTED,       /* Expand the reference that SUB expands to.  */
+    EXP_FUNCTION        /* Call CALL.  */
+  };
+
+struct expansion_step
+  {
+    enum expansion_op op;
+    const char *text;
+    size_t length;
+    struct expansion *sub;
+    struct function_call *call;
+  };
+
+struct expansion
+  {
+    char *text;                 /* The text compiled.  */
+    size_t length;
+    unsigned long generation;   /* function_generation when compiled.  */
+    unsigned int refs;          /* From the owner and from running it.  */
+    unsigned int interpret:1;   /* Expand TEXT with variable_expand_string.  */
+    unsigned int nsteps;
+    unsigned int maxsteps;
+    struct expansion_step *steps;
+  };
+
+static struct expansion *
+new_expansion (const char *text, size_t length)
+{
+  struct expansion *e = xcalloc (sizeof (struct expansion));
+
+  e->text = xstrndup (text, length);
+  e->length = length;
+  e->generation = function_generation;
+  e->refs = 1;
+  return e;
+}
+
+static struct expansion_step *
+add_step (struct expansion *e, enum expansion_op op)
+{
+  struct expansion_step *step;
+
+  if (e->nsteps == e->maxsteps)
+    {
+      e->maxsteps = e->maxsteps ? e->maxsteps * 2 : 4;
+      e->steps = xrealloc (e->steps,
+                           e->maxsteps * sizeof (struct expansion_step));
+    }
+
+  step = &e->steps[e->nsteps++];
+  memset (step, 0, sizeof (struct expansion_step));
+  step->op = op;
+  return step;
+}
+
+static void
+add_text (struct expansion *e, enum expansion_op op,
+          const char *text, size_t length)
+{
+  struct expansion_step *step = add_step (e, op);
+
+  step->text = text;
+  step->length = length;
+}
+
+/* Compile the text of E, following variable_expand_string step by step.
+   Return zero if it must be interpreted instead.  */
+
+static int
+compile_steps (struct expansion *e)
+{
+  const char *p = e->text;
+  const char *end = e->text + e->length;
+
+  while (1)
+    {
+      const char *p1 = memchr (p, '$', end - p);
+      size_t length = (p1 != 0 ? p1 : end) - p;
+
+      if (length > 0)
+        add_text (e, EXP_TEXT, p, length);
+
+      if (p1 == 0)
+        break;
+      p = p1 + 1;
+
+      switch (*p)
+        {
+        case '$':
+        case '\0':
+          add_text (e, EXP_TEXT, p1, 1);
+          break;
+
+        case '(':
+        case '{':
+          {
+            char openparen = *p;
+            char closeparen = (openparen == '(') ? ')' : '}';
+            const char *beg = p + 1;
+            const char *begp = p;
+            const char *vend;
+            struct function_call *call;
+            int r;
+
+            r = compile_function (&begp, &call);
+            if (r < 0)
+              return 0;
+            if (r > 0)
+              {
+                add_step (e, EXP_FUNCTION)->call = call;
+                p = begp;
+                break;
+              }
+
+            vend = strchr (beg, closeparen);
+            if (vend == 0)
+              return 0;
+
+            if (lindex (beg, vend, '$') != 0)
+              {
+                /* A computed name: compile the text making it up.  */
+                struct expansion *sub;
+                int count = 0;
+
+                for (p = beg; *p != '\0'; ++p)
+                  if (*p == openparen)
+                    ++count;
+                  else if (*p == closeparen && --count < 0)
+                    break;
+                if (count >= 0)
+                  return 0;
+
+                sub = compile_expansion (beg, p - beg);
+                if (sub == 0)
+                  return 0;
+                add_step (e, EXP_COMPUTED)->sub = sub;
+              }
+            else
+              {
+                const char *colon = lindex (beg, vend, ':');
+
+                add_text (e, (colon && lindex (colon + 1, vend, '=')
+                              ? EXP_REFERENCE : EXP_VARIABLE),
+                          beg, vend - beg);
+                p = vend;
+              }
+          }
+          break;
+
+        default:
+          add_text (e, EXP_VARIABLE, p, 1);
+          break;
+        }
+
+      if (*p == '\0')
+        break;
+
+      ++p;
+    }
+
+  return 1;
+}
+
+/* Compile the LENGTH chars at TEXT.  Return NULL if the text must be left
+   to variable_expand_string.  */
+
+struct expansion *
+compile_expansion (const char *text, size_t length)
+{
+  struct expansion *e = new_expansion (text, length);
+
+  if (!compile_steps (e))
+    {
+      release_expansion (e);
+      return NULL;
+    }
+
+  return e;
+}
+
+/* Drop a reference to E, freeing it with the last one.  */
+
+void
+release_expansion (struct expansion *e)
+{
+  unsigned int i;
+
+  if (e == 0 || --e->refs > 0)
+    return;
+
+  for (i = 0; i < e->nsteps; ++i)
+    {
+      release_expansion (e->steps[i].sub);
+      if (e->steps[i].call)
+        free_function_call (e->steps[i].call);
+    }
+
+  free (e->steps);
+  free (e->text);
+  free (e);
+}
+
+/* Return the expansion of TEXT kept in *EP, compiling it again if TEXT is
+   not what it was compiled from.  */
+
+static struct expansion *
+expansion_of (struct expansion **ep, const char *text)
+{
+  size_t length = strlen (text);
+  struct expansion *e = *ep;
+
+  if (e && (e->length != length || memcmp (e->text, text, length) != 0))
+    {
+      release_expansion (e);
+      e = NULL;
+    }
+
+  if (e == 0)
+    {
+      e = compile_expansion (text, length);
+      if (e == 0)
+        {
+          e = new_expansion (text, length);
+          e->interpret = 1;
+        }
+      *ep = e;
+    }
+
+  return e;
+}
+
+/* Expand E into the variable buffer at O.  Return the end of the output,
+   which is not null-terminated.  */
+
+char *
+run_expansion (char *o, struct expansion *e)
+{
+  unsigned int i;
+
+  if (e->interpret || e->generation != function_generation)
+    {
+      /* A function may have been defined since E was compiled.  */
+      if (e->length == 0)
+        return o;
+      o = variable_expand_string (o, e->text, e->length);
+      return o + strlen (o);
+    }
+
+  /* Keep E, even if running it redefines the variable it came from.  */
+  ++e->refs;
+
+  for (i = 0; i < e->nsteps; ++i)
+    {
+      const struct expansion_step *step = &e->steps[i];
+
+      switch (step->op)
+        {
+        case EXP_TEXT:
+          o = variable_buffer_output (o, step->text, step->length);
+          break;
+
+        case EXP_VARIABLE:
+          o = reference_variable (o, step->text, step->length);
+          break;
+
+        case EXP_REFERENCE:
+          o = expand_reference (o, step->text, step->text + step->length);
+          break;
+
+        case EXP_COMPUTED:
+          {
+            char *name = allocated_expansion (step->sub);
+            o = expand_reference (o, name, name + strlen (name));
+            free (name);
+          }
+          break;
+
+        case EXP_FUNCTION:
+          o = run_function (o, step->call);
+          break;
+        }
+    }
+
+  release_expansion (e);
+
+  return o;
+}
+
+/* Like allocated_variable_expand, for an expansion.  */
+
+char *
+allocated_expansion (struct expansion *e)
+{
+  char *value;
+  char *o;
+
+  char *obuf = variable_buffer;
+  size_t olen = variable_buffer_length;
+
+  variable_buffer = 0;
+
+  o = run_expansion (initialize_variable_output (), e);
+  variable_buffer_output (o, "", 1);
+  value = variable_buffer;
+
+  variable_buffer = obuf;
+  variable_buffer_length = olen;
+
+  return value;
+}
+
 /* Expand LINE for FILE.  Error messages refer to the file and line where
    FILE's commands were found.  Expansion uses FILE's variable set list.  */
 
@@ -512,7 +1044,7 @@ static char *
 variable_append (const char *name, size_t length,
                  const struct variable_set_list *set, int local)
 {
-  const struct variable *v;
+  struct variable *v;
   char *buf = 0;
   int nextlocal;
 
@@ -546,8 +1078,7 @@ variable_append (const char *name, size_t length,
   if (! v->recursive)
     return variable_buffer_output (buf, v->value, strlen (v->value));
 
-  buf = variable_expand_string (buf, v->value, strlen (v->value));
-  return (buf + strlen (buf));
+  return run_expansion (buf, expansion_of (&v->exp_prog, v->value));
 }
 
 
@@ -595,6 +1126,37 @@ allocated_variable_expand_for_file (const char *line, struct file *file)
   return value;
 }
 
+/* Like allocated_variable_expand_for_file, but keep LINE compiled in *EP
+   for the next time.  */
+
+char *
+allocated_expansion_for_file (struct expansion **ep, const char *line,
+                              struct file *file)
+{
+  char *value;
+  struct variable_set_list *savev;
+  const floc *savef;
+
+  if (file == 0)
+    return allocated_expansion (expansion_of (ep, line));
+
+  savev = current_variable_set_list;
+  current_variable_set_list = file->variables;
+
+  savef = reading_file;
+  if (file->cmds && file->cmds->fileinfo.filenm)
+    reading_file = &file->cmds->fileinfo;
+  else
+    reading_file = 0;
+
+  value = allocated_expansion (expansion_of (ep, line));
+
+  current_variable_set_list = savev;
+  reading_file = savef;
+
+  return value;
+}
+
 /* Install a new variable_buffer context, returning the current one for
    safe-keeping.  */
 
@@ -26,6 +26,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "debug.h"
 #include "hash.h"
 #include "shuffle.h"
+#include "submake.h"
 
 
 /* Remember whether snap_deps has been invoked: we need this to be sure we
@@ -60,6 +61,9 @@ file_hash_cmp (const void *x, const void *y)
 
 static struct hash_table files;
 
+/* File records are never freed, so they are carved out of an arena.  */
+struct arena file_arena;
+
 /* Whether or not .SECONDARY with no prerequisites was given.  */
 static int all_secondary = 0;
 
@@ -130,6 +134,12 @@ lookup_file (const char *name)
         name = "[]";
 #endif
     }
+
+  /* Names in the makefiles of an inlined sub-make are relative to its
+     directory.  */
+  if (submake_names)
+    name = submake_file_name (name);
+
   file_key.hname = name;
   f = hash_find_item (&files, &file_key);
 #if defined(VMS) && !defined(WANT_CASE_SENSITIVE_TARGETS)
@@ -137,6 +147,10 @@ lookup_file (const char *name)
     free (lname);
 #endif
 
+  /* The makefiles of a sub-make may change it.  */
+  if (f && reading_submake)
+    submake_save_file (f);
+
   return f;
 }
 
@@ -174,18 +188,30 @@ enter_file (const char *name)
     }
 #endif
 
+  if (submake_names)
+    name = submake_file_name (name);
+
   file_key.hname = name;
   file_slot = (struct file **) hash_find_slot (&files, &file_key);
   f = *file_slot;
+  if (! HASH_VACANT (f) && reading_submake)
+    {
+      submake_save_file (f);
+      submake_save_file (f->last);
+    }
+
   if (! HASH_VACANT (f) && !f->double_colon)
     {
       f->builtin = 0;
       return f;
     }
 
-  new = xcalloc (sizeof (struct file));
+  new = arena_alloc (&file_arena, sizeof (struct file));
   new->name = new->hname = name;
   new->update_status = us_none;
+  new->submake = current_submake;
+  if (reading_submake)
+    submake_new_file (new);
 
   if (HASH_VACANT (f))
     {
@@ -202,6 +228,18 @@ enter_file (const char *name)
 
   return new;
 }
+
+/* Remove FILE, entered by enter_file, from the table of files.  It must not
+   be referred to any more.  */
+
+void
+forget_file (struct file *file)
+{
+  struct file **file_slot = (struct file **) hash_find_slot (&files, file);
+
+  if (*file_slot == file)
+    hash_delete_at (&files, file_slot);
+}
 
 /* Rehash FILE to NAME.  This is not as simple as resetting
    the 'hname' member, since it must be put in a new hash bucket,
@@ -717,6 +755,10 @@ snap_file (const void *item, void *arg)
   struct file *f = (struct file*)item;
   struct dep *prereqs = NULL;
 
+  /* The files of other sub-makes were snapped when they were read.  */
+  if (f->submake != current_submake)
+    return;
+
   /* If we're not doing second expansion then reset updating.  */
   if (!second_expansion)
     f->updating = 0;
@@ -807,6 +849,8 @@ snap_deps (void)
           for (f2 = d->file; f2 != 0; f2 = f2->prev)
             f2->notintermediate = 1;
     /* .NOTINTERMEDIATE with no deps marks all files as notintermediate.  */
+    else if (current_submake)
+      submake_abandon (".NOTINTERMEDIATE");
     else
       no_intermediates = 1;
 
@@ -842,6 +886,8 @@ snap_deps (void)
         else
           f2->intermediate = f2->secondary = 1;
     /* .SECONDARY with no deps listed marks *all* files that way.  */
+    else if (current_submake)
+      submake_abandon (".SECONDARY");
     else
       all_secondary = 1;
 
@@ -851,12 +897,19 @@ snap_deps (void)
 
   f = lookup_file (".EXPORT_ALL_VARIABLES");
   if (f != 0 && f->is_target)
-    export_all_variables = 1;
+    {
+      if (current_submake)
+        submake_abandon (".EXPORT_ALL_VARIABLES");
+      else
+        export_all_variables = 1;
+    }
 
   f = lookup_file (".IGNORE");
   if (f != 0 && f->is_target)
     {
-      if (f->deps == 0)
+      if (f->deps == 0 && current_submake)
+        submake_abandon (".IGNORE");
+      else if (f->deps == 0)
         ignore_errors_flag = 1;
       else
         for (d = f->deps; d != 0; d = d->next)
@@ -867,7 +920,9 @@ snap_deps (void)
   f = lookup_file (".SILENT");
   if (f != 0 && f->is_target)
     {
-      if (f->deps == 0)
+      if (f->deps == 0 && current_submake)
+        submake_abandon (".SILENT");
+      else if (f->deps == 0)
         run_silent = 1;
       else
         for (d = f->deps; d != 0; d = d->next)
@@ -880,7 +935,9 @@ snap_deps (void)
     {
       struct dep *d2;
 
-      if (!f->deps)
+      if (!f->deps && current_submake)
+        submake_abandon (".NOTPARALLEL");
+      else if (!f->deps)
         not_parallel = 1;
       else
         /* Set a wait point between every prerequisite of each target.  */
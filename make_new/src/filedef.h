@@ -25,6 +25,7 @@ struct commands;
 struct dep;
 struct variable;
 struct variable_set_list;
+struct submake;
 
 struct file
   {
@@ -60,6 +61,19 @@ struct file
        the same file.  Otherwise this is null.  */
     struct file *double_colon;
 
+    /* For --graph-schedule: the files waiting for this one to finish,
+       chained through their 'file' members, and for a file that is waiting
+       itself, the goal and depth it was considered for.  */
+    struct dep *waiters;
+    struct dep *wait_goal;
+    unsigned long wait_order;   /* Order in which files started waiting.  */
+    unsigned int waiting;       /* Number of files it is waiting for.  */
+    unsigned int wait_depth;
+
+    /* For --inline-submake: the sub-make whose makefiles this file was read
+       from, or null for the top-level make.  */
+    struct submake *submake;
+
     FILE_TIMESTAMP last_mtime;  /* File's modtime, if already known.  */
     FILE_TIMESTAMP mtime_before_update; /* File's modtime before any updating
                                            has been performed.  */
@@ -113,14 +127,24 @@ struct file
                                     --shuffle passes through the graph.  */
     unsigned int snapped:1;     /* True if the deps of this file have been
                                    secondary expanded.  */
+    unsigned int ready:1;       /* True if it is in the --graph-schedule
+                                   queue of files ready to be looked at.  */
+    unsigned int inlined:1;     /* True if its recursive make was evaluated
+                                   in this process: the goals of the sub-make
+                                   were added to its prerequisites.  */
+    unsigned int saved:1;       /* True if a copy is kept while the makefiles
+                                   of a sub-make are read; see
+                                   submake_save_file.  */
   };
 
 
 extern struct file *default_file;
+extern struct arena file_arena;
 
 
 struct file *lookup_file (const char *name);
 struct file *enter_file (const char *name);
+void forget_file (struct file *file);
 struct dep *split_prereqs (char *prereqstr);
 struct dep *enter_prereqs (struct dep *prereqs, const char *stem);
 void expand_deps (struct file *f);
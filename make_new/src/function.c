@@ -23,6 +23,12 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "debug.h"
 
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#else
+# include <sys/file.h>
+#endif
+
 #ifdef _AMIGA
 #include "amiga.h"
 #endif
@@ -69,6 +75,10 @@ function_table_entry_hash_cmp (const void *xv, const void *yv)
 }
 
 static struct hash_table function_table;
+
+/* Incremented whenever a function is defined after startup: compiled calls
+   of a function may then refer to an entry that has been replaced.  */
+unsigned long function_generation = 0;
 
 
 /* Store into VARIABLE_BUFFER at O the result of scanning TEXT and replacing
@@ -134,6 +144,108 @@ subst_expand (char *o, const char *text, const char *subst, const char *replace,
 }
 
 
+/* Word lists.
+
+   The functions that work on long lists of words (patsubst, filter,
+   filter-out and sort) find the words with next_word, which knows where
+   the text ends and so can look for the end of a word eight bytes at a
+   time: as long as every character in MAP_SPACE is below '!', as in the C
+   locale, a word ends at the first byte below '!'.  */
+
+#define WORD_ONES  0x0101010101010101ULL
+#define WORD_HIGHS 0x8080808080808080ULL
+
+/* 1 if the test above works for the current stopchar_map, 0 if not, -1 if
+   not known yet.  */
+static int word_scan_fast = -1;
+
+static int
+check_word_scan (void)
+{
+  int c;
+
+  for (c = '!'; c <= UCHAR_MAX; ++c)
+    if (ISSPACE (c))
+      return 0;
+
+  return sizeof (unsigned long long) == 8;
+}
+
+/* Find the next word in *PTR, which ends at END; return the address of it,
+   or NULL if there are no more words, and store its length in *LENGTHPTR.
+   Set *PTR to the end of the word.  */
+
+static char *
+next_word (const char **ptr, const char *end, size_t *lengthptr)
+{
+  const char *p = *ptr;
+  const char *w;
+
+  while (p < end && ISSPACE (*p))
+    ++p;
+  if (p == end)
+    return NULL;
+  w = p;
+
+  if (word_scan_fast < 0)
+    word_scan_fast = check_word_scan ();
+
+  if (word_scan_fast)
+    while (end - p >= 8)
+      {
+        unsigned long long x;
+        memcpy (&x, p, 8);
+        /* Nonzero if any byte of X is below '!'.  */
+        if (((x - WORD_ONES * '!') & ~x & WORD_HIGHS) != 0)
+          break;
+        p += 8;
+      }
+
+  while (p < end && !ISSPACE (*p))
+    ++p;
+
+  *ptr = p;
+  if (lengthptr)
+    *lengthptr = p - w;
+  return (char *) w;
+}
+
+struct word
+{
+  char *str;
+  size_t length;
+};
+
+/* Return the words of TEXT, which is LENGTH chars long, in a malloc'd
+   array, and store their number in *COUNTP.  */
+
+static struct word *
+find_words (char *text, size_t length, size_t *countp)
+{
+  const char *t = text;
+  const char *end = text + length;
+  struct word *words = NULL;
+  size_t count = 0;
+  size_t max = 0;
+  char *w;
+  size_t len;
+
+  while ((w = next_word (&t, end, &len)) != NULL)
+    {
+      if (count == max)
+        {
+          max = max ? max * 2 : 64;
+          words = xrealloc (words, max * sizeof (struct word));
+        }
+      words[count].str = w;
+      words[count].length = len;
+      ++count;
+    }
+
+  *countp = count;
+  return words;
+}
+
 /* Store into VARIABLE_BUFFER at O the result of scanning TEXT
    and replacing strings matching PATTERN with REPLACE.
    If PATTERN_PERCENT is not nil, PATTERN has already been
@@ -152,6 +264,7 @@ patsubst_expand_pat (char *o, const char *text,
   size_t pattern_prepercent_len, pattern_postpercent_len;
   size_t replace_prepercent_len, replace_postpercent_len;
   const char *t;
+  const char *end;
   size_t len;
   int doneany = 0;
 
@@ -178,7 +291,8 @@ patsubst_expand_pat (char *o, const char *text,
   pattern_prepercent_len = pattern_percent - pattern - 1;
   pattern_postpercent_len = strlen (pattern_percent);
 
-  while ((t = find_next_token (&text, &len)) != 0)
+  end = text + strlen (text);
+  while ((t = next_word (&text, end, &len)) != 0)
     {
       int fail = 0;
 
@@ -391,7 +505,7 @@ string_glob (char *line)
 
       /* Because we used PARSEFS_NOCACHE above, we have to free() NAME.  */
       free ((char *)chain->name);
-      free (chain);
+      free_ns (chain);
       chain = next;
     }
 
@@ -877,6 +991,8 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
   const char *p;
   size_t len;
   struct variable *var;
+  struct expansion *prog = NULL;
+  int compiled = 0;
 
   /* Clean up the variable name by removing whitespace.  */
   char *vp = next_token (varname);
@@ -893,7 +1009,15 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
       free (var->value);
       var->value = xstrndup (p, len);
 
-      result = allocated_variable_expand (body);
+      /* From the second word on, do not parse BODY again.  */
+      if (doneany && !compiled)
+        {
+          prog = compile_expansion (body, strlen (body));
+          compiled = 1;
+        }
+
+      result = (prog ? allocated_expansion (prog)
+                : allocated_variable_expand (body));
 
       o = variable_buffer_output (o, result, strlen (result));
       o = variable_buffer_output (o, " ", 1);
@@ -905,6 +1029,7 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
     /* Kill the last space.  */
     --o;
 
+  release_expansion (prog);
   pop_variable_scope ();
   free (varname);
   free (list);
@@ -973,13 +1098,15 @@ struct a_word
 static unsigned long
 a_word_hash_1 (const void *key)
 {
-  return_STRING_HASH_1 (((struct a_word const *) key)->str);
+  const struct a_word *w = key;
+  return_STRING_N_HASH_1 (w->str, w->length);
 }
 
 static unsigned long
 a_word_hash_2 (const void *key)
 {
-  return_STRING_HASH_2 (((struct a_word const *) key)->str);
+  const struct a_word *w = key;
+  return_STRING_N_HASH_2 (w->str, w->length);
 }
 
 static int
@@ -996,11 +1123,134 @@ a_word_hash_cmp (const void *x, const void *y)
 
 struct a_pattern
 {
+  struct a_pattern *chain;
   char *str;
   char *percent;
   size_t length;
+  /* For a % pattern in a pattern index: the part before the % or the part
+     after it, whichever is longer.  */
+  const char *key;
+  size_t keylen;
 };
 
+static unsigned long
+a_pattern_hash_1 (const void *key)
+{
+  const struct a_pattern *pp = key;
+  return_STRING_N_HASH_1 (pp->key, pp->keylen);
+}
+
+static unsigned long
+a_pattern_hash_2 (const void *key)
+{
+  const struct a_pattern *pp = key;
+  return_STRING_N_HASH_2 (pp->key, pp->keylen);
+}
+
+static int
+a_pattern_hash_cmp (const void *x, const void *y)
+{
+  const struct a_pattern *px = x;
+  const struct a_pattern *py = y;
+
+  if (px->keylen != py->keylen)
+    return px->keylen > py->keylen ? 1 : -1;
+
+  return_STRING_N_COMPARE (px->key, py->key, px->keylen);
+}
+
+/* Return nonzero if the % pattern PP matches the word WP.  */
+
+static int
+a_pattern_matches (const struct a_pattern *pp, const struct a_word *wp)
+{
+  size_t prelen = pp->percent - pp->str;
+  size_t suflen = pp->length - prelen - 1;
+
+  return (wp->length >= prelen + suflen
+          && memcmp (pp->str, wp->str, prelen) == 0
+          && memcmp (pp->percent + 1, wp->str + wp->length - suflen,
+                     suflen) == 0);
+}
+
+/* An index of % patterns by their prefixes or suffixes: to find the
+   patterns that match a word, look up the start (or end) of the word for
+   each of the key lengths in the index.  */
+
+struct pattern_index
+{
+  struct hash_table table;
+  size_t *lengths;
+  size_t nlengths;
+  int suffix;
+};
+
+static void
+pattern_index_init (struct pattern_index *pi, unsigned long size, int suffix)
+{
+  hash_init (&pi->table, size, a_pattern_hash_1, a_pattern_hash_2,
+             a_pattern_hash_cmp);
+  pi->lengths = NULL;
+  pi->nlengths = 0;
+  pi->suffix = suffix;
+}
+
+static void
+pattern_index_add (struct pattern_index *pi, struct a_pattern *pp,
+                   const char *key, size_t keylen)
+{
+  struct a_pattern *opp;
+
+  pp->key = key;
+  pp->keylen = keylen;
+  opp = hash_insert (&pi->table, pp);
+  pp->chain = opp;
+  if (opp == 0)
+    {
+      size_t i;
+      for (i = 0; i < pi->nlengths; ++i)
+        if (pi->lengths[i] == keylen)
+          break;
+      if (i == pi->nlengths)
+        {
+          pi->lengths = xrealloc (pi->lengths,
+                                  (pi->nlengths + 1) * sizeof (size_t));
+          pi->lengths[pi->nlengths++] = keylen;
+        }
+    }
+}
+
+static int
+pattern_index_matches (const struct pattern_index *pi,
+                       const struct a_word *wp)
+{
+  size_t i;
+
+  for (i = 0; i < pi->nlengths; ++i)
+    {
+      struct a_pattern key;
+      struct a_pattern *pp;
+
+      key.keylen = pi->lengths[i];
+      if (key.keylen > wp->length)
+        continue;
+      key.key = pi->suffix ? wp->str + wp->length - key.keylen : wp->str;
+      for (pp = hash_find_item ((struct hash_table *) &pi->table, &key);
+           pp != 0; pp = pp->chain)
+        if (a_pattern_matches (pp, wp))
+          return 1;
+    }
+
+  return 0;
+}
+
+static void
+pattern_index_free (struct pattern_index *pi)
+{
+  hash_free (&pi->table, 0);
+  free (pi->lengths);
+}
+
 static char *
 func_filter_filterout (char *o, char **argv, const char *funcname)
 {
@@ -1013,17 +1263,22 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
   unsigned long pat_count = 0, word_count = 0;
 
   struct hash_table a_word_table;
+  struct pattern_index prefixes;
+  struct pattern_index suffixes;
   int is_filter = funcname[CSTRLEN ("filter")] == '\0';
   const char *cp;
-  int literals = 0;
+  const char *end;
+  unsigned long literals = 0;
   int hashing = 0;
+  int indexing = 0;
   char *p;
   size_t len;
   int doneany = 0;
 
   /* Find the number of words and get memory for them.  */
   cp = argv[1];
-  while ((p = find_next_token (&cp, NULL)) != 0)
+  end = cp + strlen (cp);
+  while ((p = next_word (&cp, end, NULL)) != 0)
     ++word_count;
 
   if (!word_count)
@@ -1034,7 +1289,8 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
 
   /* Find the number of patterns and get memory for them.  */
   cp = argv[0];
-  while ((p = find_next_token (&cp, NULL)) != 0)
+  end = cp + strlen (cp);
+  while ((p = next_word (&cp, end, NULL)) != 0)
     ++pat_count;
 
   patterns = xcalloc (pat_count * sizeof (struct a_pattern));
@@ -1044,9 +1300,9 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
 
   cp = argv[0];
   pp = patterns;
-  while ((p = find_next_token (&cp, &len)) != 0)
+  while ((p = next_word (&cp, end, &len)) != 0)
     {
-      if (*cp != '\0')
+      if (cp < end)
         ++cp;
 
       p[len] = '\0';
@@ -1063,13 +1319,10 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
   /* Chop ARGV[1] up into words to match against the patterns.  */
 
   cp = argv[1];
+  end = cp + strlen (cp);
   wp = words;
-  while ((p = find_next_token (&cp, &len)) != 0)
+  while ((p = next_word (&cp, end, &len)) != 0)
     {
-      if (*cp != '\0')
-        ++cp;
-
-      p[len] = '\0';
       wp->str = p;
       wp->length = len;
       ++wp;
@@ -1089,12 +1342,49 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
         }
     }
 
+  /* Likewise for indexing the % patterns: then each word is looked up in
+     the index, instead of run through each of them.  */
+  indexing = (pat_count - literals > 1
+              && ((pat_count - literals) * word_count) >= 10);
+  if (indexing)
+    {
+      unsigned long count = pat_count - literals;
+
+      pattern_index_init (&prefixes, count, 0);
+      pattern_index_init (&suffixes, count, 1);
+      for (pp = patterns; pp < pat_end; ++pp)
+        if (pp->percent)
+          {
+            size_t prelen = pp->percent - pp->str;
+            size_t suflen = pp->length - prelen - 1;
+
+            if (suflen >= prelen)
+              pattern_index_add (&suffixes, pp, pp->percent + 1, suflen);
+            else
+              pattern_index_add (&prefixes, pp, pp->str, prelen);
+          }
+
+      /* A lookup costs a few comparisons: give up on the index if there
+         are nearly as many key lengths to look up as patterns.  */
+      indexing = (suffixes.nlengths + prefixes.nlengths) * 3 < count;
+      if (indexing)
+        for (wp = words; wp < word_end; ++wp)
+          wp->matched = (pattern_index_matches (&suffixes, wp)
+                         || pattern_index_matches (&prefixes, wp));
+
+      pattern_index_free (&prefixes);
+      pattern_index_free (&suffixes);
+    }
+
   /* Run each pattern through the words, killing words.  */
   for (pp = patterns; pp < pat_end; ++pp)
     {
       if (pp->percent)
-        for (wp = words; wp < word_end; ++wp)
-          wp->matched |= pattern_matches (pp->str, pp->percent, wp->str);
+        {
+          if (!indexing)
+            for (wp = words; wp < word_end; ++wp)
+              wp->matched |= a_pattern_matches (pp, wp);
+        }
       else if (hashing)
         {
           struct a_word a_word_key;
@@ -1117,7 +1407,7 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
   for (wp = words; wp < word_end; ++wp)
     if (is_filter ? wp->matched : !wp->matched)
       {
-        o = variable_buffer_output (o, wp->str, strlen (wp->str));
+        o = variable_buffer_output (o, wp->str, wp->length);
         o = variable_buffer_output (o, " ", 1);
         doneany = 1;
       }
@@ -1200,58 +1490,182 @@ func_error (char *o, char **argv, const char *funcname)
 }
 
 
-/*
-  chop argv[0] into words, and sort them.
- */
-static char *
-func_sort (char *o, char **argv, const char *funcname UNUSED)
+/* Compare the words X and Y as alpha_compare compares strings.  */
+
+static int
+word_compare (const void *x, const void *y)
 {
-  const char *t;
-  char **words;
-  int wordi;
-  char *p;
-  size_t len;
+  const struct word *a = x;
+  const struct word *b = y;
+  int r;
 
-  /* Find the maximum number of words we'll have.  */
-  t = argv[0];
-  wordi = 0;
-  while ((p = find_next_token (&t, NULL)) != 0)
+  if (a->str[0] != b->str[0])
+    return a->str[0] - b->str[0];
+
+  r = memcmp (a->str, b->str, a->length < b->length ? a->length : b->length);
+  if (r != 0)
+    return r;
+
+  return a->length < b->length ? -1 : a->length > b->length;
+}
+
+/* Compare the words X and Y, which are equal in their first DEPTH > 0
+   bytes.  */
+
+static int
+word_compare_from (const struct word *a, const struct word *b, size_t depth)
+{
+  size_t n = a->length < b->length ? a->length : b->length;
+  int r = memcmp (a->str + depth, b->str + depth, n - depth);
+
+  if (r != 0)
+    return r;
+
+  return a->length < b->length ? -1 : a->length > b->length;
+}
+
+/* The sort key of byte DEPTH of W: 0 past its end, else one more than the
+   byte; the first byte is compared as a char, like alpha_compare does.  */
+
+static unsigned int
+word_key (const struct word *w, size_t depth)
+{
+  unsigned int c;
+
+  if (depth == w->length)
+    return 0;
+
+  c = (unsigned char) w->str[depth];
+#if CHAR_MIN < 0
+  if (depth == 0)
+    c ^= 0x80;
+#endif
+  return c + 1;
+}
+
+#define WORD_SORT_SMALL 16
+#define WORD_SORT_LEVELS 16
+
+/* Sort the COUNT words in WORDS, which are all equal in their first DEPTH
+   bytes, by a most significant byte first radix sort into TMP.  LEVEL
+   counts the recursion so that it can give up on pathological input.  */
+
+static void
+word_sort (struct word *words, struct word *tmp, size_t count, size_t depth,
+           unsigned int level)
+{
+  size_t counts[UCHAR_MAX + 2];
+  size_t starts[UCHAR_MAX + 2];
+  size_t common;
+  size_t i;
+  unsigned int k;
+
+  if (level > WORD_SORT_LEVELS)
     {
-      ++t;
-      ++wordi;
+      qsort (words, count, sizeof (struct word), word_compare);
+      return;
     }
 
-  words = xmalloc ((wordi == 0 ? 1 : wordi) * sizeof (char *));
-
-  /* Now assign pointers to each string in the array.  */
-  t = argv[0];
-  wordi = 0;
-  while ((p = find_next_token (&t, &len)) != 0)
+  if (count < WORD_SORT_SMALL && depth > 0)
     {
-      ++t;
-      p[len] = '\0';
-      words[wordi++] = p;
+      for (i = 1; i < count; ++i)
+        {
+          struct word w = words[i];
+          size_t j = i;
+
+          while (j > 0 && word_compare_from (&words[j - 1], &w, depth) > 0)
+            {
+              words[j] = words[j - 1];
+              --j;
+            }
+          words[j] = w;
+        }
+      return;
     }
 
-  if (wordi)
+  /* Skip any bytes all the words have in common.  */
+  common = words[0].length - depth;
+  for (i = 1; i < count && common > 0; ++i)
     {
-      int i;
+      const char *a = words[0].str + depth;
+      const char *b = words[i].str + depth;
+      size_t max = words[i].length - depth;
+      size_t n = 0;
 
-      /* Now sort the list of words.  */
-      qsort (words, wordi, sizeof (char *), alpha_compare);
+      if (max > common)
+        max = common;
+      while (max - n >= 8)
+        {
+          unsigned long long x, y;
+          memcpy (&x, a + n, 8);
+          memcpy (&y, b + n, 8);
+          if (x != y)
+            break;
+          n += 8;
+        }
+      while (n < max && a[n] == b[n])
+        ++n;
+      common = n;
+    }
+  depth += common;
 
-      /* Now write the sorted list, uniquified.  */
-      for (i = 0; i < wordi; ++i)
+  memset (counts, 0, sizeof (counts));
+  for (i = 0; i < count; ++i)
+    ++counts[word_key (&words[i], depth)];
+
+  if (counts[0] == count)
+    return;
+
+  starts[0] = 0;
+  for (k = 1; k <= UCHAR_MAX + 1; ++k)
+    starts[k] = starts[k - 1] + counts[k - 1];
+
+  for (i = 0; i < count; ++i)
+    tmp[starts[word_key (&words[i], depth)]++] = words[i];
+  memcpy (words, tmp, count * sizeof (struct word));
+
+  /* The words that end here are all equal; sort the rest of each bucket on
+     the next byte.  */
+  for (i = counts[0], k = 1; k <= UCHAR_MAX + 1; i += counts[k++])
+    if (counts[k] > 1)
+      word_sort (words + i, tmp, counts[k], depth + 1, level + 1);
+}
+
+/*
+  chop argv[0] into words, and sort them.
+ */
+static char *
+func_sort (char *o, char **argv, const char *funcname UNUSED)
+{
+  struct word *words;
+  size_t count;
+
+  words = find_words (argv[0], strlen (argv[0]), &count);
+
+  if (count)
+    {
+      size_t i;
+
+      /* Now sort the list of words, unless it is sorted already.  */
+      for (i = 1; i < count; ++i)
+        if (word_compare (&words[i - 1], &words[i]) > 0)
+          break;
+      if (i < count)
         {
-          len = strlen (words[i]);
-          if (i == wordi - 1 || strlen (words[i + 1]) != len
-              || memcmp (words[i], words[i + 1], len))
-            {
-              o = variable_buffer_output (o, words[i], len);
-              o = variable_buffer_output (o, " ", 1);
-            }
+          struct word *tmp = xmalloc (count * sizeof (struct word));
+          word_sort (words, tmp, count, 0, 0);
+          free (tmp);
         }
 
+      /* Now write the sorted list, uniquified.  */
+      for (i = 0; i < count; ++i)
+        if (i == count - 1 || words[i + 1].length != words[i].length
+            || memcmp (words[i].str, words[i + 1].str, words[i].length))
+          {
+            o = variable_buffer_output (o, words[i].str, words[i].length);
+            o = variable_buffer_output (o, " ", 1);
+          }
+
       /* Kill the last space.  */
       --o;
     }
@@ -1832,6 +2246,7 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 }
 
 #define func_shell 0
+#define func_shell_cached 0
 
 #else
 #ifndef _AMIGA
@@ -2101,6 +2516,361 @@ func_shell (char *o, char **argv, const char *funcname UNUSED)
 {
   return func_shell_base (o, argv, 1);
 }
+
+/* $(shell-cached COMMAND[,FILES]) remembers the output of COMMAND.  Results
+   are keyed on the command, the directory make started in and the values of
+   PATH and of the variables named in .SHELL_CACHE_ENV.  They are reused
+   until they are older than .SHELL_CACHE_TTL seconds, if that is set, or
+   until the modification time of one of FILES changes.  If .SHELL_CACHE
+   names a file, results are appended to it as they are computed and loaded
+   from it the first time, so that later runs and sub-makes share them.
+   Only the output of commands that succeed is remembered.  */
+
+struct shell_cache_entry
+  {
+    char *key;
+    char *result;
+    char *stamps;               /* The modification times of FILES.  */
+    time_t time;                /* When the command was run.  */
+  };
+
+static struct hash_table shell_cache;
+
+/* The file the cache was loaded from; NULL until it is loaded.  */
+static char *shell_cache_file;
+
+/* The records read from it, to tell when rewriting it is worth it.  */
+static unsigned long shell_cache_records;
+
+static unsigned long
+shell_cache_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((const struct shell_cache_entry *) key)->key);
+}
+
+static unsigned long
+shell_cache_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((const struct shell_cache_entry *) key)->key);
+}
+
+static int
+shell_cache_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((const struct shell_cache_entry *) x)->key,
+                         ((const struct shell_cache_entry *) y)->key);
+}
+
+/* Enter an entry for KEY into the cache, replacing any old one, and return
+   it.  The strings are taken over.  */
+
+static struct shell_cache_entry *
+shell_cache_enter (char *key, char *result, char *stamps, time_t time)
+{
+  struct shell_cache_entry ent_key;
+  struct shell_cache_entry **slot;
+  struct shell_cache_entry *ent;
+
+  ent_key.key = key;
+  slot = (struct shell_cache_entry **) hash_find_slot (&shell_cache, &ent_key);
+  ent = *slot;
+  if (HASH_VACANT (ent))
+    {
+      ent = xmalloc (sizeof (struct shell_cache_entry));
+      ent->key = key;
+      hash_insert_at (&shell_cache, ent, slot);
+    }
+  else
+    {
+      free (key);
+      free (ent->result);
+      free (ent->stamps);
+    }
+
+  ent->result = result;
+  ent->stamps = stamps;
+  ent->time = time;
+  return ent;
+}
+
+/* Return the record for ENT as it is stored in the cache file, in malloc'd
+   storage, and set *LENP to its length.  Records are
+     "E TIME KEYLEN RESULTLEN STAMPSLEN\n" KEY RESULT STAMPS "\n"
+   so that any text can be stored.  */
+
+static char *
+shell_cache_record (const struct shell_cache_entry *ent, size_t *lenp)
+{
+  size_t kl = strlen (ent->key);
+  size_t rl = strlen (ent->result);
+  size_t sl = strlen (ent->stamps);
+  char *rec = xmalloc (INTSTR_LENGTH * 4 + 8 + kl + rl + sl);
+  char *p = rec + sprintf (rec, "E %lu %lu %lu %lu\n",
+                           (unsigned long) ent->time, (unsigned long) kl,
+                           (unsigned long) rl, (unsigned long) sl);
+
+  p = mempcpy (p, ent->key, kl);
+  p = mempcpy (p, ent->result, rl);
+  p = mempcpy (p, ent->stamps, sl);
+  *(p++) = '\n';
+  *lenp = p - rec;
+  return rec;
+}
+
+/* Write the records of all entries to FILE, replacing it.  */
+
+static void
+shell_cache_rewrite (const char *file)
+{
+  char *tmp = xmalloc (strlen (file) + INTSTR_LENGTH + 2);
+  struct shell_cache_entry **slot;
+  struct shell_cache_entry **end;
+  FILE *fp;
+  int ok;
+
+  sprintf (tmp, "%s.%ld", file, (long) getpid ());
+  ENULLLOOP (fp, fopen (tmp, "wb"));
+  if (fp == NULL)
+    {
+      free (tmp);
+      return;
+    }
+
+  slot = (struct shell_cache_entry **) shell_cache.ht_vec;
+  end = slot + shell_cache.ht_size;
+  for (; slot < end; ++slot)
+    if (! HASH_VACANT (*slot))
+      {
+        size_t len;
+        char *rec = shell_cache_record (*slot, &len);
+        fwrite (rec, 1, len, fp);
+        free (rec);
+      }
+
+  ok = !ferror (fp);
+  if (fclose (fp) != 0 || !ok || rename (tmp, file) != 0)
+    unlink (tmp);
+  free (tmp);
+}
+
+/* Load the cache from FILE, if it was not loaded yet.  */
+
+static void
+shell_cache_load (const char *file)
+{
+  FILE *fp;
+  char *buf = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  const char *p;
+  const char *end;
+
+  if (shell_cache_file && streq (shell_cache_file, file))
+    return;
+
+  free (shell_cache_file);
+  shell_cache_file = xstrdup (file);
+  shell_cache_records = 0;
+
+  ENULLLOOP (fp, fopen (file, "rb"));
+  if (fp == NULL)
+    return;
+
+  while (1)
+    {
+      size_t n;
+      if (len == cap)
+        {
+          cap = cap ? cap * 2 : 8192;
+          buf = xrealloc (buf, cap);
+        }
+      n = fread (buf + len, 1, cap - len, fp);
+      if (n == 0)
+        break;
+      len += n;
+    }
+  fclose (fp);
+
+  /* Later records replace earlier ones.  Stop at anything unexpected, such
+     as a record cut short.  */
+  p = buf;
+  end = buf + len;
+  while (p < end)
+    {
+      const char *nl = memchr (p, '\n', end - p);
+      unsigned long t, kl, rl, sl;
+
+      if (!nl || sscanf (p, "E %lu %lu %lu %lu", &t, &kl, &rl, &sl) != 4)
+        break;
+      p = nl + 1;
+      if ((size_t) (end - p) < kl + rl + sl + 1 || p[kl + rl + sl] != '\n')
+        break;
+
+      shell_cache_enter (xstrndup (p, kl), xstrndup (p + kl, rl),
+                         xstrndup (p + kl + rl, sl), (time_t) t);
+      p += kl + rl + sl + 1;
+      ++shell_cache_records;
+    }
+
+  free (buf);
+
+  /* Drop the records that were replaced, once there are enough of them.  */
+  if (shell_cache_records > 2 * shell_cache.ht_fill + 64)
+    shell_cache_rewrite (file);
+}
+
+/* Append the record for ENT to the cache file, in a single write so that
+   several makes can share the file.  */
+
+static void
+shell_cache_save (const struct shell_cache_entry *ent)
+{
+  size_t len;
+  char *rec;
+  int fd;
+
+  if (!shell_cache_file)
+    return;
+
+  EINTRLOOP (fd, open (shell_cache_file, O_WRONLY|O_APPEND|O_CREAT, 0666));
+  if (fd < 0)
+    return;
+
+  rec = shell_cache_record (ent, &len);
+  if (write (fd, rec, len) == (ssize_t) len)
+    ++shell_cache_records;
+  close (fd);
+  free (rec);
+}
+
+/* Return the value of the variable NAME, LENGTH chars long, in malloc'd
+   storage.  */
+
+static char *
+shell_cache_value (const char *name, size_t length)
+{
+  struct variable *v = lookup_variable (name, length);
+
+  if (v == 0)
+    return xstrdup ("");
+  if (v->recursive)
+    return recursively_expand (v);
+  return xstrdup (v->value);
+}
+
+static char *
+func_shell_cached (char *o, char **argv, const char *funcname UNUSED)
+{
+  struct shell_cache_entry ent_key;
+  struct shell_cache_entry *ent;
+  char *file;
+  char *envnames;
+  char *stamps;
+  char *ttl;
+  const char *list;
+  const char *name;
+  size_t len;
+  size_t start;
+  time_t now = time (NULL);
+  struct variable *status;
+
+  if (shell_cache.ht_vec == 0)
+    hash_init (&shell_cache, 64, shell_cache_hash_1, shell_cache_hash_2,
+               shell_cache_hash_cmp);
+
+  file = shell_cache_value (STRING_SIZE_TUPLE (".SHELL_CACHE"));
+  if (file[0] != '\0')
+    shell_cache_load (file);
+  free (file);
+
+  /* The key: the command, the directory, the shell that runs it and the
+     relevant environment.  */
+  ent_key.key = xstrdup (concat (3, argv[0], "\n",
+                                 starting_directory ? starting_directory : ""));
+
+  {
+    char *names = shell_cache_value (STRING_SIZE_TUPLE (".SHELL_CACHE_ENV"));
+    envnames = xstrdup (concat (2, "PATH SHELL .SHELLFLAGS ", names));
+    free (names);
+  }
+  list = envnames;
+  while ((name = find_next_token (&list, &len)) != 0)
+    {
+      char *value = shell_cache_value (name, len);
+      char *key = xmalloc (strlen (ent_key.key) + len + strlen (value) + 3);
+      sprintf (key, "%s\n%.*s=%s", ent_key.key, (int) len, name, value);
+      free (ent_key.key);
+      free (value);
+      ent_key.key = key;
+    }
+  free (envnames);
+
+  /* The modification times of the files it depends on.  */
+  stamps = xstrdup ("");
+  if (argv[1])
+    {
+      list = argv[1];
+      while ((name = find_next_token (&list, &len)) != 0)
+        {
+          char *fn = xstrndup (name, len);
+          char buf[INTSTR_LENGTH + 2];
+          struct stat st;
+          int e;
+
+          buf[0] = ' ';
+          EINTRLOOP (e, stat (fn, &st));
+          if (e == 0)
+            make_ulltoa (FILE_TIMESTAMP_STAT_MODTIME (fn, st), buf + 1);
+          else
+            strcpy (buf + 1, "-");
+          stamps = xrealloc (stamps, strlen (stamps) + len + strlen (buf) + 2);
+          strcat (strncat (strcat (stamps, "\n"), fn, len), buf);
+          free (fn);
+        }
+    }
+
+  ent = hash_find_item (&shell_cache, &ent_key);
+  if (ent && streq (ent->stamps, stamps))
+    {
+      long limit;
+
+      ttl = shell_cache_value (STRING_SIZE_TUPLE (".SHELL_CACHE_TTL"));
+      limit = atol (ttl);
+      free (ttl);
+
+      if (limit <= 0 || now - ent->time <= limit)
+        {
+          DB (DB_VERBOSE, (_("Reusing the output of shell command: %s\n"),
+                           argv[0]));
+          free (ent_key.key);
+          free (stamps);
+          define_variable_cname (".SHELLSTATUS", "0", o_override, 0);
+          return variable_buffer_output (o, ent->result, strlen (ent->result));
+        }
+    }
+
+  /* Run it.  The output buffer may move.  */
+  start = o - variable_buffer;
+  o = func_shell_base (o, argv, 1);
+  ++command_count;
+
+  status = lookup_variable (STRING_SIZE_TUPLE (".SHELLSTATUS"));
+  if (status && streq (status->value, "0"))
+    {
+      ent = shell_cache_enter (ent_key.key,
+                               xstrndup (variable_buffer + start,
+                                         o - (variable_buffer + start)),
+                               stamps, now);
+      shell_cache_save (ent);
+    }
+  else
+    {
+      free (ent_key.key);
+      free (stamps);
+    }
+
+  return o;
+}
 #endif  /* !VMS */
 
 #ifdef EXPERIMENTAL
@@ -2485,6 +3255,7 @@ static struct function_table_entry function_table_init[] =
   FT_ENTRY ("patsubst",      3,  3,  1,  func_patsubst),
   FT_ENTRY ("realpath",      0,  1,  1,  func_realpath),
   FT_ENTRY ("shell",         0,  1,  1,  func_shell),
+  FT_ENTRY ("shell-cached",  1,  2,  1,  func_shell_cached),
   FT_ENTRY ("sort",          0,  1,  1,  func_sort),
   FT_ENTRY ("strip",         0,  1,  1,  func_strip),
   FT_ENTRY ("wildcard",      0,  1,  1,  func_wildcard),
@@ -2678,6 +3449,186 @@ handle_function (char **op, const char **stringp)
 }
 
 
+/* A call of a built-in function, compiled by compile_function.  */
+
+struct function_call
+  {
+    const struct function_table_entry *entry;
+    char *name;                 /* The function name, to find it again.  */
+    unsigned long generation;   /* function_generation for ENTRY.  */
+    unsigned int argc;
+    /* With expand_args: the compiled arguments, NULL for empty ones.  */
+    struct expansion **args;
+    /* Without: the arguments, each null-terminated, and where they start.  */
+    char *text;
+    size_t length;
+    size_t *offsets;
+  };
+
+/* Like handle_function, but compile the function invocation in *STRINGP
+   into *CALLP instead of running it.  Return 0 if there is no function
+   invocation, and -1 if it cannot be compiled: then handle_function must
+   deal with it, reporting any errors.  */
+
+int
+compile_function (const char **stringp, struct function_call **callp)
+{
+  const struct function_table_entry *entry_p;
+  char openparen = (*stringp)[0];
+  char closeparen = openparen == '(' ? ')' : '}';
+  struct function_call *call;
+  const char *beg;
+  const char *end;
+  int count = 0;
+  unsigned int nargs;
+
+  beg = *stringp + 1;
+
+  entry_p = lookup_function (beg);
+
+  if (!entry_p)
+    return 0;
+
+  beg += entry_p->len;
+  NEXT_TOKEN (beg);
+
+  for (nargs=1, end=beg; *end != '\0'; ++end)
+    if (!STOP_SET (*end, MAP_VARSEP|MAP_COMMA))
+      continue;
+    else if (*end == ',')
+      ++nargs;
+    else if (*end == openparen)
+      ++count;
+    else if (*end == closeparen && --count < 0)
+      break;
+
+  if (count >= 0)
+    return -1;
+
+  call = xcalloc (sizeof (struct function_call));
+  call->entry = entry_p;
+  call->name = xstrndup (entry_p->name, entry_p->len);
+  call->generation = function_generation;
+
+  /* Split the arguments as handle_function does.  */
+
+  if (entry_p->expand_args)
+    {
+      const char *p;
+
+      call->args = xcalloc (nargs * sizeof (struct expansion *));
+      for (p=beg; p <= end; )
+        {
+          const char *next;
+          unsigned int i = call->argc++;
+
+          if (call->argc == entry_p->maximum_args
+              || ((next = find_next_argument (openparen, closeparen, p, end)) == NULL))
+            next = end;
+
+          if (next > p)
+            {
+              call->args[i] = compile_expansion (p, next - p);
+              if (call->args[i] == 0)
+                {
+                  free_function_call (call);
+                  return -1;
+                }
+            }
+          p = next + 1;
+        }
+    }
+  else
+    {
+      char *p, *aend;
+
+      call->length = end - beg + 1;
+      call->text = xmalloc (call->length);
+      aend = mempcpy (call->text, beg, end - beg);
+      *aend = '\0';
+
+      call->offsets = xmalloc (nargs * sizeof (size_t));
+      for (p=call->text; p <= aend; )
+        {
+          char *next;
+
+          ++call->argc;
+
+          if (call->argc == entry_p->maximum_args
+              || ((next = find_next_argument (openparen, closeparen, p, aend)) == NULL))
+            next = aend;
+
+          call->offsets[call->argc - 1] = p - call->text;
+          *next = '\0';
+          p = next + 1;
+        }
+    }
+
+  *stringp = end;
+  *callp = call;
+  return 1;
+}
+
+/* Run CALL, compiled by compile_function, into the buffer at O.  */
+
+char *
+run_function (char *o, const struct function_call *call)
+{
+  const struct function_table_entry *entry_p = call->entry;
+  char **argv = alloca (sizeof (char *) * (call->argc + 1));
+  char *text = NULL;
+  unsigned int i;
+
+  if (call->args)
+    for (i = 0; i < call->argc; ++i)
+      argv[i] = (call->args[i] ? allocated_expansion (call->args[i])
+                 : xstrdup (""));
+  else
+    {
+      /* The function may modify its arguments.  */
+      text = xmalloc (call->length);
+      memcpy (text, call->text, call->length);
+      for (i = 0; i < call->argc; ++i)
+        argv[i] = text + call->offsets[i];
+    }
+  argv[call->argc] = NULL;
+
+  /* Expanding the arguments may have replaced the function.  */
+  if (call->generation != function_generation)
+    {
+      const struct function_table_entry *ent = lookup_function (call->name);
+      if (ent)
+        entry_p = ent;
+    }
+
+  o = expand_builtin_function (o, call->argc, argv, entry_p);
+
+  if (call->args)
+    for (i = 0; i < call->argc; ++i)
+      free (argv[i]);
+  else
+    free (text);
+
+  return o;
+}
+
+void
+free_function_call (struct function_call *call)
+{
+  unsigned int i;
+
+  if (call->args)
+    for (i = 0; i < call->argc; ++i)
+      release_expansion (call->args[i]);
+
+  free (call->args);
+  free (call->text);
+  free (call->offsets);
+  free (call->name);
+  free (call);
+}
+
+
 /* User-defined functions.  Expand the first argument as either a builtin
    function or a make variable, in the context of the rest of the arguments
    assigned to $1, $2, ... $N.  $0 is the name of the function.  */
@@ -2813,6 +3764,7 @@ define_new_function (const floc *flocp, const char *name,
 
   ent = hash_insert (&function_table, ent);
   free (ent);
+  ++function_generation;
 }
 
 void
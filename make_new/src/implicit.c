@@ -23,11 +23,37 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "job.h"      /* struct child, used inside commands.h */
 #include "commands.h" /* set_file_variables */
 #include "shuffle.h"
+#include "submake.h"
 #include <assert.h>
 
 static int pattern_search (struct file *file, int archive,
                            unsigned int depth, unsigned int recursions,
                            int allow_compat_rules);
+
+/* Name endings (from the last '.') that no pattern rule target can match,
+   whatever comes before them, for pattern_index_generation
+   NO_RULE_GENERATION.  See pattern_search.  */
+
+static struct hash_table no_rule_endings;
+static unsigned int no_rule_generation;
+
+static unsigned long
+ending_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 ((const char *) key);
+}
+
+static unsigned long
+ending_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 ((const char *) key);
+}
+
+static int
+ending_hash_cmp (const void *x, const void *y)
+{
+  return strcmp ((const char *) x, (const char *) y);
+}
 
 /* For a FILE which has no commands specified, try to figure out some
    from the implicit pattern rules.
@@ -38,32 +64,38 @@ static int pattern_search (struct file *file, int archive,
 int
 try_implicit_rule (struct file *file, unsigned int depth)
 {
+  struct submake *submake = current_submake;
+  int found;
+
   DBF (DB_IMPLICIT, _("Looking for an implicit rule for '%s'.\n"));
 
+  /* The files the search enters belong to the sub-make of FILE.  */
+  current_submake = file->submake;
+
   /* The order of these searches was previously reversed.  My logic now is
      that since the non-archive search uses more information in the target
      (the archive search omits the archive name), it is more specific and
      should come first.  */
 
-  if (pattern_search (file, 0, depth, 0, 0))
-    return 1;
+  found = pattern_search (file, 0, depth, 0, 0);
 
 #ifndef NO_ARCHIVES
   /* If this is an archive member reference, use just the
      archive member name to search for implicit rules.  */
-  if (ar_name (file->name))
+  if (!found && ar_name (file->name))
     {
       DBF (DB_IMPLICIT,
            _("Looking for archive-member implicit rule for '%s'.\n"));
-      if (pattern_search (file, 1, depth, 0, 0))
-        return 1;
-      DBS (DB_IMPLICIT,
-           (_("No archive-member implicit rule found for '%s'.\n"),
-            file->name));
+      found = pattern_search (file, 1, depth, 0, 0);
+      if (!found)
+        DBS (DB_IMPLICIT,
+             (_("No archive-member implicit rule found for '%s'.\n"),
+              file->name));
     }
 #endif
 
-  return 0;
+  current_submake = submake;
+  return found;
 }
 
 
@@ -267,6 +299,16 @@ pattern_search (struct file *file, int archive,
   int found_compat_rule = 0;
   struct rule *rule;
 
+  /* The index entries to try: the bucket for the last character of
+     FILENAME, and the targets ending in '%'.  */
+  const struct pattern_target *pt, *pt_end, *any, *any_end;
+
+  /* The end of FILENAME from its last '.', and whether every target tried
+     so far failed to match that end.  */
+  const char *ending;
+  size_t endinglen;
+  int ending_rejects_all;
+
   char *pathdir = NULL;
   size_t pathlen;
 
@@ -305,13 +347,70 @@ pattern_search (struct file *file, int archive,
 
   pathlen = lastslash ? lastslash - filename + 1 : 0;
 
+  /* If the pattern rules changed, so may have the names they match.  */
+  if (!pattern_index_valid)
+    index_pattern_rules ();
+  if (no_rule_generation != pattern_index_generation)
+    {
+      if (no_rule_endings.ht_vec == 0)
+        hash_init (&no_rule_endings, 64,
+                   ending_hash_1, ending_hash_2, ending_hash_cmp);
+      else
+        hash_delete_items (&no_rule_endings);
+      no_rule_generation = pattern_index_generation;
+    }
+
+  /* ENDING is the part of the name from the last '.' after LASTSLASH.
+     If no target matched a name with the same ending before, and each of
+     them failed only because its text after the '%' differs from the end
+     of ENDING, none can match this name either.  */
+  ending = memrchr (lastslash ? lastslash : filename, '.',
+                    namelen - (lastslash ? lastslash - filename : 0));
+  endinglen = ending ? namelen - (ending - filename) : 0;
+  if (ending && hash_find_item (&no_rule_endings, ending))
+    {
+      DBS (DB_IMPLICIT,
+           (_("No pattern rule matches names ending in '%s'.\n"), ending));
+      rule = 0;
+      goto done;
+    }
+  ending_rejects_all = ending != 0 && recursions == 0;
+
   /* First see which pattern rules match this target and may be considered.
-     Put them in TRYRULES.  */
+     Put them in TRYRULES.  Only the targets in the index bucket for the
+     last character of FILENAME, and those ending in '%', can match.  Both
+     buckets are in chain order, so merge them to try the rules in that
+     order.  */
+
+  {
+    unsigned int b = namelen ? (unsigned char) filename[namelen - 1]
+                             : PATTERN_INDEX_ANY;
+    pt = pattern_index + pattern_index_start[b];
+    pt_end = pattern_index + pattern_index_start[b + 1];
+    any = pattern_index + pattern_index_start[PATTERN_INDEX_ANY];
+    any_end = pattern_index + pattern_index_start[PATTERN_INDEX_ANY + 1];
+    if (b == PATTERN_INDEX_ANY)
+      pt = pt_end;
+  }
 
   nrules = 0;
-  for (rule = pattern_rules; rule != 0; rule = rule->next)
+  rule = 0;
+  while (pt < pt_end || any < any_end)
     {
+      const struct pattern_target *next;
+      int same_rule;
       unsigned int ti;
+      const char *target;
+      const char *suffix;
+      char check_lastslash;
+
+      if (any == any_end || (pt < pt_end && pt->seq < any->seq))
+        next = pt++;
+      else
+        next = any++;
+      same_rule = next->rule == rule;
+      rule = next->rule;
+      ti = next->ti;
 
       /* If the pattern rule has deps but no commands, ignore it.
          Users cancel built-in rules by redefining them without commands.  */
@@ -322,103 +421,119 @@ pattern_search (struct file *file, int archive,
          don't use it here.  */
       if (rule->in_use)
         {
-          DBS (DB_IMPLICIT,
-               (_("Avoiding implicit rule recursion for rule '%s'.\n"),
-                get_rule_defn (rule)));
+          if (!same_rule)
+            DBS (DB_IMPLICIT,
+                 (_("Avoiding implicit rule recursion for rule '%s'.\n"),
+                  get_rule_defn (rule)));
           continue;
         }
 
-      for (ti = 0; ti < rule->num; ++ti)
+      target = rule->targets[ti];
+      suffix = rule->suffixes[ti];
+
+      if (ending_rejects_all)
         {
-          const char *target = rule->targets[ti];
-          const char *suffix = rule->suffixes[ti];
-          char check_lastslash;
+          size_t suffixlen = rule->lens[ti] - (suffix - target);
+          if (suffixlen > endinglen
+              || memcmp (suffix, filename + namelen - suffixlen,
+                         suffixlen) == 0)
+            ending_rejects_all = 0;
+        }
 
-          /* Rules that can match any filename and are not terminal
-             are ignored if we're recursing, so that they cannot be
-             intermediate files.  */
-          if (recursions > 0 && target[1] == '\0' && !rule->terminal)
-            continue;
+      /* The rules of an inlined sub-make only apply to its own files; the
+         built-in pattern rules apply to all of them.  */
+      if (rule->submake != file->submake && !rule->builtin)
+        continue;
 
-          if (rule->lens[ti] > namelen)
-            /* It can't possibly match.  */
-            continue;
+      /* Rules that can match any filename and are not terminal
+         are ignored if we're recursing, so that they cannot be
+         intermediate files.  */
+      if (recursions > 0 && target[1] == '\0' && !rule->terminal)
+        continue;
 
-          /* From the lengths of the filename and the pattern parts,
-             find the stem: the part of the filename that matches the %.  */
-          stem = filename + (suffix - target - 1);
-          stemlen = namelen - rule->lens[ti] + 1;
+      if (rule->lens[ti] > namelen)
+        /* It can't possibly match.  */
+        continue;
 
-          /* Set CHECK_LASTSLASH if FILENAME contains a directory
-             prefix and the target pattern does not contain a slash.  */
+      /* From the lengths of the filename and the pattern parts,
+         find the stem: the part of the filename that matches the %.  */
+      stem = filename + (suffix - target - 1);
+      stemlen = namelen - rule->lens[ti] + 1;
 
-          check_lastslash = 0;
-          if (lastslash)
-            {
+      /* Set CHECK_LASTSLASH if FILENAME contains a directory
+         prefix and the target pattern does not contain a slash.  */
+
+      check_lastslash = 0;
+      if (lastslash)
+        {
 #ifdef VMS
-              check_lastslash = strpbrk (target, "/]>:") == NULL;
+          check_lastslash = strpbrk (target, "/]>:") == NULL;
 #else
-              check_lastslash = strchr (target, '/') == 0;
+          check_lastslash = strchr (target, '/') == 0;
 #endif
 #ifdef HAVE_DOS_PATHS
-              /* Didn't find it yet: check for DOS-type directories.  */
-              if (check_lastslash)
-                {
-                  char *b = strchr (target, '\\');
-                  check_lastslash = !(b || (target[0] && target[1] == ':'));
-                }
-#endif
-            }
-          if (check_lastslash)
-            {
-              /* If so, don't include the directory prefix in STEM here.  */
-              if (pathlen > stemlen)
-                continue;
-              stemlen -= pathlen;
-              stem += pathlen;
-            }
-
-          /* Check that the rule pattern matches the text before the stem.  */
+          /* Didn't find it yet: check for DOS-type directories.  */
           if (check_lastslash)
             {
-              if (stem > (lastslash + 1)
-                  && !strneq (target, lastslash + 1, stem - lastslash - 1))
-                continue;
+              char *b = strchr (target, '\\');
+              check_lastslash = !(b || (target[0] && target[1] == ':'));
             }
-          else if (stem > filename
-                   && !strneq (target, filename, stem - filename))
+#endif
+        }
+      if (check_lastslash)
+        {
+          /* If so, don't include the directory prefix in STEM here.  */
+          if (pathlen > stemlen)
             continue;
+          stemlen -= pathlen;
+          stem += pathlen;
+        }
 
-          /* Check that the rule pattern matches the text after the stem.
-             We could test simply use streq, but this way we compare the
-             first two characters immediately.  This saves time in the very
-             common case where the first character matches because it is a
-             period.  */
-          if (*suffix != stem[stemlen]
-              || (*suffix != '\0' && !streq (&suffix[1], &stem[stemlen + 1])))
+      /* Check that the rule pattern matches the text before the stem.  */
+      if (check_lastslash)
+        {
+          if (stem > (lastslash + 1)
+              && !strneq (target, lastslash + 1, stem - lastslash - 1))
             continue;
+        }
+      else if (stem > filename
+               && !strneq (target, filename, stem - filename))
+        continue;
 
-          /* Record if we match a rule that not all filenames will match.  */
-          if (target[1] != '\0')
-            specific_rule_matched = 1;
+      /* Check that the rule pattern matches the text after the stem.
+         We could test simply use streq, but this way we compare the
+         first two characters immediately.  This saves time in the very
+         common case where the first character matches because it is a
+         period.  */
+      if (*suffix != stem[stemlen]
+          || (*suffix != '\0' && !streq (&suffix[1], &stem[stemlen + 1])))
+        continue;
 
-          /* A rule with no dependencies and no commands exists solely to set
-             specific_rule_matched when it matches.  Don't try to use it.  */
-          if (rule->deps == 0 && rule->cmds == 0)
-            continue;
+      /* Record if we match a rule that not all filenames will match.  */
+      if (target[1] != '\0')
+        specific_rule_matched = 1;
 
-          /* Record this rule in TRYRULES and the index of the matching
-             target in MATCHES.  If several targets of the same rule match,
-             that rule will be in TRYRULES more than once.  */
-          tryrules[nrules].rule = rule;
-          tryrules[nrules].matches = ti;
-          tryrules[nrules].stemlen = stemlen + (check_lastslash ? pathlen : 0);
-          tryrules[nrules].order = nrules;
-          tryrules[nrules].checked_lastslash = check_lastslash;
-          ++nrules;
-        }
+      /* A rule with no dependencies and no commands exists solely to set
+         specific_rule_matched when it matches.  Don't try to use it.  */
+      if (rule->deps == 0 && rule->cmds == 0)
+        continue;
+
+      /* Record this rule in TRYRULES and the index of the matching
+         target in MATCHES.  If several targets of the same rule match,
+         that rule will be in TRYRULES more than once.  */
+      tryrules[nrules].rule = rule;
+      tryrules[nrules].matches = ti;
+      tryrules[nrules].stemlen = stemlen + (check_lastslash ? pathlen : 0);
+      tryrules[nrules].order = nrules;
+      tryrules[nrules].checked_lastslash = check_lastslash;
+      ++nrules;
     }
 
+  rule = 0;
+
+  if (ending_rejects_all)
+    hash_insert (&no_rule_endings, strcache_add (ending));
+
   /* Bail out early if we haven't found any rules. */
   if (nrules == 0)
     goto done;
@@ -890,6 +1005,7 @@ pattern_search (struct file *file, int archive,
                         int_file = alloca (sizeof (struct file));
                       memset (int_file, '\0', sizeof (struct file));
                       int_file->name = d->name;
+                      int_file->submake = file->submake;
 
                       if (pattern_search (int_file,
                                           0,
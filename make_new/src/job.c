@@ -27,6 +27,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "os.h"
 #include "dep.h"
 #include "shuffle.h"
+#include "submake.h"
 
 /* Default shell to use.  */
 #ifdef WINDOWS32
@@ -640,6 +641,8 @@ reap_children (int block, int err)
 #endif
   /* Initially, assume we have some.  */
   int reap_more = 1;
+  /* Finished files are checked by their names relative to the top.  */
+  struct submake *prev_submake = submake_enter (NULL);
 
 #ifdef WAIT_NOHANG
 # define REAP_MORE reap_more
@@ -707,7 +710,7 @@ reap_children (int block, int err)
           any_local |= ! c->remote;
 
           /* If pid < 0, this child never even started.  Handle it.  */
-          if (c->pid < 0)
+          if (c->pid < 0 && !reading_submake)
             {
               exit_sig = 0;
               coredump = 0;
@@ -757,6 +760,15 @@ reap_children (int block, int err)
               if ((c->cstatus & VMS_POSIX_EXIT_MASK) == VMS_POSIX_EXIT_MASK)
                 status = (c->cstatus >> 3 & 255) << 8;
 #else
+#ifdef HAVE_WAITPID
+              /* While the makefiles of a sub-make are read for a $(shell)
+                 in them, the state of this make is not the one the other
+                 children's recipes need: leave them for later.  */
+              if (reading_submake && shell_function_pid != 0)
+                EINTRLOOP (pid, waitpid (shell_function_pid, &status,
+                                         block ? 0 : WNOHANG));
+              else
+#endif
 #ifdef WAIT_NOHANG
               if (!block)
                 pid = WAIT_NOHANG (&status);
@@ -998,7 +1010,9 @@ reap_children (int block, int err)
               struct file *f = lookup_file (".DELETE_ON_ERROR");
               delete_on_error = f != 0 && f->is_target;
             }
-          if (exit_sig != 0 || delete_on_error)
+          if (exit_sig != 0 || (c->file->submake
+                                ? c->file->submake->delete_on_error
+                                : delete_on_error))
             delete_child_targets (c);
         }
       else
@@ -1109,7 +1123,7 @@ reap_children (int block, int err)
       block = 0;
     }
 
-  return;
+  submake_enter (prev_submake);
 }
 
 /* Free the storage allocated for CHILD.  */
@@ -1118,12 +1132,7 @@ void
 free_childbase (struct childbase *child)
 {
   if (child->environment != 0)
-    {
-      char **ep = child->environment;
-      while (*ep != 0)
-        free (*ep++);
-      free (child->environment);
-    }
+    free_environment (child->environment);
 
   free (child->cmd_name);
 }
@@ -1178,6 +1187,7 @@ start_job_command (struct child *child)
 {
   int flags;
   char *p;
+  struct submake *prev_submake;
 #ifdef VMS
 # define FREE_ARGV(_a)
   char *argv;
@@ -1422,6 +1432,9 @@ start_job_command (struct child *child)
 
   child->deleted = 0;
 
+  /* The recipes of an inlined sub-make run in its directory.  */
+  prev_submake = submake_enter (child->file->submake);
+
 #ifndef _AMIGA
   /* Set up the environment for the child.  */
   if (child->environment == 0)
@@ -1591,6 +1604,8 @@ start_job_command (struct child *child)
 #endif /* WINDOWS32 */
 #endif  /* __MSDOS__ or Amiga or WINDOWS32 */
 
+  submake_enter (prev_submake);
+
   /* Bump the number of jobs started in this second.  */
   if (child->pid >= 0)
     ++job_counter;
@@ -1684,6 +1699,7 @@ new_job (struct file *file)
 {
   struct commands *cmds = file->cmds;
   struct child *c;
+  struct submake *prev_submake;
   char **lines;
   unsigned int i;
 
@@ -1713,7 +1729,10 @@ new_job (struct file *file)
   /* Start saving output in case the expansion uses $(info ...) etc.  */
   OUTPUT_SET (&c->output);
 
-  /* Expand the command lines and store the results in LINES.  */
+  /* Expand the command lines and store the results in LINES.  Functions
+     like 'wildcard' and 'shell' work in the directory of an inlined
+     sub-make.  */
+  prev_submake = submake_enter (file->submake);
   lines = xmalloc (cmds->ncommand_lines * sizeof (char *));
   for (i = 0; i < cmds->ncommand_lines; ++i)
     {
@@ -1813,12 +1832,26 @@ new_job (struct file *file)
 
       /* Finally, expand the line.  */
       cmds->fileinfo.offset = i;
-      lines[i] = allocated_variable_expand_for_file (cmds->command_lines[i],
-                                                     file);
+      lines[i] = allocated_expansion_for_file (&cmds->command_expansions[i],
+                                               cmds->command_lines[i], file);
     }
 
   cmds->fileinfo.offset = 0;
   c->command_lines = lines;
+  submake_enter (prev_submake);
+
+  /* If the recipe is only recursive makes that can be read into this one,
+     its goals become prerequisites of FILE instead of being run.  */
+  if (inline_submake_flag && submake_inline (file, lines))
+    {
+      OUTPUT_UNSET ();
+      output_close (&c->output);
+      for (i = 0; i < cmds->ncommand_lines; ++i)
+        free (lines[i]);
+      free (lines);
+      free (c);
+      return;
+    }
 
   /* Fetch the first command line to be run.  */
   job_next_command (c);
@@ -177,6 +177,15 @@ int ignore_errors_flag = 0;
 
 int print_data_base_flag = 0;
 
+/* Nonzero means schedule from a queue of ready targets (--graph-schedule).  */
+
+int graph_schedule_flag = 0;
+
+/* Nonzero means evaluate recursive '$(MAKE) -C DIR' recipes in this process
+   (--inline-submake).  */
+
+int inline_submake_flag = 0;
+
 /* Nonzero means don't remake anything; just return a nonzero status
    if the specified targets are not up to date (-q).  */
 
@@ -336,6 +345,9 @@ static const char *const usage[] =
   -f FILE, --file=FILE, --makefile=FILE\n\
                               Read FILE as a makefile.\n"),
     N_("\
+  --graph-schedule            Queue targets as their prerequisites finish,\n\
+                              instead of rescanning the goals.\n"),
+    N_("\
   -h, --help                  Print this message and exit.\n"),
     N_("\
   -i, --ignore-errors         Ignore errors from recipes.\n"),
@@ -343,6 +355,9 @@ static const char *const usage[] =
   -I DIRECTORY, --include-dir=DIRECTORY\n\
                               Search DIRECTORY for included makefiles.\n"),
     N_("\
+  --inline-submake            Read the makefiles of recursive '$(MAKE) -C DIR'\n\
+                              recipes into this make instead of running them.\n"),
+    N_("\
   -j [N], --jobs[=N]          Allow N jobs at once; infinite jobs with no arg.\n"),
     N_("\
   --jobserver-style=STYLE     Select the style of jobserver to use.\n"),
@@ -381,6 +396,8 @@ static const char *const usage[] =
   -S, --no-keep-going, --stop\n\
                               Turns off -k.\n"),
     N_("\
+  --stats                     Print memory statistics on exit.\n"),
+    N_("\
   -t, --touch                 Touch targets instead of remaking them.\n"),
     N_("\
   --trace                     Print tracing information.\n"),
@@ -402,6 +419,10 @@ static const char *const usage[] =
 
 static int trace_flag = 0;
 
+/* Nonzero if the "--stats" option was given.  */
+
+static int stats_flag = 0;
+
 /* The structure that describes an accepted command switch.  */
 
 struct command_switch
@@ -494,6 +515,11 @@ static const struct command_switch switches[] =
     { TEMP_STDIN_OPT, filename, &makefiles, 0, 0, 0, 0, 0, "temp-stdin" },
     { CHAR_MAX+11, string, &shuffle_mode, 1, 1, 0, "random", 0, "shuffle" },
     { CHAR_MAX+12, string, &jobserver_style, 1, 0, 0, 0, 0, "jobserver-style" },
+    { CHAR_MAX+13, flag, &stats_flag, 1, 0, 0, 0, 0, "stats" },
+    { CHAR_MAX+14, flag, &graph_schedule_flag, 1, 1, 0, 0, 0,
+      "graph-schedule" },
+    { CHAR_MAX+15, flag, &inline_submake_flag, 1, 1, 0, 0, 0,
+      "inline-submake" },
     { 0, 0, 0, 0, 0, 0, 0, 0, 0 }
   };
 
@@ -3821,6 +3847,11 @@ die (int status)
       /* Remove the intermediate files.  */
       remove_intermediates (0);
 
+      print_glob_stats ();
+
+      if (stats_flag)
+        print_alloc_stats ();
+
       if (print_data_base_flag)
         print_data_base ();
 
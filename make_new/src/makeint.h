@@ -575,6 +575,18 @@ void *xcalloc (size_t);
 void *xrealloc (void *, size_t);
 char *xstrdup (const char *);
 char *xstrndup (const char *, size_t);
+
+/* A region of memory handed out by bumping a pointer; see arena_alloc().  */
+struct arena
+  {
+    char *next;                 /* Free space in the current block.  */
+    char *end;
+    unsigned long count;        /* Number of allocations.  */
+    unsigned long blocks;       /* Number of blocks.  */
+    unsigned long large;        /* Allocations too large for a block.  */
+  };
+void *arena_alloc (struct arena *, size_t);
+void print_alloc_stats (void);
 char *find_next_token (const char **, size_t *);
 char *next_token (const char *);
 char *end_of_token (const char *);
@@ -621,7 +633,11 @@ void file_impossible (const char *);
 const char *dir_name (const char *);
 void print_dir_data_base (void);
 void dir_setup_glob (glob_t *);
+int dir_glob (const char *pattern, const char ***pathv, int *pathc);
+void print_glob_stats (void);
 void hash_init_directories (void);
+void *dir_new_tables (void);
+void dir_swap_tables (void *tables);
 
 void define_default_variables (void);
 void undefine_default_variables (void);
@@ -740,6 +756,7 @@ extern int print_version_flag, print_directory, check_symlink_flag;
 extern int warn_undefined_variables_flag, posix_pedantic;
 extern int not_parallel, second_expansion, clock_skew_detected;
 extern int rebuilding_makefiles, one_shell, output_sync, verify_flag;
+extern int graph_schedule_flag, inline_submake_flag;
 extern unsigned long command_count;
 
 extern const char *default_shell;
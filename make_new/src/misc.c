@@ -36,6 +36,10 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 # include <sys/file.h>
 #endif
 
+#ifdef HAVE_SYS_RESOURCE_H
+# include <sys/resource.h>
+#endif
+
 unsigned int
 make_toui (const char *str, const char **error)
 {
@@ -465,6 +469,174 @@ readbuf (int fd, void *buffer, size_t len)
 }
 
 
+/* Arenas hand out zeroed memory from large blocks by bumping a pointer.
+   Nothing is given back: what comes from an arena lives until make exits,
+   when the blocks go away with the process.  */
+
+#define ARENA_BLOCK     (64 * 1024)
+
+union arena_align
+  {
+    void *p;
+    long l;
+    double d;
+  };
+
+#define ARENA_ALIGN     sizeof (union arena_align)
+
+void *
+arena_alloc (struct arena *a, size_t size)
+{
+  char *result;
+
+  size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+  if (size > (size_t) (a->end - a->next))
+    {
+      /* Give a large request its own allocation rather than abandoning
+         the rest of the current block.  */
+      if (size > ARENA_BLOCK / 8)
+        {
+          ++a->count;
+          ++a->large;
+          return xcalloc (size);
+        }
+
+      a->next = xmalloc (ARENA_BLOCK);
+      a->end = a->next + ARENA_BLOCK;
+      ++a->blocks;
+    }
+
+  result = a->next;
+  a->next += size;
+  ++a->count;
+  memset (result, '\0', size);
+  return result;
+}
+
+/* Records of 'struct nameseq' and of the structures that start like it
+   ('struct dep', 'struct goaldep', or whatever size parse_file_seq() was
+   asked for).  Reading makefiles and searching implicit rules creates and
+   discards these by the hundred thousand, so they come from an arena and a
+   freed record goes on the free list for its size, to be handed out again.
+   Chains of any of these sizes are released through free_ns_chain(), so
+   each record is preceded by a header that names its pool.  */
+
+struct seq_pool;
+
+union seq_head
+  {
+    struct seq_pool *pool;      /* While the record is in use.  */
+    union seq_head *next;       /* While it is on the free list.  */
+    union arena_align align;
+  };
+
+struct seq_pool
+  {
+    union seq_head *free;
+    unsigned long reused;
+    unsigned long freed;
+  };
+
+#define SEQ_UNIT        sizeof (union seq_head)
+#define SEQ_POOLS       16
+
+static struct arena seq_arena;
+static struct seq_pool seq_pools[SEQ_POOLS];
+
+void *
+alloc_seq (size_t size)
+{
+  size_t units = (size + SEQ_UNIT - 1) / SEQ_UNIT;
+  struct seq_pool *pool;
+  union seq_head *h;
+
+  /* Nothing this large is expected; let malloc have it.  */
+  if (units >= SEQ_POOLS)
+    {
+      h = xcalloc ((units + 1) * SEQ_UNIT);
+      h->pool = 0;
+      return h + 1;
+    }
+
+  pool = &seq_pools[units];
+  h = pool->free;
+  if (h)
+    {
+      pool->free = h->next;
+      ++pool->reused;
+      memset (h + 1, '\0', units * SEQ_UNIT);
+    }
+  else
+    h = arena_alloc (&seq_arena, (units + 1) * SEQ_UNIT);
+
+  h->pool = pool;
+  return h + 1;
+}
+
+void
+free_seq (void *ptr)
+{
+  union seq_head *h;
+  struct seq_pool *pool;
+
+  if (ptr == 0)
+    return;
+
+  h = (union seq_head *) ptr - 1;
+  pool = h->pool;
+  if (pool == 0)
+    {
+      free (h);
+      return;
+    }
+
+  ++pool->freed;
+  h->next = pool->free;
+  pool->free = h;
+}
+
+/* Print what the arenas were used for, and how much memory make needed.  */
+
+void
+print_alloc_stats (void)
+{
+  unsigned long reused = 0;
+  unsigned long freed = 0;
+  int i;
+
+  for (i = 0; i < SEQ_POOLS; ++i)
+    {
+      reused += seq_pools[i].reused;
+      freed += seq_pools[i].freed;
+    }
+
+  printf (_("\n# Memory statistics\n"));
+  printf (_("# %lu name and prerequisite records allocated,"
+            " %lu of them reused; %lu freed\n"),
+          seq_arena.count + reused, reused, freed);
+  printf (_("# %lu file records allocated\n"), file_arena.count);
+  printf (_("# %lu arena blocks of %d KiB, %lu allocations too large for"
+            " them\n"),
+          seq_arena.blocks + file_arena.blocks, ARENA_BLOCK / 1024,
+          seq_arena.large + file_arena.large);
+
+#if defined(HAVE_SYS_RESOURCE_H) && defined(RUSAGE_SELF)
+  {
+    struct rusage ru;
+
+    if (getrusage (RUSAGE_SELF, &ru) == 0)
+      {
+        /* BSD and Linux count in kilobytes, macOS in bytes.  */
+# ifdef __APPLE__
+        ru.ru_maxrss /= 1024;
+# endif
+        printf (_("# Maximum resident set size: %ld KiB\n"),
+                (long) ru.ru_maxrss);
+      }
+  }
+#endif
+}
+
 /* Copy a chain of 'struct dep'.  For 2nd expansion deps, dup the name.  */
 
 struct dep *
@@ -475,7 +647,7 @@ copy_dep_chain (const struct dep *d)
 
   while (d != 0)
     {
-      struct dep *c = xmalloc (sizeof (struct dep));
+      struct dep *c = alloc_seq (sizeof (struct dep));
       memcpy (c, d, sizeof (struct dep));
 
       if (c->need_2nd_expansion)
@@ -27,6 +27,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "rule.h"
 #include "debug.h"
 #include "hash.h"
+#include "submake.h"
 
 
 #ifdef WINDOWS32
@@ -169,6 +170,17 @@ static char *unescape_char (char *string, int c);
 #define word1eq(s)  (wlen == CSTRLEN (s) && memcmp (s, p, CSTRLEN (s)) == 0)
 
 
+/* Make CHAIN the list of makefiles read so far, and return the old one.
+   An inlined sub-make keeps its makefiles out of the top-level list.  */
+
+struct goaldep *
+swap_read_files (struct goaldep *chain)
+{
+  struct goaldep *old = read_files;
+  read_files = chain;
+  return old;
+}
+
 /* Read in all the makefiles and return a chain of targets to rebuild.  */
 
 struct goaldep *
@@ -406,6 +418,10 @@ eval_makefile (const char *filename, unsigned short flags)
   filename = deps->file->name;
   deps->flags = flags;
 
+  /* Messages about the makefiles of a sub-make name them as its files.  */
+  if (submake_names)
+    ebuf.floc.filenm = filename;
+
   free (expanded);
 
   if (ebuf.fp == 0)
@@ -430,8 +446,10 @@ eval_makefile (const char *filename, unsigned short flags)
   fd_noinherit (fileno (ebuf.fp));
 
   /* Add this makefile to the list. */
-  do_variable_definition (&ebuf.floc, "MAKEFILE_LIST", filename, o_file,
-                          f_append_value, 0);
+  do_variable_definition (&ebuf.floc, "MAKEFILE_LIST",
+                          submake_names
+                          ? submake_local_name (current_submake, filename)
+                          : filename, o_file, f_append_value, 0);
 
   /* Evaluate the makefile */
 
@@ -762,8 +780,11 @@ eval (struct ebuffer *ebuf, int set_default)
 
           assert (v != NULL);
 
-          if (vmod.export_v != v_default)
-            v->export = vmod.export_v;
+          if (vmod.export_v != v_default && v->export != vmod.export_v)
+            {
+              v->export = vmod.export_v;
+              ++variable_generation;
+            }
           if (vmod.private_v)
             v->private_var = 1;
 
@@ -816,7 +837,9 @@ eval (struct ebuffer *ebuf, int set_default)
           record_waiting_files ();
 
           /* (un)export by itself causes everything to be (un)exported. */
-          if (*p2 == '\0')
+          if (*p2 == '\0' && current_submake)
+            submake_abandon (exporting ? "export" : "unexport");
+          else if (*p2 == '\0')
             export_all_variables = exporting;
           else
             {
@@ -834,7 +857,11 @@ eval (struct ebuffer *ebuf, int set_default)
                   struct variable *v = lookup_variable (p, l);
                   if (v == 0)
                     v = define_variable_global (p, l, "", o_file, 0, fstart);
-                  v->export = exporting ? v_export : v_noexport;
+                  if (v->export != (exporting ? v_export : v_noexport))
+                    {
+                      v->export = exporting ? v_export : v_noexport;
+                      ++variable_generation;
+                    }
                 }
 
               free (ap);
@@ -852,6 +879,13 @@ eval (struct ebuffer *ebuf, int set_default)
           /* vpath ends the previous rule.  */
           record_waiting_files ();
 
+          /* The search paths are shared by all the files.  */
+          if (current_submake)
+            {
+              submake_abandon ("vpath");
+              continue;
+            }
+
           cp = variable_expand (p2);
           p = find_next_token (&cp, &l);
           if (p != 0)
@@ -1848,6 +1882,15 @@ record_target_var (struct nameseq *filenames, char *defn,
           else if (f->double_colon)
             f = f->double_colon;
 
+          /* The variables a file already has cannot be taken back if the
+             sub-make is abandoned.  */
+          if (current_submake && f->submake != current_submake
+              && f->variables)
+            {
+              submake_abandon (_("a variable of a file of another makefile"));
+              continue;
+            }
+
           initialize_file_variables (f, 1);
 
           current_variable_set_list = f->variables;
@@ -1901,6 +1944,11 @@ check_specials (struct nameseq *files, int set_default)
 
       if (!posix_pedantic && streq (nm, ".POSIX"))
         {
+          if (current_submake)
+            {
+              submake_abandon (nm);
+              continue;
+            }
           posix_pedantic = 1;
           define_variable_cname (".SHELLFLAGS", "-ec", o_default, 0);
           /* These default values are based on IEEE Std 1003.1-2008.
@@ -1917,6 +1965,11 @@ check_specials (struct nameseq *files, int set_default)
 
       if (!second_expansion && streq (nm, ".SECONDEXPANSION"))
         {
+          if (current_submake)
+            {
+              submake_abandon (nm);
+              continue;
+            }
           second_expansion = 1;
           continue;
         }
@@ -1924,6 +1977,11 @@ check_specials (struct nameseq *files, int set_default)
 #if !defined (__MSDOS__) && !defined (__EMX__)
       if (!one_shell && streq (nm, ".ONESHELL"))
         {
+          if (current_submake)
+            {
+              submake_abandon (nm);
+              continue;
+            }
           one_shell = 1;
           continue;
         }
@@ -2041,6 +2099,14 @@ record_files (struct nameseq *filenames, int are_also_makes,
   if (snapped_deps)
     O (fatal, flocp, _("prerequisites cannot be defined in recipes"));
 
+  /* An inlined sub-make cannot take over targets defined elsewhere.  */
+  if (current_submake && !submake_check_targets (filenames))
+    {
+      free_ns_chain (filenames);
+      free (depstr);
+      return;
+    }
+
   /* Determine if this is a pattern rule or not.  */
   name = filenames->name;
   implicit_percent = find_percent_cached (&name);
@@ -2083,9 +2149,16 @@ record_files (struct nameseq *filenames, int are_also_makes,
           /* We'll enter static pattern prereqs later when we have the stem.
              We don't want to enter pattern rules at all so that we don't
              think that they ought to exist (make manual "Implicit Rule Search
-             Algorithm", item 5c).  */
+             Algorithm", item 5c).  The prereqs of .SUFFIXES are suffixes,
+             not names of files of a sub-make.  */
           if (! pattern && ! implicit_percent)
-            deps = enter_prereqs (deps, NULL);
+            {
+              int names = submake_names;
+              if (names && streq (name, ".SUFFIXES"))
+                submake_names = 0;
+              deps = enter_prereqs (deps, NULL);
+              submake_names = names;
+            }
         }
     }
 
@@ -2246,6 +2319,7 @@ record_files (struct nameseq *filenames, int are_also_makes,
         }
 
       f->is_target = 1;
+      f->submake = current_submake;
 
       /* If this is a static pattern rule, set the stem to the part of its
          name that matched the '%' in the pattern, so you can use $* in the
@@ -2263,6 +2337,9 @@ record_files (struct nameseq *filenames, int are_also_makes,
               else
                 this->stem = f->stem;
             }
+          /* Keep the stem relative to the top, like the name.  */
+          if (submake_names && *f->stem != '\0')
+            f->stem = submake_file_name (f->stem);
         }
 
       /* Add the dependencies to this file entry.  */
@@ -3193,7 +3270,7 @@ parse_file_seq (char **stringp, size_t size, int stopmap,
   struct nameseq *new = 0;
   struct nameseq **newp = &new;
 #define NEWELT(_n)  do { \
-                        struct nameseq *_ns = xcalloc (size);       \
+                        struct nameseq *_ns = alloc_seq (size);      \
                         const char *__n = (_n);                     \
                         _ns->name = (cachep ? strcache_add (__n) : xstrdup (__n)); \
                         if (found_wait) {                           \
@@ -3468,6 +3545,17 @@ parse_file_seq (char **stringp, size_t size, int stopmap,
           tot = 1;
           nlist = &name;
         }
+      else if (dir_glob (name, &nlist, &tot))
+        {
+          /* Matched on the directory cache.  Without matches, keep the
+             name unless we want only existing items.  */
+          globme = 0;
+          if (tot == 0 && NONE_SET (flags, PARSEFS_EXISTS))
+            {
+              tot = 1;
+              nlist = &name;
+            }
+        }
       else
         switch (glob (name, GLOB_ALTDIRFUNC, NULL, &gl))
           {
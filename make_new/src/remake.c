@@ -22,6 +22,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "dep.h"
 #include "variable.h"
 #include "debug.h"
+#include "submake.h"
 
 #include <assert.h>
 
@@ -73,12 +74,209 @@ static unsigned int considered = 0;
 static enum update_status update_file (struct file *file, unsigned int depth);
 static enum update_status update_file_1 (struct file *file, unsigned int depth);
 static enum update_status check_dep (struct file *file, unsigned int depth,
-                                     FILE_TIMESTAMP this_mtime, int *must_make);
+                                     FILE_TIMESTAMP this_mtime, int *must_make,
+                                     struct file *waiter);
 static enum update_status touch_file (struct file *file);
 static void remake_file (struct file *file);
 static FILE_TIMESTAMP name_mtime (const char *name);
 static const char *library_search (const char *lib, FILE_TIMESTAMP *mtime_ptr);
 
+/* With --graph-schedule, a file whose prerequisites are being made does not
+   wait for a rescan of the goal chain to be looked at again.  Instead it is
+   recorded as waiting for each prerequisite that is still running (see
+   wait_for), and once they have all finished it goes on a queue of ready
+   files, which update_goal_chain empties after each child is reaped.  Until
+   then the file is pruned like one whose recipe is running, so a scan of
+   the goals only descends into the parts of the graph that have changed.
+
+   The queue is ordered by when the files started waiting, which keeps the
+   order in which recipes are started close to that of the makefile.  */
+
+static int graph_active = 0;
+
+static struct file **ready_files;
+static size_t ready_count;
+static size_t ready_max;
+
+/* The files that have had waiters recorded, so that stop_graph_schedule
+   can clear what is left of them.  A file may appear more than once.  */
+static struct file **waited_files;
+static size_t waited_count;
+static size_t waited_max;
+
+/* Counters for ordering the queue and for noticing when it stalls.  */
+static unsigned long wait_orders;
+static unsigned long files_finished;
+
+/* Add FILE to the queue of files ready to be looked at again.  */
+
+static void
+push_ready (struct file *file)
+{
+  size_t i;
+
+  if (file->ready)
+    return;
+  file->ready = 1;
+
+  if (ready_count == ready_max)
+    {
+      ready_max = ready_max ? ready_max * 2 : 64;
+      ready_files = xrealloc (ready_files, ready_max * sizeof (struct file *));
+    }
+
+  for (i = ready_count++; i > 0; i = (i - 1) / 2)
+    {
+      struct file *parent = ready_files[(i - 1) / 2];
+      if (parent->wait_order <= file->wait_order)
+        break;
+      ready_files[i] = parent;
+    }
+  ready_files[i] = file;
+}
+
+/* Remove and return the file that started waiting first.  */
+
+static struct file *
+pop_ready (void)
+{
+  struct file *top = ready_files[0];
+  struct file *last = ready_files[--ready_count];
+  size_t i = 0;
+
+  while (2 * i + 1 < ready_count)
+    {
+      size_t c = 2 * i + 1;
+      if (c + 1 < ready_count
+          && ready_files[c + 1]->wait_order < ready_files[c]->wait_order)
+        ++c;
+      if (last->wait_order <= ready_files[c]->wait_order)
+        break;
+      ready_files[i] = ready_files[c];
+      i = c;
+    }
+  if (ready_count > 0)
+    ready_files[i] = last;
+
+  top->ready = 0;
+  return top;
+}
+
+/* Record that WAITER must be looked at again once FILE has finished, if
+   FILE is being made, or is waiting, or is queued.  A file whose state says
+   its prerequisites are being made but which is neither (an intermediate
+   file checked by check_dep on behalf of WAITER, or a grouped target peer)
+   is not waited for: WAITER waits for what is running instead, or is
+   rescanned.  */
+
+static void
+wait_for (struct file *waiter, struct file *file)
+{
+  struct dep *d;
+
+  if (!graph_active || waiter == file)
+    return;
+  if (file->command_state != cs_running
+      && (file->command_state != cs_deps_running
+          || (file->waiting == 0 && !file->ready)))
+    return;
+
+  if (file->waiters == 0)
+    {
+      if (waited_count == waited_max)
+        {
+          waited_max = waited_max ? waited_max * 2 : 64;
+          waited_files = xrealloc (waited_files,
+                                   waited_max * sizeof (struct file *));
+        }
+      waited_files[waited_count++] = file;
+    }
+
+  d = alloc_dep ();
+  d->file = waiter;
+  d->next = file->waiters;
+  file->waiters = d;
+
+  if (waiter->waiting++ == 0)
+    waiter->wait_order = ++wait_orders;
+}
+
+/* FILE has finished: queue the files that were waiting only for it.  */
+
+static void
+release_waiters (struct file *file)
+{
+  while (file->waiters)
+    {
+      struct dep *d = file->waiters;
+      struct file *waiter = d->file;
+
+      file->waiters = d->next;
+      free_dep (d);
+
+      if (waiter->waiting > 0 && --waiter->waiting == 0)
+        push_ready (waiter);
+    }
+}
+
+/* Look again at the files whose prerequisites have all finished.  */
+
+static void
+run_ready_queue (void)
+{
+  while (graph_active && ready_count > 0)
+    {
+      struct file *file = pop_ready ();
+      struct file *f = file->double_colon ? file->double_colon : file;
+      unsigned int ocommands_started = commands_started;
+
+      /* It may have started waiting again, or been made, since.  */
+      if (file->waiting == 0 && file->command_state == cs_deps_running)
+        {
+          goal_dep = file->wait_goal;
+          f->considered = 0;
+          update_file (file, file->wait_depth);
+          check_renamed (file);
+
+          /* Credit the goal as the goal chain scan would have.  */
+          if (commands_started > ocommands_started)
+            file->wait_goal->changed = 1;
+        }
+
+      /* If it is neither being made nor waiting any more, nothing will
+         release the files waiting for it; let them look for themselves.  */
+      if (file->command_state == cs_not_started)
+        release_waiters (file);
+    }
+}
+
+/* Give up on the queue and rescan the goal chain from now on.  Forget who
+   is waiting for whom, so that nothing is pruned by a stale count if the
+   goal chain is updated again.  */
+
+static void
+stop_graph_schedule (void)
+{
+  graph_active = 0;
+  while (ready_count > 0)
+    pop_ready ();
+
+  while (waited_count > 0)
+    {
+      struct file *file = waited_files[--waited_count];
+
+      while (file->waiters)
+        {
+          struct dep *d = file->waiters;
+
+          file->waiters = d->next;
+          d->file->waiting = 0;
+          d->file->wait_order = 0;
+          free_dep (d);
+        }
+    }
+}
+
 
 static void
 check_also_make (const struct file *file)
@@ -126,6 +324,9 @@ update_goal_chain (struct goaldep *goaldeps)
   /* Start a fresh batch of consideration.  */
   ++considered;
 
+  /* Makefiles are remade one goal at a time; scanning suits them.  */
+  graph_active = graph_schedule_flag && !rebuilding_makefiles;
+
   /* Update all the goals until they are all finished.  */
   profiler_operation_end(1, "Duplicate the chain.");
   profiler_operation_start(1, "Update all the goals");
@@ -133,11 +334,16 @@ update_goal_chain (struct goaldep *goaldeps)
     {
       profiler_operation_start(2,"Variable initalzation(wait a child node to die)");
       struct dep *gu, *g, *lastgoal;
+      unsigned int ostarted = commands_started;
+      unsigned long ofinished = files_finished;
 
       /* Start jobs that are waiting for the load to go down.  */
       start_waiting_jobs ();
       /* Wait for a child to die.  */
       reap_children (1, 0);
+
+      /* Look at what the children that died were holding up.  */
+      run_ready_queue ();
       
       lastgoal = 0;
       gu = goals;
@@ -280,9 +486,20 @@ update_goal_chain (struct goaldep *goaldeps)
       if (gu == 0)
         ++considered;
         profiler_operation_end(3, "Update flags and check also-make files");
+
+      /* If a whole pass neither started nor finished anything, something is
+         waiting for a file that will not say when it is done.  Fall back to
+         rescanning, which will find it.  */
+      if (graph_active && goals != 0 && ready_count == 0
+          && commands_started == ostarted && files_finished == ofinished)
+        {
+          DB (DB_JOBS, (_("Graph schedule stalled; rescanning goals.\n")));
+          stop_graph_schedule ();
+        }
     }
     
   profiler_operation_end(1, "Update all the goals");
+  stop_graph_schedule ();
   profiler_operation_start(2, "Free_dep_chain");  
   free_dep_chain (goals_orig);
   
@@ -451,6 +668,7 @@ update_file_1 (struct file *file, unsigned int depth)
   struct file *ofile;
   struct dep *du, *d, *ad;
   struct dep amake;
+  struct file *dfile;
   int running = 0;
 
   DBF (DB_VERBOSE, _("Considering target file '%s'.\n"));
@@ -479,7 +697,13 @@ update_file_1 (struct file *file, unsigned int depth)
   switch (file->command_state)
     {
     case cs_not_started:
+      break;
     case cs_deps_running:
+      if (graph_active && file->waiting > 0)
+        {
+          DBF (DB_VERBOSE, _("Prerequisites of '%s' are still being made.\n"));
+          return us_success;
+        }
       break;
     case cs_running:
       DBF (DB_VERBOSE, _("Still updating file '%s'.\n"));
@@ -556,11 +780,12 @@ update_file_1 (struct file *file, unsigned int depth)
       try_implicit_rule (file, depth);
       file->tried_implicit = 1;
     }
+  dfile = file->submake ? file->submake->default_file : default_file;
   if (file->cmds == 0 && !file->is_target
-      && default_file != 0 && default_file->cmds != 0)
+      && dfile != 0 && dfile->cmds != 0)
     {
       DBF (DB_IMPLICIT, _("Using default recipe for '%s'.\n"));
-      file->cmds = default_file->cmds;
+      file->cmds = dfile->cmds;
     }
 
   /* Update all non-intermediate files we depend on, if necessary, and see
@@ -629,7 +854,7 @@ update_file_1 (struct file *file, unsigned int depth)
               d->file->dontcare = file->dontcare;
             }
 
-          new = check_dep (d->file, depth, this_mtime, &maybe_make);
+          new = check_dep (d->file, depth, this_mtime, &maybe_make, file);
           if (new > dep_status)
             dep_status = new;
 
@@ -650,6 +875,7 @@ update_file_1 (struct file *file, unsigned int depth)
               {
                 running |= (f->command_state == cs_running
                             || f->command_state == cs_deps_running);
+                wait_for (file, f);
                 f = f->prev;
               }
             while (f != 0);
@@ -720,6 +946,7 @@ update_file_1 (struct file *file, unsigned int depth)
                   {
                     running |= (f->command_state == cs_running
                                 || f->command_state == cs_deps_running);
+                    wait_for (file, f);
                     f = f->prev;
                   }
                 while (f != 0);
@@ -744,6 +971,8 @@ update_file_1 (struct file *file, unsigned int depth)
     {
       set_command_state (file, cs_deps_running);
       --depth;
+      file->wait_goal = goal_dep;
+      file->wait_depth = depth;
       DBF (DB_VERBOSE, _("The prerequisites of '%s' are being made.\n"));
       return us_success;
     }
@@ -905,6 +1134,11 @@ update_file_1 (struct file *file, unsigned int depth)
   /* Now, take appropriate actions to remake the file.  */
   remake_file (file);
 
+  /* If its recipe was a sub-make read into this one, the goals of the
+     sub-make are now prerequisites of FILE: make them first.  */
+  if (file->inlined && file->command_state == cs_not_started)
+    return update_file_1 (file, depth);
+
   if (file->command_state != cs_finished)
     {
       DBF (DB_VERBOSE, _("Recipe of '%s' is being run.\n"));
@@ -1071,19 +1305,28 @@ notice_finished_file (struct file *file)
     /* Nothing was done for FILE, but it needed nothing done.
        So mark it now as "succeeded".  */
     file->update_status = us_success;
+
+  if (graph_active)
+    {
+      ++files_finished;
+      release_waiters (file);
+      for (d = file->also_make; d != 0; d = d->next)
+        release_waiters (d->file);
+    }
 }
 
 /* Check whether another file (whose mtime is THIS_MTIME) needs updating on
    account of a dependency which is file FILE.  If it does, store 1 in
    *MUST_MAKE_PTR.  In the process, update any non-intermediate files that
    FILE depends on (including FILE itself).  Return nonzero if any updating
-   failed.  */
+   failed.  WAITER is the file whose prerequisites are being checked.  */
 
 static enum update_status
 check_dep (struct file *file, unsigned int depth,
-           FILE_TIMESTAMP this_mtime, int *must_make_ptr)
+           FILE_TIMESTAMP this_mtime, int *must_make_ptr, struct file *waiter)
 {
   struct file *ofile;
+  struct file *dfile;
   struct dep *d;
   enum update_status dep_status = us_success;
 
@@ -1116,11 +1359,12 @@ check_dep (struct file *file, unsigned int depth,
           try_implicit_rule (file, depth);
           file->tried_implicit = 1;
         }
+      dfile = file->submake ? file->submake->default_file : default_file;
       if (file->cmds == 0 && !file->is_target
-          && default_file != 0 && default_file->cmds != 0)
+          && dfile != 0 && dfile->cmds != 0)
         {
           DBF (DB_IMPLICIT, _("Using default commands for '%s'.\n"));
-          file->cmds = default_file->cmds;
+          file->cmds = dfile->cmds;
         }
 
       check_renamed (file);
@@ -1185,7 +1429,8 @@ check_dep (struct file *file, unsigned int depth,
 
               d->file->parent = file;
               maybe_make = *must_make_ptr;
-              new = check_dep (d->file, depth, this_mtime, &maybe_make);
+              new = check_dep (d->file, depth, this_mtime, &maybe_make,
+                               waiter);
               if (new > dep_status)
                 dep_status = new;
 
@@ -1198,6 +1443,7 @@ check_dep (struct file *file, unsigned int depth,
               if (d->file->command_state == cs_running
                   || d->file->command_state == cs_deps_running)
                 deps_running = 1;
+              wait_for (waiter, d->file);
 
               ld = d;
               d = d->next;
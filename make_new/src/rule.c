@@ -24,6 +24,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "variable.h"
 #include "rule.h"
+#include "submake.h"
 
 static void freerule (struct rule *rule, struct rule *lastrule);
 
@@ -60,6 +61,21 @@ struct file *suffix_file;
 
 static size_t maxsuffix;
 
+/* The targets of all pattern rules, bucketed by the last character of the
+   text after their '%' so that pattern_search only looks at the targets
+   that can match a name.  Bucket B holds the entries from
+   pattern_index_start[B] up to pattern_index_start[B + 1], in chain order.
+   The index is rebuilt when it is used after the chain has changed.  */
+
+struct pattern_target *pattern_index;
+unsigned int pattern_index_start[PATTERN_INDEX_ANY + 2];
+int pattern_index_valid;
+
+/* Incremented each time the index is rebuilt, so that anything derived
+   from the set of pattern rules can tell when it is stale.  */
+
+unsigned int pattern_index_generation;
+
 /* Return the rule definition: space separated rule targets, followed by
    either a colon or two colons in the case of a terminal rule, followed by
    space separated rule prerequisites, followed by a pipe, followed by
@@ -133,7 +149,10 @@ snap_implicit_rules (void)
   struct dep *prereqs = expand_extra_prereqs (lookup_variable (STRING_SIZE_TUPLE(".EXTRA_PREREQS")));
   unsigned int pre_deps = 0;
 
-  max_pattern_dep_length = 0;
+  /* For an inlined sub-make only its own rules are new: the maximums of
+     the others stay.  */
+  if (!current_submake)
+    max_pattern_dep_length = 0;
 
   for (dep = prereqs; dep; dep = dep->next)
     {
@@ -154,13 +173,17 @@ snap_implicit_rules (void)
       ++pre_deps;
     }
 
-  num_pattern_rules = max_pattern_targets = max_pattern_deps = 0;
+  if (!current_submake)
+    num_pattern_rules = max_pattern_targets = max_pattern_deps = 0;
 
   for (rule = pattern_rules; rule; rule = rule->next)
     {
       unsigned int ndeps = pre_deps;
       struct dep *lastdep = NULL;
 
+      if (rule->submake != current_submake)
+        continue;
+
       ++num_pattern_rules;
 
       if (rule->num > max_pattern_targets)
@@ -228,6 +251,57 @@ snap_implicit_rules (void)
 
   free (name);
   free_dep_chain (prereqs);
+
+  index_pattern_rules ();
+}
+
+/* Return the index bucket of a pattern target whose text after the '%'
+   is SUFFIX.  */
+
+static unsigned int
+pattern_bucket (const char *suffix)
+{
+  size_t len = strlen (suffix);
+  return len == 0 ? PATTERN_INDEX_ANY : (unsigned char) suffix[len - 1];
+}
+
+/* Build the pattern rule index from the current chain.  */
+
+void
+index_pattern_rules (void)
+{
+  unsigned int fill[PATTERN_INDEX_ANY + 1];
+  unsigned int b, seq = 0;
+  struct rule *rule;
+  unsigned int ti;
+
+  memset (pattern_index_start, 0, sizeof (pattern_index_start));
+  for (rule = pattern_rules; rule; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      ++pattern_index_start[pattern_bucket (rule->suffixes[ti]) + 1];
+
+  for (b = 0; b <= PATTERN_INDEX_ANY; ++b)
+    {
+      fill[b] = pattern_index_start[b];
+      pattern_index_start[b + 1] += pattern_index_start[b];
+    }
+
+  pattern_index = xrealloc (pattern_index,
+                            (pattern_index_start[PATTERN_INDEX_ANY + 1] + 1)
+                            * sizeof (struct pattern_target));
+
+  for (rule = pattern_rules; rule; rule = rule->next)
+    for (ti = 0; ti < rule->num; ++ti)
+      {
+        struct pattern_target *pt;
+        pt = &pattern_index[fill[pattern_bucket (rule->suffixes[ti])]++];
+        pt->rule = rule;
+        pt->ti = ti;
+        pt->seq = seq++;
+      }
+
+  pattern_index_valid = 1;
+  ++pattern_index_generation;
 }
 
 /* Create a pattern rule from a suffix rule.
@@ -311,15 +385,18 @@ convert_to_pattern (void)
 
   for (d = suffix_file->deps; d != 0; d = d->next)
     {
+      /* The suffixes of an inlined sub-make are not its files, but its
+         suffix rules are.  */
+      struct file *sf = current_submake ? lookup_file (dep_name (d)) : d->file;
       size_t slen;
 
       /* Make a rule that is just the suffix, with no deps or commands.
          This rule exists solely to disqualify match-anything rules.  */
       convert_suffix_rule (dep_name (d), 0, 0);
 
-      if (d->file->cmds != 0)
+      if (sf != 0 && sf->cmds != 0)
         /* Record a pattern for this suffix's null-suffix rule.  */
-        convert_suffix_rule ("", dep_name (d), d->file->cmds);
+        convert_suffix_rule ("", dep_name (d), sf->cmds);
 
       /* Add every other suffix to this one and see if it exists as a
          two-suffix rule.  */
@@ -372,6 +449,34 @@ convert_to_pattern (void)
 }
 
 
+/* Put RULE at the end of the chain of pattern rules.  The rules of an
+   inlined sub-make go in front of the built-in rules instead, which come
+   after the rules of the makefiles in a real sub-make too.  */
+
+static void
+link_pattern_rule (struct rule *rule)
+{
+  struct rule *r, *lastrule = 0;
+
+  if (rule->submake)
+    for (r = pattern_rules; r != 0; lastrule = r, r = r->next)
+      if (r->builtin)
+        {
+          rule->next = r;
+          if (lastrule == 0)
+            pattern_rules = rule;
+          else
+            lastrule->next = rule;
+          return;
+        }
+
+  if (pattern_rules == 0)
+    pattern_rules = rule;
+  else
+    last_pattern_rule->next = rule;
+  last_pattern_rule = rule;
+}
+
 /* Install the pattern rule RULE (whose fields have been filled in) at the end
    of the list (so that any rules previously defined will take precedence).
    If this rule duplicates a previous one (identical target and dependencies),
@@ -390,10 +495,12 @@ new_pattern_rule (struct rule *rule, int override)
 
   rule->next = 0;
 
-  /* Search for an identical rule.  */
+  pattern_index_valid = 0;
+
+  /* Search for an identical rule of the same sub-make.  */
   lastrule = 0;
   for (r = pattern_rules; r != 0; lastrule = r, r = r->next)
-    for (i = 0; i < rule->num; ++i)
+    for (i = 0; r->submake == rule->submake && i < rule->num; ++i)
       {
         for (j = 0; j < r->num; ++j)
           if (!streq (rule->targets[i], r->targets[j]))
@@ -414,11 +521,7 @@ new_pattern_rule (struct rule *rule, int override)
                     /* Remove the old rule.  */
                     freerule (r, lastrule);
                     /* Install the new one.  */
-                    if (pattern_rules == 0)
-                      pattern_rules = rule;
-                    else
-                      last_pattern_rule->next = rule;
-                    last_pattern_rule = rule;
+                    link_pattern_rule (rule);
 
                     /* We got one.  Stop looking.  */
                     goto matched;
@@ -436,14 +539,8 @@ new_pattern_rule (struct rule *rule, int override)
  matched:;
 
   if (r == 0)
-    {
-      /* There was no rule to replace.  */
-      if (pattern_rules == 0)
-        pattern_rules = rule;
-      else
-        last_pattern_rule->next = rule;
-      last_pattern_rule = rule;
-    }
+    /* There was no rule to replace.  */
+    link_pattern_rule (rule);
 
   return 1;
 }
@@ -463,6 +560,8 @@ install_pattern_rule (struct pspec *p, int terminal)
   r = xmalloc (sizeof (struct rule));
 
   r->num = 1;
+  r->submake = NULL;
+  r->builtin = 1;
   r->targets = xmalloc (sizeof (const char *));
   r->suffixes = xmalloc (sizeof (const char *));
   r->lens = xmalloc (sizeof (unsigned int));
@@ -523,6 +622,8 @@ freerule (struct rule *rule, struct rule *lastrule)
 
   free (rule);
 
+  pattern_index_valid = 0;
+
   if (pattern_rules == rule)
     if (lastrule != 0)
       abort ();
@@ -533,6 +634,25 @@ freerule (struct rule *rule, struct rule *lastrule)
   if (last_pattern_rule == rule)
     last_pattern_rule = lastrule;
 }
+
+/* Free the pattern rules defined by the makefiles of the sub-make S.  */
+
+void
+free_submake_rules (const struct submake *s)
+{
+  struct rule *rule = pattern_rules;
+  struct rule *lastrule = 0;
+
+  while (rule != 0)
+    {
+      struct rule *next = rule->next;
+      if (rule->submake == s)
+        freerule (rule, lastrule);
+      else
+        lastrule = rule;
+      rule = next;
+    }
+}
 
 /* Create a new pattern rule with the targets in the nil-terminated array
    TARGETS.  TARGET_PERCENTS is an array of pointers to the % in each element
@@ -552,6 +672,31 @@ create_pattern_rule (const char **targets, const char **target_percents,
   unsigned int i;
   struct rule *r = xmalloc (sizeof (struct rule));
 
+  /* The names in the makefiles of an inlined sub-make are relative to its
+     directory.  A target pattern without a slash matches in any directory,
+     and the directory is put in front of the prerequisite patterns then;
+     other names need the prefix.  */
+  if (submake_names)
+    {
+      int slash = 0;
+      struct dep *d;
+
+      for (i = 0; i < n; ++i)
+        if (strchr (targets[i], '/') != 0)
+          {
+            const char *t = submake_file_name (targets[i]);
+            target_percents[i] = t + (strlen (t) - strlen (targets[i]))
+                                   + (target_percents[i] - targets[i]);
+            targets[i] = t;
+            slash = 1;
+          }
+
+      for (d = deps; d != 0; d = d->next)
+        if (d->name && !d->need_2nd_expansion
+            && (slash || strchr (d->name, '%') == 0))
+          d->name = submake_file_name (d->name);
+    }
+
   r->num = n;
   r->cmds = commands;
   r->deps = deps;
@@ -559,6 +704,8 @@ create_pattern_rule (const char **targets, const char **target_percents,
   r->suffixes = target_percents;
   r->lens = xmalloc (n * sizeof (unsigned int));
   r->_defn = NULL;
+  r->submake = current_submake;
+  r->builtin = 0;
 
   for (i = 0; i < n; ++i)
     {
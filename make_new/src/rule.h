@@ -29,8 +29,24 @@ struct rule
     unsigned short num;         /* Number of targets.  */
     char terminal;              /* If terminal (double-colon).  */
     char in_use;                /* If in use by a parent pattern_search.  */
+    char builtin;               /* If from install_pattern_rule.  */
+    struct submake *submake;    /* The inlined sub-make that defined it, or
+                                   null; see pattern_search.  */
   };
 
+/* An entry of the pattern rule index: target TI of RULE.  SEQ numbers the
+   targets of all rules in chain order.  */
+struct pattern_target
+  {
+    struct rule *rule;
+    unsigned int ti;
+    unsigned int seq;
+  };
+
+/* Index bucket of the targets ending in '%', which match any last
+   character.  The other buckets are keyed by the last character.  */
+#define PATTERN_INDEX_ANY 256
+
 /* For calling install_pattern_rule.  */
 struct pspec
   {
@@ -48,12 +64,19 @@ extern size_t max_pattern_dep_length;
 
 extern struct file *suffix_file;
 
+extern struct pattern_target *pattern_index;
+extern unsigned int pattern_index_start[PATTERN_INDEX_ANY + 2];
+extern int pattern_index_valid;
+extern unsigned int pattern_index_generation;
+
 
 void snap_implicit_rules (void);
+void index_pattern_rules (void);
 void convert_to_pattern (void);
 void install_pattern_rule (struct pspec *p, int terminal);
 void create_pattern_rule (const char **targets, const char **target_percents,
                           unsigned short num, int terminal, struct dep *deps,
                           struct commands *commands, int override);
+void free_submake_rules (const struct submake *s);
 const char *get_rule_defn (struct rule *rule);
 void print_rule_data_base (void);
@@ -0,0 +1,867 @@
+/* Evaluate recursive makes in this process.
+Copyright (C) 2022 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+#include "makeint.h"
+
+#include "submake.h"
+
+#include "filedef.h"
+#include "dep.h"
+#include "variable.h"
+#include "rule.h"
+#include "commands.h"
+#include "debug.h"
+
+/* With --inline-submake, a recipe whose lines are all '$(MAKE) -C DIR ...'
+   does not run another make.  The makefiles in DIR are read into this make
+   instead, and the goals of each line become prerequisites of the target,
+   so that all the targets are scheduled together and share the job slots.
+
+   The files of a sub-make are entered with their names relative to the top
+   directory, so that they are the same files whichever makefile names them.
+   Its recipes see the names relative to its directory, and they run there.
+   Its global variables, rules, suffixes and directory caches are its own.
+
+   Anything that would need a make of its own, like vpath, global special
+   targets or a change of the switches, abandons the sub-make while it is
+   read: what its makefiles did is undone, and the recipe is run as usual.
+   So are the sub-makes of a recipe that has a line that cannot be inlined,
+   since that recipe runs them.  */
+
+struct submake *current_submake = NULL;
+int submake_names = 0;
+struct submake *reading_submake = NULL;
+
+/* All the sub-makes read so far.  */
+static struct submake *submakes = NULL;
+
+/* The sub-make whose directory is the current one, or null for the top.  */
+static struct submake *entered = NULL;
+
+/* The directory of this make.  */
+static char *top_dir = NULL;
+
+/* Put the prefix of CURRENT_SUBMAKE in front of NAME, a name in its
+   makefiles.  Leading './' and '../' are resolved against the prefix.  */
+
+const char *
+submake_file_name (const char *name)
+{
+  const char *prefix, *end;
+  size_t len;
+  char *buf;
+
+  if (current_submake == NULL || name[0] == '/'
+      || (name[0] == '-' && name[1] == 'l'))
+    return name;
+
+  prefix = current_submake->prefix;
+  end = prefix + current_submake->prefixlen;
+
+  while (1)
+    {
+      if (name[0] == '.' && name[1] == '/')
+        name += 2;
+      else if (name[0] == '.' && name[1] == '.'
+               && (name[2] == '/' || name[2] == '\0') && end > prefix)
+        {
+          /* Drop the last directory of the prefix.  */
+          for (--end; end > prefix && end[-1] != '/'; --end)
+            ;
+          name += name[2] == '\0' ? 2 : 3;
+        }
+      else
+        break;
+
+      while (*name == '/')
+        ++name;
+    }
+
+  if (streq (name, "."))
+    ++name;
+
+  if (*name == '\0')
+    return end > prefix ? strcache_add_len (prefix, end - prefix - 1) : ".";
+
+  len = strlen (name);
+  buf = alloca ((end - prefix) + len + 1);
+  memcpy (buf, prefix, end - prefix);
+  memcpy (buf + (end - prefix), name, len + 1);
+  return strcache_add (buf);
+}
+
+/* Return NAME, the name of a file relative to the top directory, as the
+   recipes of S see it.  */
+
+const char *
+submake_local_name (const struct submake *s, const char *name)
+{
+  const char *p;
+  char *buf, *cp;
+  size_t up = 0;
+
+  if (s == NULL || name[0] == '/' || (name[0] == '-' && name[1] == 'l'))
+    return name;
+
+  if (strncmp (name, s->prefix, s->prefixlen) == 0)
+    return name + s->prefixlen;
+
+  if (strncmp (name, s->prefix, s->prefixlen - 1) == 0
+      && name[s->prefixlen - 1] == '\0')
+    return ".";
+
+  /* Skip the directories NAME shares with the prefix, then go up from the
+     rest of the prefix.  */
+  p = s->prefix;
+  while (*p != '\0')
+    {
+      size_t len = strchr (p, '/') - p;
+
+      if (strncmp (p, name, len) != 0
+          || (name[len] != '/' && name[len] != '\0'))
+        break;
+      p += len + 1;
+      name += len;
+      if (*name == '/')
+        ++name;
+    }
+
+  for (; *p != '\0'; ++p)
+    if (*p == '/')
+      ++up;
+
+  buf = cp = alloca (up * 3 + strlen (name) + 1);
+  while (up-- > 0)
+    cp = mempcpy (cp, "../", 3);
+  if (*name == '\0')
+    /* NAME is a directory above S.  */
+    --cp;
+  strcpy (cp, name);
+  return strcache_add (buf);
+}
+
+/* Make the directory of S (or the top directory, if S is null) the current
+   one, with its directory caches.  Return the sub-make that was entered.  */
+
+struct submake *
+submake_enter (struct submake *s)
+{
+  struct submake *prev = entered;
+  const char *dir;
+
+  if (s == entered)
+    return prev;
+
+  if (entered)
+    dir_swap_tables (entered->dir_tables);
+  if (s)
+    {
+      if (s->dir_tables == NULL)
+        s->dir_tables = dir_new_tables ();
+      dir_swap_tables (s->dir_tables);
+    }
+
+  dir = s ? s->dir : top_dir;
+  if (chdir (dir) < 0)
+    pfatal_with_name (dir);
+
+  starting_directory = s ? (char *) s->dir : top_dir;
+  entered = s;
+  return prev;
+}
+
+/* Note that the makefiles of CURRENT_SUBMAKE need a make of their own, for
+   REASON: usually the directive or special target they use.  */
+
+void
+submake_abandon (const char *reason)
+{
+  if (current_submake && !current_submake->abandoned)
+    {
+      current_submake->abandoned = reason;
+      DB (DB_BASIC, (_("Not inlining the sub-make in '%s' (%s).\n"),
+                     current_submake->dir, reason));
+    }
+}
+
+/* Check that the targets NAMES of CURRENT_SUBMAKE are not made elsewhere.
+   Return zero if the sub-make has been abandoned.  */
+
+int
+submake_check_targets (struct nameseq *names)
+{
+  for (; names && !current_submake->abandoned; names = names->next)
+    {
+      struct file *f;
+
+      if (strchr (names->name, '%') != 0)
+        continue;
+
+      f = lookup_file (names->name);
+      if (f && f->submake != current_submake
+          && (f->is_target || f->updated || f->tried_implicit
+              || f->command_state != cs_not_started))
+        submake_abandon (_("a target of another makefile"));
+    }
+
+  return !current_submake->abandoned;
+}
+
+/* While the makefiles of READING_SUBMAKE are read, the files they found
+   that were there before, as they were, and the files they entered, so that
+   a sub-make that is abandoned leaves nothing behind.  */
+
+struct saved_file
+  {
+    struct file *file;
+    struct dep *last_dep;       /* The last of its deps and also_make, to */
+    struct dep *last_also_make; /* cut off what was appended to them.  */
+    struct file copy;
+  };
+
+static struct saved_file *saved_files = NULL;
+static size_t saved_count = 0;
+static size_t saved_max = 0;
+
+static struct file **new_files = NULL;
+static size_t new_count = 0;
+static size_t new_max = 0;
+
+static struct dep *
+last_dep (struct dep *d)
+{
+  if (d)
+    while (d->next)
+      d = d->next;
+  return d;
+}
+
+/* Keep a copy of FILE, which the makefiles of READING_SUBMAKE may change,
+   unless it is one of theirs.  */
+
+void
+submake_save_file (struct file *file)
+{
+  struct saved_file *sf;
+
+  if (file->saved || file->submake == reading_submake)
+    return;
+
+  if (saved_count == saved_max)
+    {
+      saved_max = saved_max ? saved_max * 2 : 64;
+      saved_files = xrealloc (saved_files,
+                              saved_max * sizeof (struct saved_file));
+    }
+
+  sf = &saved_files[saved_count++];
+  sf->file = file;
+  sf->last_dep = last_dep (file->deps);
+  sf->last_also_make = last_dep (file->also_make);
+  sf->copy = *file;
+  file->saved = 1;
+}
+
+/* Note that FILE was entered by the makefiles of READING_SUBMAKE.  */
+
+void
+submake_new_file (struct file *file)
+{
+  if (new_count == new_max)
+    {
+      new_max = new_max ? new_max * 2 : 64;
+      new_files = xrealloc (new_files, new_max * sizeof (struct file *));
+    }
+  new_files[new_count++] = file;
+}
+
+/* The makefiles of the N sub-makes SMS have been read.  If they are not
+   inlined, abandon them, with REASON unless they already were, and undo
+   what they did to the files and rules of this make.  */
+
+static void
+finish_reading (struct submake **sms, unsigned int n, int inlined,
+                const char *reason)
+{
+  unsigned int i;
+
+  while (saved_count > 0)
+    {
+      struct saved_file *sf = &saved_files[--saved_count];
+
+      if (inlined)
+        sf->file->saved = 0;
+      else
+        {
+          *sf->file = sf->copy;
+          if (sf->last_dep)
+            sf->last_dep->next = NULL;
+          if (sf->last_also_make)
+            sf->last_also_make->next = NULL;
+        }
+    }
+
+  if (!inlined)
+    {
+      while (new_count > 0)
+        forget_file (new_files[--new_count]);
+      for (i = 0; i < n; ++i)
+        {
+          if (!sms[i]->abandoned)
+            {
+              sms[i]->abandoned = reason;
+              DB (DB_BASIC, (_("Not inlining the sub-make in '%s' (%s).\n"),
+                             sms[i]->dir, reason));
+            }
+          free_submake_rules (sms[i]);
+          free_submake_pattern_vars (sms[i]);
+        }
+    }
+  new_count = 0;
+}
+
+/* Put the absolute name of DIR, relative to FROM, in a new string, with
+   '.' and '..' resolved without looking at the file system.  */
+
+static char *
+absolute_dir (const char *from, const char *dir)
+{
+  char *buf = xmalloc (strlen (from) + strlen (dir) + 3);
+  char *end = buf;
+  const char *p;
+
+  if (*dir != '/')
+    {
+      strcpy (buf, from);
+      end = buf + strlen (buf);
+      if (end > buf && end[-1] == '/')
+        --end;
+    }
+
+  for (p = dir; *p != '\0'; )
+    {
+      const char *q = strchr (p, '/');
+      size_t len = q ? (size_t) (q - p) : strlen (p);
+
+      if (len == 0 || (len == 1 && p[0] == '.'))
+        ;
+      else if (len == 2 && p[0] == '.' && p[1] == '.')
+        {
+          while (end > buf && *--end != '/')
+            ;
+        }
+      else
+        {
+          *end++ = '/';
+          memcpy (end, p, len);
+          end += len;
+        }
+
+      p += len;
+      if (*p == '/')
+        ++p;
+    }
+
+  if (end == buf)
+    *end++ = '/';
+  *end = '\0';
+  return buf;
+}
+
+/* The parts of a recursive make in a recipe.  */
+
+struct submake_line
+  {
+    const char *line;           /* The line, without the '@' and '+'.  */
+    int silent;                 /* Nonzero if it is not echoed.  */
+    char *dir;                  /* The absolute name of its directory.  */
+    char *args;                 /* Its assignments, one per line.  */
+    char *goals;                /* Its goals, each followed by a blank.  */
+    struct submake *submake;
+  };
+
+/* Parse LINE, from the recipe of FILE, whose 'make' is MAKE.  Return zero
+   if it is not a '$(MAKE) -C DIR' that can be read into this make.  */
+
+static int
+parse_submake_line (struct submake_line *sl, const char *line, int silent,
+                    const char *make, const char *from)
+{
+  char *words, *p, *w;
+  char *dir = NULL;
+  size_t argslen = 0;
+  size_t goalslen = 0;
+  int first = 1;
+
+  while (ISBLANK (*line) || *line == '@' || *line == '+')
+    silent |= *line++ == '@';
+
+  /* Errors of the sub-make are ignored, or the line needs a shell.  */
+  if (*line == '-' || strpbrk (line, "\n;|&<>()$`\\\"'*?[]{}~#") != NULL)
+    return 0;
+
+  memset (sl, 0, sizeof (*sl));
+  sl->line = line;
+  sl->silent = silent;
+  sl->args = xstrdup ("");
+  sl->goals = xstrdup ("");
+
+  p = words = xstrdup (line);
+  while ((w = find_next_token ((const char **) &p, NULL)) != NULL)
+    {
+      size_t len;
+
+      if (*p != '\0')
+        *p++ = '\0';
+
+      if (first)
+        {
+          first = 0;
+          if (!streq (w, make))
+            goto fail;
+          continue;
+        }
+
+      if (streq (w, "-C") || streq (w, "--directory"))
+        {
+          w = find_next_token ((const char **) &p, NULL);
+          if (w == NULL)
+            goto fail;
+          if (*p != '\0')
+            *p++ = '\0';
+        }
+      else if (w[0] == '-' && w[1] == 'C')
+        w += 2;
+      else if (strncmp (w, "--directory=", CSTRLEN ("--directory=")) == 0)
+        w += CSTRLEN ("--directory=");
+      else if (streq (w, "-w") || streq (w, "--print-directory")
+               || streq (w, "--no-print-directory"))
+        continue;
+      else if (w[0] == '-')
+        goto fail;
+      else
+        {
+          /* An assignment, which is kept for the comparison too, or a
+             goal.  */
+          char *eq = strchr (w, '=');
+          len = strlen (w);
+          if (eq == w)
+            goto fail;
+          if (eq)
+            {
+              sl->args = xrealloc (sl->args, argslen + len + 2);
+              memcpy (sl->args + argslen, w, len);
+              argslen += len;
+              sl->args[argslen++] = '\n';
+              sl->args[argslen] = '\0';
+            }
+          else
+            {
+              sl->goals = xrealloc (sl->goals, goalslen + len + 2);
+              memcpy (sl->goals + goalslen, w, len);
+              goalslen += len;
+              sl->goals[goalslen++] = ' ';
+              sl->goals[goalslen] = '\0';
+            }
+          continue;
+        }
+
+      /* Each -C is relative to the previous one.  */
+      {
+        char *d = absolute_dir (dir ? dir : from, w);
+        free (dir);
+        dir = d;
+      }
+    }
+
+  free (words);
+
+  if (dir == NULL)
+    goto fail2;
+  sl->dir = dir;
+  return 1;
+
+ fail:
+  free (words);
+  free (dir);
+ fail2:
+  free (sl->args);
+  free (sl->goals);
+  return 0;
+}
+
+/* Return nonzero if DIR has one of the default makefiles.  */
+
+static int
+has_default_makefile (const char *dir)
+{
+  static const char *names[] = { "GNUmakefile", "makefile", "Makefile", 0 };
+  const char **np;
+
+  for (np = names; *np != NULL; ++np)
+    {
+      struct stat st;
+      int r;
+      const char *name = concat (3, dir, "/", *np);
+      EINTRLOOP (r, stat (name, &st));
+      if (r == 0)
+        return 1;
+    }
+  return 0;
+}
+
+/* Read the makefiles of S as a sub-make would, with the environment ENV,
+   and the assignments ARGS and the goals GOALS of its command line.  What
+   they do is kept until finish_reading.  */
+
+static void
+read_submake (struct submake *s, char **env, char *args, const char *goals)
+{
+  struct variable_set_list *save_vars = current_variable_set_list;
+  struct variable *save_goal_var = default_goal_var;
+  struct file *save_suffix_file = suffix_file;
+  struct file *save_default_file = default_file;
+  const floc *save_reading = reading_file;
+  int save_snapped = snapped_deps;
+  char save_prefix = cmd_prefix;
+  struct submake *save_submake = current_submake;
+  int save_names = submake_names;
+  struct goaldep *save_read_files = swap_read_files (NULL);
+  struct goaldep *rf, *d;
+  struct variable_set *vars;
+  struct variable *v;
+  struct submake *prev;
+  char **ep;
+  char *p;
+
+  DB (DB_BASIC, (_("Reading the makefiles of the sub-make in '%s'...\n"),
+                 s->dir));
+  reading_submake = s;
+
+  current_variable_set_list = s->variables = create_new_variable_set ();
+  s->variables->next = NULL;
+  vars = s->variables->set;
+  current_variable_set_list = save_vars;
+  reading_file = NULL;
+  snapped_deps = 0;
+  cmd_prefix = RECIPEPREFIX_DEFAULT;
+  current_submake = s;
+  submake_names = 1;
+
+  /* Start with the variables the sub-make would get from this one.  The
+     files of the sub-make see them through its variable set, which stands
+     for the global one until they are swapped back.  */
+  s->variables->set = swap_global_variable_set (vars);
+  inherit_global_variables (vars);
+
+  for (ep = env; *ep != NULL; ++ep)
+    {
+      char *eq = strchr (*ep, '=');
+      size_t len;
+
+      if (eq == NULL)
+        continue;
+      len = eq - *ep;
+#define ENV_IS(_n) (len == CSTRLEN (_n) && memcmp (*ep, _n, len) == 0)
+      if (ENV_IS ("SHELL") || ENV_IS (MAKEFLAGS_NAME) || ENV_IS ("MFLAGS")
+          || ENV_IS (MAKELEVEL_NAME) || ENV_IS ("GNUMAKEFLAGS")
+          || ENV_IS ("MAKE_RESTARTS") || ENV_IS ("MAKEOVERRIDES"))
+        continue;
+#undef ENV_IS
+      define_variable_global (*ep, len, eq + 1, o_env, 1, NILF)->export
+        = v_export;
+    }
+
+  {
+    unsigned int save_level = makelevel;
+    makelevel = s->level;
+    define_automatic_variables ();
+    makelevel = save_level;
+  }
+  define_default_variables ();
+
+  if (!lookup_variable (STRING_SIZE_TUPLE (".VARIABLES")))
+    define_variable_cname (".VARIABLES", "", o_default, 0)->special = 1;
+  if (!lookup_variable (STRING_SIZE_TUPLE (".RECIPEPREFIX")))
+    define_variable_cname (".RECIPEPREFIX", "", o_default, 0)->special = 1;
+  define_variable_cname ("CURDIR", s->dir, o_file, 0);
+  p = xstrndup (goals, *goals ? strlen (goals) - 1 : 0);
+  define_variable_cname ("MAKECMDGOALS", p, o_default, 0);
+  free (p);
+
+  for (p = args; *p != '\0'; )
+    {
+      char *nl = strchr (p, '\n');
+      *nl = '\0';
+      try_variable_definition (NILF, p, o_command, 0);
+      p = nl + 1;
+    }
+
+  default_goal_var = define_variable_cname (".DEFAULT_GOAL", "", o_file, 0);
+
+  prev = submake_enter (s);
+
+  set_default_suffixes ();
+  install_default_suffix_rules ();
+  default_file = enter_file (strcache_add (".DEFAULT"));
+
+  rf = read_all_makefiles (NULL);
+  for (d = rf; d != NULL; d = d->next)
+    if (d->error && (!(d->flags & RM_DONTCARE) || d->file->is_target))
+      submake_abandon (_("a makefile that must be remade"));
+
+  if (!s->abandoned)
+    {
+      snap_deps ();
+      convert_to_pattern ();
+    }
+
+  /* The directories of the patterns are checked from the top.  */
+  submake_enter (NULL);
+  if (!s->abandoned)
+    snap_implicit_rules ();
+
+  v = lookup_variable (STRING_SIZE_TUPLE ("VPATH"));
+  if (v && *v->value != '\0')
+    submake_abandon ("VPATH");
+  v = lookup_variable (STRING_SIZE_TUPLE ("GPATH"));
+  if (v && *v->value != '\0')
+    submake_abandon ("GPATH");
+
+  {
+    struct file *f = lookup_file (".DELETE_ON_ERROR");
+    s->delete_on_error = f != 0 && f->is_target;
+  }
+  s->default_goal = strcache_add (default_goal_var->value);
+  s->suffix_file = suffix_file;
+  s->default_file = default_file;
+
+  reading_submake = NULL;
+
+  swap_global_variable_set (vars);
+  s->variables->set = vars;
+
+  free_goal_chain (swap_read_files (save_read_files));
+  current_variable_set_list = save_vars;
+  default_goal_var = save_goal_var;
+  suffix_file = save_suffix_file;
+  default_file = save_default_file;
+  reading_file = save_reading;
+  snapped_deps = save_snapped;
+  cmd_prefix = save_prefix;
+  current_submake = save_submake;
+  submake_names = save_names;
+
+  submake_enter (prev);
+}
+
+/* Return the file of GOAL, a goal of S.  If CREATE is zero, return null
+   if it has none.  */
+
+static struct file *
+submake_goal (struct submake *s, const char *goal, int create)
+{
+  struct submake *save_submake = current_submake;
+  int save_names = submake_names;
+  struct file *f;
+
+  current_submake = s;
+  submake_names = 1;
+  goal = strcache_add (goal);
+  f = lookup_file (goal);
+  if (f == NULL && create)
+    {
+      f = enter_file (goal);
+      f->submake = s;
+    }
+  current_submake = save_submake;
+  submake_names = save_names;
+  return f;
+}
+
+/* If the recipe of FILE, expanded into LINES, only runs sub-makes that can
+   be read into this make, read them, make their goals prerequisites of
+   FILE, and return nonzero.  Otherwise return zero: the recipe runs.  */
+
+int
+submake_inline (struct file *file, char **lines)
+{
+  struct commands *cmds = file->cmds;
+  struct submake_line *sls;
+  struct submake **sms;
+  const char *from;
+  char *make;
+  char **env = NULL;
+  unsigned int i, n = 0, nread = 0;
+  int ok = 1;
+  struct dep **tail;
+
+  if (second_expansion || posix_pedantic || one_shell || rebuilding_makefiles
+      || cmds->ncommand_lines == 0)
+    return 0;
+
+  for (i = 0; i < cmds->ncommand_lines; ++i)
+    if (!(cmds->lines_flags[i] & COMMANDS_RECURSE))
+      return 0;
+
+  if (top_dir == NULL)
+    {
+      if (starting_directory == NULL)
+        return 0;
+      top_dir = xstrdup (starting_directory);
+    }
+  from = file->submake ? file->submake->dir : top_dir;
+
+  make = allocated_variable_expand_for_file ("$(MAKE)", file);
+  sls = xcalloc (cmds->ncommand_lines * sizeof (struct submake_line));
+  sms = xmalloc (cmds->ncommand_lines * sizeof (struct submake *));
+
+  for (i = 0; ok && i < cmds->ncommand_lines; ++i)
+    {
+      struct submake_line *sl = &sls[n];
+      size_t toplen = strlen (top_dir);
+      struct submake *s;
+      char *key;
+
+      if (!parse_submake_line (sl, lines[i],
+                               (cmds->lines_flags[i] & COMMANDS_SILENT) != 0,
+                               make, from))
+        {
+          ok = 0;
+          break;
+        }
+      ++n;
+
+      /* The directory must be below the top one, and have a makefile.  */
+      if (strncmp (sl->dir, top_dir, toplen) != 0 || sl->dir[toplen] != '/'
+          || streq (sl->dir, from) || !has_default_makefile (sl->dir))
+        {
+          ok = 0;
+          break;
+        }
+
+      /* The goals are part of the arguments too: MAKECMDGOALS is.  */
+      key = xstrdup (concat (3, sl->args, "\n", sl->goals));
+
+      for (s = submakes; s != NULL; s = s->next)
+        if (streq (s->dir, sl->dir))
+          break;
+
+      if (s == NULL)
+        {
+          s = xcalloc (sizeof (struct submake));
+          s->dir = strcache_add (sl->dir);
+          s->prefix = strcache_add (concat (2, sl->dir + toplen + 1, "/"));
+          s->prefixlen = strlen (s->prefix);
+          s->args = key;
+          s->level = (file->submake ? file->submake->level : makelevel) + 1;
+          s->next = submakes;
+          submakes = s;
+
+          if (env == NULL)
+            {
+              struct submake *prev = submake_enter (file->submake);
+              env = target_environment (file, 1);
+              submake_enter (prev);
+            }
+          read_submake (s, env, sl->args, sl->goals);
+          sms[nread++] = s;
+        }
+      else
+        {
+          if (!streq (s->args, key))
+            ok = 0;
+          free (key);
+        }
+
+      if (s->abandoned)
+        ok = 0;
+      sl->submake = s;
+    }
+
+  if (env)
+    free_environment (env);
+  free (make);
+
+  /* Find the goals, which must not include FILE.  */
+  for (i = 0; ok && i < n; ++i)
+    {
+      const char *gp = *sls[i].goals ? sls[i].goals : sls[i].submake->default_goal;
+      const char *g;
+      size_t len;
+
+      if (find_next_token (&gp, NULL) == NULL)
+        ok = 0;
+      gp = *sls[i].goals ? sls[i].goals : sls[i].submake->default_goal;
+      while (ok && (g = find_next_token (&gp, &len)) != NULL)
+        {
+          char *name = xstrndup (g, len);
+          if (submake_goal (sls[i].submake, name, 0) == file)
+            ok = 0;
+          free (name);
+        }
+    }
+
+  /* The recipe runs the sub-makes it read if any of its lines cannot be
+     inlined, so none of them may be.  */
+  finish_reading (sms, nread, ok, _("a recipe that also runs it"));
+  free (sms);
+
+  if (ok)
+    {
+      for (tail = &file->deps; *tail != NULL; tail = &(*tail)->next)
+        ;
+
+      for (i = 0; i < n; ++i)
+        {
+          struct submake_line *sl = &sls[i];
+          const char *gp = *sl->goals ? sl->goals : sl->submake->default_goal;
+          const char *g;
+          size_t len;
+          int first = 1;
+
+          if (just_print_flag || ISDB (DB_PRINT) || (!sl->silent && !run_silent))
+            OS (message, 0, "%s", sl->line);
+          ++commands_started;
+
+          while ((g = find_next_token (&gp, &len)) != NULL)
+            {
+              char *name = xstrndup (g, len);
+              struct dep *d = alloc_dep ();
+              d->file = submake_goal (sl->submake, name, 1);
+              d->wait_here = i > 0 && first;
+              first = 0;
+              *tail = d;
+              tail = &d->next;
+              free (name);
+            }
+        }
+
+      DB (DB_BASIC, (_("Inlined the sub-makes of target '%s'.\n"),
+                     file->name));
+      file->inlined = 1;
+    }
+
+  for (i = 0; i < n; ++i)
+    {
+      free (sls[i].dir);
+      free (sls[i].args);
+      free (sls[i].goals);
+    }
+  free (sls);
+
+  return ok;
+}
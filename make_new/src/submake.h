@@ -0,0 +1,61 @@
+/* Declarations for evaluating recursive makes in this process.
+Copyright (C) 2022 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+struct file;
+struct nameseq;
+struct variable_set_list;
+
+/* A sub-make read into this process (--inline-submake).  Its files are
+   entered with names relative to the top-level directory, by putting PREFIX
+   in front of the names its makefiles use.  */
+
+struct submake
+  {
+    struct submake *next;
+    const char *dir;            /* Absolute name of its directory.  */
+    const char *prefix;         /* DIR relative to the top, with a '/'.  */
+    size_t prefixlen;
+    const char *args;           /* The variable assignments and goals it was
+                                   run with.  */
+    const char *abandoned;      /* Why it is run as a real sub-make instead,
+                                   or null.  */
+    const char *default_goal;   /* The value of its .DEFAULT_GOAL.  */
+    unsigned int level;         /* Its MAKELEVEL.  */
+    int delete_on_error;        /* Nonzero if .DELETE_ON_ERROR is a target.  */
+    struct variable_set_list *variables; /* Its global variables.  */
+    struct file *suffix_file;   /* Its .SUFFIXES and .DEFAULT.  */
+    struct file *default_file;
+    void *dir_tables;           /* Its directory caches; see dir_swap_tables.  */
+  };
+
+/* The sub-make whose files are being entered, or null for the top level.  */
+extern struct submake *current_submake;
+
+/* Nonzero if lookup_file and enter_file put the prefix of CURRENT_SUBMAKE in
+   front of relative names: while its makefiles are read.  */
+extern int submake_names;
+
+/* The sub-make whose makefiles are being read, or null.  */
+extern struct submake *reading_submake;
+
+int submake_inline (struct file *file, char **lines);
+const char *submake_file_name (const char *name);
+const char *submake_local_name (const struct submake *s, const char *name);
+struct submake *submake_enter (struct submake *s);
+void submake_abandon (const char *reason);
+void submake_save_file (struct file *file);
+void submake_new_file (struct file *file);
+int submake_check_targets (struct nameseq *names);
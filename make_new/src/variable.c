@@ -26,6 +26,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "variable.h"
 #include "os.h"
 #include "rule.h"
+#include "submake.h"
 #ifdef WINDOWS32
 #include "pathstuff.h"
 #endif
@@ -37,6 +38,24 @@ unsigned long long env_recursion = 0;
 /* Incremented every time we add or remove a global variable.  */
 static unsigned long variable_changenum = 0;
 
+/* Incremented every time a global variable that a cached expansion may
+   depend on is defined, redefined or removed, and every time a name is
+   first defined outside the global set.  Cached expansions (see
+   recursively_expand_for_file) are only valid for the generation they were
+   made in.  So is the exported environment (see target_environment), which
+   is why changing the origin or the export status of a global variable
+   bumps it too.  */
+unsigned long variable_generation = 1;
+
+/* Names of the variables ever defined in a set other than the global one:
+   target- and pattern-specific variables, automatic variables, and the
+   locals of foreach, let and call.  */
+static struct hash_table local_variable_names;
+
+/* Names of the variables that cached expansions looked at (see
+   observe_variable).  Changing any other variable leaves them valid.  */
+static struct hash_table observed_variable_names;
+
 /* Chain of all pattern-specific variables.  */
 
 static struct pattern_var *pattern_vars = NULL;
@@ -55,9 +74,18 @@ static struct pattern_var *last_pattern_vars[256];
 struct pattern_var *
 create_pattern_var (const char *target, const char *suffix)
 {
-  size_t len = strlen (target);
+  size_t len;
   struct pattern_var *p = xcalloc (sizeof (struct pattern_var));
 
+  /* The patterns of an inlined sub-make match the names of its files.  */
+  if (submake_names)
+    {
+      const char *t = submake_file_name (target);
+      suffix = t + (strlen (t) - strlen (target)) + (suffix - target);
+      target = t;
+    }
+  len = strlen (target);
+
   if (pattern_vars != 0)
     {
       if (len < 256 && last_pattern_vars[len] != 0)
@@ -93,6 +121,7 @@ create_pattern_var (const char *target, const char *suffix)
   p->target = target;
   p->len = len;
   p->suffix = suffix + 1;
+  p->submake = current_submake;
 
   if (len < 256)
     last_pattern_vars[len] = p;
@@ -100,11 +129,37 @@ create_pattern_var (const char *target, const char *suffix)
   return p;
 }
 
-/* Look up a target in the pattern-specific variable list.  */
+/* Free the pattern-specific variables defined by the makefiles of the
+   sub-make S.  */
+
+void
+free_submake_pattern_vars (const struct submake *s)
+{
+  struct pattern_var **pp = &pattern_vars;
+  struct pattern_var *p;
+
+  memset (last_pattern_vars, 0, sizeof (last_pattern_vars));
+  while ((p = *pp) != 0)
+    {
+      if (p->submake == s)
+        {
+          *pp = p->next;
+          free (p->variable.name);
+          free (p->variable.value);
+          free (p);
+          continue;
+        }
+      if (p->len < 256)
+        last_pattern_vars[p->len] = p;
+      pp = &p->next;
+    }
+}
+
+/* Look up a target of SUBMAKE in the pattern-specific variable list.  */
 
 static struct pattern_var *
 lookup_pattern_var (struct pattern_var *start, const char *target,
-                    size_t targlen)
+                    size_t targlen, const struct submake *submake)
 {
   struct pattern_var *p;
 
@@ -113,7 +168,7 @@ lookup_pattern_var (struct pattern_var *start, const char *target,
       const char *stem;
       size_t stemlen;
 
-      if (p->len > targlen)
+      if (p->len > targlen || p->submake != submake)
         /* It can't possibly match.  */
         continue;
 
@@ -166,6 +221,65 @@ variable_hash_cmp (const void *xv, const void *yv)
   return_STRING_N_COMPARE (x->name, y->name, x->length);
 }
 
+/* Add NAME, LENGTH chars long, to TABLE, a set of variable names.
+   Return nonzero if it was not there yet.  */
+
+static int
+add_variable_name (struct hash_table *table, const char *name, size_t length)
+{
+  struct variable var_key;
+  struct variable **var_slot;
+  struct variable *v;
+
+  if (table->ht_vec == 0)
+    hash_init (table, 64, variable_hash_1, variable_hash_2, variable_hash_cmp);
+
+  var_key.name = (char *) name;
+  var_key.length = (unsigned int) length;
+  var_slot = (struct variable **) hash_find_slot (table, &var_key);
+  if (!HASH_VACANT (*var_slot))
+    return 0;
+
+  v = xcalloc (sizeof (struct variable));
+  v->name = xstrndup (name, length);
+  v->length = (unsigned int) length;
+  hash_insert_at (table, v, var_slot);
+  return 1;
+}
+
+/* Return nonzero if NAME, LENGTH chars long, is in TABLE.  */
+
+static int
+has_variable_name (struct hash_table *table, const char *name, size_t length)
+{
+  struct variable var_key;
+
+  if (table->ht_vec == 0)
+    return 0;
+
+  var_key.name = (char *) name;
+  var_key.length = (unsigned int) length;
+  return hash_find_item (table, &var_key) != 0;
+}
+
+/* Return nonzero if NAME has ever been defined outside the global set, so
+   that looking it up may give a different variable for each target.  */
+
+int
+variable_defined_locally (const char *name, size_t length)
+{
+  return has_variable_name (&local_variable_names, name, length);
+}
+
+/* Note that a cached expansion depends on the global variable NAME, or on
+   it staying undefined.  */
+
+void
+observe_variable (const char *name, size_t length)
+{
+  add_variable_name (&observed_variable_names, name, length);
+}
+
 #ifndef VARIABLE_BUCKETS
 #define VARIABLE_BUCKETS                523
 #endif
@@ -190,6 +304,55 @@ init_hash_global_variable_set (void)
              variable_hash_1, variable_hash_2, variable_hash_cmp);
 }
 
+/* Exchange the global variables with those in SET, so that the makefiles of
+   an inlined sub-make define its own globals.  Return the address of the
+   global set, which holds the variables of SET until the next swap.  */
+
+struct variable_set *
+swap_global_variable_set (struct variable_set *set)
+{
+  struct variable_set tmp = global_variable_set;
+  global_variable_set = *set;
+  *set = tmp;
+
+  ++variable_generation;
+  ++variable_changenum;
+  return &global_variable_set;
+}
+
+/* Define as globals copies of the variables in FROM that a sub-make gets
+   from its parent other than through the environment: the default and
+   automatic ones, those from the command line, and MAKEFLAGS, MFLAGS and
+   MAKEOVERRIDES.  */
+
+void
+inherit_global_variables (struct variable_set *from)
+{
+  struct variable **v_slot = (struct variable **) from->table.ht_vec;
+  struct variable **v_end = v_slot + from->table.ht_size;
+
+  for ( ; v_slot < v_end; v_slot++)
+    if (! HASH_VACANT (*v_slot))
+      {
+        struct variable *v = *v_slot;
+        struct variable *nv;
+
+        if (v->origin != o_default && v->origin != o_automatic
+            && v->origin != o_command && !streq (v->name, MAKEFLAGS_NAME)
+            && !streq (v->name, "MFLAGS") && !streq (v->name, "MAKEOVERRIDES"))
+          continue;
+
+        nv = define_variable_global (v->name, v->length, v->value, v->origin,
+                                     v->recursive, &v->fileinfo);
+        nv->export = v->export;
+        nv->exportable = v->exportable;
+        nv->special = v->special;
+        nv->flavor = v->flavor;
+        nv->append = v->append;
+        nv->conditional = v->conditional;
+      }
+}
+
 /* Define variable named NAME with value VALUE in SET.  VALUE is copied.
    LENGTH is the length of NAME, which does not need to be null-terminated.
    ORIGIN specifies the origin of the variable (makefile, command line
@@ -210,6 +373,14 @@ define_variable_in_set (const char *name, size_t length,
   if (set == NULL)
     set = &global_variable_set;
 
+  if (set == &global_variable_set)
+    {
+      if (has_variable_name (&observed_variable_names, name, length))
+        ++variable_generation;
+    }
+  else if (add_variable_name (&local_variable_names, name, length))
+    ++variable_generation;
+
   var_key.name = (char *) name;
   var_key.length = (unsigned int) length;
   var_slot = (struct variable **) hash_find_slot (&set->table, &var_key);
@@ -258,6 +429,9 @@ define_variable_in_set (const char *name, size_t length,
          than this one, don't redefine it.  */
       if ((int) origin >= (int) v->origin)
         {
+          /* A new origin can change whether V is exported.  */
+          if (set == &global_variable_set && v->origin != origin)
+            ++variable_generation;
           free (v->value);
           v->value = xstrdup (value);
           if (flocp != 0)
@@ -317,6 +491,8 @@ free_variable_name_and_value (const void *item)
   struct variable *v = (struct variable *) item;
   free (v->name);
   free (v->value);
+  free (v->exp_cache);
+  release_expansion (v->exp_prog);
 }
 
 void
@@ -363,7 +539,10 @@ undefine_variable_in_set (const char *name, size_t length,
           free_variable_name_and_value (v);
           free (v);
           if (set == &global_variable_set)
-            ++variable_changenum;
+            {
+              ++variable_changenum;
+              ++variable_generation;
+            }
         }
     }
 }
@@ -592,8 +771,10 @@ initialize_file_variables (struct file *file, int reading)
       return;
     }
 
-  if (file->parent == 0)
-    l->next = &global_setlist;
+  /* The targets of an inlined sub-make see its global variables, not
+     those of the target that ran it.  */
+  if (file->parent == 0 || file->parent->submake != file->submake)
+    l->next = file->submake ? file->submake->variables : &global_setlist;
   else
     {
       initialize_file_variables (file->parent, reading);
@@ -609,7 +790,7 @@ initialize_file_variables (struct file *file, int reading)
       struct pattern_var *p;
       const size_t targlen = strlen (file->name);
 
-      p = lookup_pattern_var (0, file->name, targlen);
+      p = lookup_pattern_var (0, file->name, targlen, file->submake);
       if (p != 0)
         {
           struct variable_set_list *global = current_variable_set_list;
@@ -648,7 +829,8 @@ initialize_file_variables (struct file *file, int reading)
               v->export = p->variable.export;
               v->private_var = p->variable.private_var;
             }
-          while ((p = lookup_pattern_var (p, file->name, targlen)) != 0);
+          while ((p = lookup_pattern_var (p, file->name, targlen,
+                                          file->submake)) != 0);
 
           current_variable_set_list = global;
         }
@@ -769,11 +951,14 @@ merge_variable_sets (struct variable_set *to_set,
           {
             hash_insert_at (&to_set->table, from_var, to_var_slot);
             variable_changenum += inc;
+            variable_generation += inc;
           }
         else
           {
             /* GKM FIXME: delete in from_set->table */
             free (from_var->value);
+            free (from_var->exp_cache);
+            release_expansion (from_var->exp_prog);
             free (from_var);
           }
       }
@@ -891,6 +1076,7 @@ define_automatic_variables (void)
           free (shell->value);
           shell->value = xstrdup (default_shell);
           shell->origin = o_default;
+          ++variable_generation;
         }
 
     /* Some people do not like cmd to be used as the default
@@ -938,6 +1124,7 @@ define_automatic_variables (void)
       free (v->value);
       v->origin = o_file;
       v->value = xstrdup (default_shell);
+      ++variable_generation;
     }
 #endif
 
@@ -1019,27 +1206,228 @@ should_export (const struct variable *v)
   return 1;
 }
 
+/* The MAKELEVEL of the makefile FILE belongs to.  */
+
+#define FILE_MAKELEVEL(_f) \
+  ((_f) != NULL && (_f)->submake != NULL ? (_f)->submake->level : makelevel)
+
+/* Return "NAME=VALUE" for the exported variable V in the environment of
+   FILE's commands, in malloc'd storage.  If INVALID is not NULL it is
+   added to the jobserver auth option in MAKEFLAGS and MFLAGS.  */
+
+static char *
+environment_string (struct variable *v, struct file *file, const char *invalid)
+{
+  char *value = v->value;
+  char *cp = NULL;
+  char *result;
+
+  /* If V is recursively expanded and didn't come from the environment,
+     expand its value.  If it came from the environment, it should
+     go back into the environment unchanged.  */
+  if (v->recursive && v->origin != o_env && v->origin != o_env_override)
+    value = cp = recursively_expand_for_file (v, file);
+
+  /* If this is MAKELEVEL, update it.  */
+  if (streq (v->name, MAKELEVEL_NAME))
+    {
+      char val[INTSTR_LENGTH + 1];
+      sprintf (val, "%u", FILE_MAKELEVEL (file) + 1);
+      free (cp);
+      value = cp = xstrdup (val);
+      goto setit;
+    }
+
+  /* If we need to reset jobserver, check for MAKEFLAGS / MFLAGS.  */
+  if (invalid && streq (v->name, MAKEFLAGS_NAME))
+    {
+      char *mf;
+      char *vars;
+
+      if (!strstr (value, " --" JOBSERVER_AUTH_OPT "="))
+        goto setit;
+
+      /* The invalid option must come before variable overrides.  */
+      vars = strstr (value, " -- ");
+      if (!vars)
+        mf = xstrdup (concat (2, value, invalid));
+      else
+        {
+          size_t lf = vars - value;
+          size_t li = strlen (invalid);
+          mf = xmalloc (strlen (value) + li + 1);
+          strcpy (mempcpy (mempcpy (mf, value, lf), invalid, li), vars);
+        }
+      free (cp);
+      value = cp = mf;
+      goto setit;
+    }
+
+  if (invalid && streq (v->name, "MFLAGS"))
+    {
+      const char *mf;
+
+      if (!strstr (value, " --" JOBSERVER_AUTH_OPT "="))
+        goto setit;
+
+      if (v->origin != o_env)
+        goto setit;
+      mf = concat (2, value, invalid);
+      free (cp);
+      value = cp = xstrdup (mf);
+      goto setit;
+    }
+
+#ifdef WINDOWS32
+  if (streq (v->name, "Path") || streq (v->name, "PATH"))
+    {
+      if (!cp)
+        cp = xstrdup (value);
+      value = convert_Path_to_windows32 (cp, ';');
+      goto setit;
+    }
+#endif
+
+ setit:
+  result = xstrdup (concat (3, v->name, "=", value));
+  free (cp);
+  return result;
+}
+
+/* The part of the children's environment that comes from the global
+   variable set.  It is rebuilt when a global variable that could change it
+   is redefined or its export status changes; see variable_generation.  */
+
+struct global_environment
+  {
+    unsigned long generation;   /* variable_generation when built.  */
+    unsigned long changenum;    /* variable_changenum when built.  */
+    int export_all;             /* export_all_variables when built.  */
+    unsigned int refs;          /* Environments pointing into TEXT, plus one
+                                   while this is the current one.  */
+    unsigned int count;         /* The number of exported variables.  */
+    struct variable **vars;     /* The exported global variables.  */
+    char **strings;             /* "NAME=VALUE" for each of VARS, in TEXT,
+                                   or NULL if it must be computed for each
+                                   child.  */
+    char *text;
+    size_t size;
+  };
+
+static struct global_environment *global_environment;
+
+static void
+release_global_environment (struct global_environment *genv)
+{
+  if (--genv->refs == 0)
+    {
+      free (genv->vars);
+      free (genv->strings);
+      free (genv->text);
+      free (genv);
+    }
+}
+
+/* Return the current global environment, building it if the variables
+   changed since the last time.  */
+
+static struct global_environment *
+get_global_environment (struct file *file)
+{
+  struct global_environment *genv = global_environment;
+  struct variable **v_slot;
+  struct variable **v_end;
+  char *p;
+  unsigned int i;
+
+  if (genv && genv->generation == variable_generation
+      && genv->changenum == variable_changenum
+      && genv->export_all == export_all_variables)
+    return genv;
+
+  if (genv)
+    release_global_environment (genv);
+
+  genv = xcalloc (sizeof (struct global_environment));
+  genv->generation = variable_generation;
+  genv->changenum = variable_changenum;
+  genv->export_all = export_all_variables;
+  genv->refs = 1;
+  global_environment = genv;
+
+  genv->vars = xmalloc ((global_variable_set.table.ht_fill + 1)
+                        * sizeof (struct variable *));
+  genv->strings = xmalloc ((global_variable_set.table.ht_fill + 1)
+                           * sizeof (char *));
+
+  v_slot = (struct variable **) global_variable_set.table.ht_vec;
+  v_end = v_slot + global_variable_set.table.ht_size;
+  for ( ; v_slot < v_end; v_slot++)
+    if (! HASH_VACANT (*v_slot) && should_export (*v_slot))
+      {
+        struct variable *v = *v_slot;
+        char *str = NULL;
+
+        /* Redefining V must rebuild the environment.  */
+        observe_variable (v->name, v->length);
+
+        /* MAKEFLAGS and MFLAGS depend on the child's jobserver auth,
+           MAKELEVEL on its sub-make, and values that may depend on the
+           target are expanded for each.  */
+        if (!streq (v->name, MAKEFLAGS_NAME) && !streq (v->name, "MFLAGS")
+            && !streq (v->name, MAKELEVEL_NAME)
+            && (!v->recursive || v->origin == o_env
+                || v->origin == o_env_override
+                || variable_expansion_is_pure (v)))
+          {
+            str = environment_string (v, file, NULL);
+            genv->size += strlen (str) + 1;
+          }
+
+        genv->vars[genv->count] = v;
+        genv->strings[genv->count++] = str;
+      }
+
+  /* Move the strings into one block, so children can share them.  */
+  p = genv->text = xmalloc (genv->size + 1);
+  for (i = 0; i < genv->count; ++i)
+    if (genv->strings[i])
+      {
+        char *str = genv->strings[i];
+        genv->strings[i] = p;
+        p = stpcpy (p, str) + 1;
+        free (str);
+      }
+
+  return genv;
+}
+
 /* Create a new environment for FILE's commands.
    If FILE is nil, this is for the 'shell' function.
    The child's MAKELEVEL variable is incremented.
-   If recursive is true then we're running a recursive make, else not.  */
+   If recursive is true then we're running a recursive make, else not.
+   The exported global variables come from the global environment, whose
+   strings are shared between children; only target-specific variables and
+   globals whose value can depend on the target are expanded for each.
+   Free the result with free_environment.  */
 
 char **
 target_environment (struct file *file, int recursive)
 {
   struct variable_set_list *set_list;
   struct variable_set_list *s;
+  struct global_environment *genv;
+  int in_global = 1;
   struct hash_table table;
   struct variable **v_slot;
   struct variable **v_end;
   char **result_0;
   char **result;
   const char *invalid = NULL;
+  unsigned int i;
   /* If we got no value from the environment then never add the default.  */
   int added_SHELL = shell_var.value == 0;
   int found_makelevel = 0;
-  int found_mflags = 0;
-  int found_makeflags = 0;
 
   /* If file is NULL we're creating the target environment for $(shell ...)
      Remember this so we can just ignore recursion.  */
@@ -1056,16 +1444,21 @@ target_environment (struct file *file, int recursive)
   else
     set_list = current_variable_set_list;
 
-  hash_init (&table, VARIABLE_BUCKETS,
-             variable_hash_1, variable_hash_2, variable_hash_cmp);
+  hash_init (&table, 64, variable_hash_1, variable_hash_2, variable_hash_cmp);
 
-  /* Run through all the variable sets in the list, accumulating variables
-     in TABLE.  We go from most specific to least, so the first variable we
-     encounter is the keeper.  */
+  /* Run through the variable sets in the list other than the global one,
+     accumulating variables in TABLE.  We go from most specific to least,
+     so the first variable we encounter is the keeper.  */
   for (s = set_list; s != 0; s = s->next)
     {
       struct variable_set *set = s->set;
-      int isglobal = set == &global_variable_set;
+
+      if (set == &global_variable_set)
+        continue;
+
+      /* The targets of an inlined sub-make end with its own globals.  */
+      if (s->next == 0)
+        in_global = 0;
 
       v_slot = (struct variable **) set->table.ht_vec;
       v_end = v_slot + set->table.ht_size;
@@ -1078,18 +1471,31 @@ target_environment (struct file *file, int recursive)
             evslot = (struct variable **) hash_find_slot (&table, v);
 
             if (HASH_VACANT (*evslot))
-              {
-                /* If we're not global, or we are and should export, add it.  */
-                if (!isglobal || should_export (v))
-                  hash_insert_at (&table, v, evslot);
-              }
+              hash_insert_at (&table, v, evslot);
             else if ((*evslot)->export == v_default)
               /* We already have a variable but we don't know its status.  */
               (*evslot)->export = v->export;
           }
     }
 
-  result = result_0 = xmalloc ((table.ht_fill + 3) * sizeof (char *));
+  /* Let the global variables decide the status of the others.  */
+  v_slot = (struct variable **) table.ht_vec;
+  v_end = v_slot + table.ht_size;
+  for ( ; in_global && v_slot < v_end; v_slot++)
+    if (! HASH_VACANT (*v_slot) && (*v_slot)->export == v_default)
+      {
+        struct variable *gv = hash_find_item (&global_variable_set.table,
+                                              *v_slot);
+        if (gv)
+          (*v_slot)->export = gv->export;
+      }
+
+  /* Keep GENV alive even if an expansion below rebuilds it.  */
+  genv = get_global_environment (file);
+  ++genv->refs;
+
+  result = result_0 = xmalloc ((table.ht_fill + genv->count + 4)
+                               * sizeof (char *));
 
   v_slot = (struct variable **) table.ht_vec;
   v_end = v_slot + table.ht_size;
@@ -1097,102 +1503,39 @@ target_environment (struct file *file, int recursive)
     if (! HASH_VACANT (*v_slot))
       {
         struct variable *v = *v_slot;
-        char *value = v->value;
-        char *cp = NULL;
 
         /* This might be here because it was a target-specific variable that
            we didn't know the status of when we added it.  */
         if (! should_export (v))
           continue;
 
-        /* If V is recursively expanded and didn't come from the environment,
-           expand its value.  If it came from the environment, it should
-           go back into the environment unchanged.  */
-        if (v->recursive && v->origin != o_env && v->origin != o_env_override)
-          value = cp = recursively_expand_for_file (v, file);
-
         /* If this is the SHELL variable remember we already added it.  */
-        if (!added_SHELL && streq (v->name, "SHELL"))
-          {
-            added_SHELL = 1;
-            goto setit;
-          }
-
-        /* If this is MAKELEVEL, update it.  */
-        if (!found_makelevel && streq (v->name, MAKELEVEL_NAME))
-          {
-            char val[INTSTR_LENGTH + 1];
-            sprintf (val, "%u", makelevel + 1);
-            free (cp);
-            value = cp = xstrdup (val);
-            found_makelevel = 1;
-            goto setit;
-          }
-
-        /* If we need to reset jobserver, check for MAKEFLAGS / MFLAGS.  */
-        if (invalid)
-          {
-            if (!found_makeflags && streq (v->name, MAKEFLAGS_NAME))
-              {
-                char *mf;
-                char *vars;
-                found_makeflags = 1;
+        if (streq (v->name, "SHELL"))
+          added_SHELL = 1;
+        else if (streq (v->name, MAKELEVEL_NAME))
+          found_makelevel = 1;
 
-                if (!strstr (value, " --" JOBSERVER_AUTH_OPT "="))
-                  goto setit;
+        *result++ = environment_string (v, file, invalid);
+      }
 
-                /* The invalid option must come before variable overrides.  */
-                vars = strstr (value, " -- ");
-                if (!vars)
-                  mf = xstrdup (concat (2, value, invalid));
-                else
-                  {
-                    size_t lf = vars - value;
-                    size_t li = strlen (invalid);
-                    mf = xmalloc (strlen (value) + li + 1);
-                    strcpy (mempcpy (mempcpy (mf, value, lf), invalid, li),
-                            vars);
-                  }
-                free (cp);
-                value = cp = mf;
-                if (found_mflags)
-                  invalid = NULL;
-                goto setit;
-              }
+  for (i = 0; in_global && i < genv->count; ++i)
+    {
+      struct variable *v = genv->vars[i];
 
-            if (!found_mflags && streq (v->name, "MFLAGS"))
-              {
-                const char *mf;
-                found_mflags = 1;
-
-                if (!strstr (value, " --" JOBSERVER_AUTH_OPT "="))
-                  goto setit;
-
-                if (v->origin != o_env)
-                  goto setit;
-                mf = concat (2, value, invalid);
-                free (cp);
-                value = cp = xstrdup (mf);
-                if (found_makeflags)
-                  invalid = NULL;
-                goto setit;
-              }
-          }
+      /* Variables of the other sets hide the global ones.  */
+      if (table.ht_fill && hash_find_item (&table, v))
+        continue;
 
-#ifdef WINDOWS32
-        if (streq (v->name, "Path") || streq (v->name, "PATH"))
-          {
-            if (!cp)
-              cp = xstrdup (value);
-            value = convert_Path_to_windows32 (cp, ';');
-            goto setit;
-          }
-#endif
+      if (streq (v->name, "SHELL"))
+        added_SHELL = 1;
+      else if (streq (v->name, MAKELEVEL_NAME))
+        found_makelevel = 1;
 
-      setit:
-        *result++ = xstrdup (concat (3, v->name, "=", value));
-        free (cp);
-      }
+      if (genv->strings[i])
+        *result++ = genv->strings[i];
+      else
+        *result++ = environment_string (v, file, invalid);
+    }
 
   if (!added_SHELL)
     *result++ = xstrdup (concat (3, shell_var.name, "=", shell_var.value));
@@ -1200,11 +1543,13 @@ target_environment (struct file *file, int recursive)
   if (!found_makelevel)
     {
       char val[MAKELEVEL_LENGTH + 1 + INTSTR_LENGTH + 1];
-      sprintf (val, "%s=%u", MAKELEVEL_NAME, makelevel + 1);
+      sprintf (val, "%s=%u", MAKELEVEL_NAME, FILE_MAKELEVEL (file) + 1);
       *result++ = xstrdup (val);
     }
 
-  *result = NULL;
+  /* free_environment finds the global environment after the NULL.  */
+  *result++ = NULL;
+  *result = (char *) genv;
 
   hash_free (&table, 0);
 
@@ -1213,7 +1558,27 @@ target_environment (struct file *file, int recursive)
 
   return result_0;
 }
-
+
+/* Free ENVP, as returned by target_environment.  */
+
+void
+free_environment (char **envp)
+{
+  struct global_environment *genv;
+  char **ep;
+
+  for (ep = envp; *ep != 0; ++ep)
+    ;
+  genv = (struct global_environment *) ep[1];
+
+  for (ep = envp; *ep != 0; ++ep)
+    if (*ep < genv->text || *ep >= genv->text + genv->size)
+      free (*ep);
+
+  release_global_environment (genv);
+  free (envp);
+}
+
 static struct variable *
 set_special_var (struct variable *var)
 {
@@ -1225,7 +1590,13 @@ set_special_var (struct variable *var)
       cmd_prefix = var->value[0]=='\0' ? RECIPEPREFIX_DEFAULT : var->value[0];
     }
   else if (streq (var->name, MAKEFLAGS_NAME))
-    decode_env_switches (STRING_SIZE_TUPLE(MAKEFLAGS_NAME));
+    {
+      /* The switches are shared by all the files.  */
+      if (current_submake)
+        submake_abandon (MAKEFLAGS_NAME);
+      else
+        decode_env_switches (STRING_SIZE_TUPLE(MAKEFLAGS_NAME));
+    }
 
   return var;
 }
@@ -17,6 +17,7 @@ this program.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "hash.h"
 
 struct file;
+struct expansion;
 
 /* Codes in a variable definition saying where the definition came from.
    Increasing numeric values signify less-overridable definitions.  */
@@ -76,6 +77,8 @@ struct variable
     unsigned int expanding:1;   /* Nonzero if currently being expanded.  */
     unsigned int private_var:1; /* Nonzero avoids inheritance of this
                                    target-specific variable.  */
+    unsigned int exp_pure:1;    /* Nonzero if the expansion does not depend
+                                   on the target; see exp_gen.  */
     unsigned int exp_count:EXP_COUNT_BITS;
                                 /* If >1, allow this many self-referential
                                    expansions.  */
@@ -85,6 +88,10 @@ struct variable
       origin ENUM_BITFIELD (3); /* Variable origin.  */
     enum variable_export
       export ENUM_BITFIELD (2); /* Export control. */
+    unsigned long exp_gen;      /* variable_generation that exp_pure and
+                                   exp_cache are valid for.  */
+    char *exp_cache;            /* Expanded value, if exp_pure.  */
+    struct expansion *exp_prog; /* Compiled value; see compile_expansion.  */
   };
 
 /* Structure that represents a variable set.  */
@@ -111,10 +118,12 @@ struct pattern_var
     const char *suffix;
     const char *target;
     size_t len;
+    struct submake *submake;    /* The inlined sub-make that defined it.  */
     struct variable variable;
   };
 
 extern unsigned long long env_recursion;
+extern unsigned long variable_generation;
 extern char *variable_buffer;
 extern struct variable_set_list *current_variable_set_list;
 extern struct variable *default_goal_var;
@@ -133,12 +142,23 @@ char *allocated_variable_expand_for_file (const char *line, struct file *file);
   allocated_variable_expand_for_file (line, (struct file *) 0)
 char *expand_argument (const char *str, const char *end);
 char *variable_expand_string (char *line, const char *string, size_t length);
+struct expansion *compile_expansion (const char *text, size_t length);
+char *run_expansion (char *o, struct expansion *e);
+char *allocated_expansion (struct expansion *e);
+char *allocated_expansion_for_file (struct expansion **ep, const char *line,
+                                    struct file *file);
+void release_expansion (struct expansion *e);
 char *initialize_variable_output (void);
 void install_variable_buffer (char **bufp, size_t *lenp);
 void restore_variable_buffer (char *buf, size_t len);
 
 /* function.c */
+struct function_call;
+extern unsigned long function_generation;
 int handle_function (char **op, const char **stringp);
+int compile_function (const char **stringp, struct function_call **callp);
+char *run_function (char *o, const struct function_call *call);
+void free_function_call (struct function_call *call);
 int pattern_matches (const char *pattern, const char *percent, const char *str);
 char *subst_expand (char *o, const char *text, const char *subst,
                     const char *replace, size_t slen, size_t rlen,
@@ -153,6 +173,7 @@ void shell_completed (int exit_code, int exit_sig);
 /* expand.c */
 char *recursively_expand_for_file (struct variable *v, struct file *file);
 #define recursively_expand(v)   recursively_expand_for_file (v, NULL)
+int variable_expansion_is_pure (struct variable *v);
 
 /* variable.c */
 struct variable_set_list *create_new_variable_set (void);
@@ -177,6 +198,8 @@ struct variable *try_variable_definition (const floc *flocp, const char *line,
                                           enum variable_origin origin,
                                           int target_var);
 void init_hash_global_variable_set (void);
+struct variable_set *swap_global_variable_set (struct variable_set *set);
+void inherit_global_variables (struct variable_set *from);
 void hash_init_function_table (void);
 void define_new_function(const floc *flocp, const char *name,
                          unsigned int min, unsigned int max, unsigned int flags,
@@ -184,6 +207,8 @@ void define_new_function(const floc *flocp, const char *name,
 struct variable *lookup_variable (const char *name, size_t length);
 struct variable *lookup_variable_in_set (const char *name, size_t length,
                                          const struct variable_set *set);
+int variable_defined_locally (const char *name, size_t length);
+void observe_variable (const char *name, size_t length);
 
 struct variable *define_variable_in_set (const char *name, size_t length,
                                          const char *value,
@@ -239,9 +264,11 @@ void undefine_variable_in_set (const char *name, size_t length,
                               }while(0)
 
 char **target_environment (struct file *file, int recursive);
+void free_environment (char **envp);
 
 struct pattern_var *create_pattern_var (const char *target,
                                         const char *suffix);
+void free_submake_pattern_vars (const struct submake *s);
 
 extern int export_all_variables;
 
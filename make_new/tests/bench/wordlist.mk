@@ -0,0 +1,59 @@
+# -*-Makefile-*-
+# Benchmark for the functions that work on long lists of words.
+#
+# This is not part of the test suite; run it by hand, for example:
+#
+#   time ./make -f tests/bench/wordlist.mk
+#   time ./make -f tests/bench/wordlist.mk SCALE=4 ROUNDS=5
+#
+# It builds a list of file names like the ones generated for big C and C++
+# projects and runs $(sort), $(filter), $(filter-out) and $(patsubst) over
+# it ROUNDS times.  The list has 1000 * SCALE names (about 24000 words for
+# the default SCALE of 24).
+
+SCALE ?= 24
+ROUNDS ?= 3
+
+digits := 0 1 2 3 4 5 6 7 8 9
+dirs := $(wordlist 1,$(SCALE),aten/src/ATen/native c10/core c10/util \
+          torch/csrc/api torch/csrc/autograd torch/csrc/jit/ir \
+          torch/csrc/jit/passes torch/csrc/jit/runtime ggml/src \
+          ggml/src/ggml-cpu common examples/server src/models \
+          third_party/fmt third_party/kineto third_party/onnx \
+          third_party/protobuf tools/quantize tools/perplexity \
+          vendor/nlohmann vendor/cpp-httplib caffe2/core caffe2/utils \
+          functorch/csrc $(addprefix extra/d,$(digits) $(addprefix 1,$(digits))))
+
+# 1000 names per directory, with mixed suffixes.
+names := $(foreach a,$(digits),$(foreach b,$(digits),$(foreach c,$(digits),f$a$b$c)))
+stems := $(foreach d,$(dirs),$(addprefix $d/,$(names)))
+srcs := $(join $(stems),$(foreach s,$(stems),.cpp)) \
+        $(addsuffix .c,$(wordlist 1,3000,$(stems))) \
+        $(addsuffix .h,$(wordlist 3001,6000,$(stems)))
+
+# Patterns: a few suffixes, many directory prefixes, and a long list of
+# literal names to drop.
+suffix_pats := %.c %.cu %.mm %.S %.asm
+prefix_pats := $(addsuffix /%,$(wordlist 1,8,$(dirs)))
+dir_pats := $(foreach d,$(dirs),$d/%3.cpp $d/%7.h)
+drop := $(addsuffix .cpp,$(filter %5,$(stems)))
+
+rounds := $(wordlist 1,$(ROUNDS),$(digits) $(addprefix 1,$(digits)))
+
+define round
+sorted$1 := $$(sort $$(srcs) $$(srcs))
+cfiles$1 := $$(filter $$(suffix_pats),$$(srcs))
+ours$1 := $$(filter-out $$(prefix_pats),$$(srcs))
+some$1 := $$(filter $$(dir_pats),$$(srcs))
+kept$1 := $$(filter-out $$(drop),$$(srcs))
+objs$1 := $$(patsubst %.cpp,obj/%.o,$$(srcs))
+endef
+
+$(foreach r,$(rounds),$(eval $(call round,$r)))
+
+r := $(lastword $(rounds))
+$(info srcs: $(words $(srcs)) sorted: $(words $(sorted$r)))
+$(info cfiles: $(words $(cfiles$r)) ours: $(words $(ours$r)) some: $(words $(some$r)))
+$(info kept: $(words $(kept$r)) objs: $(words $(objs$r)))
+
+all: ; @:
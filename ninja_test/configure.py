@@ -418,6 +418,8 @@ else:
     elif options.profile == 'pprof':
         cflags.append('-fno-omit-frame-pointer')
         libs.extend(['-Wl,--no-as-needed', '-lprofiler'])
+    # ninja.cc loads the logs on a background thread.
+    ldflags.append('-pthread')
 
 if platform.supports_ppoll() and not options.force_pselect:
     cflags.append('-DUSE_PPOLL')
@@ -539,11 +541,14 @@ n.newline()
 
 n.comment('Core source files all build into ninja library.')
 objs.extend(re2c_objs)
-for name in ['build',
+for name in ['arena',
+             'build',
              'build_log',
              'clean',
              'clparser',
+             'compdb',
              'debug_flags',
+             'depfile_workers',
              'deps_log',
              'disk_interface',
              'dyndep',
@@ -552,13 +557,17 @@ for name in ['build',
              'elide_middle',
              'eval_env',
              'graph',
+             'graph_export',
              'graphviz',
              'json',
              'line_printer',
+             'log_writer',
              'manifest_parser',
              'metrics',
              'missing_deps',
              'parser',
+             'pressure',
+             'query_server',
              'real_command_runner',
              'state',
              'status_printer',
@@ -641,22 +650,29 @@ if gtest_src_dir:
         test_variables += [('pdb', 'ninja_test.pdb')]
 
     test_names = [
+        'arena_test',
         'build_log_test',
         'build_test',
+        'byte_scan_test',
         'clean_test',
         'clparser_test',
+        'compdb_test',
         'depfile_parser_test',
+        'depfile_workers_test',
         'deps_log_test',
         'disk_interface_test',
         'dyndep_parser_test',
         'edit_distance_test',
         'elide_middle_test',
         'explanations_test',
+        'graph_export_test',
         'graph_test',
         'json_test',
         'lexer_test',
         'manifest_parser_test',
         'ninja_test',
+        'pressure_test',
+        'query_server_test',
         'state_test',
         'string_piece_util_test',
         'subprocess_test',
@@ -696,10 +712,13 @@ if platform.is_aix() and '-maix64' not in ldflags:
 
 for name in ['build_log_perftest',
              'canon_perftest',
+             'compdb_perftest',
              'elide_middle_perftest',
              'depfile_parser_perftest',
              'hash_collision_bench',
              'manifest_parser_perftest',
+             'missing_deps_perftest',
+             'subprocess_perftest',
              'clparser_perftest']:
   if platform.is_msvc():
     cxxvariables = [('pdb', name + '.pdb')]
@@ -522,6 +522,42 @@ options:
             self.assertEqual(expected, actual)
 
 
+    def test_tool_resources(self) -> None:
+        plan = '''
+rule touch
+  command = touch $out
+rule copy
+  command = cp $in $out
+build sub/a: touch
+build sub/b: touch
+build c: copy sub/a
+build all: phony c sub/b
+'''
+
+        def edge_counts(output: str) -> T.List[T.Tuple[str, T.Dict[str, int]]]:
+            # The times and sizes vary from run to run, and so does the
+            # order of the rows, which is by CPU time.
+            sections = []
+            for section in output.strip().split('\n\n'):
+                lines = section.split('\n')
+                header = lines[0].split()
+                self.assertEqual(header[0], 'edges')
+                sections.append((header[-1], {
+                    line.split()[-1]: int(line.split()[0])
+                    for line in lines[1:]}))
+            return sections
+
+        with BuildDir(plan) as b:
+            b.run(pipe=True)
+            self.assertEqual(edge_counts(b.run('-t resources', pipe=True)), [
+                ('rule', {'touch': 2, 'copy': 1}),
+                ('directory', {'sub': 2, '.': 1}),
+            ])
+            self.assertEqual(edge_counts(b.run('-t resources -r', pipe=True)),
+                             [('rule', {'touch': 2, 'copy': 1})])
+            self.assertEqual(edge_counts(b.run('-t resources -d', pipe=True)),
+                             [('directory', {'sub': 2, '.': 1})])
+
     def test_tool_multi_inputs(self) -> None:
         plan = '''
 rule cat
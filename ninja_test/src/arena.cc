@@ -0,0 +1,69 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "arena.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+namespace {
+
+/// Blocks grow geometrically up to this size; larger requests get a block
+/// of their own.
+const size_t kMaxBlockSize = 1 << 20;
+
+}  // namespace
+
+Arena::~Arena() {
+  for (std::vector<char*>::iterator b = blocks_.begin(); b != blocks_.end();
+       ++b)
+    free(*b);
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  assert(alignment && (alignment & (alignment - 1)) == 0);
+  assert(alignment <= alignof(max_align_t));
+  uintptr_t p = reinterpret_cast<uintptr_t>(ptr_);
+  uintptr_t aligned = (p + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  if (!ptr_ || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    size_t block_size = next_block_size_;
+    if (next_block_size_ < kMaxBlockSize)
+      next_block_size_ *= 2;
+    if (size > block_size)
+      block_size = size;
+    // malloc() returns memory aligned for any fundamental type.
+    char* block = static_cast<char*>(malloc(block_size));
+    if (!block)
+      Fatal("out of memory");
+    blocks_.push_back(block);
+    bytes_reserved_ += block_size;
+    ptr_ = block;
+    end_ = block + block_size;
+    aligned = reinterpret_cast<uintptr_t>(block);
+  }
+  ptr_ = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+StringPiece Arena::Copy(StringPiece s) {
+  char* copy = static_cast<char*>(Allocate(s.size() + 1, 1));
+  if (!s.empty())
+    memcpy(copy, s.str_, s.size());
+  copy[s.size()] = '\0';
+  return StringPiece(copy, s.size());
+}
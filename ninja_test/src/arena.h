@@ -0,0 +1,52 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_ARENA_H_
+#define NINJA_ARENA_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "string_piece.h"
+
+/// A bump allocator.  Memory is handed out from a few large blocks and only
+/// released, all at once, when the Arena is destroyed.  Destructors of
+/// objects placed in an Arena are never run.
+struct Arena {
+  Arena() = default;
+  ~Arena();
+
+  /// Return |size| bytes aligned to |alignment|, which must be a power of
+  /// two no larger than alignof(max_align_t).
+  void* Allocate(size_t size, size_t alignment = alignof(max_align_t));
+
+  /// Copy |s| into the arena, followed by a NUL byte.
+  StringPiece Copy(StringPiece s);
+
+  /// Total size of the blocks allocated so far.
+  size_t bytes_reserved() const { return bytes_reserved_; }
+
+ private:
+  Arena(const Arena&) = delete;
+  void operator=(const Arena&) = delete;
+
+  std::vector<char*> blocks_;
+  char* ptr_ = nullptr;
+  char* end_ = nullptr;
+  size_t next_block_size_ = 4096;
+  size_t bytes_reserved_ = 0;
+};
+
+#endif  // NINJA_ARENA_H_
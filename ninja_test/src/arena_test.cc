@@ -0,0 +1,71 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "eval_env.h"
+#include "test.h"
+
+using namespace std;
+
+TEST(Arena, Copy) {
+  Arena arena;
+  StringPiece a = arena.Copy("foo");
+  StringPiece b = arena.Copy("");
+  StringPiece c = arena.Copy("bar baz");
+  EXPECT_EQ("foo", a.AsString());
+  EXPECT_EQ(0u, b.size());
+  EXPECT_EQ("bar baz", c.AsString());
+  // Copies are NUL-terminated.
+  EXPECT_EQ('\0', a.str_[a.size()]);
+  EXPECT_STREQ("bar baz", c.str_);
+}
+
+TEST(Arena, Alignment) {
+  Arena arena;
+  arena.Allocate(1, 1);
+  void* p = arena.Allocate(sizeof(double), alignof(double));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % alignof(double));
+}
+
+TEST(Arena, LargeAllocations) {
+  Arena arena;
+  char* small = static_cast<char*>(arena.Allocate(16));
+  memset(small, 'a', 16);
+  // Larger than any block; gets a block of its own.
+  const size_t kBig = 4 << 20;
+  char* big = static_cast<char*>(arena.Allocate(kBig));
+  memset(big, 'b', kBig);
+  EXPECT_GE(arena.bytes_reserved(), kBig);
+  EXPECT_EQ('a', small[15]);
+}
+
+TEST(Arena, PersistEvalString) {
+  Arena arena;
+  EvalString str;
+  string text = "cc $in -o $out";
+  // Mirror what the lexer does: tokens borrow from |text|.
+  str.AddText(StringPiece(text.data(), 3));
+  str.AddSpecial(StringPiece(text.data() + 4, 2));
+  str.AddText(StringPiece(text.data() + 6, 4));
+  str.AddSpecial(StringPiece(text.data() + 11, 3));
+  str.Persist(&arena);
+  text.assign(text.size(), 'x');
+  EXPECT_EQ("[cc ][$in][ -o ][$out]", str.Serialize());
+}
@@ -86,6 +86,7 @@ Plan::Plan(Builder* builder)
   : builder_(builder)
   , command_edges_(0)
   , wanted_edges_(0)
+  , memory_in_use_(0)
 {}
 
 void Plan::Reset() {
@@ -93,6 +94,9 @@ void Plan::Reset() {
   wanted_edges_ = 0;
   ready_.clear();
   want_.clear();
+  memory_reserved_.clear();
+  memory_in_use_ = 0;
+  memory_delayed_.clear();
 }
 
 bool Plan::AddTarget(const Node* target, string* err) {
@@ -126,8 +130,8 @@ bool Plan::AddSubTarget(const Node* node, const Node* dependent, string* err,
      if (node->dirty() && !node->generated_by_dep_loader()) {
        string referenced;
        if (dependent)
-         referenced = ", needed by '" + dependent->path() + "',";
-       *err = "'" + node->path() + "'" + referenced +
+         referenced = ", needed by '" + dependent->path().AsString() + "',";
+       *err = "'" + node->path().AsString() + "'" + referenced +
               " missing and no known rule to make it";
      }
      return false;
@@ -193,13 +197,40 @@ void Plan::EdgeWanted(const Edge* edge) {
   }
 }
 
-Edge* Plan::FindWork() {
-  if (ready_.empty())
-    return NULL;
+void Plan::EdgeStartedEarly(Edge* edge) {
+  pair<map<Edge*, Want>::iterator, bool> want_ins =
+    want_.insert(make_pair(edge, kWantNothing));
+  Want& want = want_ins.first->second;
+  if (want == kWantToFinish)
+    return;
+  // The scan may not have wanted the edge, e.g. if it already finished and
+  // wrote its outputs; it still has to be reaped and recorded.
+  if (want == kWantNothing)
+    EdgeWanted(edge);
+  want = kWantToFinish;
+  edge->pool()->EdgeScheduled(*edge);
+}
 
-  Edge* work = ready_.top();
-  ready_.pop();
-  return work;
+Edge* Plan::FindWork() {
+  const int64_t budget = builder_ ? builder_->config_.memory_budget : 0;
+  while (!ready_.empty()) {
+    Edge* work = ready_.top();
+    ready_.pop();
+    if (budget <= 0 || work->is_phony())
+      return work;
+
+    // Always admit an edge when nothing else holds memory, so that an edge
+    // predicted to exceed the whole budget still runs eventually.
+    int64_t rss = builder_->PredictPeakRss(work);
+    if (memory_in_use_ > 0 && memory_in_use_ + rss > budget) {
+      memory_delayed_.push_back(work);
+      continue;
+    }
+    memory_reserved_[work] = rss;
+    memory_in_use_ += rss;
+    return work;
+  }
+  return NULL;
 }
 
 void Plan::ScheduleWork(map<Edge*, Want>::iterator want_e) {
@@ -261,6 +292,17 @@ bool Plan::EdgeFinished(Edge* edge, EdgeResult result, string* err) {
 // 而且是这个edge对应的pool，因为这个edge空出来位置了
   edge->pool()->RetrieveReadyEdges(&ready_);
 
+  // Edges held back for memory get another chance.
+  map<Edge*, int64_t>::iterator reserved = memory_reserved_.find(edge);
+  if (reserved != memory_reserved_.end()) {
+    memory_in_use_ -= reserved->second;
+    memory_reserved_.erase(reserved);
+    for (vector<Edge*>::iterator d = memory_delayed_.begin();
+         d != memory_delayed_.end(); ++d)
+      ready_.push(*d);
+    memory_delayed_.clear();
+  }
+
   // The rest of this function only applies to successful commands.
   // TODO: 为什么命令出错还返回true？因为那就是failed说明，说明调用这个就是为了完成上面的内容而已，下面的是成功的才会
   // 进行操作的内容
@@ -648,9 +690,11 @@ void Plan::ComputeCriticalPath() {
   }
 
   const auto& sorted_edges = topo_sort.result();
+  const PriorityMode priority_mode =
+      builder_ ? builder_->config_.priority_mode : PRIORITY_DEFAULT;
 
   // First, reset all weights to 1.
-  if (builder_->config_.priority_mode == PRIORITY_ORACLE) {
+  if (priority_mode == PRIORITY_ORACLE) {
     for (std::map<Edge*, Plan::Want>::iterator it = want_.begin(),
           end = want_.end(); it != end; ++it) {
       Edge* edge = it->first;
@@ -659,7 +703,7 @@ void Plan::ComputeCriticalPath() {
   }
   else {
     for (Edge* edge : sorted_edges)
-      edge->set_critical_path_weight(EdgeWeightHeuristic(edge, builder_->config_.priority_mode));
+      edge->set_critical_path_weight(EdgeWeightHeuristic(edge, priority_mode));
 
     // Second propagate / increment weights from
     // children to parents. Scan the list
@@ -680,7 +724,7 @@ void Plan::ComputeCriticalPath() {
           continue;
 
         int64_t producer_weight = producer->critical_path_weight();
-        int64_t candidate_weight = edge_weight + EdgeWeightHeuristic(producer, builder_->config_.priority_mode);
+        int64_t candidate_weight = edge_weight + EdgeWeightHeuristic(producer, priority_mode);
         if (candidate_weight > producer_weight)
           producer->set_critical_path_weight(candidate_weight);
       }
@@ -760,6 +804,10 @@ Builder::~Builder() {
 }
 
 void Builder::Cleanup() {
+  // Commands whose depfiles are still being parsed have already finished;
+  // their outputs stay, but without deps they are rebuilt next time.
+  depfile_workers_.reset();
+
   if (command_runner_.get()) {
     vector<Edge*> active_edges = command_runner_->GetActiveEdges();
     command_runner_->Abort();
@@ -777,11 +825,12 @@ void Builder::Cleanup() {
         // mentioned in a depfile, and the command touches its depfile
         // but is interrupted before it touches its output file.)
         string err;
-        TimeStamp new_mtime = disk_interface_->Stat((*o)->path(), &err);
+        TimeStamp new_mtime =
+            disk_interface_->Stat((*o)->path().AsString(), &err);
         if (new_mtime == -1)  // Log and ignore Stat() errors.
           status_->Error("%s", err.c_str());
         if (!depfile.empty() || (*o)->mtime() != new_mtime)
-          disk_interface_->RemoveFile((*o)->path());
+          disk_interface_->RemoveFile((*o)->path().AsString());
       }
       if (!depfile.empty())
         disk_interface_->RemoveFile(depfile);
@@ -846,19 +895,108 @@ bool Builder::AddTarget(Node* target, string* err) {
   return true;
 }
 
+bool Builder::StartEagerEdges(const vector<Node*>& targets, string* err) {
+  if (config_.dry_run)
+    return true;
+
+  // Walk everything reachable from the targets and collect the edges that
+  // only read source files, in manifest order.
+  vector<Edge*> candidates;
+  vector<Edge*> stack;
+  unordered_set<Edge*> visited;
+  for (vector<Node*>::const_iterator t = targets.begin(); t != targets.end();
+       ++t) {
+    if (Edge* in_edge = (*t)->in_edge())
+      stack.push_back(in_edge);
+  }
+  while (!stack.empty()) {
+    Edge* edge = stack.back();
+    stack.pop_back();
+    if (!visited.insert(edge).second)
+      continue;
+    bool reads_only_sources = true;
+    for (vector<Node*>::iterator i = edge->inputs_.begin();
+         i != edge->inputs_.end(); ++i) {
+      if (Edge* producer = (*i)->in_edge()) {
+        reads_only_sources = false;
+        stack.push_back(producer);
+      }
+    }
+    if (reads_only_sources)
+      candidates.push_back(edge);
+  }
+  sort(candidates.begin(), candidates.end(), EdgeCmp());
+
+  if (!command_runner_.get())
+    command_runner_.reset(CommandRunner::factory(config_));
+
+  size_t capacity = command_runner_->CanRunMore();
+  for (vector<Edge*>::iterator e = candidates.begin();
+       e != candidates.end() && capacity > 0; ++e) {
+    if (!CanStartEagerly(*e, err)) {
+      if (!err->empty())
+        return false;
+      continue;
+    }
+    if (eager_edges_.empty())
+      status_->BuildStarted();
+    if (!StartEdge(*e, err))
+      return false;
+    eager_edges_.push_back(*e);
+    --capacity;
+  }
+  return true;
+}
+
+bool Builder::CanStartEagerly(Edge* edge, string* err) {
+  // Anything whose scheduling or dirtiness depends on more than the files
+  // on disk is left to the regular scan.
+  if (edge->is_phony() || edge->pool() != &State::kDefaultPool ||
+      edge->dyndep_ || edge->GetBindingBool("generator"))
+    return false;
+
+  for (vector<Node*>::iterator i = edge->inputs_.begin();
+       i != edge->inputs_.end(); ++i) {
+    if (!(*i)->StatIfNecessary(disk_interface_, err))
+      return false;
+    // A missing source is reported by the scan.
+    if (!(*i)->exists())
+      return false;
+  }
+
+  bool output_missing = false;
+  for (vector<Node*>::iterator o = edge->outputs_.begin();
+       o != edge->outputs_.end(); ++o) {
+    if (!(*o)->StatIfNecessary(disk_interface_, err))
+      return false;
+    if (!(*o)->exists())
+      output_missing = true;
+  }
+  return output_missing;
+}
+
 bool Builder::AlreadyUpToDate() const {
-  return !plan_.more_to_do();
+  return !plan_.more_to_do() && eager_edges_.empty();
 }
 
+/// A command whose depfile is read by the depfile workers.
+struct Builder::DepfileJob : public DepfileWorkers::Job {
+  CommandRunner::Result result;
+};
+
 ExitStatus Builder::Build(string* err) {
   assert(!AlreadyUpToDate());
 
   // 准备任务队列
   profiler.start("Prepare Queue");
+  for (vector<Edge*>::iterator e = eager_edges_.begin();
+       e != eager_edges_.end(); ++e)
+    plan_.EdgeStartedEarly(*e);
   plan_.PrepareQueue();
   profiler.end();
 
-  int pending_commands = 0;
+  int pending_commands = static_cast<int>(eager_edges_.size());
+  eager_edges_.clear();
   int failures_allowed = config_.failures_allowed;
 
   // 设置命令运行器
@@ -869,11 +1007,18 @@ ExitStatus Builder::Build(string* err) {
     else
       command_runner_.reset(CommandRunner::factory(config_));
   }
+  if (config_.depfile_threads > 0 && !config_.dry_run && !depfile_workers_) {
+    CommandRunner* runner = command_runner_.get();
+    depfile_workers_.reset(new DepfileWorkers(
+        config_.depfile_threads, disk_interface_,
+        config_.depfile_parser_options, [runner]() { runner->WakeUp(); }));
+  }
   profiler.end();
 
   // 构建开始
   profiler.start("Build Start");
-  status_->BuildStarted();
+  if (pending_commands == 0)
+    status_->BuildStarted();
   profiler.end();
 
   // 主构建循环
@@ -943,6 +1088,33 @@ ExitStatus Builder::Build(string* err) {
       profiler.end();  // Check Early Exit
     }
 
+    // Finish the commands whose depfiles have been parsed.  With no
+    // command left running, wait for them.
+    if (depfile_workers_ && depfile_workers_->pending()) {
+      profiler.start("Finish Parsed Depfiles");
+      vector<DepfileWorkers::Job*> jobs;
+      depfile_workers_->TakeFinished(&jobs, pending_commands == 0);
+      for (size_t i = 0; i < jobs.size(); ++i) {
+        std::unique_ptr<DepfileJob> job(static_cast<DepfileJob*>(jobs[i]));
+        bool command_finished = FinishCommand(&job->result, job.get(), err);
+        SetFailureCode(job->result.status);
+        if (!command_finished) {
+          for (++i; i < jobs.size(); ++i)
+            delete jobs[i];
+          Cleanup();
+          status_->BuildFinished();
+          profiler.end();  // Finish Parsed Depfiles
+          profiler.end();  // Build Loop
+          return job->result.status;
+        }
+        if (!job->result.success() && failures_allowed)
+          failures_allowed--;
+      }
+      profiler.end();  // Finish Parsed Depfiles
+      if (!jobs.empty())
+        continue;
+    }
+
     // See if we can reap any finished commands.
     if (pending_commands) {
       profiler.start("Wait For Command");
@@ -958,8 +1130,15 @@ ExitStatus Builder::Build(string* err) {
       }
       profiler.end();  // Wait For Command
 
+      // Woken up by a depfile worker.
+      if (!result.edge)
+        continue;
+
       --pending_commands;
 
+      if (PostDepfileJob(result))
+        continue;
+
       profiler.start("Finish Command");
       bool command_finished = FinishCommand(&result, err);
       SetFailureCode(result.status);
@@ -1037,7 +1216,7 @@ bool Builder::StartEdge(Edge* edge, string* err) {
 // 例子：main.o 在 obj/main.o，确保 obj/ 存在。
   for (vector<Node*>::iterator o = edge->outputs_.begin();
        o != edge->outputs_.end(); ++o) {
-    if (!disk_interface_->MakeDirs((*o)->path()))
+    if (!disk_interface_->MakeDirs((*o)->path().AsString()))
       return false;
     if (build_start == -1) {
       disk_interface_->WriteFile(lock_file_path_, "");
@@ -1086,7 +1265,49 @@ bool Builder::StartEdge(Edge* edge, string* err) {
   return true;
 }
 
+bool Builder::PostDepfileJob(const CommandRunner::Result& result) {
+  if (!depfile_workers_ || !result.success() ||
+      result.edge->GetBinding("deps") != "gcc")
+    return false;
+  string depfile = result.edge->GetUnescapedDepfile();
+  if (depfile.empty())
+    return false;  // ExtractDeps() reports this.
+
+  DepfileJob* job = new DepfileJob;
+  job->path = depfile;
+  job->result = result;
+  depfile_workers_->Post(job);
+  return true;
+}
+
+bool Builder::DepsFromJob(DepfileJob* job, vector<Node*>* deps_nodes,
+                          string* err) {
+  if (!job->ok) {
+    *err = job->err;
+    return false;
+  }
+  if (job->content.empty())
+    return true;
+
+  deps_nodes->reserve(job->ins.size());
+  for (size_t i = 0; i < job->ins.size(); ++i)
+    deps_nodes->push_back(state_->GetNode(job->ins[i], job->slash_bits[i]));
+
+  if (!g_keep_depfile) {
+    if (disk_interface_->RemoveFile(job->path) < 0) {
+      *err = string("deleting depfile: ") + strerror(errno) + string("\n");
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
+  return FinishCommand(result, NULL, err);
+}
+
+bool Builder::FinishCommand(CommandRunner::Result* result,
+                            DepfileJob* depfile_job, string* err) {
   METRIC_RECORD("FinishCommand");
 
   Edge* edge = result->edge;
@@ -1107,9 +1328,11 @@ bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
   const string deps_prefix = edge->GetBinding("msvc_deps_prefix");
   if (!deps_type.empty()) {
     string extract_err;
-    if (!ExtractDeps(result, deps_type, deps_prefix, &deps_nodes,
-                     &extract_err) &&
-        result->success()) {
+    bool extracted =
+        depfile_job ? DepsFromJob(depfile_job, &deps_nodes, &extract_err)
+                    : ExtractDeps(result, deps_type, deps_prefix, &deps_nodes,
+                                  &extract_err);
+    if (!extracted && result->success()) {
       if (!result->output.empty())
         result->output.append("\n");
       result->output.append(extract_err);
@@ -1148,7 +1371,8 @@ bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
     if (record_mtime == 0 || restat || generator) {
       for (vector<Node*>::iterator o = edge->outputs_.begin();
            o != edge->outputs_.end(); ++o) {
-        TimeStamp new_mtime = disk_interface_->Stat((*o)->path(), err);
+        TimeStamp new_mtime =
+            disk_interface_->Stat((*o)->path().AsString(), err);
         if (new_mtime == -1)
           return false;
         if (new_mtime > record_mtime)
@@ -1186,9 +1410,16 @@ bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
   if (!rspfile.empty() && !g_keep_rsp)
     disk_interface_->RemoveFile(rspfile);
 
+  if (result->usage.peak_rss > 0 && rule_rss_loaded_) {
+    RuleRss& rss = rule_rss_[&edge->rule()];
+    rss.total += result->usage.peak_rss;
+    ++rss.count;
+  }
+
   if (scan_.build_log()) {
     if (!scan_.build_log()->RecordCommand(edge, start_time_millis,
-                                          end_time_millis, record_mtime)) {
+                                          end_time_millis, record_mtime,
+                                          result->usage)) {
       *err = string("Error writing to build log: ") + strerror(errno);
       return false;
     }
@@ -1198,7 +1429,8 @@ bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
     assert(!edge->outputs_.empty() && "should have been rejected by parser");
     for (std::vector<Node*>::const_iterator o = edge->outputs_.begin();
          o != edge->outputs_.end(); ++o) {
-      TimeStamp deps_mtime = disk_interface_->Stat((*o)->path(), err);
+      TimeStamp deps_mtime =
+          disk_interface_->Stat((*o)->path().AsString(), err);
       if (deps_mtime == -1)
         return false;
       if (!scan_.deps_log()->RecordDeps(*o, deps_mtime, deps_nodes)) {
@@ -1210,6 +1442,41 @@ bool Builder::FinishCommand(CommandRunner::Result* result, string* err) {
   return true;
 }
 
+int64_t Builder::PredictPeakRss(const Edge* edge) {
+  BuildLog* build_log = scan_.build_log();
+  if (!build_log)
+    return 0;
+
+  if (!rule_rss_loaded_) {
+    for (vector<Edge*>::const_iterator e = state_->edges_.begin();
+         e != state_->edges_.end(); ++e) {
+      if ((*e)->outputs_.empty())
+        continue;
+      BuildLog::LogEntry* entry =
+          build_log->LookupByOutput((*e)->outputs_[0]->path());
+      if (!entry || entry->usage.peak_rss <= 0)
+        continue;
+      RuleRss& rss = rule_rss_[&(*e)->rule()];
+      rss.total += entry->usage.peak_rss;
+      ++rss.count;
+    }
+    rule_rss_loaded_ = true;
+  }
+
+  for (vector<Node*>::const_iterator o = edge->outputs_.begin();
+       o != edge->outputs_.end(); ++o) {
+    BuildLog::LogEntry* entry = build_log->LookupByOutput((*o)->path());
+    if (entry && entry->usage.peak_rss > 0)
+      return entry->usage.peak_rss;
+  }
+
+  map<const Rule*, RuleRss>::const_iterator rss =
+      rule_rss_.find(&edge->rule());
+  if (rss != rule_rss_.end() && rss->second.count > 0)
+    return rss->second.total / rss->second.count;
+  return 0;
+}
+
 // 你干完活，包工头说：“你用了哪些砖（依赖），告诉我！”  
 // 你用的是 MSVC 工具，他就看你的报告单（输出）。  
 // 你用的是 GCC 工具，他就看你的记录本（depfile）。  
@@ -1263,13 +1530,12 @@ bool Builder::ExtractDeps(CommandRunner::Result* result,
       return false;
 
     // XXX check depfile matches expected output.
-    deps_nodes->reserve(deps.ins_.size());
-    for (vector<StringPiece>::iterator i = deps.ins_.begin();
-         i != deps.ins_.end(); ++i) {
-      uint64_t slash_bits;
-      CanonicalizePath(const_cast<char*>(i->str_), &i->len_, &slash_bits);
-      deps_nodes->push_back(state_->GetNode(*i, slash_bits));
-    }
+    size_t count = deps.ins_.size();
+    vector<uint64_t> slash_bits(count);
+    CanonicalizePaths(deps.ins_.data(), count, slash_bits.data());
+    deps_nodes->reserve(count);
+    for (size_t i = 0; i < count; ++i)
+      deps_nodes->push_back(state_->GetNode(deps.ins_[i], slash_bits[i]));
 
     // 做什么：如果不保留 depfile，就删掉。  
     // 例子：删 main.d。
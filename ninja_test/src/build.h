@@ -22,8 +22,12 @@
 #include <vector>
 
 #include "depfile_parser.h"
+#include "depfile_workers.h"
 #include "exit_status.h"
 #include "graph.h"
+#include "log_writer.h"
+#include "pressure.h"
+#include "resource_usage.h"
 #include "util.h"  // int64_t
 
 struct BuildLog;
@@ -46,7 +50,9 @@ struct Plan {
   bool AddTarget(const Node* target, std::string* err);
 
   // Pop a ready edge off the queue of edges to build.
-  // Returns NULL if there's no work to do.
+  // Returns NULL if there's no work to do.  With a memory budget, edges whose
+  // predicted peak RSS does not fit next to the running ones are held back
+  // until a running edge finishes.
   Edge* FindWork();
 
   /// Returns true if there's more work to be done.
@@ -79,6 +85,11 @@ struct Plan {
   /// Number of edges with commands to run.
   int command_edge_count() const { return command_edges_; }
 
+  /// Record that |edge| was started before the plan was built (see
+  /// Builder::StartEagerEdges), so that it is waited for but not scheduled
+  /// again.
+  void EdgeStartedEarly(Edge* edge);
+
   /// Reset state.  Clears want and ready sets.
   void Reset();
 
@@ -145,6 +156,13 @@ private:
   int wanted_edges_;
 
   EdgePriorityQueue ready_;
+
+  /// Predicted peak RSS in KiB of the edges returned by FindWork() that have
+  /// not finished yet, and its sum.
+  std::map<Edge*, int64_t> memory_reserved_;
+  int64_t memory_in_use_;
+  /// Ready edges that did not fit into the memory budget.
+  std::vector<Edge*> memory_delayed_;
 };
 
 struct BuildConfig;
@@ -159,14 +177,19 @@ struct CommandRunner {
 
   /// The result of waiting for a command.
   struct Result {
-    Result() : edge(NULL) {}
+    Result() : edge(NULL), status(ExitSuccess) {}
     Edge* edge;
     ExitStatus status;
     std::string output;
+    ResourceUsage usage;
     bool success() const { return status == ExitSuccess; }
   };
   /// Wait for a command to complete, or return false if interrupted.
+  /// After a WakeUp() it may also return true with result->edge NULL.
   virtual bool WaitForCommand(Result* result) = 0;
+  /// Make a pending or the next WaitForCommand() return early.  May be
+  /// called from any thread.
+  virtual void WakeUp() {}
 
   virtual std::vector<Edge*> GetActiveEdges() { return std::vector<Edge*>(); }
   virtual void Abort() {}
@@ -179,7 +202,10 @@ struct CommandRunner {
 struct BuildConfig {
   BuildConfig() : verbosity(NORMAL), dry_run(false), parallelism(1),
                   failures_allowed(1), max_load_average(-0.0f),
-                  priority_mode(PRIORITY_DEFAULT) {}  // 添加默认值
+                  priority_mode(PRIORITY_DEFAULT),  // 添加默认值
+                  pipelined_startup(false), pressure_limit(false),
+                  memory_budget(0), depfile_threads(0),
+                  log_durability(LogWriter::kFlushEachRecord) {}
 
   enum Verbosity {
     QUIET,  // No output -- used when testing.
@@ -196,6 +222,22 @@ struct BuildConfig {
   double max_load_average;
   DepfileParserOptions depfile_parser_options;
   PriorityMode priority_mode;  // 添加权重策略成员变量
+  /// Start edges that only read source files while the build log is still
+  /// loading.
+  bool pipelined_startup;
+  /// Adapt the number of running commands to the pressure stall
+  /// information of the machine, never exceeding |parallelism|.
+  bool pressure_limit;
+  PressureTargets pressure_targets;
+  /// Memory in KiB that the commands running at the same time may use
+  /// according to the peak RSS recorded in the build log. 0 means no limit.
+  int64_t memory_budget;
+  /// Threads that read and parse the depfiles of deps = gcc edges while the
+  /// build loop carries on.  0 does it on the build loop itself.  The
+  /// DiskInterface must allow ReadFile() from these threads.
+  int depfile_threads;
+  /// How .ninja_log and .ninja_deps records reach the disk.
+  LogWriter::Durability log_durability;
 };
 
 /// Builder wraps the build process: starting commands, updating status.
@@ -214,6 +256,13 @@ struct Builder {
   /// @return false on error.
   bool AddTarget(Node* target, std::string* err);
 
+  /// Start the edges reachable from |targets| whose inputs are all source
+  /// files and which have a missing output.  Such edges are dirty no matter
+  /// what the build and deps logs say, so they can run before the dependency
+  /// scan.  Must be called before AddTarget().
+  /// @return false on error.
+  bool StartEagerEdges(const std::vector<Node*>& targets, std::string* err);
+
   /// Returns true if the build targets are already up to date.
   bool AlreadyUpToDate() const;
 
@@ -223,6 +272,11 @@ struct Builder {
 
   bool StartEdge(Edge* edge, std::string* err);
 
+  /// Predict the peak RSS of |edge| in KiB from the build log: the value
+  /// recorded for its outputs or else the average of its rule.
+  /// @return 0 if nothing is known.
+  int64_t PredictPeakRss(const Edge* edge);
+
   /// Update status ninja logs following a command termination.
   /// @return false if the build can not proceed further due to a fatal error.
   bool FinishCommand(CommandRunner::Result* result, std::string* err);
@@ -247,10 +301,44 @@ struct Builder {
   ExitStatus GetExitCode() const { return exit_code_; }
 
  private:
+  struct DepfileJob;
+
+  /// FinishCommand(), with the depfile already parsed by |depfile_job| if
+  /// that is not NULL.
+  bool FinishCommand(CommandRunner::Result* result, DepfileJob* depfile_job,
+                     std::string* err);
+
   bool ExtractDeps(CommandRunner::Result* result, const std::string& deps_type,
                    const std::string& deps_prefix,
                    std::vector<Node*>* deps_nodes, std::string* err);
 
+  /// Hand the depfile of the finished command in |result| to
+  /// depfile_workers_, if there are any and it has one.  The command
+  /// is finished when the job comes back.
+  /// @return whether the job was posted.
+  bool PostDepfileJob(const CommandRunner::Result& result);
+
+  /// Look up the Nodes of the depfile parsed by |job|.
+  bool DepsFromJob(DepfileJob* job, std::vector<Node*>* deps_nodes,
+                   std::string* err);
+
+  /// Reads depfiles off the build loop, see BuildConfig::depfile_threads.
+  std::unique_ptr<DepfileWorkers> depfile_workers_;
+
+  /// Whether |edge| can be started by StartEagerEdges().
+  bool CanStartEagerly(Edge* edge, std::string* err);
+
+  /// Edges started by StartEagerEdges() that Build() still has to wait for.
+  std::vector<Edge*> eager_edges_;
+
+  /// Peak RSS recorded for the edges of a rule, see PredictPeakRss().
+  struct RuleRss {
+    int64_t total = 0;
+    int count = 0;
+  };
+  std::map<const Rule*, RuleRss> rule_rss_;
+  bool rule_rss_loaded_ = false;
+
   /// Map of running edge to time the edge started running.
   typedef std::map<const Edge*, int> RunningEdgeMap;
   RunningEdgeMap running_edges_;
@@ -52,7 +52,7 @@ namespace {
 
 const char kFileSignature[] = "# ninja log v%d\n";
 const int kOldestSupportedVersion = 7;
-const int kCurrentVersion = 7;
+const int kCurrentVersion = 9;
 
 }  // namespace
 
@@ -81,25 +81,24 @@ bool BuildLog::OpenForWrite(const std::string& path, const BuildLogUser& user,
       return false;
   }
 
-  assert(!log_file_);
+  assert(!log_file_.is_open());
   log_file_path_ = path;  // we don't actually open the file right now, but will
                           // do so on the first write attempt
   return true;
 }
 
 bool BuildLog::RecordCommand(Edge* edge, int start_time, int end_time,
-                             TimeStamp mtime) {
-  std::string command = edge->EvaluateCommand(true);
-  uint64_t command_hash = LogEntry::HashCommand(command);
+                             TimeStamp mtime, const ResourceUsage& usage) {
+  uint64_t command_hash = edge->CommandHash();
   for (std::vector<Node*>::iterator out = edge->outputs_.begin();
        out != edge->outputs_.end(); ++out) {
-    const std::string& path = (*out)->path();
+    StringPiece path = (*out)->path();
     Entries::iterator i = entries_.find(path);
     LogEntry* log_entry;
     if (i != entries_.end()) {
       log_entry = i->second.get();
     } else {
-      log_entry = new LogEntry(path);
+      log_entry = new LogEntry(path.AsString());
       // Passes ownership of |log_entry| to the map, but keeps the pointer valid.
       entries_.emplace(log_entry->output, std::unique_ptr<LogEntry>(log_entry));
     }
@@ -107,16 +106,16 @@ bool BuildLog::RecordCommand(Edge* edge, int start_time, int end_time,
     log_entry->start_time = start_time;
     log_entry->end_time = end_time;
     log_entry->mtime = mtime;
+    log_entry->usage = usage;
 
     if (!OpenForWriteIfNeeded()) {
       return false;
     }
-    if (log_file_) {
-      if (!WriteEntry(log_file_, *log_entry))
+    if (log_file_.is_open()) {
+      std::string line;
+      FormatEntry(*log_entry, &line);
+      if (!log_file_.Append(line.data(), line.size()))
         return false;
-      if (fflush(log_file_) != 0) {
-          return false;
-      }
     }
   }
   return true;
@@ -124,33 +123,34 @@ bool BuildLog::RecordCommand(Edge* edge, int start_time, int end_time,
 
 void BuildLog::Close() {
   OpenForWriteIfNeeded();  // create the file even if nothing has been recorded
-  if (log_file_)
-    fclose(log_file_);
-  log_file_ = NULL;
+  log_file_.Close();
 }
 
 bool BuildLog::OpenForWriteIfNeeded() {
-  if (log_file_ || log_file_path_.empty()) {
+  if (log_file_.is_open() || log_file_path_.empty()) {
     return true;
   }
-  log_file_ = fopen(log_file_path_.c_str(), "ab");
-  if (!log_file_) {
+  FILE* f = fopen(log_file_path_.c_str(), "ab");
+  if (!f) {
     return false;
   }
-  if (setvbuf(log_file_, NULL, _IOLBF, BUFSIZ) != 0) {
+  if (setvbuf(f, NULL, _IOLBF, BUFSIZ) != 0) {
+    fclose(f);
     return false;
   }
-  SetCloseOnExec(fileno(log_file_));
+  SetCloseOnExec(fileno(f));
 
   // Opening a file in append mode doesn't set the file pointer to the file's
   // end on Windows. Do that explicitly.
-  fseek(log_file_, 0, SEEK_END);
+  fseek(f, 0, SEEK_END);
 
-  if (ftell(log_file_) == 0) {
-    if (fprintf(log_file_, kFileSignature, kCurrentVersion) < 0) {
+  if (ftell(f) == 0) {
+    if (fprintf(f, kFileSignature, kCurrentVersion) < 0) {
+      fclose(f);
       return false;
     }
   }
+  log_file_.Open(f);
   return true;
 }
 
@@ -282,7 +282,25 @@ LoadStatus BuildLog::Load(const std::string& path, std::string* err) {
     std::string output(start, end - start);
 
     start = end + 1;
-    end = line_end;
+    // Since v8 the command hash is followed by the peak RSS, since v9 by
+    // the rest of the resource usage.
+    ResourceUsage usage;
+    end = static_cast<char*>(memchr(start, kFieldSeparator, line_end - start));
+    if (end) {
+      int64_t* const fields[] = {
+        &usage.peak_rss, &usage.user_millis, &usage.system_millis,
+        &usage.in_blocks, &usage.out_blocks, &usage.voluntary_switches,
+        &usage.involuntary_switches,
+      };
+      *line_end = 0;
+      char* field = end;
+      for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]) &&
+                         *field == kFieldSeparator; ++f)
+        *fields[f] = strtoll(field + 1, &field, 10);
+      *line_end = '\n';
+    } else {
+      end = line_end;
+    }
 
     LogEntry* entry;
     Entries::iterator i = entries_.find(output);
@@ -299,6 +317,7 @@ LoadStatus BuildLog::Load(const std::string& path, std::string* err) {
     entry->start_time = start_time;
     entry->end_time = end_time;
     entry->mtime = mtime;
+    entry->usage = usage;
     char c = *end; *end = '\0';
     entry->command_hash = (uint64_t)strtoull(start, NULL, 16);
     *end = c;
@@ -324,7 +343,7 @@ LoadStatus BuildLog::Load(const std::string& path, std::string* err) {
   return LOAD_SUCCESS;
 }
 
-BuildLog::LogEntry* BuildLog::LookupByOutput(const std::string& path) {
+BuildLog::LogEntry* BuildLog::LookupByOutput(StringPiece path) {
   Entries::iterator i = entries_.find(path);
   if (i != entries_.end())
     return i->second.get();
@@ -332,9 +351,27 @@ BuildLog::LogEntry* BuildLog::LookupByOutput(const std::string& path) {
 }
 
 bool BuildLog::WriteEntry(FILE* f, const LogEntry& entry) {
-  return fprintf(f, "%d\t%d\t%" PRId64 "\t%s\t%" PRIx64 "\n",
-          entry.start_time, entry.end_time, entry.mtime,
-          entry.output.c_str(), entry.command_hash) > 0;
+  std::string line;
+  FormatEntry(entry, &line);
+  return fwrite(line.data(), line.size(), 1, f) == 1;
+}
+
+// static
+void BuildLog::FormatEntry(const LogEntry& entry, std::string* out) {
+  const ResourceUsage& u = entry.usage;
+  char head[64];
+  snprintf(head, sizeof(head), "%d\t%d\t%" PRId64 "\t",
+           entry.start_time, entry.end_time, entry.mtime);
+  char tail[256];
+  snprintf(tail, sizeof(tail), "\t%" PRIx64 "\t%" PRId64 "\t%" PRId64
+           "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64
+           "\n",
+           entry.command_hash, u.peak_rss, u.user_millis, u.system_millis,
+           u.in_blocks, u.out_blocks, u.voluntary_switches,
+           u.involuntary_switches);
+  out->assign(head);
+  out->append(entry.output);
+  out->append(tail);
 }
 
 bool BuildLog::Recompact(const std::string& path, const BuildLogUser& user,
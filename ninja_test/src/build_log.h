@@ -22,6 +22,8 @@
 
 #include "hash_map.h"
 #include "load_status.h"
+#include "log_writer.h"
+#include "resource_usage.h"
 #include "timestamp.h"
 #include "util.h"  // uint64_t
 
@@ -42,6 +44,8 @@ struct BuildLogUser {
 ///    when we need to rebuild due to the command changing
 /// 2) timing information, perhaps for generating reports
 /// 3) restat information
+/// 4) resource usage of commands, for scheduling with a memory budget and
+///    for reports (see "ninja -t resources")
 struct BuildLog {
   BuildLog();
   ~BuildLog();
@@ -51,9 +55,18 @@ struct BuildLog {
   bool OpenForWrite(const std::string& path, const BuildLogUser& user,
                     std::string* err);
   bool RecordCommand(Edge* edge, int start_time, int end_time,
-                     TimeStamp mtime = 0);
+                     TimeStamp mtime = 0,
+                     const ResourceUsage& usage = ResourceUsage());
   void Close();
 
+  /// How records reach the disk; see LogWriter.  Set before writing.
+  void set_durability(LogWriter::Durability durability) {
+    log_file_.set_durability(durability);
+  }
+  /// Wait for the records still on their way to the disk.  When false is
+  /// returned, errno will be set.
+  bool Flush() { return log_file_.Flush(); }
+
   /// Load the on-disk log.
   LoadStatus Load(const std::string& path, std::string* err);
 
@@ -63,6 +76,7 @@ struct BuildLog {
     int start_time = 0;
     int end_time = 0;
     TimeStamp mtime = 0;
+    ResourceUsage usage;
 
     static uint64_t HashCommand(StringPiece command);
 
@@ -70,7 +84,7 @@ struct BuildLog {
     bool operator==(const LogEntry& o) const {
       return output == o.output && command_hash == o.command_hash &&
           start_time == o.start_time && end_time == o.end_time &&
-          mtime == o.mtime;
+          mtime == o.mtime && usage == o.usage;
     }
 
     explicit LogEntry(std::string output);
@@ -79,10 +93,12 @@ struct BuildLog {
   };
 
   /// Lookup a previously-run command by its output path.
-  LogEntry* LookupByOutput(const std::string& path);
+  LogEntry* LookupByOutput(StringPiece path);
 
   /// Serialize an entry into a log file.
   bool WriteEntry(FILE* f, const LogEntry& entry);
+  /// Serialize an entry, as one line, into |out|.
+  static void FormatEntry(const LogEntry& entry, std::string* out);
 
   /// Rewrite the known log entries, throwing away old data.
   bool Recompact(const std::string& path, const BuildLogUser& user,
@@ -101,7 +117,7 @@ struct BuildLog {
   bool OpenForWriteIfNeeded();
 
   Entries entries_;
-  FILE* log_file_ = nullptr;
+  LogWriter log_file_;
   std::string log_file_path_;
   bool needs_recompaction_ = false;
 };
@@ -70,6 +70,39 @@ TEST_F(BuildLogTest, WriteRead) {
   ASSERT_EQ("out", e1->output);
 }
 
+TEST_F(BuildLogTest, WriteReadBatched) {
+  AssertParse(&state_,
+"build out: cat mid\n"
+"build mid: cat in\n");
+
+  BuildLog log1;
+  std::string err;
+  log1.set_durability(LogWriter::kBatch);
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(log1.RecordCommand(state_.edges_[0], 15, 18));
+  EXPECT_TRUE(log1.RecordCommand(state_.edges_[1], 20, 25));
+
+  // Flush() makes the records visible without closing the log.
+  EXPECT_TRUE(log1.Flush());
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(2u, log2.entries().size());
+  BuildLog::LogEntry* e = log2.LookupByOutput("mid");
+  ASSERT_TRUE(e);
+  EXPECT_EQ(20, e->start_time);
+
+  EXPECT_TRUE(log1.RecordCommand(state_.edges_[1], 30, 35));
+  log1.Close();
+  BuildLog log3;
+  EXPECT_TRUE(log3.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  e = log3.LookupByOutput("mid");
+  ASSERT_TRUE(e);
+  EXPECT_EQ(30, e->start_time);
+}
+
 TEST_F(BuildLogTest, FirstWriteAddsSignature) {
   const char kExpectedVersion[] = "# ninja log vX\n";
   const size_t kVersionPos = strlen(kExpectedVersion) - 2;  // Points at 'X'.
@@ -119,6 +152,61 @@ TEST_F(BuildLogTest, DoubleEntry) {
   ASSERT_NO_FATAL_FAILURE(AssertHash("command def", e->command_hash));
 }
 
+TEST_F(BuildLogTest, ResourceUsage) {
+  AssertParse(&state_,
+"build out: cat mid\n"
+"build mid: cat in\n");
+
+  BuildLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  ResourceUsage usage;
+  usage.user_millis = 1500;
+  usage.system_millis = 250;
+  usage.peak_rss = 123456;
+  usage.in_blocks = 8;
+  usage.out_blocks = 16;
+  usage.voluntary_switches = 3;
+  usage.involuntary_switches = 7;
+  log1.RecordCommand(state_.edges_[0], 15, 18, 0, usage);
+  log1.RecordCommand(state_.edges_[1], 20, 25);
+  log1.Close();
+
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  BuildLog::LogEntry* e = log2.LookupByOutput("out");
+  ASSERT_TRUE(e);
+  EXPECT_TRUE(usage == e->usage);
+  ASSERT_NO_FATAL_FAILURE(AssertHash("cat mid > out", e->command_hash));
+  e = log2.LookupByOutput("mid");
+  ASSERT_TRUE(e);
+  EXPECT_TRUE(ResourceUsage() == e->usage);
+
+  // v7 entries have no resource usage, v8 entries only the peak RSS.
+  FILE* f = fopen(kTestFilename, "wb");
+  fprintf(f, "# ninja log v7\n");
+  fprintf(f, "0\t1\t2\tout\t%" PRIx64 "\n",
+      BuildLog::LogEntry::HashCommand("command abc"));
+  fprintf(f, "0\t1\t2\tmid\t%" PRIx64 "\t4096\n",
+      BuildLog::LogEntry::HashCommand("command def"));
+  fclose(f);
+
+  BuildLog log3;
+  EXPECT_TRUE(log3.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  e = log3.LookupByOutput("out");
+  ASSERT_TRUE(e);
+  EXPECT_TRUE(ResourceUsage() == e->usage);
+  ASSERT_NO_FATAL_FAILURE(AssertHash("command abc", e->command_hash));
+  e = log3.LookupByOutput("mid");
+  ASSERT_TRUE(e);
+  EXPECT_EQ(4096, e->usage.peak_rss);
+  EXPECT_EQ(0, e->usage.user_millis);
+  ASSERT_NO_FATAL_FAILURE(AssertHash("command def", e->command_hash));
+}
+
 TEST_F(BuildLogTest, Truncate) {
   AssertParse(&state_,
 "build out: cat mid\n"
@@ -29,7 +29,8 @@ using namespace std;
 
 struct CompareEdgesByOutput {
   static bool cmp(const Edge* a, const Edge* b) {
-    return a->outputs_[0]->path() < b->outputs_[0]->path();
+    return a->outputs_[0]->path().AsString() <
+        b->outputs_[0]->path().AsString();
   }
 };
 
@@ -74,8 +75,8 @@ TEST_F(PlanTest, Basic) {
 
   Edge* edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in",  edge->inputs_[0]->path());
-  ASSERT_EQ("mid", edge->outputs_[0]->path());
+  ASSERT_EQ("in",  edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("mid", edge->outputs_[0]->path().AsString());
 
   ASSERT_FALSE(plan_.FindWork());
 
@@ -85,8 +86,8 @@ TEST_F(PlanTest, Basic) {
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("mid", edge->inputs_[0]->path());
-  ASSERT_EQ("out", edge->outputs_[0]->path());
+  ASSERT_EQ("mid", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("out", edge->outputs_[0]->path().AsString());
 
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
@@ -215,8 +216,8 @@ void PlanTest::TestPoolWithDepthOne(const char* test_case) {
 
   Edge* edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in",  edge->inputs_[0]->path());
-  ASSERT_EQ("out1", edge->outputs_[0]->path());
+  ASSERT_EQ("in",  edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("out1", edge->outputs_[0]->path().AsString());
 
   // This will be false since poolcat is serialized
   ASSERT_FALSE(plan_.FindWork());
@@ -226,8 +227,8 @@ void PlanTest::TestPoolWithDepthOne(const char* test_case) {
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in", edge->inputs_[0]->path());
-  ASSERT_EQ("out2", edge->outputs_[0]->path());
+  ASSERT_EQ("in", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("out2", edge->outputs_[0]->path().AsString());
 
   ASSERT_FALSE(plan_.FindWork());
 
@@ -293,16 +294,17 @@ TEST_F(PlanTest, PoolsWithDepthTwo) {
 
   for (int i = 0; i < 4; ++i) {
     Edge *edge = edges[i];
-    ASSERT_EQ("in",  edge->inputs_[0]->path());
+    ASSERT_EQ("in",  edge->inputs_[0]->path().AsString());
     string base_name(i < 2 ? "out" : "outb");
-    ASSERT_EQ(base_name + string(1, '1' + (i % 2)), edge->outputs_[0]->path());
+    ASSERT_EQ(base_name + string(1, '1' + (i % 2)),
+              edge->outputs_[0]->path().AsString());
   }
 
   // outb3 is exempt because it has an empty pool
   Edge* edge = edges[4];
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in",  edge->inputs_[0]->path());
-  ASSERT_EQ("outb3", edge->outputs_[0]->path());
+  ASSERT_EQ("in",  edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("outb3", edge->outputs_[0]->path().AsString());
 
   // finish out1
   string err;
@@ -313,8 +315,8 @@ TEST_F(PlanTest, PoolsWithDepthTwo) {
   // out3 should be available
   Edge* out3 = plan_.FindWork();
   ASSERT_TRUE(out3);
-  ASSERT_EQ("in",  out3->inputs_[0]->path());
-  ASSERT_EQ("out3", out3->outputs_[0]->path());
+  ASSERT_EQ("in",  out3->inputs_[0]->path().AsString());
+  ASSERT_EQ("out3", out3->outputs_[0]->path().AsString());
 
   ASSERT_FALSE(plan_.FindWork());
 
@@ -330,7 +332,7 @@ TEST_F(PlanTest, PoolsWithDepthTwo) {
 
   Edge* last = plan_.FindWork();
   ASSERT_TRUE(last);
-  ASSERT_EQ("allTheThings", last->outputs_[0]->path());
+  ASSERT_EQ("allTheThings", last->outputs_[0]->path().AsString());
 
   plan_.EdgeFinished(last, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
@@ -371,7 +373,7 @@ TEST_F(PlanTest, PoolWithRedundantEdges) {
   FindWorkSorted(&initial_edges, 2);
 
   edge = initial_edges[1];  // Foo first
-  ASSERT_EQ("foo.cpp", edge->outputs_[0]->path());
+  ASSERT_EQ("foo.cpp", edge->outputs_[0]->path().AsString());
   string err;
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
@@ -379,40 +381,40 @@ TEST_F(PlanTest, PoolWithRedundantEdges) {
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
   ASSERT_FALSE(plan_.FindWork());
-  ASSERT_EQ("foo.cpp", edge->inputs_[0]->path());
-  ASSERT_EQ("foo.cpp", edge->inputs_[1]->path());
-  ASSERT_EQ("foo.cpp.obj", edge->outputs_[0]->path());
+  ASSERT_EQ("foo.cpp", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("foo.cpp", edge->inputs_[1]->path().AsString());
+  ASSERT_EQ("foo.cpp.obj", edge->outputs_[0]->path().AsString());
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
 
   edge = initial_edges[0];  // Now for bar
-  ASSERT_EQ("bar.cpp", edge->outputs_[0]->path());
+  ASSERT_EQ("bar.cpp", edge->outputs_[0]->path().AsString());
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
   ASSERT_FALSE(plan_.FindWork());
-  ASSERT_EQ("bar.cpp", edge->inputs_[0]->path());
-  ASSERT_EQ("bar.cpp", edge->inputs_[1]->path());
-  ASSERT_EQ("bar.cpp.obj", edge->outputs_[0]->path());
+  ASSERT_EQ("bar.cpp", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("bar.cpp", edge->inputs_[1]->path().AsString());
+  ASSERT_EQ("bar.cpp.obj", edge->outputs_[0]->path().AsString());
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
   ASSERT_FALSE(plan_.FindWork());
-  ASSERT_EQ("foo.cpp.obj", edge->inputs_[0]->path());
-  ASSERT_EQ("bar.cpp.obj", edge->inputs_[1]->path());
-  ASSERT_EQ("libfoo.a", edge->outputs_[0]->path());
+  ASSERT_EQ("foo.cpp.obj", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("bar.cpp.obj", edge->inputs_[1]->path().AsString());
+  ASSERT_EQ("libfoo.a", edge->outputs_[0]->path().AsString());
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
   ASSERT_FALSE(plan_.FindWork());
-  ASSERT_EQ("libfoo.a", edge->inputs_[0]->path());
-  ASSERT_EQ("all", edge->outputs_[0]->path());
+  ASSERT_EQ("libfoo.a", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("all", edge->outputs_[0]->path().AsString());
   plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err);
   ASSERT_EQ("", err);
 
@@ -442,8 +444,8 @@ TEST_F(PlanTest, PoolWithFailingEdge) {
 
   Edge* edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in",  edge->inputs_[0]->path());
-  ASSERT_EQ("out1", edge->outputs_[0]->path());
+  ASSERT_EQ("in",  edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("out1", edge->outputs_[0]->path().AsString());
 
   // This will be false since poolcat is serialized
   ASSERT_FALSE(plan_.FindWork());
@@ -453,8 +455,8 @@ TEST_F(PlanTest, PoolWithFailingEdge) {
 
   edge = plan_.FindWork();
   ASSERT_TRUE(edge);
-  ASSERT_EQ("in", edge->inputs_[0]->path());
-  ASSERT_EQ("out2", edge->outputs_[0]->path());
+  ASSERT_EQ("in", edge->inputs_[0]->path().AsString());
+  ASSERT_EQ("out2", edge->outputs_[0]->path().AsString());
 
   ASSERT_FALSE(plan_.FindWork());
 
@@ -506,7 +508,7 @@ TEST_F(PlanTest, PriorityWithoutBuildLog) {
   for (int i = 0; i < n_edges; ++i) {
     Edge* edge = plan_.FindWork();
     ASSERT_TRUE(edge != nullptr);
-    EXPECT_EQ(expected_order[i], edge->outputs_[0]->path());
+    EXPECT_EQ(expected_order[i], edge->outputs_[0]->path().AsString());
 
     std::string err;
     ASSERT_TRUE(plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, &err));
@@ -519,7 +521,7 @@ TEST_F(PlanTest, PriorityWithoutBuildLog) {
 /// Fake implementation of CommandRunner, useful for tests.
 struct FakeCommandRunner : public CommandRunner {
   explicit FakeCommandRunner(VirtualFileSystem* fs) :
-      max_active_edges_(1), fs_(fs) {}
+      max_active_edges_(1), wake_ups_(0), fs_(fs) {}
 
   // CommandRunner impl
   virtual size_t CanRunMore() const;
@@ -531,6 +533,9 @@ struct FakeCommandRunner : public CommandRunner {
   vector<string> commands_ran_;
   vector<Edge*> active_edges_;
   size_t max_active_edges_;
+  /// WaitForCommand() returns this many times as if woken up, with no
+  /// finished edge, before it reports one.
+  size_t wake_ups_;
   VirtualFileSystem* fs_;
 };
 
@@ -646,7 +651,7 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
       edge->rule().name() == "touch-fail-tick2") {
     for (vector<Node*>::iterator out = edge->outputs_.begin();
          out != edge->outputs_.end(); ++out) {
-      fs_->Create((*out)->path(), "");
+      fs_->Create((*out)->path().AsString(), "");
     }
   } else if (edge->rule().name() == "true" ||
              edge->rule().name() == "fail" ||
@@ -658,9 +663,9 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
     assert(edge->outputs_.size() == 1);
     string content;
     string err;
-    if (fs_->ReadFile(edge->inputs_[0]->path(), &content, &err) ==
+    if (fs_->ReadFile(edge->inputs_[0]->path().AsString(), &content, &err) ==
         DiskInterface::Okay)
-      fs_->WriteFile(edge->outputs_[0]->path(), content);
+      fs_->WriteFile(edge->outputs_[0]->path().AsString(), content);
   } else if (edge->rule().name() == "touch-implicit-dep-out") {
     string dep = edge->GetBinding("test_dependency");
     fs_->Tick();
@@ -668,13 +673,13 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
     fs_->Tick();
     for (vector<Node*>::iterator out = edge->outputs_.begin();
          out != edge->outputs_.end(); ++out) {
-      fs_->Create((*out)->path(), "");
+      fs_->Create((*out)->path().AsString(), "");
     }
   } else if (edge->rule().name() == "touch-out-implicit-dep") {
     string dep = edge->GetBinding("test_dependency");
     for (vector<Node*>::iterator out = edge->outputs_.begin();
          out != edge->outputs_.end(); ++out) {
-      fs_->Create((*out)->path(), "");
+      fs_->Create((*out)->path().AsString(), "");
     }
     fs_->Tick();
     fs_->Create(dep, "");
@@ -689,8 +694,8 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
     string contents;
     for (vector<Node*>::iterator out = edge->outputs_.begin();
          out != edge->outputs_.end(); ++out) {
-      contents += (*out)->path() + ": " + dep + "\n";
-      fs_->Create((*out)->path(), "");
+      contents += (*out)->path().AsString() + ": " + dep + "\n";
+      fs_->Create((*out)->path().AsString(), "");
     }
     fs_->Create(depfile, contents);
   } else if (edge->rule().name() == "long-cc") {
@@ -702,8 +707,8 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
       fs_->Tick();
       fs_->Tick();
       fs_->Tick();
-      fs_->Create((*out)->path(), "");
-      contents += (*out)->path() + ": " + dep + "\n";
+      fs_->Create((*out)->path().AsString(), "");
+      contents += (*out)->path().AsString() + ": " + dep + "\n";
     }
     if (!dep.empty() && !depfile.empty())
       fs_->Create(depfile, contents);
@@ -725,6 +730,11 @@ bool FakeCommandRunner::WaitForCommand(Result* result) {
   if (active_edges_.empty())
     return false;
 
+  if (wake_ups_ > 0) {
+    --wake_ups_;
+    return true;
+  }
+
   // All active edges were already completed immediately when started,
   // so we can pick any edge here.  Pick the last edge.  Tests can
   // control the order of edges by the name of the first output.
@@ -752,7 +762,7 @@ bool FakeCommandRunner::WaitForCommand(Result* result) {
     const std::string prefix = edge->GetBinding("msvc_deps_prefix");
     for (std::vector<Node*>::iterator in = edge->inputs_.begin();
          in != edge->inputs_.end(); ++in) {
-      result->output += prefix + (*in)->path() + '\n';
+      result->output += prefix + (*in)->path().AsString() + '\n';
     }
   }
 
@@ -845,6 +855,24 @@ TEST_F(BuildTest, OneStep2) {
   EXPECT_EQ("cat in1 > cat1", command_runner_.commands_ran_[0]);
 }
 
+// A wake-up from a depfile worker, which finishes no edge, does not end the
+// build.
+TEST_F(BuildTest, WakeUpWithoutFinishedEdge) {
+  EXPECT_TRUE(CommandRunner::Result().success());
+
+  Dirty("cat1");
+  command_runner_.wake_ups_ = 2;
+  string err;
+  EXPECT_TRUE(builder_.AddTarget("cat1", &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ(builder_.Build(&err), ExitSuccess);
+  EXPECT_EQ("", err);
+
+  EXPECT_EQ(0u, command_runner_.wake_ups_);
+  ASSERT_EQ(1u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cat in1 > cat1", command_runner_.commands_ran_[0]);
+}
+
 TEST_F(BuildTest, TwoStep) {
   string err;
   EXPECT_TRUE(builder_.AddTarget("cat12", &err));
@@ -876,6 +904,45 @@ TEST_F(BuildTest, TwoStep) {
   EXPECT_EQ("cat cat1 cat2 > cat12", command_runner_.commands_ran_[4]);
 }
 
+TEST_F(BuildTest, EagerEdges) {
+  // Edges that only read source files start before the scan and are
+  // waited for, not run again, by the build.
+  command_runner_.max_active_edges_ = 2;
+  string err;
+  vector<Node*> targets(1, GetNode("cat12"));
+  EXPECT_TRUE(builder_.StartEagerEdges(targets, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(2u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cat in1 > cat1", command_runner_.commands_ran_[0]);
+  EXPECT_EQ("cat in1 in2 > cat2", command_runner_.commands_ran_[1]);
+
+  EXPECT_TRUE(builder_.AddTarget("cat12", &err));
+  ASSERT_EQ("", err);
+  EXPECT_FALSE(builder_.AlreadyUpToDate());
+  EXPECT_EQ(builder_.Build(&err), ExitSuccess);
+  EXPECT_EQ("", err);
+  ASSERT_EQ(3u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cat cat1 cat2 > cat12", command_runner_.commands_ran_[2]);
+}
+
+TEST_F(BuildTest, EagerEdgesSkipped) {
+  // Edges with an existing output, a missing input, or a non-default pool
+  // are left to the regular scan.
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat in1\n"
+"build out2: cat missing\n"
+"build out3: cat in1\n"
+"  pool = console\n"
+"build all: phony out1 out2 out3\n"));
+  fs_.Create("out1", "");
+  command_runner_.max_active_edges_ = 3;
+  string err;
+  vector<Node*> targets(1, GetNode("all"));
+  EXPECT_TRUE(builder_.StartEagerEdges(targets, &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ(0u, command_runner_.commands_ran_.size());
+}
+
 TEST_F(BuildTest, TwoOutputs) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
 "rule touch\n"
@@ -1080,8 +1147,8 @@ TEST_F(BuildTest, EncounterReadyTwice) {
 
   vector<Edge*> c_out = GetNode("c")->out_edges();
   ASSERT_EQ(2u, c_out.size());
-  EXPECT_EQ("b", c_out[0]->outputs_[0]->path());
-  EXPECT_EQ("a", c_out[1]->outputs_[0]->path());
+  EXPECT_EQ("b", c_out[0]->outputs_[0]->path().AsString());
+  EXPECT_EQ("a", c_out[1]->outputs_[0]->path().AsString());
 
   fs_.Create("b", "");
   EXPECT_TRUE(builder_.AddTarget("a", &err));
@@ -1111,10 +1178,10 @@ TEST_F(BuildTest, OrderOnlyDeps) {
   EXPECT_EQ(1, edge->order_only_deps_);
   // Verify the inputs are in the order we expect
   // (explicit then implicit then orderonly).
-  EXPECT_EQ("foo.c", edge->inputs_[0]->path());
-  EXPECT_EQ("blah.h", edge->inputs_[1]->path());
-  EXPECT_EQ("bar.h", edge->inputs_[2]->path());
-  EXPECT_EQ("otherfile", edge->inputs_[3]->path());
+  EXPECT_EQ("foo.c", edge->inputs_[0]->path().AsString());
+  EXPECT_EQ("blah.h", edge->inputs_[1]->path().AsString());
+  EXPECT_EQ("bar.h", edge->inputs_[2]->path().AsString());
+  EXPECT_EQ("otherfile", edge->inputs_[3]->path().AsString());
 
   // Expect the command line we generate to only use the original input.
   ASSERT_EQ("cc foo.c", edge->EvaluateCommand());
@@ -1641,6 +1708,58 @@ TEST_F(BuildWithLogTest, NotInLogButOnDisk) {
   EXPECT_TRUE(builder_.AlreadyUpToDate());
 }
 
+/// A ResourceUsage with only the peak RSS set.
+static ResourceUsage Rss(int64_t kib) {
+  ResourceUsage usage;
+  usage.peak_rss = kib;
+  return usage;
+}
+
+TEST_F(BuildWithLogTest, MemoryBudget) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build big1: cat in1\n"
+"build big2: cat in2\n"
+"build small: cat in3\n"
+"build all: phony big1 big2 small\n"));
+  fs_.Create("in1", "");
+  fs_.Create("in2", "");
+  fs_.Create("in3", "");
+  build_log_.RecordCommand(GetNode("big1")->in_edge(), 0, 0, 0, Rss(2000));
+  build_log_.RecordCommand(GetNode("big2")->in_edge(), 0, 0, 0, Rss(2000));
+  build_log_.RecordCommand(GetNode("small")->in_edge(), 0, 0, 0, Rss(500));
+
+  // big1 and big2 do not fit into the budget together, so big2 waits for
+  // big1 although small, which does fit, can start right away.
+  config_.memory_budget = 3000;
+  command_runner_.max_active_edges_ = 3;
+  string err;
+  EXPECT_TRUE(builder_.AddTarget("all", &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ(builder_.Build(&err), ExitSuccess);
+  ASSERT_EQ("", err);
+  ASSERT_EQ(3u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cat in1 > big1", command_runner_.commands_ran_[0]);
+  EXPECT_EQ("cat in3 > small", command_runner_.commands_ran_[1]);
+  EXPECT_EQ("cat in2 > big2", command_runner_.commands_ran_[2]);
+}
+
+TEST_F(BuildWithLogTest, PredictPeakRss) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule touch\n"
+"  command = touch $out\n"
+"build known1: cat in\n"
+"build known2: cat in\n"
+"build unknown: cat in\n"
+"build other: touch in\n"));
+  build_log_.RecordCommand(GetNode("known1")->in_edge(), 0, 0, 0, Rss(1000));
+  build_log_.RecordCommand(GetNode("known2")->in_edge(), 0, 0, 0, Rss(3000));
+
+  EXPECT_EQ(1000, builder_.PredictPeakRss(GetNode("known1")->in_edge()));
+  // Edges without history get the average of their rule.
+  EXPECT_EQ(2000, builder_.PredictPeakRss(GetNode("unknown")->in_edge()));
+  EXPECT_EQ(0, builder_.PredictPeakRss(GetNode("other")->in_edge()));
+}
+
 TEST_F(BuildWithLogTest, RebuildAfterFailure) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
 "rule touch-fail-tick2\n"
@@ -2373,12 +2492,12 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileMSVC) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(1, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(1, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
 }
 
 /// Test a GCC-style deps log with multiple outputs.
@@ -2402,14 +2521,14 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCOneLine) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(2, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out1_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out1_deps->nodes[1]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(2, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out2_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out2_deps->nodes[1]->path().AsString());
 }
 
 /// Test a GCC-style deps log with multiple outputs using a line per input.
@@ -2433,14 +2552,14 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCMultiLineInput) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(2, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out1_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out1_deps->nodes[1]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(2, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out2_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out2_deps->nodes[1]->path().AsString());
 }
 
 /// Test a GCC-style deps log with multiple outputs using a line per output.
@@ -2464,14 +2583,14 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCMultiLineOutput) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(2, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out1_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out1_deps->nodes[1]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(2, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out2_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out2_deps->nodes[1]->path().AsString());
 }
 
 /// Test a GCC-style deps log with multiple outputs mentioning only the main output.
@@ -2495,14 +2614,14 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCOnlyMainOutput) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(2, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out1_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out1_deps->nodes[1]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(2, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out2_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out2_deps->nodes[1]->path().AsString());
 }
 
 /// Test a GCC-style deps log with multiple outputs mentioning only the secondary output.
@@ -2528,14 +2647,14 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCOnlySecondaryOutput) {
   Node* out1_node = state_.LookupNode("out1");
   DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
   EXPECT_EQ(2, out1_deps->node_count);
-  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out1_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out1_deps->nodes[1]->path().AsString());
 
   Node* out2_node = state_.LookupNode("out2");
   DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
   EXPECT_EQ(2, out2_deps->node_count);
-  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
-  EXPECT_EQ("in2", out2_deps->nodes[1]->path());
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path().AsString());
+  EXPECT_EQ("in2", out2_deps->nodes[1]->path().AsString());
 }
 
 /// Tests of builds involving deps logs necessarily must span
@@ -3084,6 +3203,70 @@ TEST_F(BuildWithDepsLogTest, DepFileOKDepsLog) {
   }
 }
 
+/// Depfiles parsed by the depfile workers end up in the deps log, and the
+/// edges that depend on their outputs wait for them.
+TEST_F(BuildWithDepsLogTest, DepfileWorkers) {
+  string err;
+  config_.depfile_threads = 1;
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule cc\n  command = cc $in\n  depfile = $out.d\n  deps = gcc\n"
+"build a.o: cc a.c\n"
+"build b.o: cc a.o\n"));
+  fs_.Create("a.c", "");
+  fs_.Create("a.o.d", "a.o: a.c ./a.h\n");
+  fs_.Create("b.o.d", "b.o: a.o b.h\n");
+
+  DepsLog deps_log;
+  ASSERT_TRUE(deps_log.OpenForWrite(deps_log_file_.path(), &err));
+  ASSERT_EQ("", err);
+
+  Builder builder(&state_, config_, NULL, &deps_log, &fs_, &status_, 0);
+  builder.command_runner_.reset(&command_runner_);
+  EXPECT_TRUE(builder.AddTarget("b.o", &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ(builder.Build(&err), ExitSuccess);
+  EXPECT_EQ("", err);
+  builder.command_runner_.release();
+  deps_log.Close();
+
+  ASSERT_EQ(2u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cc a.c", command_runner_.commands_ran_[0]);
+  EXPECT_EQ("cc a.o", command_runner_.commands_ran_[1]);
+
+  DepsLog::Deps* deps = deps_log.GetDeps(state_.LookupNode("a.o"));
+  ASSERT_TRUE(deps);
+  ASSERT_EQ(2, deps->node_count);
+  EXPECT_EQ("a.c", deps->nodes[0]->path().AsString());
+  EXPECT_EQ("a.h", deps->nodes[1]->path().AsString());
+  deps = deps_log.GetDeps(state_.LookupNode("b.o"));
+  ASSERT_TRUE(deps);
+  ASSERT_EQ(2, deps->node_count);
+  EXPECT_EQ("b.h", deps->nodes[1]->path().AsString());
+
+  // The depfiles are removed on the build loop once parsed.
+  EXPECT_EQ(1u, fs_.files_removed_.count("a.o.d"));
+  EXPECT_EQ(1u, fs_.files_removed_.count("b.o.d"));
+}
+
+TEST_F(BuildWithDepsLogTest, DepfileWorkersParseError) {
+  string err;
+  config_.depfile_threads = 1;
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule cc\n  command = cc $in\n  depfile = $out.d\n  deps = gcc\n"
+"build a.o: cc a.c\n"));
+  fs_.Create("a.c", "");
+  // Only one path may be on the left of the colon.
+  fs_.Create("a.o.d", "AAA BBB");
+
+  Builder builder(&state_, config_, NULL, NULL, &fs_, &status_, 0);
+  builder.command_runner_.reset(&command_runner_);
+  EXPECT_TRUE(builder.AddTarget("a.o", &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ(builder.Build(&err), ExitFailure);
+  EXPECT_EQ("subcommand failed", err);
+  builder.command_runner_.release();
+}
+
 TEST_F(BuildWithDepsLogTest, DiscoveredDepDuringBuildChanged) {
   string err;
   const char* manifest =
@@ -0,0 +1,184 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_BYTE_SCAN_H_
+#define NINJA_BYTE_SCAN_H_
+
+// Fast paths for the lexers: skip runs of bytes that the re2c state
+// machines would consume one at a time without doing anything interesting.
+// Each function has a scalar version, which is the reference, and a version
+// that looks at a block of bytes at a time using whichever of AVX2 and SSE2
+// the compiler targets.  Both only read bytes in [p, end).
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NINJA_BYTE_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NINJA_BYTE_SCAN_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace byte_scan {
+
+/// Index of the lowest set bit of a nonzero |mask|.
+inline int LowestBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+/// Whether |c| ends a run of literal text in a manifest EvalString:
+/// '$', ' ', ':', '|', '\r', '\n' or NUL.
+inline bool IsEvalStringSpecial(unsigned char c) {
+  return c == '$' || c == ' ' || c == ':' || c == '|' || c == '\r' ||
+         c == '\n' || c == '\0';
+}
+
+/// Whether |c| can always be copied verbatim into a depfile filename:
+/// letters, digits, "+-./_" and bytes >= 0x80.  This is a subset of
+/// the plain text the depfile parser accepts; the rest goes through the
+/// state machine.
+inline bool IsDepfilePlain(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '-' && c <= '9') || c == '_' || c == '+' || c >= 0x80;
+}
+
+inline const char* FindEvalStringSpecialScalar(const char* p,
+                                               const char* end) {
+  while (p < end && !IsEvalStringSpecial(*p))
+    ++p;
+  return p;
+}
+
+inline const char* SkipDepfilePlainScalar(const char* p, const char* end) {
+  while (p < end && IsDepfilePlain(*p))
+    ++p;
+  return p;
+}
+
+#if NINJA_BYTE_SCAN_AVX2
+typedef __m256i Block;
+const int kBlockSize = 32;
+inline Block Load(const char* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+inline Block Splat(char c) { return _mm256_set1_epi8(c); }
+inline Block Eq(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+inline Block Gt(Block a, Block b) { return _mm256_cmpgt_epi8(a, b); }
+inline Block Or(Block a, Block b) { return _mm256_or_si256(a, b); }
+inline Block And(Block a, Block b) { return _mm256_and_si256(a, b); }
+inline unsigned Mask(Block a) {
+  return static_cast<unsigned>(_mm256_movemask_epi8(a));
+}
+#elif NINJA_BYTE_SCAN_SSE2
+typedef __m128i Block;
+const int kBlockSize = 16;
+inline Block Load(const char* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline Block Splat(char c) { return _mm_set1_epi8(c); }
+inline Block Eq(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+inline Block Gt(Block a, Block b) { return _mm_cmpgt_epi8(a, b); }
+inline Block Or(Block a, Block b) { return _mm_or_si128(a, b); }
+inline Block And(Block a, Block b) { return _mm_and_si128(a, b); }
+inline unsigned Mask(Block a) {
+  return static_cast<unsigned>(_mm_movemask_epi8(a));
+}
+#endif
+
+#if NINJA_BYTE_SCAN_AVX2 || NINJA_BYTE_SCAN_SSE2
+/// Bytes of |b| in [lo, hi], both in 0..0x7f.  The comparisons are
+/// signed, so bytes >= 0x80 never match.
+inline Block InRange(Block b, char lo, char hi) {
+  return And(Gt(b, Splat(lo - 1)), Gt(Splat(hi + 1), b));
+}
+#endif
+
+/// @return the first '/' in [p, end) that is followed by another '/' or a
+/// '.', i.e. one that may start an empty, "." or ".." path component, or end.
+inline const char* FindSlashBeforeSlashOrDotScalar(const char* p,
+                                                   const char* end) {
+  for (; end - p >= 2; ++p) {
+    if (p[0] == '/' && (p[1] == '/' || p[1] == '.'))
+      return p;
+  }
+  return end;
+}
+
+inline const char* FindEvalStringSpecial(const char* p, const char* end) {
+#if NINJA_BYTE_SCAN_AVX2 || NINJA_BYTE_SCAN_SSE2
+  while (end - p >= kBlockSize) {
+    Block b = Load(p);
+    Block special = Or(Or(Or(Eq(b, Splat('$')), Eq(b, Splat(' '))),
+                          Or(Eq(b, Splat(':')), Eq(b, Splat('|')))),
+                       Or(Or(Eq(b, Splat('\r')), Eq(b, Splat('\n'))),
+                          Eq(b, Splat('\0'))));
+    unsigned mask = Mask(special);
+    if (mask)
+      return p + LowestBit(mask);
+    p += kBlockSize;
+  }
+#endif
+  return FindEvalStringSpecialScalar(p, end);
+}
+
+inline const char* SkipDepfilePlain(const char* p, const char* end) {
+#if NINJA_BYTE_SCAN_AVX2 || NINJA_BYTE_SCAN_SSE2
+  while (end - p >= kBlockSize) {
+    Block b = Load(p);
+    Block high = Gt(Splat(0), b);  // Bytes >= 0x80.
+    Block plain = Or(Or(Or(InRange(b, 'a', 'z'), InRange(b, 'A', 'Z')),
+                        Or(InRange(b, '-', '9'), high)),
+                     Or(Eq(b, Splat('_')), Eq(b, Splat('+'))));
+    unsigned mask = ~Mask(plain);
+    if (kBlockSize == 16)
+      mask &= 0xffff;
+    if (mask)
+      return p + LowestBit(mask);
+    p += kBlockSize;
+  }
+#endif
+  return SkipDepfilePlainScalar(p, end);
+}
+
+inline const char* FindSlashBeforeSlashOrDot(const char* p,
+                                             const char* end) {
+#if NINJA_BYTE_SCAN_AVX2 || NINJA_BYTE_SCAN_SSE2
+  // Each block is compared against itself shifted by one byte.
+  while (end - p > kBlockSize) {
+    Block b = Load(p);
+    Block next = Load(p + 1);
+    Block hit = And(Eq(b, Splat('/')),
+                    Or(Eq(next, Splat('/')), Eq(next, Splat('.'))));
+    unsigned mask = Mask(hit);
+    if (mask)
+      return p + LowestBit(mask);
+    p += kBlockSize;
+  }
+#endif
+  return FindSlashBeforeSlashOrDotScalar(p, end);
+}
+
+}  // namespace byte_scan
+
+#endif  // NINJA_BYTE_SCAN_H_
@@ -0,0 +1,67 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "byte_scan.h"
+
+#include <stdlib.h>
+
+#include <string>
+
+#include "test.h"
+
+using namespace std;
+using namespace byte_scan;
+
+TEST(ByteScan, EvalStringSpecial) {
+  string s = "foo/bar.cc";
+  EXPECT_EQ(s.data() + s.size(),
+            FindEvalStringSpecial(s.data(), s.data() + s.size()));
+  s = "a_rather_long_path/to/some/source_file.cc $out";
+  EXPECT_EQ(s.data() + s.find(' '),
+            FindEvalStringSpecial(s.data(), s.data() + s.size()));
+  s = string(40, 'x') + "|";
+  EXPECT_EQ(s.data() + 40,
+            FindEvalStringSpecial(s.data(), s.data() + s.size()));
+}
+
+TEST(ByteScan, DepfilePlain) {
+  string s = "out/obj/foo-bar_baz+1.o: \\\n";
+  EXPECT_EQ(s.data() + s.find(':'),
+            SkipDepfilePlain(s.data(), s.data() + s.size()));
+  s = string(33, 'a') + "\xc3\xa9" + "$";
+  EXPECT_EQ(s.data() + s.size() - 1,
+            SkipDepfilePlain(s.data(), s.data() + s.size()));
+}
+
+// The block versions must agree with the scalar ones byte for byte.
+TEST(ByteScan, MatchesScalar) {
+  srand(12345);
+  for (int i = 0; i < 2000; ++i) {
+    string s(rand() % 100, '\0');
+    for (size_t j = 0; j < s.size(); ++j) {
+      // Mostly plain text with the occasional arbitrary byte.
+      s[j] = rand() % 8 ? "abcXYZ019./-_+"[rand() % 14]
+                        : static_cast<char>(rand() % 256);
+    }
+    const char* begin = s.data();
+    const char* end = begin + s.size();
+    for (const char* p = begin; p <= end; p += 7) {
+      ASSERT_EQ(FindEvalStringSpecialScalar(p, end),
+                FindEvalStringSpecial(p, end));
+      ASSERT_EQ(SkipDepfilePlainScalar(p, end), SkipDepfilePlain(p, end));
+      ASSERT_EQ(FindSlashBeforeSlashOrDotScalar(p, end),
+                FindSlashBeforeSlashOrDot(p, end));
+    }
+  }
+}
@@ -17,6 +17,7 @@
 
 #include "util.h"
 #include "metrics.h"
+#include "string_piece.h"
 
 using namespace std;
 
@@ -24,6 +25,53 @@ const char kPath[] =
     "../../third_party/WebKit/Source/WebCore/"
     "platform/leveldb/LevelDBWriteBatch.cpp";
 
+/// A depfile's worth of paths: mostly canonical, as compilers write them,
+/// with some that need work.
+string MakeDepfilePaths(vector<size_t>* lengths) {
+  const char* const kPaths[] = {
+    "/usr/include/x86_64-linux-gnu/c++/13/bits/c++config.h",
+    "../../third_party/WebKit/Source/WebCore/platform/leveldb/LevelDB.h",
+    "../../base/containers/flat_map.h",
+    "gen/base/base_export.h",
+    "../../third_party/abseil-cpp/absl/base/../meta/type_traits.h",
+    "./gen/build/buildflag.h",
+  };
+  const int kNumPaths = sizeof(kPaths) / sizeof(kPaths[0]);
+  string buf;
+  for (int i = 0; i < 1000; ++i) {
+    const char* path = kPaths[i % kNumPaths];
+    lengths->push_back(strlen(path));
+    buf += path;
+    buf += ' ';
+  }
+  return buf;
+}
+
+void MeasureBulk() {
+  vector<size_t> lengths;
+  const string buf = MakeDepfilePaths(&lengths);
+  vector<char> scratch(buf.size());
+  vector<StringPiece> paths(lengths.size());
+  vector<uint64_t> slash_bits(lengths.size());
+
+  const int kNumRepetitions = 20000;
+  int64_t start = GetTimeMillis();
+  for (int rep = 0; rep < kNumRepetitions; ++rep) {
+    // Canonicalization works in place, so start over from a fresh copy.
+    memcpy(&scratch[0], buf.data(), buf.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      paths[i] = StringPiece(&scratch[offset], lengths[i]);
+      offset += lengths[i] + 1;
+    }
+    CanonicalizePaths(&paths[0], paths.size(), &slash_bits[0]);
+  }
+  int delta = max<int>((int)(GetTimeMillis() - start), 1);
+  double total = (double)kNumRepetitions * paths.size();
+  printf("bulk: %.1fM paths/s, %.0fMB/s\n", total / delta / 1000,
+         (double)kNumRepetitions * buf.size() / delta / 1000);
+}
+
 int main() {
   vector<int> times;
 
@@ -55,4 +103,7 @@ int main() {
 
   printf("min %dms  max %dms  avg %.1fms\n",
          min, max, total / times.size());
+  printf("single: %.1fM paths/s\n", 2000000 / (double)(min > 0 ? min : 1) / 1000);
+
+  MeasureBulk();
 }
@@ -16,7 +16,7 @@
 #define NINJA_COMMAND_COLLECTOR_H_
 
 #include <cassert>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "graph.h"
@@ -36,23 +36,45 @@ struct CommandCollector {
   void CollectFrom(const Node* node) {
     assert(node);
 
-    if (!visited_nodes_.insert(node).second)
+    // Walk with an explicit stack rather than recursion, so that long
+    // chains of edges cannot overflow the call stack.  Each entry holds an
+    // edge and the index of its next input to visit.
+    Edge* edge = Visit(node);
+    if (!edge)
       return;
+    stack_.push_back(std::make_pair(edge, size_t(0)));
+    while (!stack_.empty()) {
+      edge = stack_.back().first;
+      size_t input = stack_.back().second;
+      if (input < edge->inputs_.size()) {
+        ++stack_.back().second;
+        if (Edge* input_edge = Visit(edge->inputs_[input]))
+          stack_.push_back(std::make_pair(input_edge, size_t(0)));
+        continue;
+      }
+      stack_.pop_back();
+      if (!edge->is_phony())
+        in_edges.push_back(edge);
+    }
+  }
 
+ private:
+  /// Return the in-edge of |node| if it is yet to be walked.  Edges are
+  /// tracked by id, as nodes only lead to them.
+  Edge* Visit(const Node* node) {
     Edge* edge = node->in_edge();
-    if (!edge || !visited_edges_.insert(edge).second)
-      return;
-
-    for (Node* input_node : edge->inputs_)
-      CollectFrom(input_node);
-
-    if (!edge->is_phony())
-      in_edges.push_back(edge);
+    if (!edge)
+      return NULL;
+    if (edge->id_ >= visited_edges_.size())
+      visited_edges_.resize(edge->id_ + 1);
+    if (visited_edges_[edge->id_])
+      return NULL;
+    visited_edges_[edge->id_] = true;
+    return edge;
   }
 
- private:
-  std::unordered_set<const Node*> visited_nodes_;
-  std::unordered_set<Edge*> visited_edges_;
+  std::vector<bool> visited_edges_;
+  std::vector<std::pair<Edge*, size_t> > stack_;
 
   /// we use a vector to preserve order from requisites to their dependents.
   /// This may help LSP server performance in languages that support modules,
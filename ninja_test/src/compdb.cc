@@ -0,0 +1,160 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "compdb.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "graph.h"
+#include "json.h"
+#include "wait_slice.h"
+
+using namespace std;
+
+std::string EvaluateCommandWithRspfile(const Edge* edge,
+                                       EvaluateCommandMode mode) {
+  string command = edge->EvaluateCommand();
+  if (mode == ECM_NORMAL)
+    return command;
+
+  string rspfile = edge->GetUnescapedRspfile();
+  if (rspfile.empty())
+    return command;
+
+  size_t index = command.find(rspfile);
+  if (index == 0 || index == string::npos ||
+      (command[index - 1] != '@' &&
+       command.find("--option-file=") != index - 14 &&
+       command.find("-f ") != index - 3))
+    return command;
+
+  string rspfile_content = edge->GetBinding("rspfile_content");
+  size_t newline_index = 0;
+  while ((newline_index = rspfile_content.find('\n', newline_index)) !=
+         string::npos) {
+    rspfile_content.replace(newline_index, 1, 1, ' ');
+    ++newline_index;
+  }
+  if (command[index - 1] == '@') {
+    command.replace(index - 1, rspfile.length() + 1, rspfile_content);
+  } else if (command.find("-f ") == index - 3) {
+    command.replace(index - 3, rspfile.length() + 3, rspfile_content);
+  } else {  // --option-file syntax
+    command.replace(index - 14, rspfile.length() + 14, rspfile_content);
+  }
+  return command;
+}
+
+namespace {
+
+/// Append the entry for |edge|, preceded by a newline, to |out|.
+/// |directory| is already JSON-encoded.
+void AppendCompdbObject(const string& directory, const Edge* edge,
+                        EvaluateCommandMode mode, string* out) {
+  out->append("\n  {\n    \"directory\": \"");
+  out->append(directory);
+  out->append("\",\n    \"command\": \"");
+  AppendJSONString(EvaluateCommandWithRspfile(edge, mode), out);
+  out->append("\",\n    \"file\": \"");
+  AppendJSONString(edge->inputs_[0]->path(), out);
+  out->append("\",\n    \"output\": \"");
+  AppendJSONString(edge->outputs_[0]->path(), out);
+  out->append("\"\n  }");
+}
+
+}  // namespace
+
+void WriteCompdb(FILE* out, const string& directory,
+                 const vector<Edge*>& edges, EvaluateCommandMode mode,
+                 int threads) {
+  const size_t kChunkSize = 1024;
+  const size_t chunk_count = (edges.size() + kChunkSize - 1) / kChunkSize;
+  const string encoded_directory = EncodeJSONString(directory);
+  auto format = [&](size_t chunk, string* text) {
+    size_t end = min(edges.size(), (chunk + 1) * kChunkSize);
+    for (size_t i = chunk * kChunkSize; i < end; ++i) {
+      if (i != 0)
+        text->push_back(',');
+      AppendCompdbObject(encoded_directory, edges[i], mode, text);
+    }
+  };
+
+  fputc('[', out);
+  if (threads <= 1 || chunk_count <= 1) {
+    string text;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+      text.clear();
+      format(chunk, &text);
+      fwrite(text.data(), 1, text.size(), out);
+    }
+    fputs("\n]\n", out);
+    return;
+  }
+
+  // Workers take chunks in order, staying at most |window| chunks ahead of
+  // the one being written so that memory use does not grow with the
+  // output.
+  const size_t window = threads * 4;
+  vector<string> texts(chunk_count);
+  vector<bool> done(chunk_count);
+  size_t next = 0;
+  size_t written = 0;
+  mutex mu;
+  condition_variable cv;
+  auto work = [&]() {
+    for (;;) {
+      size_t chunk;
+      {
+        unique_lock<mutex> lock(mu);
+        while (next < chunk_count && next >= written + window)
+          WaitSlice(&cv, &lock);
+        if (next == chunk_count)
+          return;
+        chunk = next++;
+      }
+      string text;
+      format(chunk, &text);
+      {
+        lock_guard<mutex> lock(mu);
+        texts[chunk].swap(text);
+        done[chunk] = true;
+      }
+      cv.notify_all();
+    }
+  };
+  vector<thread> workers;
+  for (int i = 0; i < threads; ++i)
+    workers.push_back(thread(work));
+
+  string text;
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    {
+      unique_lock<mutex> lock(mu);
+      while (!done[chunk])
+        WaitSlice(&cv, &lock);
+      text.swap(texts[chunk]);
+      written = chunk + 1;
+    }
+    cv.notify_all();
+    fwrite(text.data(), 1, text.size(), out);
+    text.clear();
+    string().swap(texts[chunk]);
+  }
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+  fputs("\n]\n", out);
+}
@@ -0,0 +1,44 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_COMPDB_H_
+#define NINJA_COMPDB_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+struct Edge;
+
+enum EvaluateCommandMode {
+  ECM_NORMAL,
+  ECM_EXPAND_RSPFILE
+};
+
+/// The command of |edge|.  For ECM_EXPAND_RSPFILE, a reference to its
+/// response file (@file, -f file or --option-file=file) is replaced by the
+/// file's contents.
+std::string EvaluateCommandWithRspfile(const Edge* edge,
+                                       EvaluateCommandMode mode);
+
+/// Write the compilation database entries for |edges|, in order, to |out|
+/// as a JSON array (as "-t compdb" prints it).  Commands are evaluated and
+/// formatted in chunks on |threads| threads, a bounded number of chunks
+/// ahead of the one being written.
+void WriteCompdb(FILE* out, const std::string& directory,
+                 const std::vector<Edge*>& edges, EvaluateCommandMode mode,
+                 int threads);
+
+#endif  // NINJA_COMPDB_H_
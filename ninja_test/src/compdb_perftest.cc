@@ -0,0 +1,127 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times "ninja -t compdb-targets" over a synthetic manifest: compile edges
+// with a few hundred bytes of flags each, linked into one target per
+// directory, and a phony target depending on all of those.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "command_collector.h"
+#include "compdb.h"
+#include "graph.h"
+#include "manifest_parser.h"
+#include "metrics.h"
+#include "state.h"
+#include "util.h"
+
+using namespace std;
+
+namespace {
+
+const char kTestFilename[] = "CompdbPerfTest-tempfile";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int edges = 500000;
+  if (argc > 1)
+    edges = atoi(argv[1]);
+  if (edges <= 0) {
+    fprintf(stderr, "usage: compdb_perftest [edges]\n");
+    return 1;
+  }
+  const int kObjectsPerLink = 100;
+
+  string manifest =
+      "cflags = -O2 -g -fPIC -Wall -Wextra -Werror -std=c++17"
+      " -Iinclude -Ithird_party/include -Ibuild/gen -DNDEBUG"
+      " -DFEATURE_ONE=1 -DFEATURE_TWO=1 -fno-exceptions -fno-rtti\n"
+      "rule cxx\n"
+      "  command = c++ -MMD -MF $out.d $cflags -c $in -o $out\n"
+      "  depfile = $out.d\n"
+      "rule link\n"
+      "  command = c++ -shared -o $out @$out.rsp\n"
+      "  rspfile = $out.rsp\n"
+      "  rspfile_content = $in\n";
+  string all = "build all: phony";
+  char buf[256];
+  for (int i = 0; i < edges; i += kObjectsPerLink) {
+    string link;
+    snprintf(buf, sizeof(buf), "build lib/lib%d.so: link", i / kObjectsPerLink);
+    link = buf;
+    for (int j = i; j < min(edges, i + kObjectsPerLink); ++j) {
+      snprintf(buf, sizeof(buf),
+               "build obj/dir%d/file%d.o: cxx src/dir%d/file%d.cc\n",
+               i / kObjectsPerLink, j, i / kObjectsPerLink, j);
+      manifest += buf;
+      snprintf(buf, sizeof(buf), " obj/dir%d/file%d.o", i / kObjectsPerLink, j);
+      link += buf;
+    }
+    manifest += link + "\n";
+    snprintf(buf, sizeof(buf), " lib/lib%d.so", i / kObjectsPerLink);
+    all += buf;
+  }
+  manifest += all + "\n";
+
+  State state;
+  ManifestParser parser(&state, NULL);
+  string err;
+  int64_t start = GetTimeMillis();
+  if (!parser.ParseTest(manifest, &err)) {
+    fprintf(stderr, "%s\n", err.c_str());
+    return 1;
+  }
+  printf("parsed %d edges in %dms\n", (int)state.edges_.size(),
+         (int)(GetTimeMillis() - start));
+
+  start = GetTimeMillis();
+  CommandCollector collector;
+  collector.CollectFrom(state.LookupNode("all"));
+  vector<Edge*> collected;
+  for (Edge* edge : collector.in_edges) {
+    if (!edge->is_phony() && !edge->inputs_.empty())
+      collected.push_back(edge);
+  }
+  printf("collected %d edges in %dms\n", (int)collected.size(),
+         (int)(GetTimeMillis() - start));
+
+  // Also run the threaded path on a single processor, to see its overhead.
+  int thread_counts[] = { 1, max(2, GetProcessorCount()) };
+  for (int t = 0; t < 2; ++t) {
+    for (int mode = ECM_NORMAL; mode <= ECM_EXPAND_RSPFILE; ++mode) {
+      FILE* file = fopen(kTestFilename, "wb");
+      if (!file) {
+        perror(kTestFilename);
+        return 1;
+      }
+      start = GetTimeMillis();
+      WriteCompdb(file, "/work/dir", collected, EvaluateCommandMode(mode),
+                  thread_counts[t]);
+      long size = ftell(file);
+      fclose(file);
+      printf("%d thread(s)%s: wrote %ld bytes in %dms\n", thread_counts[t],
+             mode == ECM_EXPAND_RSPFILE ? ", -x" : "", size,
+             (int)(GetTimeMillis() - start));
+    }
+  }
+
+  platformAwareUnlink(kTestFilename);
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "compdb.h"
+
+#include "graph.h"
+#include "state.h"
+#include "test.h"
+
+using namespace std;
+
+namespace {
+
+struct CompdbTest : public StateTestWithBuiltinRules {
+  string Write(const vector<Edge*>& edges, EvaluateCommandMode mode,
+               int threads, const string& directory = "/dir") {
+    FILE* file = tmpfile();
+    EXPECT_TRUE(file != NULL);
+    WriteCompdb(file, directory, edges, mode, threads);
+    string text;
+    rewind(file);
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+      text.append(buf, len);
+    fclose(file);
+    return text;
+  }
+};
+
+TEST_F(CompdbTest, Format) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule rsp\n"
+"  command = link @$out.rsp\n"
+"  rspfile = $out.rsp\n"
+"  rspfile_content = $in\n"
+"build out1: cat in1\n"
+"build out2: rsp a b\n"));
+
+  EXPECT_EQ("[\n]\n", Write(vector<Edge*>(), ECM_NORMAL, 1));
+  EXPECT_EQ("[\n"
+            "  {\n"
+            "    \"directory\": \"/dir\",\n"
+            "    \"command\": \"cat in1 > out1\",\n"
+            "    \"file\": \"in1\",\n"
+            "    \"output\": \"out1\"\n"
+            "  },\n"
+            "  {\n"
+            "    \"directory\": \"/dir\",\n"
+            "    \"command\": \"link a b\",\n"
+            "    \"file\": \"a\",\n"
+            "    \"output\": \"out2\"\n"
+            "  }\n"
+            "]\n",
+            Write(state_.edges_, ECM_EXPAND_RSPFILE, 1));
+
+  vector<Edge*> edges(1, state_.edges_[0]);
+  EXPECT_EQ(0u, Write(edges, ECM_NORMAL, 1, "/d\"ir")
+                    .find("[\n  {\n    \"directory\": \"/d\\\"ir\",\n"));
+}
+
+TEST_F(CompdbTest, Threads) {
+  // Enough edges for several chunks, and more chunks than the workers may
+  // run ahead of the writer.
+  string manifest;
+  for (int i = 0; i < 50000; ++i) {
+    char line[64];
+    snprintf(line, sizeof(line), "build out%d: cat in%d\n", i, i);
+    manifest += line;
+  }
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_, manifest.c_str()));
+
+  string serial = Write(state_.edges_, ECM_NORMAL, 1);
+  EXPECT_NE(string::npos, serial.find("cat in49999 > out49999"));
+  EXPECT_EQ(serial, Write(state_.edges_, ECM_NORMAL, 3));
+}
+
+}  // namespace
@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "depfile_parser.h"
+#include "byte_scan.h"
 #include "util.h"
 
 #include <algorithm>
@@ -65,6 +66,17 @@ bool DepfileParser::Parse(string* content, string* err) {
     for (;;) {
       // start: beginning of the current parsed span.
       const char* start = in;
+      // Plain filename characters are the common case; copy them over a
+      // block at a time.  The state machine below handles everything else,
+      // and would treat this span the same way.
+      in = const_cast<char*>(byte_scan::SkipDepfilePlain(in, end));
+      if (in != start) {
+        int len = (int)(in - start);
+        if (out < start)
+          memmove(out, start, len);
+        out += len;
+        continue;
+      }
       char* yymarker = NULL;
       
     {
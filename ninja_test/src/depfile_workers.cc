@@ -0,0 +1,116 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "depfile_workers.h"
+
+#include "disk_interface.h"
+#include "wait_slice.h"
+
+using namespace std;
+
+DepfileWorkers::DepfileWorkers(int threads, DiskInterface* disk_interface,
+                               const DepfileParserOptions& options,
+                               const function<void()>& notify)
+    : disk_interface_(disk_interface), options_(options), notify_(notify),
+      pending_(0), quit_(false) {
+  for (int i = 0; i < threads; ++i)
+    threads_.push_back(thread(&DepfileWorkers::Run, this));
+}
+
+DepfileWorkers::~DepfileWorkers() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    quit_ = true;
+  }
+  queued_cv_.notify_all();
+  for (vector<thread>::iterator t = threads_.begin(); t != threads_.end(); ++t)
+    t->join();
+  for (deque<Job*>::iterator j = queued_.begin(); j != queued_.end(); ++j)
+    delete *j;
+  for (vector<Job*>::iterator j = finished_.begin(); j != finished_.end(); ++j)
+    delete *j;
+}
+
+void DepfileWorkers::Post(Job* job) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    queued_.push_back(job);
+    ++pending_;
+  }
+  queued_cv_.notify_one();
+}
+
+void DepfileWorkers::TakeFinished(vector<Job*>* jobs, bool wait) {
+  unique_lock<mutex> lock(mutex_);
+  if (wait) {
+    while (finished_.empty() && pending_ > 0)
+      WaitSlice(&finished_cv_, &lock);
+  }
+  jobs->insert(jobs->end(), finished_.begin(), finished_.end());
+  pending_ -= finished_.size();
+  finished_.clear();
+}
+
+size_t DepfileWorkers::pending() const {
+  lock_guard<mutex> lock(mutex_);
+  return pending_;
+}
+
+void DepfileWorkers::Run() {
+  for (;;) {
+    Job* job;
+    {
+      unique_lock<mutex> lock(mutex_);
+      while (queued_.empty() && !quit_)
+        WaitSlice(&queued_cv_, &lock);
+      if (quit_)
+        return;
+      job = queued_.front();
+      queued_.pop_front();
+    }
+
+    Process(job);
+
+    {
+      lock_guard<mutex> lock(mutex_);
+      finished_.push_back(job);
+    }
+    finished_cv_.notify_all();
+    if (notify_)
+      notify_();
+  }
+}
+
+void DepfileWorkers::Process(Job* job) {
+  // Read depfile content.  Treat a missing depfile as empty.
+  switch (disk_interface_->ReadFile(job->path, &job->content, &job->err)) {
+  case DiskInterface::Okay:
+    break;
+  case DiskInterface::NotFound:
+    job->err.clear();
+    break;
+  case DiskInterface::OtherError:
+    return;
+  }
+  if (!job->content.empty()) {
+    DepfileParser deps(options_);
+    if (!deps.Parse(&job->content, &job->err))
+      return;
+    job->ins.swap(deps.ins_);
+    job->slash_bits.resize(job->ins.size());
+    CanonicalizePaths(job->ins.data(), job->ins.size(),
+                      job->slash_bits.data());
+  }
+  job->ok = true;
+}
@@ -0,0 +1,90 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_DEPFILE_WORKERS_H_
+#define NINJA_DEPFILE_WORKERS_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "depfile_parser.h"
+#include "string_piece.h"
+#include "util.h"
+
+struct DiskInterface;
+
+/// Reads, parses and canonicalizes gcc-style depfiles on worker threads,
+/// so that large depfiles do not hold up the build loop.  Jobs only touch
+/// the file system through ReadFile(); everything that needs the State
+/// (looking up Nodes, writing the deps log) is left to the thread that
+/// collects the finished jobs.
+struct DepfileWorkers {
+  /// Callers may derive from Job to carry their own context.
+  struct Job {
+    Job() : ok(false) {}
+    virtual ~Job() {}
+
+    std::string path;
+
+    /// Set by the worker.  An empty or missing depfile yields no ins.
+    bool ok;
+    std::string err;
+    std::string content;
+    /// Canonical paths pointing into |content|, with their slash bits.
+    std::vector<StringPiece> ins;
+    std::vector<uint64_t> slash_bits;
+  };
+
+  /// |notify| is called from a worker thread after each job finishes.
+  DepfileWorkers(int threads, DiskInterface* disk_interface,
+                 const DepfileParserOptions& options,
+                 const std::function<void()>& notify);
+  /// Waits for running jobs; jobs not yet started are dropped.
+  ~DepfileWorkers();
+
+  /// Queue |job|; ownership passes to the workers until it is returned
+  /// by TakeFinished().
+  void Post(Job* job);
+
+  /// Append finished jobs to |jobs|.  If |wait|, block until there is at
+  /// least one, unless nothing is pending.
+  void TakeFinished(std::vector<Job*>* jobs, bool wait);
+
+  /// Jobs posted and not yet taken back.
+  size_t pending() const;
+
+ private:
+  void Run();
+  void Process(Job* job);
+
+  DiskInterface* disk_interface_;
+  DepfileParserOptions options_;
+  std::function<void()> notify_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queued_cv_;
+  std::condition_variable finished_cv_;
+  std::deque<Job*> queued_;
+  std::vector<Job*> finished_;
+  size_t pending_;
+  bool quit_;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // NINJA_DEPFILE_WORKERS_H_
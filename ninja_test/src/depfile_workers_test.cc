@@ -0,0 +1,145 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "depfile_workers.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <map>
+
+#include "disk_interface.h"
+#include "test.h"
+
+using namespace std;
+
+namespace {
+
+struct DepfileWorkersTest : public testing::Test {
+  virtual void SetUp() {
+    // The workers read through a RealDiskInterface, so use a temp dir.
+    temp_dir_.CreateAndEnter("Ninja-DepfileWorkersTest");
+  }
+
+  virtual void TearDown() {
+    temp_dir_.Cleanup();
+  }
+
+  void Write(const string& path, const string& content) {
+    ASSERT_TRUE(disk_.WriteFile(path, content));
+  }
+
+  /// Run |paths| through |threads| workers and return the jobs in order.
+  void RunJobs(int threads, const vector<string>& paths,
+               vector<DepfileWorkers::Job*>* jobs) {
+    std::atomic<int> notified(0);
+    {
+      DepfileWorkers workers(threads, &disk_, DepfileParserOptions(),
+                             [&notified]() { ++notified; });
+      for (size_t i = 0; i < paths.size(); ++i) {
+        DepfileWorkers::Job* job = new DepfileWorkers::Job;
+        job->path = paths[i];
+        workers.Post(job);
+      }
+      while (workers.pending() > 0)
+        workers.TakeFinished(jobs, true);
+    }
+    // The last notifications may come after the jobs were taken.
+    EXPECT_EQ(static_cast<int>(paths.size()), notified.load());
+
+    std::map<string, DepfileWorkers::Job*> by_path;
+    for (size_t i = 0; i < jobs->size(); ++i)
+      by_path[(*jobs)[i]->path] = (*jobs)[i];
+    jobs->clear();
+    for (size_t i = 0; i < paths.size(); ++i)
+      jobs->push_back(by_path[paths[i]]);
+  }
+
+  ScopedTempDir temp_dir_;
+  RealDiskInterface disk_;
+};
+
+TEST_F(DepfileWorkersTest, Basic) {
+  Write("a.d", "a.o: ./a.c foo/../b.h \\\n  c.h\n");
+  Write("empty.d", "");
+  Write("bad.d", "AAA BBB");
+
+  vector<string> paths;
+  paths.push_back("a.d");
+  paths.push_back("empty.d");
+  paths.push_back("missing.d");
+  paths.push_back("bad.d");
+  vector<DepfileWorkers::Job*> jobs;
+  RunJobs(2, paths, &jobs);
+  ASSERT_EQ(4u, jobs.size());
+
+  EXPECT_TRUE(jobs[0]->ok);
+  ASSERT_EQ(3u, jobs[0]->ins.size());
+  EXPECT_EQ("a.c", jobs[0]->ins[0].AsString());
+  EXPECT_EQ("b.h", jobs[0]->ins[1].AsString());
+  EXPECT_EQ("c.h", jobs[0]->ins[2].AsString());
+  ASSERT_EQ(3u, jobs[0]->slash_bits.size());
+
+  // Empty and missing depfiles have no deps.
+  EXPECT_TRUE(jobs[1]->ok);
+  EXPECT_TRUE(jobs[1]->ins.empty());
+  EXPECT_TRUE(jobs[2]->ok);
+  EXPECT_EQ("", jobs[2]->err);
+  EXPECT_TRUE(jobs[2]->ins.empty());
+
+  EXPECT_FALSE(jobs[3]->ok);
+  EXPECT_NE("", jobs[3]->err);
+
+  // The workers leave the depfiles alone.
+  string err;
+  EXPECT_GT(disk_.Stat("a.d", &err), 0);
+
+  for (size_t i = 0; i < jobs.size(); ++i)
+    delete jobs[i];
+}
+
+TEST_F(DepfileWorkersTest, ManyJobs) {
+  vector<string> paths;
+  for (int i = 0; i < 200; ++i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d.d", i);
+    paths.push_back(buf);
+    ASSERT_NO_FATAL_FAILURE(
+        Write(buf, string(buf) + ".o: " + buf + ".c common.h\n"));
+  }
+  vector<DepfileWorkers::Job*> jobs;
+  RunJobs(4, paths, &jobs);
+  ASSERT_EQ(paths.size(), jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    ASSERT_TRUE(jobs[i]);
+    EXPECT_TRUE(jobs[i]->ok);
+    ASSERT_EQ(2u, jobs[i]->ins.size());
+    EXPECT_EQ(paths[i] + ".c", jobs[i]->ins[0].AsString());
+    delete jobs[i];
+  }
+}
+
+/// Jobs still queued when the workers go away are deleted with them.
+TEST_F(DepfileWorkersTest, DestroyWithPendingJobs) {
+  Write("a.d", "a.o: a.c\n");
+  DepfileWorkers workers(1, &disk_, DepfileParserOptions(),
+                         std::function<void()>());
+  for (int i = 0; i < 50; ++i) {
+    DepfileWorkers::Job* job = new DepfileWorkers::Job;
+    job->path = "a.d";
+    workers.Post(job);
+  }
+}
+
+}  // namespace
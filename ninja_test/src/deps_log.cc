@@ -46,6 +46,8 @@ static constexpr size_t kMaxRecordSize = (1 << 19) - 1;
 
 DepsLog::~DepsLog() {
   Close();
+  for (vector<Deps*>::iterator i = deps_.begin(); i != deps_.end(); ++i)
+    delete *i;
 }
 
 bool DepsLog::OpenForWrite(const string& path, string* err) {
@@ -54,7 +56,7 @@ bool DepsLog::OpenForWrite(const string& path, string* err) {
       return false;
   }
 
-  assert(!file_);
+  assert(!file_.is_open());
   file_path_ = path;  // we don't actually open the file right now, but will do
                       // so on the first write attempt
   return true;
@@ -116,23 +118,15 @@ bool DepsLog::RecordDeps(Node* node, TimeStamp mtime, int node_count,
     return false;
   }
   size |= 0x80000000;  // Deps record: set high bit.
-  if (fwrite(&size, 4, 1, file_) < 1)
-    return false;
-  int id = node->id();
-  if (fwrite(&id, 4, 1, file_) < 1)
-    return false;
-  uint32_t mtime_part = static_cast<uint32_t>(mtime & 0xffffffff);
-  if (fwrite(&mtime_part, 4, 1, file_) < 1)
-    return false;
-  mtime_part = static_cast<uint32_t>((mtime >> 32) & 0xffffffff);
-  if (fwrite(&mtime_part, 4, 1, file_) < 1)
-    return false;
-  for (int i = 0; i < node_count; ++i) {
-    id = nodes[i]->id();
-    if (fwrite(&id, 4, 1, file_) < 1)
-      return false;
-  }
-  if (fflush(file_) != 0)
+  vector<uint32_t> record;
+  record.reserve(4 + node_count);
+  record.push_back(size);
+  record.push_back(static_cast<uint32_t>(node->id()));
+  record.push_back(static_cast<uint32_t>(mtime & 0xffffffff));
+  record.push_back(static_cast<uint32_t>((mtime >> 32) & 0xffffffff));
+  for (int i = 0; i < node_count; ++i)
+    record.push_back(static_cast<uint32_t>(nodes[i]->id()));
+  if (!file_.Append(record.data(), record.size() * 4))
     return false;
 
   // Update in-memory representation.
@@ -146,12 +140,11 @@ bool DepsLog::RecordDeps(Node* node, TimeStamp mtime, int node_count,
 
 void DepsLog::Close() {
   OpenForWriteIfNeeded();  // create the file even if nothing has been recorded
-  if (file_)
-    fclose(file_);
-  file_ = NULL;
+  file_.Close();
 }
 
-LoadStatus DepsLog::Load(const string& path, State* state, string* err) {
+LoadStatus DepsLog::Load(const string& path, State* state, string* err,
+                          bool read_only) {
   METRIC_RECORD(".ninja_deps load");
   char buf[kMaxRecordSize + 1];
   FILE* f = fopen(path.c_str(), "rb");
@@ -179,7 +172,8 @@ LoadStatus DepsLog::Load(const string& path, State* state, string* err) {
     else
       *err = "bad deps log signature or version; starting over";
     fclose(f);
-    platformAwareUnlink(path.c_str());
+    if (!read_only)
+      platformAwareUnlink(path.c_str());
     // Don't report this as a failure.  An empty deps log will cause
     // us to rebuild the outputs anyway.
     return LOAD_SUCCESS;
@@ -280,6 +274,10 @@ LoadStatus DepsLog::Load(const string& path, State* state, string* err) {
     }
     fclose(f);
 
+    // A torn final record may just be one that is still being written.
+    if (read_only)
+      return LOAD_SUCCESS;
+
     if (!Truncate(path, offset, err))
       return LOAD_ERROR;
 
@@ -411,18 +409,15 @@ bool DepsLog::RecordId(Node* node) {
   if (!OpenForWriteIfNeeded()) {
     return false;
   }
-  if (fwrite(&size, 4, 1, file_) < 1)
-    return false;
-  if (fwrite(node->path().data(), path_size, 1, file_) < 1) {
-    return false;
-  }
-  if (padding && fwrite("\0\0", padding, 1, file_) < 1)
-    return false;
   int id = nodes_.size();
   unsigned checksum = ~(unsigned)id;
-  if (fwrite(&checksum, 4, 1, file_) < 1)
-    return false;
-  if (fflush(file_) != 0)
+  string record;
+  record.reserve(4 + size);
+  record.append(reinterpret_cast<const char*>(&size), 4);
+  record.append(node->path().str_, node->path().len_);
+  record.append(padding, '\0');
+  record.append(reinterpret_cast<const char*>(&checksum), 4);
+  if (!file_.Append(record.data(), record.size()))
     return false;
 
   node->set_id(id);
@@ -435,32 +430,34 @@ bool DepsLog::OpenForWriteIfNeeded() {
   if (file_path_.empty()) {
     return true;
   }
-  file_ = fopen(file_path_.c_str(), "ab");
-  if (!file_) {
+  FILE* f = fopen(file_path_.c_str(), "ab");
+  if (!f) {
     return false;
   }
   // Set the buffer size to this and flush the file buffer after every record
   // to make sure records aren't written partially.
-  if (setvbuf(file_, NULL, _IOFBF, kMaxRecordSize + 1) != 0) {
+  if (setvbuf(f, NULL, _IOFBF, kMaxRecordSize + 1) != 0) {
+    fclose(f);
     return false;
   }
-  SetCloseOnExec(fileno(file_));
+  SetCloseOnExec(fileno(f));
 
   // Opening a file in append mode doesn't set the file pointer to the file's
   // end on Windows. Do that explicitly.
-  fseek(file_, 0, SEEK_END);
+  fseek(f, 0, SEEK_END);
 
-  if (ftell(file_) == 0) {
-    if (fwrite(kFileSignature, sizeof(kFileSignature) - 1, 1, file_) < 1) {
-      return false;
-    }
-    if (fwrite(&kCurrentVersion, 4, 1, file_) < 1) {
+  if (ftell(f) == 0) {
+    if (fwrite(kFileSignature, sizeof(kFileSignature) - 1, 1, f) < 1 ||
+        fwrite(&kCurrentVersion, 4, 1, f) < 1) {
+      fclose(f);
       return false;
     }
   }
-  if (fflush(file_) != 0) {
+  if (fflush(f) != 0) {
+    fclose(f);
     return false;
   }
+  file_.Open(f);
   file_path_.clear();
   return true;
 }
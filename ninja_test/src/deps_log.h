@@ -21,6 +21,7 @@
 #include <stdio.h>
 
 #include "load_status.h"
+#include "log_writer.h"
 #include "timestamp.h"
 
 struct Node;
@@ -66,7 +67,7 @@ struct State;
 /// wins, allowing updates to just be appended to the file.  A separate
 /// repacking step can run occasionally to remove dead records.
 struct DepsLog {
-  DepsLog() : needs_recompaction_(false), file_(NULL) {}
+  DepsLog() : needs_recompaction_(false) {}
   ~DepsLog();
 
   // Writing (build-time) interface.
@@ -76,6 +77,14 @@ struct DepsLog {
                   Node* const* nodes);
   void Close();
 
+  /// How records reach the disk; see LogWriter.  Set before writing.
+  void set_durability(LogWriter::Durability durability) {
+    file_.set_durability(durability);
+  }
+  /// Wait for the records still on their way to the disk.  When false is
+  /// returned, errno will be set.
+  bool Flush() { return file_.Flush(); }
+
   // Reading (startup-time) interface.
   struct Deps {
     Deps(int64_t mtime, int node_count)
@@ -85,7 +94,12 @@ struct DepsLog {
     int node_count;
     Node** nodes;
   };
-  LoadStatus Load(const std::string& path, State* state, std::string* err);
+  /// Load the log.  A damaged log is normally repaired on disk: truncated
+  /// to its last complete record, or removed if its header is bad.  With
+  /// |read_only|, loading stops at the last complete record and the file
+  /// is left as it is, for readers of a log another process may be writing.
+  LoadStatus Load(const std::string& path, State* state, std::string* err,
+                  bool read_only = false);
   Deps* GetDeps(Node* node);
   Node* GetFirstReverseDepsNode(Node* node);
 
@@ -116,7 +130,7 @@ struct DepsLog {
   bool OpenForWriteIfNeeded();
 
   bool needs_recompaction_;
-  FILE* file_;
+  LogWriter file_;
   std::string file_path_;
 
   /// Maps id -> Node.
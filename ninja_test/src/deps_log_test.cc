@@ -60,8 +60,8 @@ TEST_F(DepsLogTest, WriteRead) {
     ASSERT_TRUE(log_deps);
     ASSERT_EQ(1, log_deps->mtime);
     ASSERT_EQ(2, log_deps->node_count);
-    ASSERT_EQ("foo.h", log_deps->nodes[0]->path());
-    ASSERT_EQ("bar.h", log_deps->nodes[1]->path());
+    ASSERT_EQ("foo.h", log_deps->nodes[0]->path().AsString());
+    ASSERT_EQ("bar.h", log_deps->nodes[1]->path().AsString());
   }
 
   log1.Close();
@@ -84,8 +84,42 @@ TEST_F(DepsLogTest, WriteRead) {
   ASSERT_TRUE(log_deps);
   ASSERT_EQ(2, log_deps->mtime);
   ASSERT_EQ(2, log_deps->node_count);
-  ASSERT_EQ("foo.h", log_deps->nodes[0]->path());
-  ASSERT_EQ("bar2.h", log_deps->nodes[1]->path());
+  ASSERT_EQ("foo.h", log_deps->nodes[0]->path().AsString());
+  ASSERT_EQ("bar2.h", log_deps->nodes[1]->path().AsString());
+}
+
+TEST_F(DepsLogTest, WriteReadBatched) {
+  State state1;
+  DepsLog log1;
+  string err;
+  log1.set_durability(LogWriter::kBatchSync);
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  for (int i = 0; i < 100; ++i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "out%d.o", i);
+    vector<Node*> deps;
+    deps.push_back(state1.GetNode("foo.h", 0));
+    snprintf(buf, sizeof(buf), "bar%d.h", i);
+    deps.push_back(state1.GetNode(buf, 0));
+    snprintf(buf, sizeof(buf), "out%d.o", i);
+    EXPECT_TRUE(log1.RecordDeps(state1.GetNode(buf, 0), i + 1, deps));
+  }
+  EXPECT_TRUE(log1.Flush());
+
+  // Everything recorded so far is on disk before the log is closed.
+  State state2;
+  DepsLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &state2, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(log1.nodes().size(), log2.nodes().size());
+  DepsLog::Deps* log_deps = log2.GetDeps(state2.GetNode("out99.o", 0));
+  ASSERT_TRUE(log_deps);
+  EXPECT_EQ(100, log_deps->mtime);
+  ASSERT_EQ(2, log_deps->node_count);
+  EXPECT_EQ("bar99.h", log_deps->nodes[1]->path().AsString());
+  log1.Close();
 }
 
 TEST_F(DepsLogTest, LotsOfDeps) {
@@ -260,15 +294,15 @@ TEST_F(DepsLogTest, Recompact) {
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(1, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
 
     Node* other_out = state.GetNode("other_out.o", 0);
     deps = log.GetDeps(other_out);
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(2, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
-    ASSERT_EQ("baz.h", deps->nodes[1]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
+    ASSERT_EQ("baz.h", deps->nodes[1]->path().AsString());
 
     ASSERT_TRUE(log.Recompact(kTestFilename, &err));
 
@@ -277,15 +311,15 @@ TEST_F(DepsLogTest, Recompact) {
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(1, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
     ASSERT_EQ(out, log.nodes()[out->id()]);
 
     deps = log.GetDeps(other_out);
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(2, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
-    ASSERT_EQ("baz.h", deps->nodes[1]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
+    ASSERT_EQ("baz.h", deps->nodes[1]->path().AsString());
     ASSERT_EQ(other_out, log.nodes()[other_out->id()]);
 
     // The file should have shrunk a bit for the smaller deps.
@@ -314,15 +348,15 @@ TEST_F(DepsLogTest, Recompact) {
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(1, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
 
     Node* other_out = state.GetNode("other_out.o", 0);
     deps = log.GetDeps(other_out);
     ASSERT_TRUE(deps);
     ASSERT_EQ(1, deps->mtime);
     ASSERT_EQ(2, deps->node_count);
-    ASSERT_EQ("foo.h", deps->nodes[0]->path());
-    ASSERT_EQ("baz.h", deps->nodes[1]->path());
+    ASSERT_EQ("foo.h", deps->nodes[0]->path().AsString());
+    ASSERT_EQ("baz.h", deps->nodes[1]->path().AsString());
 
     ASSERT_TRUE(log.Recompact(kTestFilename, &err));
 
@@ -514,6 +548,59 @@ TEST_F(DepsLogTest, TruncatedRecovery) {
   }
 }
 
+TEST_F(DepsLogTest, TruncatedReadOnly) {
+  // Create a file with some entries.
+  {
+    State state;
+    DepsLog log;
+    string err;
+    EXPECT_TRUE(log.OpenForWrite(kTestFilename, &err));
+    ASSERT_EQ("", err);
+
+    vector<Node*> deps;
+    deps.push_back(state.GetNode("foo.h", 0));
+    deps.push_back(state.GetNode("bar.h", 0));
+    log.RecordDeps(state.GetNode("out.o", 0), 1, deps);
+
+    deps.clear();
+    deps.push_back(state.GetNode("foo.h", 0));
+    deps.push_back(state.GetNode("bar2.h", 0));
+    log.RecordDeps(state.GetNode("out2.o", 0), 2, deps);
+
+    log.Close();
+  }
+
+  // Tear the last record, as if a writer were still appending it.
+#ifdef __USE_LARGEFILE64
+  struct stat64 st;
+  ASSERT_EQ(0, stat64(kTestFilename, &st));
+#else
+  struct stat st;
+  ASSERT_EQ(0, stat(kTestFilename, &st));
+#endif
+  off_t torn_size = st.st_size - 2;
+  {
+    string err;
+    ASSERT_TRUE(Truncate(kTestFilename, torn_size, &err));
+  }
+
+  // A read-only load keeps the complete records and leaves the file alone.
+  {
+    State state;
+    DepsLog log;
+    string err;
+    EXPECT_EQ(LOAD_SUCCESS, log.Load(kTestFilename, &state, &err, true));
+    EXPECT_TRUE(log.GetDeps(state.GetNode("out.o", 0)));
+    EXPECT_EQ(NULL, log.GetDeps(state.GetNode("out2.o", 0)));
+  }
+#ifdef __USE_LARGEFILE64
+  ASSERT_EQ(0, stat64(kTestFilename, &st));
+#else
+  ASSERT_EQ(0, stat(kTestFilename, &st));
+#endif
+  EXPECT_EQ(torn_size, st.st_size);
+}
+
 TEST_F(DepsLogTest, ReverseDepsNodes) {
   State state;
   DepsLog log;
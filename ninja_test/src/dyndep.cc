@@ -46,7 +46,7 @@ bool DyndepLoader::LoadDyndeps(Node* node, DyndepFile* ddf,
 
   // Load the dyndep information from the file.
   // 用 explanations_ 记录一条消息，比如“正在加载文件 xxx”，方便调试
-  explanations_.Record(node, "loading dyndep file '%s'", node->path().c_str());
+  explanations_.Record(node, "loading dyndep file '%s'", node->path().str_);
 
   // 调用 LoadDyndepFile 方法，把文件内容加载到 ddf 里。如果失败，就返回 false，并设置错误消息
   if (!LoadDyndepFile(node, ddf, err))
@@ -65,9 +65,9 @@ bool DyndepLoader::LoadDyndeps(Node* node, DyndepFile* ddf,
     /// TODO: 要看一下怎么找的
     DyndepFile::iterator ddi = ddf->find(edge);
     if (ddi == ddf->end()) {
-      *err = ("'" + edge->outputs_[0]->path() + "' "
+      *err = ("'" + edge->outputs_[0]->path().AsString() + "' "
               "not mentioned in its dyndep file "
-              "'" + node->path() + "'");
+              "'" + node->path().AsString() + "'");
       return false;
     }
 
@@ -101,9 +101,9 @@ bool DyndepLoader::LoadDyndeps(Node* node, DyndepFile* ddf,
   for (const auto& dyndep_output : *ddf) {
     if (!dyndep_output.second.used_) {
       Edge* const edge = dyndep_output.first;
-      *err = ("dyndep file '" + node->path() + "' mentions output "
-              "'" + edge->outputs_[0]->path() + "' whose build statement "
-              "does not have a dyndep binding for the file");
+      *err = ("dyndep file '" + node->path().AsString() + "' mentions output "
+              "'" + edge->outputs_[0]->path().AsString() + "' whose build "
+              "statement does not have a dyndep binding for the file");
       return false;
     }
   }
@@ -140,6 +140,8 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
 // 重新检查文件状态是为了让 Ninja 更聪明，避免被“假更新”（只有时间变，内容没变）误导，节省构建时间。
   if (dyndeps->restat_)
     edge->env_->AddBinding("restat", "1");
+  // The new binding may appear in the command.
+  edge->ClearCommandHash();
 
   // Add the dyndep-discovered outputs to the edge.
   // 添加额外的输出文件
@@ -159,7 +161,7 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
   for (Node* node : dyndeps->implicit_outputs_) {
     if (node->in_edge()) {
       // This node already has an edge producing it.
-      *err = "multiple rules generate " + node->path();
+      *err = "multiple rules generate " + node->path().AsString();
       return false;
     }
     node->set_in_edge(edge);
@@ -190,5 +192,5 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
 bool DyndepLoader::LoadDyndepFile(Node* file, DyndepFile* ddf,
                                   std::string* err) const {
   DyndepParser parser(state_, disk_interface_, ddf);
-  return parser.Load(file->path(), err);
+  return parser.Load(file->path().AsString(), err);
 }
@@ -391,7 +391,7 @@ TEST_F(DyndepParserTest, ImplicitIn) {
   EXPECT_EQ(false, i->second.restat_);
   EXPECT_EQ(0u, i->second.implicit_outputs_.size());
   ASSERT_EQ(1u, i->second.implicit_inputs_.size());
-  EXPECT_EQ("impin", i->second.implicit_inputs_[0]->path());
+  EXPECT_EQ("impin", i->second.implicit_inputs_[0]->path().AsString());
 }
 
 TEST_F(DyndepParserTest, ImplicitIns) {
@@ -405,8 +405,8 @@ TEST_F(DyndepParserTest, ImplicitIns) {
   EXPECT_EQ(false, i->second.restat_);
   EXPECT_EQ(0u, i->second.implicit_outputs_.size());
   ASSERT_EQ(2u, i->second.implicit_inputs_.size());
-  EXPECT_EQ("impin1", i->second.implicit_inputs_[0]->path());
-  EXPECT_EQ("impin2", i->second.implicit_inputs_[1]->path());
+  EXPECT_EQ("impin1", i->second.implicit_inputs_[0]->path().AsString());
+  EXPECT_EQ("impin2", i->second.implicit_inputs_[1]->path().AsString());
 }
 
 TEST_F(DyndepParserTest, ImplicitOut) {
@@ -419,7 +419,7 @@ TEST_F(DyndepParserTest, ImplicitOut) {
   ASSERT_NE(i, dyndep_file_.end());
   EXPECT_EQ(false, i->second.restat_);
   ASSERT_EQ(1u, i->second.implicit_outputs_.size());
-  EXPECT_EQ("impout", i->second.implicit_outputs_[0]->path());
+  EXPECT_EQ("impout", i->second.implicit_outputs_[0]->path().AsString());
   EXPECT_EQ(0u, i->second.implicit_inputs_.size());
 }
 
@@ -433,8 +433,8 @@ TEST_F(DyndepParserTest, ImplicitOuts) {
   ASSERT_NE(i, dyndep_file_.end());
   EXPECT_EQ(false, i->second.restat_);
   ASSERT_EQ(2u, i->second.implicit_outputs_.size());
-  EXPECT_EQ("impout1", i->second.implicit_outputs_[0]->path());
-  EXPECT_EQ("impout2", i->second.implicit_outputs_[1]->path());
+  EXPECT_EQ("impout1", i->second.implicit_outputs_[0]->path().AsString());
+  EXPECT_EQ("impout2", i->second.implicit_outputs_[1]->path().AsString());
   EXPECT_EQ(0u, i->second.implicit_inputs_.size());
 }
 
@@ -448,11 +448,11 @@ TEST_F(DyndepParserTest, ImplicitInsAndOuts) {
   ASSERT_NE(i, dyndep_file_.end());
   EXPECT_EQ(false, i->second.restat_);
   ASSERT_EQ(2u, i->second.implicit_outputs_.size());
-  EXPECT_EQ("impout1", i->second.implicit_outputs_[0]->path());
-  EXPECT_EQ("impout2", i->second.implicit_outputs_[1]->path());
+  EXPECT_EQ("impout1", i->second.implicit_outputs_[0]->path().AsString());
+  EXPECT_EQ("impout2", i->second.implicit_outputs_[1]->path().AsString());
   ASSERT_EQ(2u, i->second.implicit_inputs_.size());
-  EXPECT_EQ("impin1", i->second.implicit_inputs_[0]->path());
-  EXPECT_EQ("impin2", i->second.implicit_inputs_[1]->path());
+  EXPECT_EQ("impin1", i->second.implicit_inputs_[0]->path().AsString());
+  EXPECT_EQ("impin2", i->second.implicit_inputs_[1]->path().AsString());
 }
 
 TEST_F(DyndepParserTest, Restat) {
@@ -487,7 +487,7 @@ TEST_F(DyndepParserTest, MultipleEdges) {
 "build out2: touch\n");
   ASSERT_EQ(2u, state_.edges_.size());
   ASSERT_EQ(1u, state_.edges_[1]->outputs_.size());
-  EXPECT_EQ("out2", state_.edges_[1]->outputs_[0]->path());
+  EXPECT_EQ("out2", state_.edges_[1]->outputs_[0]->path().AsString());
   EXPECT_EQ(0u, state_.edges_[0]->inputs_.size());
 
   ASSERT_NO_FATAL_FAILURE(AssertParse(
@@ -16,6 +16,8 @@
 
 #include "eval_env.h"
 
+#include "arena.h"
+
 using namespace std;
 
 string BindingEnv::LookupVariable(const string& var) {
@@ -31,6 +33,10 @@ void BindingEnv::AddBinding(const string& key, const string& val) {
   bindings_[key] = val;
 }
 
+void BindingEnv::RemoveBinding(const string& key) {
+  bindings_.erase(key);
+}
+
 void BindingEnv::AddRule(std::unique_ptr<const Rule> rule) {
   assert(LookupRuleCurrentScope(rule->name()) == NULL);
   rules_[rule->name()] = std::move(rule);
@@ -54,6 +60,8 @@ const Rule* BindingEnv::LookupRule(const string& rule_name) {
 
 void Rule::AddBinding(const string& key, const EvalString& val) {
   bindings_[key] = val;
+  if (key == "command")
+    command_template_.reset(new EvalTemplate(val));
 }
 
 const EvalString* Rule::GetBinding(const string& key) const {
@@ -110,28 +118,45 @@ string BindingEnv::LookupWithFallback(const string& var,
 }
 
 string EvalString::Evaluate(Env* env) const {
+  string result;
+  EvaluateInto(env, &result);
+  return result;
+}
+
+void EvalString::EvaluateInto(Env* env, string* result) const {
   if (parsed_.empty()) {
-    return single_token_;
+    result->assign(single_token_.str_, single_token_.len_);
+    return;
   }
 
-  string result;
+  result->clear();
   for (TokenList::const_iterator i = parsed_.begin(); i != parsed_.end(); ++i) {
     if (i->second == RAW)
-      result.append(i->first);
+      result->append(i->first.str_, i->first.len_);
     else
-      result.append(env->LookupVariable(i->first));
+      result->append(env->LookupVariable(i->first.AsString()));
   }
-  return result;
 }
 
 void EvalString::AddText(StringPiece text) {
-  if (parsed_.empty()) {
-    single_token_.append(text.begin(), text.end());
-  } else if (!parsed_.empty() && parsed_.back().second == RAW) {
-    parsed_.back().first.append(text.begin(), text.end());
-  } else {
-    parsed_.push_back(std::make_pair(text.AsString(), RAW));
+  // Adjacent pieces of the same buffer, as the lexer produces for text
+  // around an escape, are merged; anything else becomes its own token.
+  StringPiece* last = NULL;
+  if (parsed_.empty() && single_token_.empty()) {
+    single_token_ = text;
+    return;
+  }
+  if (parsed_.empty())
+    last = &single_token_;
+  else if (parsed_.back().second == RAW)
+    last = &parsed_.back().first;
+  if (last && last->str_ + last->len_ == text.str_) {
+    last->len_ += text.len_;
+    return;
   }
+  if (parsed_.empty())
+    parsed_.push_back(std::make_pair(single_token_, RAW));
+  parsed_.push_back(std::make_pair(text, RAW));
 }
 
 void EvalString::AddSpecial(StringPiece text) {
@@ -139,24 +164,64 @@ void EvalString::AddSpecial(StringPiece text) {
     // Going from one to two tokens, so we can no longer apply
     // our single_token_ optimization and need to push everything
     // onto the vector.
-    parsed_.push_back(std::make_pair(std::move(single_token_), RAW));
+    parsed_.push_back(std::make_pair(single_token_, RAW));
+  }
+  parsed_.push_back(std::make_pair(text, SPECIAL));
+}
+
+void EvalString::Persist(Arena* arena) {
+  single_token_ = arena->Copy(single_token_);
+  for (TokenList::iterator i = parsed_.begin(); i != parsed_.end(); ++i)
+    i->first = arena->Copy(i->first);
+}
+
+EvalTemplate::EvalTemplate(const EvalString& str) {
+  if (str.parsed_.empty()) {
+    if (!str.single_token_.empty()) {
+      Piece piece = { kText, str.single_token_ };
+      pieces_.push_back(piece);
+      text_size_ = str.single_token_.size();
+    }
+    return;
+  }
+  pieces_.reserve(str.parsed_.size());
+  for (EvalString::TokenList::const_iterator i = str.parsed_.begin();
+       i != str.parsed_.end(); ++i) {
+    Piece piece = { kText, i->first };
+    if (i->second == EvalString::RAW)
+      text_size_ += i->first.size();
+    else if (i->first == "in")
+      piece.slot = kIn;
+    else if (i->first == "in_newline")
+      piece.slot = kInNewline;
+    else if (i->first == "out")
+      piece.slot = kOut;
+    else
+      piece.slot = kVariable;
+    pieces_.push_back(piece);
   }
-  parsed_.push_back(std::make_pair(text.AsString(), SPECIAL));
 }
 
 string EvalString::Serialize() const {
   string result;
   if (parsed_.empty() && !single_token_.empty()) {
     result.append("[");
-    result.append(single_token_);
+    result.append(single_token_.str_, single_token_.len_);
     result.append("]");
   } else {
+    // Consecutive RAW tokens read as one.
+    TokenType last_type = SPECIAL;
     for (const auto& pair : parsed_) {
-      result.append("[");
-      if (pair.second == SPECIAL)
-        result.append("$");
+      if (pair.second == RAW && last_type == RAW) {
+        result.resize(result.size() - 1);
+      } else {
+        result.append("[");
+        if (pair.second == SPECIAL)
+          result.append("$");
+      }
       result.append(pair.first.begin(), pair.first.end());
       result.append("]");
+      last_type = pair.second;
     }
   }
   return result;
@@ -165,7 +230,7 @@ string EvalString::Serialize() const {
 string EvalString::Unparse() const {
   string result;
   if (parsed_.empty() && !single_token_.empty()) {
-    result.append(single_token_.begin(), single_token_.end());
+    result.append(single_token_.str_, single_token_.len_);
   } else {
     for (TokenList::const_iterator i = parsed_.begin();
          i != parsed_.end(); ++i) {
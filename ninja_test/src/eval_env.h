@@ -22,6 +22,7 @@
 
 #include "string_piece.h"
 
+struct Arena;
 struct Rule;
 
 /// An interface for a scope for variable (e.g. "$foo") lookups.
@@ -32,34 +33,69 @@ struct Env {
 
 /// A tokenized string that contains variable references.
 /// Can be evaluated relative to an Env.
+/// The tokens refer to text owned elsewhere, usually the manifest being
+/// parsed; call Persist() to keep an EvalString beyond that text's lifetime.
 struct EvalString {
   /// @return The evaluated string with variable expanded using value found in
   ///         environment @a env.
   std::string Evaluate(Env* env) const;
 
+  /// Like Evaluate(), but reuses the storage of |result|.
+  void EvaluateInto(Env* env, std::string* result) const;
+
   /// @return The string with variables not expanded.
   std::string Unparse() const;
 
-  void Clear() { parsed_.clear(); single_token_.clear(); }
+  void Clear() { parsed_.clear(); single_token_ = StringPiece(); }
   bool empty() const { return parsed_.empty() && single_token_.empty(); }
 
+  /// Append a token.  |text| is not copied and must outlive the EvalString
+  /// or a call to Persist().
   void AddText(StringPiece text);
   void AddSpecial(StringPiece text);
 
+  /// Copy the text of all tokens into |arena|.
+  void Persist(Arena* arena);
+
   /// Construct a human-readable representation of the parsed state,
   /// for use in tests.
   std::string Serialize() const;
 
 private:
+  friend struct EvalTemplate;
+
   enum TokenType { RAW, SPECIAL };
-  typedef std::vector<std::pair<std::string, TokenType> > TokenList;
+  typedef std::vector<std::pair<StringPiece, TokenType> > TokenList;
   TokenList parsed_;
 
   // If we hold only a single RAW token, then we keep it here instead of
   // pushing it on TokenList. This saves a bunch of allocations for
   // what is a common case. If parsed_ is nonempty, then this value
   // must be ignored.
-  std::string single_token_;
+  StringPiece single_token_;
+};
+
+/// An EvalString prepared for evaluation in many edges.  References to $in,
+/// $in_newline and $out are resolved to slots up front, so evaluating them
+/// needs no variable lookup.  Like the EvalString it is built from, the
+/// template borrows its text.
+struct EvalTemplate {
+  enum Slot { kText, kIn, kInNewline, kOut, kVariable };
+  struct Piece {
+    Slot slot;
+    /// The text for kText, the variable name for kVariable.
+    StringPiece text;
+  };
+
+  explicit EvalTemplate(const EvalString& str);
+
+  const std::vector<Piece>& pieces() const { return pieces_; }
+  /// Total length of the kText pieces.
+  size_t text_size() const { return text_size_; }
+
+ private:
+  std::vector<Piece> pieces_;
+  size_t text_size_ = 0;
 };
 
 /// An invocable build command and associated metadata (description, etc.).
@@ -78,6 +114,11 @@ struct Rule {
 
   const EvalString* GetBinding(const std::string& key) const;
 
+  /// The "command" binding in compiled form, or NULL if there is none.
+  const EvalTemplate* command_template() const {
+    return command_template_.get();
+  }
+
  private:
   // Allow the parsers to reach into this object and fill out its fields.
   friend struct ManifestParser;
@@ -85,6 +126,7 @@ struct Rule {
   std::string name_;
   typedef std::map<std::string, EvalString> Bindings;
   Bindings bindings_;
+  std::unique_ptr<EvalTemplate> command_template_;
   bool phony_ = false;
 };
 
@@ -103,6 +145,12 @@ struct BindingEnv : public Env {
   const std::map<std::string, std::unique_ptr<const Rule>>& GetRules() const;
 
   void AddBinding(const std::string& key, const std::string& val);
+  void RemoveBinding(const std::string& key);
+
+  /// @return whether |var| is set in this scope itself, ignoring parents.
+  bool HasLocalBinding(const std::string& var) const {
+    return bindings_.find(var) != bindings_.end();
+  }
 
   /// This is tricky.  Edges want lookup scope to go in this order:
   /// 1) value set on edge itself (edge_->env_)
@@ -32,7 +32,7 @@
 using namespace std;
 
 bool Node::Stat(DiskInterface* disk_interface, string* err) {
-  mtime_ = disk_interface->Stat(path_, err);
+  mtime_ = disk_interface->Stat(path_.AsString(), err);
   if (mtime_ == -1) {
     return false;
   }
@@ -109,7 +109,7 @@ bool DependencyScan::RecomputeNodeDirty(Node* node, std::vector<Node*>* stack,
       return false;
     if (!node->exists())
       explanations_.Record(node, "%s has no in-edge and is missing",
-                           node->path().c_str());
+                           node->path().str_);
     node->set_dirty(!node->exists());
     return true;
   }
@@ -202,7 +202,7 @@ bool DependencyScan::RecomputeNodeDirty(Node* node, std::vector<Node*>* stack,
       // If a regular input is dirty (or missing), we're dirty.
       // Otherwise consider mtime.
       if ((*i)->dirty()) {
-        explanations_.Record(node, "%s is dirty", (*i)->path().c_str());
+        explanations_.Record(node, "%s is dirty", (*i)->path().str_);
         dirty = true;
       } else {
         // 输出文件比最新的输入文件旧：虽然在代码片段中没有直接显示，但通常构建系统会比较输出文件与最新输入文件的修改时间。这里收集了最新输入：
@@ -271,10 +271,10 @@ bool DependencyScan::VerifyDAG(Node* node, vector<Node*>* stack, string* err) {
   // Construct the error message rejecting the cycle.
   *err = "dependency cycle: ";
   for (vector<Node*>::const_iterator i = start; i != stack->end(); ++i) {
-    err->append((*i)->path());
+    err->append((*i)->path().str_, (*i)->path().len_);
     err->append(" -> ");
   }
-  err->append((*start)->path());
+  err->append((*start)->path().str_, (*start)->path().len_);
 
   if ((start + 1) == stack->end() && edge->maybe_phonycycle_diagnostic()) {
     // The manifest parser would have filtered out the self-referencing
@@ -287,10 +287,9 @@ bool DependencyScan::VerifyDAG(Node* node, vector<Node*>* stack, string* err) {
 
 bool DependencyScan::RecomputeOutputsDirty(Edge* edge, Node* most_recent_input,
                                            bool* outputs_dirty, string* err) {
-  string command = edge->EvaluateCommand(/*incl_rsp_file=*/true);
   for (vector<Node*>::iterator o = edge->outputs_.begin();
        o != edge->outputs_.end(); ++o) {
-    if (RecomputeOutputDirty(edge, most_recent_input, command, *o)) {
+    if (RecomputeOutputDirty(edge, most_recent_input, *o)) {
       *outputs_dirty = true;
       return true;
     }
@@ -300,7 +299,6 @@ bool DependencyScan::RecomputeOutputsDirty(Edge* edge, Node* most_recent_input,
 
 bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
                                           const Node* most_recent_input,
-                                          const string& command,
                                           Node* output) {
   if (edge->is_phony()) {
     // Phony edges don't write any output.  Outputs are only dirty if
@@ -308,7 +306,7 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
     if (edge->inputs_.empty() && !output->exists()) {
       explanations_.Record(
           output, "output %s of phony edge with no inputs doesn't exist",
-          output->path().c_str());
+          output->path().str_);
       return true;
     }
 
@@ -325,7 +323,7 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
   // Dirty if we're missing the output.
   if (!output->exists()) {
     explanations_.Record(output, "output %s doesn't exist",
-                         output->path().c_str());
+                         output->path().str_);
     return true;
   }
 
@@ -348,8 +346,8 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
     explanations_.Record(output,
                          "output %s older than most recent input %s "
                          "(%" PRId64 " vs %" PRId64 ")",
-                         output->path().c_str(),
-                         most_recent_input->path().c_str(), output->mtime(),
+                         output->path().str_,
+                         most_recent_input->path().str_, output->mtime(),
                          most_recent_input->mtime());
     return true;
   }
@@ -358,12 +356,12 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
     bool generator = edge->GetBindingBool("generator");
     if (entry || (entry = build_log()->LookupByOutput(output->path()))) {
       if (!generator &&
-          BuildLog::LogEntry::HashCommand(command) != entry->command_hash) {
+          edge->CommandHash() != entry->command_hash) {
         // May also be dirty due to the command changing since the last build.
         // But if this is a generator rule, the command changing does not make us
         // dirty.
         explanations_.Record(output, "command line changed for %s",
-                             output->path().c_str());
+                             output->path().str_);
         return true;
       }
       if (most_recent_input && entry->mtime < most_recent_input->mtime()) {
@@ -377,14 +375,14 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
             output,
             "recorded mtime of %s older than most recent input %s (%" PRId64
             " vs %" PRId64 ")",
-            output->path().c_str(), most_recent_input->path().c_str(),
+            output->path().str_, most_recent_input->path().str_,
             entry->mtime, most_recent_input->mtime());
         return true;
       }
     }
     if (!entry && !generator) {
       explanations_.Record(output, "command line not found in log for %s",
-                           output->path().c_str());
+                           output->path().str_);
       return true;
     }
   }
@@ -418,9 +416,15 @@ struct EdgeEnv : public Env {
       : edge_(edge), escape_in_out_(escape), recursive_(false) {}
   virtual string LookupVariable(const string& var);
 
+  /// Evaluate |tmpl|, the compiled form of a rule binding, into |result|.
+  void EvaluateTemplate(const EvalTemplate& tmpl, std::string* result);
+
   /// Given a span of Nodes, construct a list of paths suitable for a command
   /// line.
   std::string MakePathList(const Node* const* span, size_t size, char sep) const;
+  /// Like MakePathList(), but append to |result|.
+  void AppendPathList(const Node* const* span, size_t size, char sep,
+                      std::string* result) const;
 
  private:
   std::vector<std::string> lookups_;
@@ -431,13 +435,11 @@ struct EdgeEnv : public Env {
 
 string EdgeEnv::LookupVariable(const string& var) {
   if (var == "in" || var == "in_newline") {
-    int explicit_deps_count = edge_->inputs_.size() - edge_->implicit_deps_ -
-      edge_->order_only_deps_;
-    return MakePathList(edge_->inputs_.data(), explicit_deps_count,
+    return MakePathList(edge_->inputs_.data(), edge_->explicit_deps_count(),
                         var == "in" ? ' ' : '\n');
   } else if (var == "out") {
-    int explicit_outs_count = edge_->outputs_.size() - edge_->implicit_outs_;
-    return MakePathList(&edge_->outputs_[0], explicit_outs_count, ' ');
+    return MakePathList(edge_->outputs_.data(), edge_->explicit_outs_count(),
+                        ' ');
   }
 
   // Technical note about the lookups_ vector.
@@ -499,28 +501,91 @@ string EdgeEnv::LookupVariable(const string& var) {
   return result;
 }
 
+void EdgeEnv::EvaluateTemplate(const EvalTemplate& tmpl, string* result) {
+  // As in LookupVariable(), the binding being evaluated is not itself
+  // recorded on the lookup stack.
+  recursive_ = true;
+
+  const vector<EvalTemplate::Piece>& pieces = tmpl.pieces();
+  size_t size = tmpl.text_size();
+  for (vector<EvalTemplate::Piece>::const_iterator p = pieces.begin();
+       p != pieces.end(); ++p) {
+    const Node* const* span;
+    size_t count;
+    if (p->slot == EvalTemplate::kOut) {
+      span = edge_->outputs_.data();
+      count = edge_->explicit_outs_count();
+    } else if (p->slot == EvalTemplate::kIn ||
+               p->slot == EvalTemplate::kInNewline) {
+      span = edge_->inputs_.data();
+      count = edge_->explicit_deps_count();
+    } else {
+      continue;
+    }
+    for (size_t i = 0; i < count; ++i)
+      size += span[i]->PathDecanonicalized().size() + 1;
+  }
+
+  result->clear();
+  result->reserve(size);
+  for (vector<EvalTemplate::Piece>::const_iterator p = pieces.begin();
+       p != pieces.end(); ++p) {
+    switch (p->slot) {
+    case EvalTemplate::kText:
+      result->append(p->text.str_, p->text.len_);
+      break;
+    case EvalTemplate::kIn:
+    case EvalTemplate::kInNewline:
+      AppendPathList(edge_->inputs_.data(), edge_->explicit_deps_count(),
+                     p->slot == EvalTemplate::kIn ? ' ' : '\n', result);
+      break;
+    case EvalTemplate::kOut:
+      AppendPathList(edge_->outputs_.data(), edge_->explicit_outs_count(),
+                     ' ', result);
+      break;
+    case EvalTemplate::kVariable:
+      result->append(LookupVariable(p->text.AsString()));
+      break;
+    }
+  }
+}
+
 std::string EdgeEnv::MakePathList(const Node* const* const span,
                                   const size_t size, const char sep) const {
   string result;
+  AppendPathList(span, size, sep, &result);
+  return result;
+}
+
+void EdgeEnv::AppendPathList(const Node* const* const span, const size_t size,
+                             const char sep, string* result) const {
   for (const Node* const* i = span; i != span + size; ++i) {
-    if (!result.empty())
-      result.push_back(sep);
+    if (i != span)
+      result->push_back(sep);
     const string& path = (*i)->PathDecanonicalized();
     if (escape_in_out_ == kShellEscape) {
 #ifdef _WIN32
-      GetWin32EscapedString(path, &result);
+      GetWin32EscapedString(path, result);
 #else
-      GetShellEscapedString(path, &result);
+      GetShellEscapedString(path, result);
 #endif
     } else {
-      result.append(path);
+      result->append(path);
     }
   }
-  return result;
 }
 
 std::string Edge::EvaluateCommand(const bool incl_rsp_file) const {
-  string command = GetBinding("command");
+  string command;
+  // An edge-level "command" binding shadows the rule's; see
+  // BindingEnv::LookupWithFallback.
+  const EvalTemplate* tmpl = rule_->command_template();
+  if (tmpl && !env_->HasLocalBinding("command")) {
+    EdgeEnv env(this, EdgeEnv::kShellEscape);
+    env.EvaluateTemplate(*tmpl, &command);
+  } else {
+    command = GetBinding("command");
+  }
   if (incl_rsp_file) {
     string rspfile_content = GetBinding("rspfile_content");
     if (!rspfile_content.empty())
@@ -529,6 +594,15 @@ std::string Edge::EvaluateCommand(const bool incl_rsp_file) const {
   return command;
 }
 
+uint64_t Edge::CommandHash() const {
+  if (!command_hash_valid_) {
+    command_hash_ =
+        BuildLog::LogEntry::HashCommand(EvaluateCommand(/*incl_rsp_file=*/true));
+    command_hash_valid_ = true;
+  }
+  return command_hash_;
+}
+
 std::string Edge::GetBinding(const std::string& key) const {
   EdgeEnv env(this, EdgeEnv::kShellEscape);
   return env.LookupVariable(key);
@@ -557,18 +631,18 @@ void Edge::Dump(const char* prefix) const {
   printf("%s[ ", prefix);
   for (vector<Node*>::const_iterator i = inputs_.begin();
        i != inputs_.end() && *i != NULL; ++i) {
-    printf("%s ", (*i)->path().c_str());
+    printf("%s ", (*i)->path().str_);
   }
   printf("--%s-> ", rule_->name().c_str());
   for (vector<Node*>::const_iterator i = outputs_.begin();
        i != outputs_.end() && *i != NULL; ++i) {
-    printf("%s ", (*i)->path().c_str());
+    printf("%s ", (*i)->path().str_);
   }
   if (!validations_.empty()) {
     printf(" validations ");
     for (std::vector<Node*>::const_iterator i = validations_.begin();
          i != validations_.end() && *i != NULL; ++i) {
-      printf("%s ", (*i)->path().c_str());
+      printf("%s ", (*i)->path().str_);
     }
   }
   if (pool_) {
@@ -598,8 +672,8 @@ bool Edge::maybe_phonycycle_diagnostic() const {
 }
 
 // static
-string Node::PathDecanonicalized(const string& path, uint64_t slash_bits) {
-  string result = path;
+string Node::PathDecanonicalized(StringPiece path, uint64_t slash_bits) {
+  string result = path.AsString();
 #ifdef _WIN32
   uint64_t mask = 1;
   for (char* c = &result[0]; (c = strchr(c, '/')) != NULL;) {
@@ -614,7 +688,7 @@ string Node::PathDecanonicalized(const string& path, uint64_t slash_bits) {
 
 void Node::Dump(const char* prefix) const {
   printf("%s <%s 0x%p> mtime: %" PRId64 "%s, (:%s), ",
-         prefix, path().c_str(), this,
+         prefix, path().str_, this,
          mtime(), exists() ? "" : " (:missing)",
          dirty() ? " dirty" : " clean");
   if (in_edge()) {
@@ -708,7 +782,7 @@ bool ImplicitDepLoader::LoadDepFile(Edge* edge, const string& path,
   if (opath != *primary_out) {
     explanations_.Record(first_output,
                          "expected depfile '%s' to mention '%s', got '%s'",
-                         path.c_str(), first_output->path().c_str(),
+                         path.c_str(), first_output->path().str_,
                          primary_out->AsString().c_str());
     return false;
   }
@@ -751,7 +825,7 @@ bool ImplicitDepLoader::LoadDepsFromLog(Edge* edge, string* err) {
   DepsLog::Deps* deps = deps_log_ ? deps_log_->GetDeps(output) : NULL;
   if (!deps) {
     explanations_.Record(output, "deps for '%s' are missing",
-                         output->path().c_str());
+                         output->path().str_);
     return false;
   }
 
@@ -760,7 +834,7 @@ bool ImplicitDepLoader::LoadDepsFromLog(Edge* edge, string* err) {
     explanations_.Record(output,
                          "stored deps info out of date for '%s' (%" PRId64
                          " vs %" PRId64 ")",
-                         output->path().c_str(), deps->mtime, output->mtime());
+                         output->path().str_, deps->mtime, output->mtime());
     return false;
   }
 
@@ -46,7 +46,9 @@ struct State;
 struct Node {
   // 名字
 // 就是文件的路径，比如 src/main.cpp
-  Node(const std::string& path, uint64_t slash_bits)
+  /// |path| must outlive the Node and be followed by a NUL byte: State
+  /// keeps the paths of its nodes in its arena.
+  Node(StringPiece path, uint64_t slash_bits)
       : path_(path), slash_bits_(slash_bits) {}
 
   /// Return false on error.
@@ -87,12 +89,13 @@ struct Node {
     return exists_ != ExistenceStatusUnknown;
   }
 
-  const std::string& path() const { return path_; }
+  /// The path is followed by a NUL byte, so path().str_ is a C string.
+  StringPiece path() const { return path_; }
   /// Get |path()| but use slash_bits to convert back to original slash styles.
   std::string PathDecanonicalized() const {
     return PathDecanonicalized(path_, slash_bits_);
   }
-  static std::string PathDecanonicalized(const std::string& path,
+  static std::string PathDecanonicalized(StringPiece path,
                                          uint64_t slash_bits);
   uint64_t slash_bits() const { return slash_bits_; }
 
@@ -122,6 +125,8 @@ struct Node {
   const std::vector<Edge*>& out_edges() const { return out_edges_; }
   const std::vector<Edge*>& validation_out_edges() const { return validation_out_edges_; }
   void AddOutEdge(Edge* edge) { out_edges_.push_back(edge); }
+  /// Drop the out-edges added after the first |count|.
+  void TruncateOutEdges(size_t count) { out_edges_.resize(count); }
   void AddValidationOutEdge(Edge* edge) { validation_out_edges_.push_back(edge); }
 
   void Dump(const char* prefix="") const;
@@ -129,7 +134,7 @@ struct Node {
 private:
 // 就是文件的路径，比如 src/main.cpp。
 // Ninja 靠这个找到文件。
-  std::string path_;
+  StringPiece path_;
 
   /// Set bits starting from lowest for backslashes that were normalized to
   /// forward slashes by CanonicalizePath. See |PathDecanonicalized|.
@@ -236,6 +241,12 @@ struct Edge {
   /// full contents of a response file (if applicable)
   std::string EvaluateCommand(bool incl_rsp_file = false) const;
 
+  /// Hash of EvaluateCommand(true), as stored in the build log.  Computed
+  /// once and remembered; call ClearCommandHash() after changing the
+  /// edge's bindings.
+  uint64_t CommandHash() const;
+  void ClearCommandHash() { command_hash_valid_ = false; }
+
   /// Returns the shell-escaped value of |key|.
   std::string GetBinding(const std::string& key) const;
   bool GetBindingBool(const std::string& key) const;
@@ -277,6 +288,8 @@ struct Edge {
   bool deps_missing_ = false;
   bool generated_by_dep_loader_ = false;
   TimeStamp command_start_time_ = 0;
+  mutable uint64_t command_hash_ = 0;
+  mutable bool command_hash_valid_ = false;
 
   const Rule& rule() const { return *rule_; }
   Pool* pool() const { return pool_; }
@@ -308,6 +321,10 @@ struct Edge {
   bool is_order_only(size_t index) {
     return index >= inputs_.size() - order_only_deps_;
   }
+  /// Number of explicit inputs, the ones that make up $in.
+  size_t explicit_deps_count() const {
+    return inputs_.size() - implicit_deps_ - order_only_deps_;
+  }
 
   // There are two types of outputs.
   // 1) explicit outs, which show up as $out on the command line;
@@ -320,6 +337,10 @@ struct Edge {
   bool is_implicit_out(size_t index) const {
     return index >= outputs_.size() - implicit_outs_;
   }
+  /// Number of explicit outputs, the ones that make up $out.
+  size_t explicit_outs_count() const {
+    return outputs_.size() - implicit_outs_;
+  }
 
   bool is_phony() const;
   bool use_console() const;
@@ -443,7 +464,7 @@ struct DependencyScan {
   /// Recompute whether a given single output should be marked dirty.
   /// Returns true if so.
   bool RecomputeOutputDirty(const Edge* edge, const Node* most_recent_input,
-                            const std::string& command, Node* output);
+                            Node* output);
 
   void RecordExplanation(const Node* node, const char* fmt, ...);
 
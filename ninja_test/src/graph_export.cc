@@ -0,0 +1,432 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graph_export.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include "graph.h"
+#include "json.h"
+#include "util.h"
+
+using namespace std;
+
+namespace {
+
+/// Collects output in a buffer and writes it out in large blocks.
+struct BufferedWriter {
+  explicit BufferedWriter(FILE* out) : out_(out) {}
+  ~BufferedWriter() { Flush(); }
+
+  string* buffer() {
+    if (buffer_.size() >= kBlockSize)
+      Flush();
+    return &buffer_;
+  }
+
+  void Flush() {
+    fwrite(buffer_.data(), 1, buffer_.size(), out_);
+    buffer_.clear();
+  }
+
+ private:
+  static const size_t kBlockSize = 1 << 20;
+  FILE* out_;
+  string buffer_;
+};
+
+void AppendUInt(string* out, uint64_t value) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+  out->append(buf);
+}
+
+void AppendLE32(string* out, uint32_t value) {
+  char bytes[4] = {
+    static_cast<char>(value), static_cast<char>(value >> 8),
+    static_cast<char>(value >> 16), static_cast<char>(value >> 24)
+  };
+  out->append(bytes, 4);
+}
+
+/// A path as a DOT string, with the slashes GraphViz uses.
+void AppendDotLabel(string* out, StringPiece text) {
+  for (StringPiece::const_iterator c = text.begin(); c != text.end(); ++c) {
+    if (*c == '\\')
+      out->push_back('/');
+    else if (*c == '"')
+      out->append("\\\"");
+    else
+      out->push_back(*c);
+  }
+}
+
+}  // namespace
+
+GraphExport::GraphExport(State* state, DiskInterface* disk_interface,
+                         const GraphExportOptions& options)
+    : options_(options), dyndep_loader_(state, disk_interface) {}
+
+uint32_t GraphExport::AddNode(Node* node, bool* added) {
+  pair<unordered_map<const Node*, uint32_t>::iterator, bool> entry =
+      node_ids_.insert(make_pair(node, (uint32_t)nodes_.size()));
+  *added = entry.second;
+  if (entry.second)
+    nodes_.push_back(node);
+  return entry.first->second;
+}
+
+void GraphExport::AddTargets(const vector<Node*>& targets) {
+  // Breadth first: each entry is a node and its distance from a target.
+  deque<pair<Node*, int> > queue;
+  bool added;
+  for (vector<Node*>::const_iterator t = targets.begin(); t != targets.end();
+       ++t) {
+    AddNode(*t, &added);
+    if (added)
+      queue.push_back(make_pair(*t, 0));
+  }
+
+  while (!queue.empty()) {
+    Node* node = queue.front().first;
+    int depth = queue.front().second;
+    queue.pop_front();
+
+    Edge* edge = node->in_edge();
+    if (!edge)
+      continue;
+    if (options_.max_depth > 0 && depth >= options_.max_depth)
+      continue;
+    if (options_.only_dirty && !node->dirty())
+      continue;
+    if (edge->id_ >= edge_ids_.size())
+      edge_ids_.resize(edge->id_ + 1);
+    if (edge_ids_[edge->id_])
+      continue;
+
+    if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
+      string err;
+      if (!dyndep_loader_.LoadDyndeps(edge->dyndep_, &err))
+        Warning("%s", err.c_str());
+    }
+    edges_.push_back(edge);
+    edge_ids_[edge->id_] = edges_.size();
+
+    for (vector<Node*>::iterator out = edge->outputs_.begin();
+         out != edge->outputs_.end(); ++out) {
+      AddNode(*out, &added);
+    }
+    for (vector<Node*>::iterator in = edge->inputs_.begin();
+         in != edge->inputs_.end(); ++in) {
+      AddNode(*in, &added);
+      if (added)
+        queue.push_back(make_pair(*in, depth + 1));
+    }
+  }
+
+  CollectRules();
+}
+
+void GraphExport::CollectRules() {
+  rules_.clear();
+  edge_rules_.clear();
+  rule_edges_.clear();
+  rule_deps_.clear();
+
+  map<const Rule*, uint32_t> rule_ids;
+  edge_rules_.reserve(edges_.size());
+  for (vector<Edge*>::iterator e = edges_.begin(); e != edges_.end(); ++e) {
+    pair<map<const Rule*, uint32_t>::iterator, bool> entry =
+        rule_ids.insert(make_pair((*e)->rule_, (uint32_t)rules_.size()));
+    if (entry.second)
+      rules_.push_back((*e)->rule_);
+    edge_rules_.push_back(entry.first->second);
+  }
+  if (!options_.collapse_rules)
+    return;
+
+  // Count, for each pair of rules, the edges of the second that use a file
+  // built by the first.  An edge using several such files counts once.
+  rule_edges_.resize(rules_.size());
+  vector<map<uint32_t, uint32_t> > deps(rules_.size());
+  vector<uint32_t> producers;
+  for (size_t i = 0; i < edges_.size(); ++i) {
+    Edge* edge = edges_[i];
+    uint32_t rule = edge_rules_[i];
+    ++rule_edges_[rule];
+    producers.clear();
+    for (vector<Node*>::iterator in = edge->inputs_.begin();
+         in != edge->inputs_.end(); ++in) {
+      Edge* producer = (*in)->in_edge();
+      if (!producer || producer->id_ >= edge_ids_.size() ||
+          !edge_ids_[producer->id_]) {
+        continue;
+      }
+      producers.push_back(edge_rules_[edge_ids_[producer->id_] - 1]);
+    }
+    sort(producers.begin(), producers.end());
+    producers.erase(unique(producers.begin(), producers.end()),
+                    producers.end());
+    for (vector<uint32_t>::iterator p = producers.begin();
+         p != producers.end(); ++p) {
+      ++deps[*p][rule];
+    }
+  }
+  rule_deps_.resize(rules_.size());
+  for (size_t r = 0; r < rules_.size(); ++r)
+    rule_deps_[r].assign(deps[r].begin(), deps[r].end());
+}
+
+void GraphExport::WriteJsonLines(FILE* out) const {
+  BufferedWriter writer(out);
+
+  if (options_.collapse_rules) {
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      string* line = writer.buffer();
+      line->append("{\"type\":\"rule\",\"id\":");
+      AppendUInt(line, r);
+      line->append(",\"name\":\"");
+      AppendJSONString(rules_[r]->name(), line);
+      line->append("\",\"edges\":");
+      AppendUInt(line, rule_edges_[r]);
+      line->append("}\n");
+    }
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      for (size_t d = 0; d < rule_deps_[r].size(); ++d) {
+        string* line = writer.buffer();
+        line->append("{\"type\":\"dep\",\"from\":");
+        AppendUInt(line, r);
+        line->append(",\"to\":");
+        AppendUInt(line, rule_deps_[r][d].first);
+        line->append(",\"count\":");
+        AppendUInt(line, rule_deps_[r][d].second);
+        line->append("}\n");
+      }
+    }
+    return;
+  }
+
+  for (size_t n = 0; n < nodes_.size(); ++n) {
+    string* line = writer.buffer();
+    line->append("{\"type\":\"node\",\"id\":");
+    AppendUInt(line, n);
+    line->append(",\"path\":\"");
+    AppendJSONString(nodes_[n]->path(), line);
+    line->push_back('"');
+    if (options_.only_dirty)
+      line->append(nodes_[n]->dirty() ? ",\"dirty\":true" : ",\"dirty\":false");
+    line->append("}\n");
+  }
+  for (size_t e = 0; e < edges_.size(); ++e) {
+    const Edge* edge = edges_[e];
+    string* line = writer.buffer();
+    line->append("{\"type\":\"edge\",\"id\":");
+    AppendUInt(line, e);
+    line->append(",\"rule\":\"");
+    AppendJSONString(edge->rule_->name(), line);
+    line->append("\",\"inputs\":[");
+    for (size_t i = 0; i < edge->inputs_.size(); ++i) {
+      if (i)
+        line->push_back(',');
+      AppendUInt(line, node_ids_.find(edge->inputs_[i])->second);
+    }
+    line->append("],\"implicit\":");
+    AppendUInt(line, edge->implicit_deps_);
+    line->append(",\"order_only\":");
+    AppendUInt(line, edge->order_only_deps_);
+    line->append(",\"outputs\":[");
+    for (size_t i = 0; i < edge->outputs_.size(); ++i) {
+      if (i)
+        line->push_back(',');
+      AppendUInt(line, node_ids_.find(edge->outputs_[i])->second);
+    }
+    line->append("]}\n");
+  }
+}
+
+void GraphExport::WriteBinary(FILE* out) const {
+  string strings;
+  vector<uint32_t> rule_names;
+  for (size_t r = 0; r < rules_.size(); ++r) {
+    rule_names.push_back(strings.size());
+    strings.append(rules_[r]->name());
+  }
+  rule_names.push_back(strings.size());
+
+  uint32_t flags = (options_.collapse_rules ? 1 : 0) |
+                   (options_.only_dirty ? 2 : 0);
+  uint32_t node_count = options_.collapse_rules ? 0 : nodes_.size();
+  uint32_t edge_count = edges_.size();
+  if (options_.collapse_rules) {
+    edge_count = 0;
+    for (size_t r = 0; r < rule_deps_.size(); ++r)
+      edge_count += rule_deps_[r].size();
+  }
+
+  // The arrays go out first and the string table last, so build the
+  // arrays into one buffer while collecting the node paths.
+  string arrays;
+  for (size_t i = 0; i < rule_names.size(); ++i)
+    AppendLE32(&arrays, rule_names[i]);
+
+  if (options_.collapse_rules) {
+    for (size_t r = 0; r < rules_.size(); ++r)
+      AppendLE32(&arrays, rule_edges_[r]);
+    uint32_t start = 0;
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      AppendLE32(&arrays, start);
+      start += rule_deps_[r].size();
+    }
+    AppendLE32(&arrays, start);
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      for (size_t d = 0; d < rule_deps_[r].size(); ++d)
+        AppendLE32(&arrays, rule_deps_[r][d].first);
+    }
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      for (size_t d = 0; d < rule_deps_[r].size(); ++d)
+        AppendLE32(&arrays, rule_deps_[r][d].second);
+    }
+  } else {
+    arrays.reserve(arrays.size() + 4 * (3 * nodes_.size() + 6 * edges_.size()));
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+      AppendLE32(&arrays, strings.size());
+      strings.append(nodes_[n]->path().str_, nodes_[n]->path().len_);
+    }
+    AppendLE32(&arrays, strings.size());
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+      Edge* edge = nodes_[n]->in_edge();
+      uint32_t id = 0xffffffff;
+      if (edge && edge->id_ < edge_ids_.size() && edge_ids_[edge->id_])
+        id = edge_ids_[edge->id_] - 1;
+      AppendLE32(&arrays, id);
+    }
+    for (size_t n = 0; n < nodes_.size(); ++n)
+      AppendLE32(&arrays, nodes_[n]->dirty() ? 1 : 0);
+    for (size_t e = 0; e < edges_.size(); ++e)
+      AppendLE32(&arrays, edge_rules_[e]);
+    for (size_t e = 0; e < edges_.size(); ++e)
+      AppendLE32(&arrays, edges_[e]->implicit_deps_);
+    for (size_t e = 0; e < edges_.size(); ++e)
+      AppendLE32(&arrays, edges_[e]->order_only_deps_);
+    for (int outputs = 0; outputs < 2; ++outputs) {
+      uint32_t start = 0;
+      for (size_t e = 0; e < edges_.size(); ++e) {
+        AppendLE32(&arrays, start);
+        start += outputs ? edges_[e]->outputs_.size()
+                         : edges_[e]->inputs_.size();
+      }
+      AppendLE32(&arrays, start);
+      for (size_t e = 0; e < edges_.size(); ++e) {
+        const vector<Node*>& nodes =
+            outputs ? edges_[e]->outputs_ : edges_[e]->inputs_;
+        for (size_t i = 0; i < nodes.size(); ++i)
+          AppendLE32(&arrays, node_ids_.find(nodes[i])->second);
+      }
+    }
+  }
+
+  string header = "NJGRAPH1";
+  AppendLE32(&header, flags);
+  AppendLE32(&header, node_count);
+  AppendLE32(&header, edge_count);
+  AppendLE32(&header, rules_.size());
+  AppendLE32(&header, strings.size());
+  fwrite(header.data(), 1, header.size(), out);
+  fwrite(arrays.data(), 1, arrays.size(), out);
+  fwrite(strings.data(), 1, strings.size(), out);
+}
+
+void GraphExport::WriteDot(FILE* out) const {
+  BufferedWriter writer(out);
+  writer.buffer()->append("digraph ninja {\n"
+                          "rankdir=\"LR\"\n"
+                          "node [fontsize=10, shape=box, height=0.25]\n"
+                          "edge [fontsize=10]\n");
+
+  if (options_.collapse_rules) {
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      string* line = writer.buffer();
+      line->append("\"r");
+      AppendUInt(line, r);
+      line->append("\" [label=\"");
+      AppendDotLabel(line, rules_[r]->name());
+      line->append(" (");
+      AppendUInt(line, rule_edges_[r]);
+      line->append(")\", shape=ellipse]\n");
+    }
+    for (size_t r = 0; r < rules_.size(); ++r) {
+      for (size_t d = 0; d < rule_deps_[r].size(); ++d) {
+        string* line = writer.buffer();
+        line->append("\"r");
+        AppendUInt(line, r);
+        line->append("\" -> \"r");
+        AppendUInt(line, rule_deps_[r][d].first);
+        line->append("\" [label=\" ");
+        AppendUInt(line, rule_deps_[r][d].second);
+        line->append("\"]\n");
+      }
+    }
+    writer.buffer()->append("}\n");
+    return;
+  }
+
+  for (size_t n = 0; n < nodes_.size(); ++n) {
+    string* line = writer.buffer();
+    line->append("\"n");
+    AppendUInt(line, n);
+    line->append("\" [label=\"");
+    AppendDotLabel(line, nodes_[n]->path());
+    line->append("\"]\n");
+  }
+  for (size_t e = 0; e < edges_.size(); ++e) {
+    const Edge* edge = edges_[e];
+    string* line = writer.buffer();
+    if (edge->inputs_.size() == 1 && edge->outputs_.size() == 1) {
+      // Note extra space before label text -- this is cosmetic and feels
+      // like a graphviz bug.
+      line->append("\"n");
+      AppendUInt(line, node_ids_.find(edge->inputs_[0])->second);
+      line->append("\" -> \"n");
+      AppendUInt(line, node_ids_.find(edge->outputs_[0])->second);
+      line->append("\" [label=\" ");
+      AppendDotLabel(line, edge->rule_->name());
+      line->append("\"]\n");
+      continue;
+    }
+    line->append("\"e");
+    AppendUInt(line, e);
+    line->append("\" [label=\"");
+    AppendDotLabel(line, edge->rule_->name());
+    line->append("\", shape=ellipse]\n");
+    for (size_t i = 0; i < edge->outputs_.size(); ++i) {
+      line->append("\"e");
+      AppendUInt(line, e);
+      line->append("\" -> \"n");
+      AppendUInt(line, node_ids_.find(edge->outputs_[i])->second);
+      line->append("\"\n");
+    }
+    for (size_t i = 0; i < edge->inputs_.size(); ++i) {
+      line->append("\"n");
+      AppendUInt(line, node_ids_.find(edge->inputs_[i])->second);
+      line->append("\" -> \"e");
+      AppendUInt(line, e);
+      bool order_only = i >= edge->inputs_.size() - edge->order_only_deps_;
+      line->append(order_only ? "\" [arrowhead=none style=dotted]\n"
+                              : "\" [arrowhead=none]\n");
+    }
+  }
+  writer.buffer()->append("}\n");
+}
@@ -0,0 +1,115 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_GRAPH_EXPORT_H_
+#define NINJA_GRAPH_EXPORT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dyndep.h"
+
+struct DiskInterface;
+struct Edge;
+struct Node;
+struct Rule;
+struct State;
+
+struct GraphExportOptions {
+  /// Do not follow edges more than this many steps away from the targets;
+  /// 0 for no limit.
+  int max_depth = 0;
+  /// Export one vertex per rule, with the number of file dependencies
+  /// between the edges of each pair of rules, instead of files and edges.
+  bool collapse_rules = false;
+  /// Only follow edges that have a dirty output.  The caller must have
+  /// computed the dirty state of the targets (DependencyScan).
+  bool only_dirty = false;
+};
+
+/// Collects the part of the build graph leading to some targets and writes
+/// it in forms that are quick to load for analysis tools ("ninja -t graph
+/// --format=...").
+///
+/// JSON lines: one object per line, all vertices before all edges.
+///   {"type":"node","id":0,"path":"foo.o","dirty":true}
+///   {"type":"edge","id":0,"rule":"cxx","inputs":[1,2],"implicit":1,
+///    "order_only":0,"outputs":[0]}
+/// "dirty" is only present with only_dirty; the last "implicit" and
+/// "order_only" inputs are of those kinds.  With collapse_rules:
+///   {"type":"rule","id":0,"name":"cxx","edges":120}
+///   {"type":"dep","from":1,"to":0,"count":4000}
+/// where |count| edges of rule |to| use a file built by rule |from|.
+///
+/// Binary: little-endian uint32 values throughout, arrays back to back.
+///   "NJGRAPH1", flags (1: collapse_rules, 2: dirty present),
+///   node_count, edge_count, rule_count, string_bytes,
+///   rule_name[rule_count + 1]      offsets into the string table
+/// then without collapse_rules:
+///   node_path[node_count + 1]      offsets into the string table
+///   node_in_edge[node_count]       edge id, or 0xffffffff
+///   node_dirty[node_count]         0 or 1
+///   edge_rule[edge_count]
+///   edge_implicit[edge_count], edge_order_only[edge_count]
+///   edge_inputs_start[edge_count + 1], edge_inputs[...]  node ids (CSR)
+///   edge_outputs_start[edge_count + 1], edge_outputs[...]
+/// or with collapse_rules (edge_count is the number of deps):
+///   rule_edges[rule_count]
+///   rule_deps_start[rule_count + 1], dep_to[...], dep_count[...]
+/// and then the string table, string_bytes long.
+struct GraphExport {
+  GraphExport(State* state, DiskInterface* disk_interface,
+              const GraphExportOptions& options);
+
+  /// Collect the graph leading to |targets|, breadth first so that
+  /// max_depth counts the shortest path from any of them.  Call once.
+  void AddTargets(const std::vector<Node*>& targets);
+
+  void WriteJsonLines(FILE* out) const;
+  void WriteBinary(FILE* out) const;
+  /// A graphviz .dot file, drawn like plain "-t graph" draws it.
+  void WriteDot(FILE* out) const;
+
+  const std::vector<Node*>& nodes() const { return nodes_; }
+  const std::vector<Edge*>& edges() const { return edges_; }
+
+ private:
+  /// Index of |node|, adding it if new; |added| tells which.
+  uint32_t AddNode(Node* node, bool* added);
+  /// Fill in the rule tables from the collected edges.
+  void CollectRules();
+
+  GraphExportOptions options_;
+  DyndepLoader dyndep_loader_;
+
+  std::vector<Node*> nodes_;
+  std::unordered_map<const Node*, uint32_t> node_ids_;
+  std::vector<Edge*> edges_;
+  /// Index in edges_ plus one by Edge::id_, 0 for not collected.
+  std::vector<uint32_t> edge_ids_;
+
+  /// The rules of the collected edges, and each edge's index in rules_.
+  std::vector<const Rule*> rules_;
+  std::vector<uint32_t> edge_rules_;
+  /// With collapse_rules: the number of edges of each rule, and for each
+  /// rule the (consumer rule, count) pairs, sorted.
+  std::vector<uint32_t> rule_edges_;
+  std::vector<std::vector<std::pair<uint32_t, uint32_t> > > rule_deps_;
+};
+
+#endif  // NINJA_GRAPH_EXPORT_H_
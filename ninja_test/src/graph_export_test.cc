@@ -0,0 +1,181 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graph_export.h"
+
+#include "graph.h"
+#include "state.h"
+#include "test.h"
+
+using namespace std;
+
+namespace {
+
+struct GraphExportTest : public StateTestWithBuiltinRules {
+  GraphExportTest() {
+    AssertParse(&state_,
+"rule link\n"
+"  command = link $in -o $out\n"
+"build mid: cat in1 in2 | imp || oo\n"
+"build other: cat in1\n"
+"build out: link mid other\n");
+  }
+
+  /// Export the graph leading to |target| in |format| ('j', 'b' or 'd').
+  string Export(const GraphExportOptions& options, char format,
+                const char* target = "out") {
+    GraphExport graph(&state_, &fs_, options);
+    graph.AddTargets(vector<Node*>(1, GetNode(target)));
+    FILE* file = tmpfile();
+    EXPECT_TRUE(file != NULL);
+    if (format == 'j')
+      graph.WriteJsonLines(file);
+    else if (format == 'b')
+      graph.WriteBinary(file);
+    else
+      graph.WriteDot(file);
+    string text;
+    rewind(file);
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+      text.append(buf, len);
+    fclose(file);
+    return text;
+  }
+
+  VirtualFileSystem fs_;
+};
+
+uint32_t ReadLE32(const string& data, size_t index) {
+  const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(data.data()) + 8 + 4 * index;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+TEST_F(GraphExportTest, JsonLines) {
+  EXPECT_EQ("{\"type\":\"node\",\"id\":0,\"path\":\"out\"}\n"
+            "{\"type\":\"node\",\"id\":1,\"path\":\"mid\"}\n"
+            "{\"type\":\"node\",\"id\":2,\"path\":\"other\"}\n"
+            "{\"type\":\"node\",\"id\":3,\"path\":\"in1\"}\n"
+            "{\"type\":\"node\",\"id\":4,\"path\":\"in2\"}\n"
+            "{\"type\":\"node\",\"id\":5,\"path\":\"imp\"}\n"
+            "{\"type\":\"node\",\"id\":6,\"path\":\"oo\"}\n"
+            "{\"type\":\"edge\",\"id\":0,\"rule\":\"link\",\"inputs\":[1,2],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[0]}\n"
+            "{\"type\":\"edge\",\"id\":1,\"rule\":\"cat\",\"inputs\":[3,4,5,6],"
+            "\"implicit\":1,\"order_only\":1,\"outputs\":[1]}\n"
+            "{\"type\":\"edge\",\"id\":2,\"rule\":\"cat\",\"inputs\":[3],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[2]}\n",
+            Export(GraphExportOptions(), 'j'));
+}
+
+TEST_F(GraphExportTest, DepthAndDirty) {
+  GraphExportOptions options;
+  options.max_depth = 1;
+  EXPECT_EQ("{\"type\":\"node\",\"id\":0,\"path\":\"out\"}\n"
+            "{\"type\":\"node\",\"id\":1,\"path\":\"mid\"}\n"
+            "{\"type\":\"node\",\"id\":2,\"path\":\"other\"}\n"
+            "{\"type\":\"edge\",\"id\":0,\"rule\":\"link\",\"inputs\":[1,2],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[0]}\n",
+            Export(options, 'j'));
+
+  options.max_depth = 0;
+  options.only_dirty = true;
+  GetNode("out")->set_dirty(true);
+  GetNode("other")->set_dirty(true);
+  EXPECT_EQ("{\"type\":\"node\",\"id\":0,\"path\":\"out\",\"dirty\":true}\n"
+            "{\"type\":\"node\",\"id\":1,\"path\":\"mid\",\"dirty\":false}\n"
+            "{\"type\":\"node\",\"id\":2,\"path\":\"other\",\"dirty\":true}\n"
+            "{\"type\":\"node\",\"id\":3,\"path\":\"in1\",\"dirty\":false}\n"
+            "{\"type\":\"edge\",\"id\":0,\"rule\":\"link\",\"inputs\":[1,2],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[0]}\n"
+            "{\"type\":\"edge\",\"id\":1,\"rule\":\"cat\",\"inputs\":[3],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[2]}\n",
+            Export(options, 'j'));
+}
+
+TEST_F(GraphExportTest, DirtyWithValidation) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build checked: cat in1 |@ check\n"
+"build check: cat in1\n"));
+  fs_.Create("in1", "");
+
+  // Scan the way "-t graph --dirty" does; validations need a vector.
+  DependencyScan scan(&state_, NULL, NULL, &fs_, NULL, NULL);
+  vector<Node*> validation_nodes;
+  string err;
+  ASSERT_TRUE(scan.RecomputeDirty(GetNode("checked"), &validation_nodes,
+                                  &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(1u, validation_nodes.size());
+  EXPECT_EQ("check", validation_nodes[0]->path().AsString());
+
+  GraphExportOptions options;
+  options.only_dirty = true;
+  EXPECT_EQ("{\"type\":\"node\",\"id\":0,\"path\":\"checked\",\"dirty\":true}\n"
+            "{\"type\":\"node\",\"id\":1,\"path\":\"in1\",\"dirty\":false}\n"
+            "{\"type\":\"edge\",\"id\":0,\"rule\":\"cat\",\"inputs\":[1],"
+            "\"implicit\":0,\"order_only\":0,\"outputs\":[0]}\n",
+            Export(options, 'j', "checked"));
+}
+
+TEST_F(GraphExportTest, CollapseRules) {
+  GraphExportOptions options;
+  options.collapse_rules = true;
+  // Both link inputs are built by cat, but the link edge counts once.
+  EXPECT_EQ("{\"type\":\"rule\",\"id\":0,\"name\":\"link\",\"edges\":1}\n"
+            "{\"type\":\"rule\",\"id\":1,\"name\":\"cat\",\"edges\":2}\n"
+            "{\"type\":\"dep\",\"from\":1,\"to\":0,\"count\":1}\n",
+            Export(options, 'j'));
+  EXPECT_NE(string::npos, Export(options, 'd').find(
+      "\"r1\" -> \"r0\" [label=\" 1\"]\n"));
+}
+
+TEST_F(GraphExportTest, Binary) {
+  string data = Export(GraphExportOptions(), 'b');
+  ASSERT_EQ("NJGRAPH1", data.substr(0, 8));
+  EXPECT_EQ(0u, ReadLE32(data, 0));  // flags
+  EXPECT_EQ(7u, ReadLE32(data, 1));  // nodes
+  EXPECT_EQ(3u, ReadLE32(data, 2));  // edges
+  EXPECT_EQ(2u, ReadLE32(data, 3));  // rules
+  uint32_t string_bytes = ReadLE32(data, 4);
+  EXPECT_EQ(string("linkcat") + "outmidotherin1in2impoo",
+            data.substr(data.size() - string_bytes));
+
+  // rule_name, node_path, node_in_edge, node_dirty, edge_rule,
+  // edge_implicit, edge_order_only, then the inputs and outputs in CSR form.
+  size_t index = 5 + 3 + 8 + 7 + 7 + 3 + 3 + 3;
+  EXPECT_EQ(1u, ReadLE32(data, 5 + 3 + 8 + 1));  // mid's in edge
+  EXPECT_EQ(0xffffffffu, ReadLE32(data, 5 + 3 + 8 + 3));  // in1 has none
+  EXPECT_EQ(0u, ReadLE32(data, index));
+  EXPECT_EQ(2u, ReadLE32(data, index + 1));
+  EXPECT_EQ(6u, ReadLE32(data, index + 2));
+  EXPECT_EQ(7u, ReadLE32(data, index + 3));
+  index += 4 + 7;
+  EXPECT_EQ(3u, ReadLE32(data, index + 3));
+  index += 4 + 3;
+  EXPECT_EQ(data.size() - string_bytes, 8 + 4 * index);
+}
+
+TEST_F(GraphExportTest, Dot) {
+  string dot = Export(GraphExportOptions(), 'd');
+  EXPECT_EQ(0u, dot.find("digraph ninja {\n"));
+  EXPECT_NE(string::npos, dot.find("\"n0\" [label=\"out\"]\n"));
+  EXPECT_NE(string::npos, dot.find("\"n3\" -> \"n2\" [label=\" cat\"]\n"));
+  EXPECT_NE(string::npos, dot.find(
+      "\"n6\" -> \"e1\" [arrowhead=none style=dotted]\n"));
+}
+
+}  // namespace
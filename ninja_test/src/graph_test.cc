@@ -110,8 +110,8 @@ TEST_F(GraphTest, ImplicitOutputParse) {
 
   Edge* edge = GetNode("out")->in_edge();
   EXPECT_EQ(size_t(2), edge->outputs_.size());
-  EXPECT_EQ("out", edge->outputs_[0]->path());
-  EXPECT_EQ("out.imp", edge->outputs_[1]->path());
+  EXPECT_EQ("out", edge->outputs_[0]->path().AsString());
+  EXPECT_EQ("out.imp", edge->outputs_[1]->path().AsString());
   EXPECT_EQ(1, edge->implicit_outs_);
   EXPECT_EQ(edge, GetNode("out.imp")->in_edge());
 }
@@ -152,7 +152,7 @@ TEST_F(GraphTest, ImplicitOutputOnlyParse) {
 
   Edge* edge = GetNode("out.imp")->in_edge();
   EXPECT_EQ(size_t(1), edge->outputs_.size());
-  EXPECT_EQ("out.imp", edge->outputs_[0]->path());
+  EXPECT_EQ("out.imp", edge->outputs_[0]->path().AsString());
   EXPECT_EQ(1, edge->implicit_outs_);
   EXPECT_EQ(edge, GetNode("out.imp")->in_edge());
 }
@@ -211,7 +211,7 @@ TEST_F(GraphTest, RootNodes) {
   vector<Node*> root_nodes = state_.RootNodes(&err);
   EXPECT_EQ(4u, root_nodes.size());
   for (size_t i = 0; i < root_nodes.size(); ++i) {
-    string name = root_nodes[i]->path();
+    string name = root_nodes[i]->path().AsString();
     EXPECT_EQ("out", name.substr(0, 3));
   }
 }
@@ -359,6 +359,23 @@ TEST_F(GraphTest, CommandCollector) {
   }
 }
 
+TEST_F(GraphTest, CommandCollectorDeepChain) {
+  // Deep enough to overflow the stack of a recursive walk.
+  const int kDepth = 200000;
+  Node* in = GetNode("in");
+  for (int i = 0; i < kDepth; ++i) {
+    Edge* edge = state_.AddEdge(state_.bindings_.LookupRule("cat"));
+    state_.AddIn(edge, in->path(), 0);
+    state_.AddOut(edge, "out" + std::to_string(i), 0, nullptr);
+    in = GetNode("out" + std::to_string(i));
+  }
+
+  CommandCollector collector;
+  collector.CollectFrom(in);
+  ASSERT_EQ(size_t(kDepth), collector.in_edges.size());
+  EXPECT_EQ("cat in > out0", collector.in_edges[0]->EvaluateCommand());
+}
+
 TEST_F(GraphTest, VarInOutPathEscaping) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
 "build a$ b: cat no'space with$ space$$ no\"space2\n"));
@@ -427,6 +444,28 @@ TEST_F(GraphTest, RuleVariablesInScope) {
   EXPECT_EQ("depfile is x", edge->EvaluateCommand());
 }
 
+// The compiled command must expand the same way as the rule binding.
+TEST_F(GraphTest, CommandTemplate) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"flags = -O2\n"
+"rule r\n"
+"  command = cc $flags $in$in_newline -o $out -MF $depfile\n"
+"  depfile = $out.d\n"
+"build out1 | out1.imp: r in1 in2 | implicit || order\n"
+"build out2: r\n"
+"  flags = -g\n"
+"build out3: r in3\n"
+"  command = override\n"));
+  Edge* edge = GetNode("out1")->in_edge();
+  EXPECT_EQ("cc -O2 in1 in2in1\nin2 -o out1 -MF out1.d",
+            edge->EvaluateCommand());
+  EXPECT_EQ(edge->GetBinding("command"), edge->EvaluateCommand());
+  EXPECT_EQ("cc -g  -o out2 -MF out2.d",
+            GetNode("out2")->in_edge()->EvaluateCommand());
+  // The build statement's own binding shadows the rule's.
+  EXPECT_EQ("override", GetNode("out3")->in_edge()->EvaluateCommand());
+}
+
 // Check that build statements can override rule builtins like depfile.
 TEST_F(GraphTest, DepfileOverride) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
@@ -550,7 +589,7 @@ TEST_F(GraphTest, CycleWithLengthZeroFromDepfile) {
   // only once:
   Edge* edge = GetNode("a")->in_edge();
   EXPECT_EQ(size_t(1), edge->inputs_.size());
-  EXPECT_EQ("b", edge->inputs_[0]->path());
+  EXPECT_EQ("b", edge->inputs_[0]->path().AsString());
 }
 
 // Like CycleWithLengthZeroFromDepfile but with a higher cycle length.
@@ -575,7 +614,7 @@ TEST_F(GraphTest, CycleWithLengthOneFromDepfile) {
   // output)), the deps should have been loaded only once:
   Edge* edge = GetNode("a")->in_edge();
   EXPECT_EQ(size_t(1), edge->inputs_.size());
-  EXPECT_EQ("c", edge->inputs_[0]->path());
+  EXPECT_EQ("c", edge->inputs_[0]->path().AsString());
 }
 
 // Like CycleWithLengthOneFromDepfile but building a node one hop away from
@@ -602,7 +641,7 @@ TEST_F(GraphTest, CycleWithLengthOneFromDepfileOneHopAway) {
   // output)), the deps should have been loaded only once:
   Edge* edge = GetNode("a")->in_edge();
   EXPECT_EQ(size_t(1), edge->inputs_.size());
-  EXPECT_EQ("c", edge->inputs_[0]->path());
+  EXPECT_EQ("c", edge->inputs_[0]->path().AsString());
 }
 
 #ifdef _WIN32
@@ -615,10 +654,10 @@ TEST_F(GraphTest, Decanonicalize) {
   string err;
   vector<Node*> root_nodes = state_.RootNodes(&err);
   EXPECT_EQ(4u, root_nodes.size());
-  EXPECT_EQ(root_nodes[0]->path(), "out/out1");
-  EXPECT_EQ(root_nodes[1]->path(), "out/out2/out3/out4");
-  EXPECT_EQ(root_nodes[2]->path(), "out3");
-  EXPECT_EQ(root_nodes[3]->path(), "out4/foo");
+  EXPECT_EQ(root_nodes[0]->path().AsString(), "out/out1");
+  EXPECT_EQ(root_nodes[1]->path().AsString(), "out/out2/out3/out4");
+  EXPECT_EQ(root_nodes[2]->path().AsString(), "out3");
+  EXPECT_EQ(root_nodes[3]->path().AsString(), "out4/foo");
   EXPECT_EQ(root_nodes[0]->PathDecanonicalized(), "out\\out1");
   EXPECT_EQ(root_nodes[1]->PathDecanonicalized(), "out\\out2/out3\\out4");
   EXPECT_EQ(root_nodes[2]->PathDecanonicalized(), "out3");
@@ -646,10 +685,10 @@ TEST_F(GraphTest, DyndepLoadTrivial) {
 
   Edge* edge = GetNode("out")->in_edge();
   ASSERT_EQ(size_t(1), edge->outputs_.size());
-  EXPECT_EQ("out", edge->outputs_[0]->path());
+  EXPECT_EQ("out", edge->outputs_[0]->path().AsString());
   ASSERT_EQ(size_t(2), edge->inputs_.size());
-  EXPECT_EQ("in", edge->inputs_[0]->path());
-  EXPECT_EQ("dd", edge->inputs_[1]->path());
+  EXPECT_EQ("in", edge->inputs_[0]->path().AsString());
+  EXPECT_EQ("dd", edge->inputs_[1]->path().AsString());
   EXPECT_EQ(0, edge->implicit_deps_);
   EXPECT_EQ(1, edge->order_only_deps_);
   EXPECT_FALSE(edge->GetBindingBool("restat"));
@@ -676,11 +715,11 @@ TEST_F(GraphTest, DyndepLoadImplicit) {
 
   Edge* edge = GetNode("out1")->in_edge();
   ASSERT_EQ(size_t(1), edge->outputs_.size());
-  EXPECT_EQ("out1", edge->outputs_[0]->path());
+  EXPECT_EQ("out1", edge->outputs_[0]->path().AsString());
   ASSERT_EQ(size_t(3), edge->inputs_.size());
-  EXPECT_EQ("in", edge->inputs_[0]->path());
-  EXPECT_EQ("out2", edge->inputs_[1]->path());
-  EXPECT_EQ("dd", edge->inputs_[2]->path());
+  EXPECT_EQ("in", edge->inputs_[0]->path().AsString());
+  EXPECT_EQ("out2", edge->inputs_[1]->path().AsString());
+  EXPECT_EQ("dd", edge->inputs_[2]->path().AsString());
   EXPECT_EQ(1, edge->implicit_deps_);
   EXPECT_EQ(1, edge->order_only_deps_);
   EXPECT_FALSE(edge->GetBindingBool("restat"));
@@ -809,13 +848,13 @@ TEST_F(GraphTest, DyndepLoadMultiple) {
 
   Edge* edge1 = GetNode("out1")->in_edge();
   ASSERT_EQ(size_t(2), edge1->outputs_.size());
-  EXPECT_EQ("out1", edge1->outputs_[0]->path());
-  EXPECT_EQ("out1imp", edge1->outputs_[1]->path());
+  EXPECT_EQ("out1", edge1->outputs_[0]->path().AsString());
+  EXPECT_EQ("out1imp", edge1->outputs_[1]->path().AsString());
   EXPECT_EQ(1, edge1->implicit_outs_);
   ASSERT_EQ(size_t(3), edge1->inputs_.size());
-  EXPECT_EQ("in1", edge1->inputs_[0]->path());
-  EXPECT_EQ("in1imp", edge1->inputs_[1]->path());
-  EXPECT_EQ("dd", edge1->inputs_[2]->path());
+  EXPECT_EQ("in1", edge1->inputs_[0]->path().AsString());
+  EXPECT_EQ("in1imp", edge1->inputs_[1]->path().AsString());
+  EXPECT_EQ("dd", edge1->inputs_[2]->path().AsString());
   EXPECT_EQ(1, edge1->implicit_deps_);
   EXPECT_EQ(1, edge1->order_only_deps_);
   EXPECT_FALSE(edge1->GetBindingBool("restat"));
@@ -826,12 +865,12 @@ TEST_F(GraphTest, DyndepLoadMultiple) {
 
   Edge* edge2 = GetNode("out2")->in_edge();
   ASSERT_EQ(size_t(1), edge2->outputs_.size());
-  EXPECT_EQ("out2", edge2->outputs_[0]->path());
+  EXPECT_EQ("out2", edge2->outputs_[0]->path().AsString());
   EXPECT_EQ(0, edge2->implicit_outs_);
   ASSERT_EQ(size_t(3), edge2->inputs_.size());
-  EXPECT_EQ("in2", edge2->inputs_[0]->path());
-  EXPECT_EQ("in2imp", edge2->inputs_[1]->path());
-  EXPECT_EQ("dd", edge2->inputs_[2]->path());
+  EXPECT_EQ("in2", edge2->inputs_[0]->path().AsString());
+  EXPECT_EQ("in2imp", edge2->inputs_[1]->path().AsString());
+  EXPECT_EQ("dd", edge2->inputs_[2]->path().AsString());
   EXPECT_EQ(1, edge2->implicit_deps_);
   EXPECT_EQ(1, edge2->order_only_deps_);
   EXPECT_TRUE(edge2->GetBindingBool("restat"));
@@ -1027,9 +1066,9 @@ TEST_F(GraphTest, DyndepFileCircular) {
   // Verify that "out.d" was loaded exactly once despite
   // circular reference discovered from dyndep file.
   ASSERT_EQ(size_t(3), edge->inputs_.size());
-  EXPECT_EQ("in", edge->inputs_[0]->path());
-  EXPECT_EQ("inimp", edge->inputs_[1]->path());
-  EXPECT_EQ("dd", edge->inputs_[2]->path());
+  EXPECT_EQ("in", edge->inputs_[0]->path().AsString());
+  EXPECT_EQ("inimp", edge->inputs_[1]->path().AsString());
+  EXPECT_EQ("dd", edge->inputs_[2]->path().AsString());
   EXPECT_EQ(1, edge->implicit_deps_);
   EXPECT_EQ(1, edge->order_only_deps_);
 }
@@ -1046,7 +1085,7 @@ TEST_F(GraphTest, Validation) {
   ASSERT_EQ("", err);
 
   ASSERT_EQ(validation_nodes.size(), size_t(1));
-  EXPECT_EQ(validation_nodes[0]->path(), "validate");
+  EXPECT_EQ(validation_nodes[0]->path().AsString(), "validate");
 
   EXPECT_TRUE(GetNode("out")->dirty());
   EXPECT_TRUE(GetNode("validate")->dirty());
@@ -18,33 +18,44 @@
 #include <string>
 
 std::string EncodeJSONString(const std::string& in) {
-  static const char* hex_digits = "0123456789abcdef";
   std::string out;
   out.reserve(in.length() * 1.2);
-  for (std::string::const_iterator it = in.begin(); it != in.end(); ++it) {
-    char c = *it;
+  AppendJSONString(in, &out);
+  return out;
+}
+
+void AppendJSONString(StringPiece in, std::string* out) {
+  static const char* hex_digits = "0123456789abcdef";
+  // Copy runs of characters that need no escaping in one go.
+  const char* run = in.str_;
+  const char* end = run + in.len_;
+  for (const char* p = run; p != end; ++p) {
+    unsigned char c = *p;
+    if (c >= 0x20 && c != '\\' && c != '\"')
+      continue;
+    out->append(run, p - run);
+    run = p + 1;
     if (c == '\b')
-      out += "\\b";
+      out->append("\\b");
     else if (c == '\f')
-      out += "\\f";
+      out->append("\\f");
     else if (c == '\n')
-      out += "\\n";
+      out->append("\\n");
     else if (c == '\r')
-      out += "\\r";
+      out->append("\\r");
     else if (c == '\t')
-      out += "\\t";
-    else if (0x0 <= c && c < 0x20) {
-      out += "\\u00";
-      out += hex_digits[c >> 4];
-      out += hex_digits[c & 0xf];
-    } else if (c == '\\')
-      out += "\\\\";
+      out->append("\\t");
+    else if (c == '\\')
+      out->append("\\\\");
     else if (c == '\"')
-      out += "\\\"";
-    else
-      out += c;
+      out->append("\\\"");
+    else {
+      out->append("\\u00");
+      *out += hex_digits[c >> 4];
+      *out += hex_digits[c & 0xf];
+    }
   }
-  return out;
+  out->append(run, end - run);
 }
 
 void PrintJSONString(const std::string& in) {
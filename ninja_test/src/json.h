@@ -17,9 +17,14 @@
 
 #include <string>
 
+#include "string_piece.h"
+
 // Encode a string in JSON format without enclosing quotes
 std::string EncodeJSONString(const std::string& in);
 
+// Like EncodeJSONString, but append to |out|
+void AppendJSONString(StringPiece in, std::string* out);
+
 // Print a string in JSON format to stdout without enclosing quotes
 void PrintJSONString(const std::string& in);
 
@@ -38,3 +38,11 @@ TEST(JSONTest, UTF8) {
   const char* utf8str = "\xe4\xbd\xa0\xe5\xa5\xbd";
   EXPECT_EQ(EncodeJSONString(utf8str), utf8str);
 }
+
+TEST(JSONTest, Append) {
+  std::string out = "[\"";
+  AppendJSONString("a\"b\x01", &out);
+  AppendJSONString("", &out);
+  AppendJSONString("c", &out);
+  EXPECT_EQ("[\"a\\\"b\\u0001c", out);
+}
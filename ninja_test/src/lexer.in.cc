@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 
+#include "byte_scan.h"
 #include "eval_env.h"
 #include "util.h"
 
@@ -210,8 +211,16 @@ bool Lexer::ReadEvalString(EvalString* eval, bool path, string* err) {
   const char* p = ofs_;
   const char* q;
   const char* start;
+  const char* end = input_.str_ + input_.len_;
   for (;;) {
     start = p;
+    // Literal text is the common case; skip over it a block at a time.
+    // Splitting a run of text into pieces is invisible to the EvalString.
+    p = byte_scan::FindEvalStringSpecial(p, end);
+    if (p != start) {
+      eval->AddText(StringPiece(start, p - start));
+      continue;
+    }
     /*!re2c
     [^$ :\r\n|\000]+ {
       eval->AddText(StringPiece(start, p - start));
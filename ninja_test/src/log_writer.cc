@@ -0,0 +1,165 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "log_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "wait_slice.h"
+
+using namespace std;
+
+namespace {
+
+/// How long the writer thread lets records gather before writing them.
+const chrono::milliseconds kBatchInterval(4);
+
+int SyncFile(FILE* file) {
+#ifdef _WIN32
+  return _commit(_fileno(file));
+#elif defined(__linux__)
+  return fdatasync(fileno(file));
+#else
+  return fsync(fileno(file));
+#endif
+}
+
+}  // namespace
+
+void LogWriter::Open(FILE* file) {
+  file_ = file;
+  error_ = 0;
+  closing_ = false;
+  if (durability_ != kFlushEachRecord)
+    thread_ = thread(&LogWriter::Run, this);
+}
+
+bool LogWriter::Append(const void* data, size_t size) {
+  if (durability_ == kFlushEachRecord) {
+    if (fwrite(data, size, 1, file_) < 1)
+      return false;
+    return fflush(file_) == 0;
+  }
+
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (error_) {
+      errno = error_;
+      return false;
+    }
+    pending_.append(static_cast<const char*>(data), size);
+  }
+  wake_cv_.notify_one();
+  return true;
+}
+
+bool LogWriter::Flush() {
+  if (!thread_.joinable())
+    return true;
+
+  unique_lock<mutex> lock(mutex_);
+  ++flushing_;
+  wake_cv_.notify_one();
+  while (!pending_.empty() || writing_)
+    WaitSlice(&written_cv_, &lock);
+  --flushing_;
+  if (error_) {
+    errno = error_;
+    return false;
+  }
+  return true;
+}
+
+bool LogWriter::Close() {
+  if (!file_)
+    return true;
+
+  int error = 0;
+  if (thread_.joinable()) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      closing_ = true;
+    }
+    wake_cv_.notify_one();
+    thread_.join();
+    error = error_;
+  }
+  if (fclose(file_) != 0 && !error)
+    error = errno;
+  file_ = NULL;
+  if (error) {
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+void LogWriter::Run() {
+  unique_lock<mutex> lock(mutex_);
+  for (;;) {
+    while (pending_.empty() && !closing_)
+      WaitSlice(&wake_cv_, &lock);
+    if (pending_.empty())
+      return;
+
+    // Let the records of the other commands finishing about now join in,
+    // unless someone is waiting for them.
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + kBatchInterval;
+    while (!closing_ && !flushing_ &&
+           wake_cv_.wait_until(lock, deadline) != cv_status::timeout) {
+    }
+
+    string batch;
+    batch.swap(pending_);
+    writing_ = true;
+    lock.unlock();
+    int error = Write(batch);
+    lock.lock();
+    writing_ = false;
+    if (error && !error_)
+      error_ = error;
+    written_cv_.notify_all();
+  }
+}
+
+int LogWriter::Write(const string& data) {
+  errno = 0;
+  if (fwrite(data.data(), data.size(), 1, file_) < 1 || fflush(file_) != 0 ||
+      (durability_ == kBatchSync && SyncFile(file_) != 0)) {
+    return errno ? errno : EIO;
+  }
+  return 0;
+}
+
+bool ParseLogDurability(const char* value, LogWriter::Durability* durability) {
+  if (strcmp(value, "record") == 0)
+    *durability = LogWriter::kFlushEachRecord;
+  else if (strcmp(value, "batch") == 0)
+    *durability = LogWriter::kBatch;
+  else if (strcmp(value, "sync") == 0)
+    *durability = LogWriter::kBatchSync;
+  else
+    return false;
+  return true;
+}
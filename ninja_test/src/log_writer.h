@@ -0,0 +1,89 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_LOG_WRITER_H_
+#define NINJA_LOG_WRITER_H_
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// Appends whole records to one of the logs ninja writes while building
+/// (.ninja_log, .ninja_deps).
+///
+/// Records are only ever appended, and both logs treat an output without a
+/// valid record (missing, or older than the output) as dirty.  So however
+/// records are batched, an output is never considered up to date after a
+/// crash unless its record made it to disk; a crash only costs rebuilding
+/// the outputs whose records were still in flight.
+struct LogWriter {
+  enum Durability {
+    /// Write and flush each record to the OS before Append() returns.
+    kFlushEachRecord,
+    /// Hand records to a writer thread that writes everything that
+    /// accumulated over a few milliseconds at once.
+    kBatch,
+    /// Like kBatch, and sync each batch to the disk.
+    kBatchSync,
+  };
+
+  LogWriter() : durability_(kFlushEachRecord), file_(NULL), error_(0),
+                writing_(false), flushing_(0), closing_(false) {}
+  ~LogWriter() { Close(); }
+
+  /// Must be called while no file is open.
+  void set_durability(Durability durability) { durability_ = durability; }
+  Durability durability() const { return durability_; }
+
+  /// Take ownership of |file|, positioned at its end.
+  void Open(FILE* file);
+  bool is_open() const { return file_ != NULL; }
+
+  /// Append one record.  When false is returned, errno will be set; with
+  /// batching this may report the failure to write an earlier record.
+  bool Append(const void* data, size_t size);
+
+  /// Wait until all records appended so far have been written (and, for
+  /// kBatchSync, synced).  When false is returned, errno will be set.
+  bool Flush();
+
+  /// Flush, then close the file.  When false is returned, errno will be set.
+  bool Close();
+
+ private:
+  void Run();
+  /// Write |data| to file_ according to durability_.  Returns 0 or errno.
+  int Write(const std::string& data);
+
+  Durability durability_;
+  FILE* file_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable written_cv_;
+  std::string pending_;
+  int error_;
+  bool writing_;
+  int flushing_;
+  bool closing_;
+  std::thread thread_;
+};
+
+/// Parse the value of --log-durability ("record", "batch" or "sync").
+bool ParseLogDurability(const char* value, LogWriter::Durability* durability);
+
+#endif  // NINJA_LOG_WRITER_H_
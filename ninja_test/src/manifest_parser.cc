@@ -160,6 +160,9 @@ bool ManifestParser::ParseRule(string* err) {
       return false;
 
     if (Rule::IsReservedBinding(key)) {
+      // The lexer's tokens point into the manifest text, which is freed
+      // once parsing is done; rules outlive it.
+      value.Persist(&state_->arena_);
       rule->AddBinding(key, value);
     } else {
       // Die on other keyvals for now; revisit if we want to add a
@@ -323,7 +326,11 @@ bool ManifestParser::ParseEdge(string* err) {
   // 处理额外绑定（缩进行）如果有缩进（比如 pool = mypool），读键值对，存到环境变量 env 中
   // Bindings on edges are rare, so allocate per-edge envs only when needed.
   bool has_indent_token = lexer_.PeekToken(Lexer::INDENT);
-  BindingEnv* env = has_indent_token ? new BindingEnv(env_) : env_;
+  BindingEnv* env = env_;
+  if (has_indent_token) {
+    env = new BindingEnv(env_);
+    state_->scopes_.emplace_back(env);
+  }
   while (has_indent_token) {
     string key;
     EvalString val;
@@ -350,7 +357,8 @@ bool ManifestParser::ParseEdge(string* err) {
 // 如果路径为空或添加失败，报错。
   edge->outputs_.reserve(outs_.size());
   for (size_t i = 0, e = outs_.size(); i != e; ++i) {
-    string path = outs_[i].Evaluate(env);
+    string& path = path_buf_;
+    outs_[i].EvaluateInto(env, &path);
     if (path.empty())
       return lexer_.Error("empty path", err);
     uint64_t slash_bits;
@@ -374,7 +382,8 @@ bool ManifestParser::ParseEdge(string* err) {
 
   edge->inputs_.reserve(ins_.size());
   for (vector<EvalString>::iterator i = ins_.begin(); i != ins_.end(); ++i) {
-    string path = i->Evaluate(env);
+    string& path = path_buf_;
+    i->EvaluateInto(env, &path);
     if (path.empty())
       return lexer_.Error("empty path", err);
     uint64_t slash_bits;
@@ -387,7 +396,8 @@ bool ManifestParser::ParseEdge(string* err) {
   edge->validations_.reserve(validations_.size());
   for (std::vector<EvalString>::iterator v = validations_.begin();
       v != validations_.end(); ++v) {
-    string path = v->Evaluate(env);
+    string& path = path_buf_;
+    v->EvaluateInto(env, &path);
     if (path.empty())
       return lexer_.Error("empty path", err);
     uint64_t slash_bits;
@@ -409,7 +419,7 @@ bool ManifestParser::ParseEdge(string* err) {
       if (!quiet_) {
         Warning("phony target '%s' names itself as an input; "
                 "ignoring [-w phonycycle=warn]",
-                out->path().c_str());
+                out->path().str_);
       }
     }
   }
@@ -445,6 +455,7 @@ bool ManifestParser::ParseFileInclude(bool new_scope, string* err) {
   }
   if (new_scope) {
     subparser_->env_ = new BindingEnv(env_);
+    state_->scopes_.emplace_back(subparser_->env_);
   } else {
     subparser_->env_ = env_;
   }
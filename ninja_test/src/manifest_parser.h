@@ -72,6 +72,8 @@ private:
   // subparser_ is reused solely to get better reuse out ins_/outs_/validation_.
   std::unique_ptr<ManifestParser> subparser_;
   std::vector<EvalString> ins_, outs_, validations_;
+  // path_buf_ holds each evaluated path in turn, for the same reason.
+  std::string path_buf_;
 };
 
 #endif  // NINJA_MANIFEST_PARSER_H_
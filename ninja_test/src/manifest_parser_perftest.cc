@@ -15,6 +15,7 @@
 // Tests manifest parser performance.  Expects to be run in ninja's root
 // directory.
 
+#include <new>
 #include <numeric>
 
 #include <errno.h>
@@ -33,6 +34,11 @@
 #include <unistd.h>
 #endif
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "byte_scan.h"
 #include "disk_interface.h"
 #include "graph.h"
 #include "manifest_parser.h"
@@ -42,6 +48,40 @@
 
 using namespace std;
 
+/// Number of heap allocations made through operator new.
+static size_t g_allocation_count = 0;
+
+void* operator new(size_t size) {
+  ++g_allocation_count;
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+/// Peak RSS of this process in KiB, or 0 if unknown.
+static long PeakRss() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) < 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
 bool WriteFakeManifests(const string& dir, string* err) {
   RealDiskInterface disk_interface;
   TimeStamp mtime = disk_interface.Stat(dir + "/build.ninja", err);
@@ -76,6 +116,59 @@ int LoadManifests(bool measure_command_evaluation) {
   return optimization_guard;
 }
 
+/// Remembers the contents of every file the parser reads.
+struct RecordingDiskInterface : public RealDiskInterface {
+  virtual Status ReadFile(const string& path, string* contents, string* err) {
+    Status status = RealDiskInterface::ReadFile(path, contents, err);
+    if (status == Okay)
+      files_.push_back(*contents);
+    return status;
+  }
+  vector<string> files_;
+};
+
+/// Scan |files| for EvalString specials the way the lexer does, with
+/// |find|.  @return throughput in MB/s.
+double ScanRate(const vector<string>& files,
+                const char* (*find)(const char*, const char*),
+                int* optimization_guard) {
+  const int kRepetitions = 20;
+  size_t bytes = 0;
+  int64_t start = GetTimeMillis();
+  for (int i = 0; i < kRepetitions; ++i) {
+    for (vector<string>::const_iterator f = files.begin(); f != files.end();
+         ++f) {
+      const char* end = f->data() + f->size();
+      for (const char* p = f->data(); p < end; ++p) {
+        p = find(p, end);
+        ++*optimization_guard;
+      }
+      bytes += f->size();
+    }
+  }
+  int64_t delta = GetTimeMillis() - start;
+  return bytes / 1000.0 / max<int64_t>(delta, 1);
+}
+
+/// Compare the lexer's block and byte-at-a-time text scanning.
+void MeasureLexerScan() {
+  string err;
+  RecordingDiskInterface disk_interface;
+  State state;
+  ManifestParser parser(&state, &disk_interface);
+  if (!parser.Load("build.ninja", &err)) {
+    fprintf(stderr, "Failed to read test data: %s\n", err.c_str());
+    exit(1);
+  }
+  int guard = 0;
+  double block = ScanRate(disk_interface.files_,
+                          byte_scan::FindEvalStringSpecial, &guard);
+  double scalar = ScanRate(disk_interface.files_,
+                           byte_scan::FindEvalStringSpecialScalar, &guard);
+  printf("text scan: block %.0fMB/s  scalar %.0fMB/s (guard: %x)\n", block,
+         scalar, guard);
+}
+
 int main(int argc, char* argv[]) {
   bool measure_command_evaluation = true;
   int opt;
@@ -109,10 +202,13 @@ int main(int argc, char* argv[]) {
   const int kNumRepetitions = 5;
   vector<int> times;
   for (int i = 0; i < kNumRepetitions; ++i) {
+    size_t allocations = g_allocation_count;
     int64_t start = GetTimeMillis();
     int optimization_guard = LoadManifests(measure_command_evaluation);
     int delta = (int)(GetTimeMillis() - start);
-    printf("%dms (hash: %x)\n", delta, optimization_guard);
+    allocations = g_allocation_count - allocations;
+    printf("%dms, %zu allocations (hash: %x)\n", delta, allocations,
+           optimization_guard);
     times.push_back(delta);
   }
 
@@ -120,4 +216,6 @@ int main(int argc, char* argv[]) {
   int max = *max_element(times.begin(), times.end());
   float total = accumulate(times.begin(), times.end(), 0.0f);
   printf("min %dms  max %dms  avg %.1fms\n", min, max, total / times.size());
+  printf("peak RSS %ldKiB\n", PeakRss());
+  MeasureLexerScan();
 }
@@ -239,9 +239,9 @@ TEST_F(ParserTest, EscapeSpaces) {
 "build foo$ bar: spaces $$one two$$$ three\n"
 ));
   EXPECT_TRUE(state.LookupNode("foo bar"));
-  EXPECT_EQ(state.edges_[0]->outputs_[0]->path(), "foo bar");
-  EXPECT_EQ(state.edges_[0]->inputs_[0]->path(), "$one");
-  EXPECT_EQ(state.edges_[0]->inputs_[1]->path(), "two$ three");
+  EXPECT_EQ(state.edges_[0]->outputs_[0]->path().AsString(), "foo bar");
+  EXPECT_EQ(state.edges_[0]->inputs_[0]->path().AsString(), "$one");
+  EXPECT_EQ(state.edges_[0]->inputs_[1]->path().AsString(), "two$ three");
   EXPECT_EQ(state.edges_[0]->EvaluateCommand(), "something");
 }
 
@@ -945,7 +945,7 @@ TEST_F(ParserTest, Validations) {
 
   Edge* edge = state.LookupNode("foo")->in_edge();
   ASSERT_EQ(edge->validations_.size(), size_t(1));
-  EXPECT_EQ(edge->validations_[0]->path(), "baz");
+  EXPECT_EQ(edge->validations_[0]->path().AsString(), "baz");
 }
 
 TEST_F(ParserTest, ImplicitOutput) {
@@ -1039,9 +1039,9 @@ TEST_F(ParserTest, DefaultStatements) {
   vector<Node*> nodes = state.DefaultNodes(&err);
   EXPECT_EQ("", err);
   ASSERT_EQ(3u, nodes.size());
-  EXPECT_EQ("a", nodes[0]->path());
-  EXPECT_EQ("b", nodes[1]->path());
-  EXPECT_EQ("c", nodes[2]->path());
+  EXPECT_EQ("a", nodes[0]->path().AsString());
+  EXPECT_EQ("b", nodes[1]->path().AsString());
+  EXPECT_EQ("c", nodes[2]->path().AsString());
 }
 
 TEST_F(ParserTest, UTF8) {
@@ -1098,7 +1098,7 @@ TEST_F(ParserTest, DyndepExplicitInput) {
   Edge* edge = state.GetNode("result", 0)->in_edge();
   ASSERT_TRUE(edge->dyndep_);
   EXPECT_TRUE(edge->dyndep_->dyndep_pending());
-  EXPECT_EQ(edge->dyndep_->path(), "in");
+  EXPECT_EQ(edge->dyndep_->path().AsString(), "in");
 }
 
 TEST_F(ParserTest, DyndepImplicitInput) {
@@ -1110,7 +1110,7 @@ TEST_F(ParserTest, DyndepImplicitInput) {
   Edge* edge = state.GetNode("result", 0)->in_edge();
   ASSERT_TRUE(edge->dyndep_);
   EXPECT_TRUE(edge->dyndep_->dyndep_pending());
-  EXPECT_EQ(edge->dyndep_->path(), "dd");
+  EXPECT_EQ(edge->dyndep_->path().AsString(), "dd");
 }
 
 TEST_F(ParserTest, DyndepOrderOnlyInput) {
@@ -1122,7 +1122,7 @@ TEST_F(ParserTest, DyndepOrderOnlyInput) {
   Edge* edge = state.GetNode("result", 0)->in_edge();
   ASSERT_TRUE(edge->dyndep_);
   EXPECT_TRUE(edge->dyndep_->dyndep_pending());
-  EXPECT_EQ(edge->dyndep_->path(), "dd");
+  EXPECT_EQ(edge->dyndep_->path().AsString(), "dd");
 }
 
 TEST_F(ParserTest, DyndepRuleInput) {
@@ -1134,5 +1134,5 @@ TEST_F(ParserTest, DyndepRuleInput) {
   Edge* edge = state.GetNode("result", 0)->in_edge();
   ASSERT_TRUE(edge->dyndep_);
   EXPECT_TRUE(edge->dyndep_->dyndep_pending());
-  EXPECT_EQ(edge->dyndep_->path(), "in");
+  EXPECT_EQ(edge->dyndep_->path().AsString(), "in");
 }
@@ -16,7 +16,10 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 #include "depfile_parser.h"
 #include "deps_log.h"
@@ -65,7 +68,7 @@ MissingDependencyScannerDelegate::~MissingDependencyScannerDelegate() {}
 
 void MissingDependencyPrinter::OnMissingDep(Node* node, const std::string& path,
                                             const Rule& generator) {
-  std::cout << "Missing dep: " << node->path() << " uses " << path
+  std::cout << "Missing dep: " << node->path().str_ << " uses " << path
             << " (generated by " << generator.name() << ")\n";
 }
 
@@ -76,6 +79,50 @@ MissingDependencyScanner::MissingDependencyScanner(
       disk_interface_(disk_interface), missing_dep_path_count_(0) {}
 
 void MissingDependencyScanner::ProcessNode(Node* node) {
+  ProcessNodes(std::vector<Node*>(1, node), 1);
+}
+
+void MissingDependencyScanner::ProcessNodes(const std::vector<Node*>& nodes,
+                                            int threads) {
+  // Looking up deps may add nodes to the state, so that part stays on this
+  // thread.  Checking them only reads the graph.
+  std::vector<NodeDeps> pending;
+  for (std::vector<Node*>::const_iterator it = nodes.begin();
+       it != nodes.end(); ++it) {
+    CollectNode(*it, &pending);
+  }
+
+  if (threads > 1 && pending.size() > 1) {
+    const size_t kChunkSize = 64;
+    std::atomic<size_t> next(0);
+    auto check = [&pending, &next]() {
+      DepsChecker checker;
+      for (;;) {
+        size_t begin = next.fetch_add(kChunkSize);
+        if (begin >= pending.size())
+          return;
+        size_t end = std::min(begin + kChunkSize, pending.size());
+        for (size_t i = begin; i < end; ++i)
+          checker.Check(&pending[i]);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+      workers.push_back(std::thread(check));
+    check();
+    for (size_t i = 0; i < workers.size(); ++i)
+      workers[i].join();
+  } else {
+    for (size_t i = 0; i < pending.size(); ++i)
+      checker_.Check(&pending[i]);
+  }
+
+  for (size_t i = 0; i < pending.size(); ++i)
+    ReportDeps(pending[i]);
+}
+
+void MissingDependencyScanner::CollectNode(Node* node,
+                                           std::vector<NodeDeps>* pending) {
   if (!node)
     return;
   Edge* edge = node->in_edge();
@@ -86,31 +133,56 @@ void MissingDependencyScanner::ProcessNode(Node* node) {
 
   for (std::vector<Node*>::iterator in = edge->inputs_.begin();
        in != edge->inputs_.end(); ++in) {
-    ProcessNode(*in);
+    CollectNode(*in, pending);
   }
 
+  NodeDeps node_deps;
+  node_deps.node = node;
+  node_deps.deps = NULL;
+  node_deps.count = 0;
   std::string deps_type = edge->GetBinding("deps");
   if (!deps_type.empty()) {
     DepsLog::Deps* deps = deps_log_->GetDeps(node);
-    if (deps)
-      ProcessNodeDeps(node, deps->nodes, deps->node_count);
+    if (!deps)
+      return;
+    node_deps.deps = deps->nodes;
+    node_deps.count = deps->node_count;
   } else {
     DepfileParserOptions parser_opts;
-    std::vector<Node*> depfile_deps;
     NodeStoringImplicitDepLoader dep_loader(state_, deps_log_, disk_interface_,
                                             &parser_opts, nullptr,
-                                            &depfile_deps);
+                                            &node_deps.depfile_deps);
     std::string err;
     dep_loader.LoadDeps(edge, &err);
-    if (!depfile_deps.empty())
-      ProcessNodeDeps(node, &depfile_deps[0], depfile_deps.size());
+    if (node_deps.depfile_deps.empty())
+      return;
+    node_deps.count = node_deps.depfile_deps.size();
   }
+  pending->push_back(std::move(node_deps));
 }
 
 void MissingDependencyScanner::ProcessNodeDeps(Node* node, Node** dep_nodes,
                                                int dep_nodes_count) {
-  Edge* edge = node->in_edge();
-  std::set<Edge*> deplog_edges;
+  NodeDeps node_deps;
+  node_deps.node = node;
+  node_deps.deps = dep_nodes;
+  node_deps.count = dep_nodes_count;
+  checker_.Check(&node_deps);
+  ReportDeps(node_deps);
+}
+
+void MissingDependencyScanner::DepsChecker::Check(NodeDeps* node_deps) {
+  Node** dep_nodes = node_deps->depfile_deps.empty()
+                         ? node_deps->deps
+                         : node_deps->depfile_deps.data();
+  int dep_nodes_count = node_deps->count;
+  Edge* edge = node_deps->node->in_edge();
+
+  // Index the edges generating the deps, so that each is checked once and
+  // the deps are matched to the missing ones in a single pass.  Each node
+  // is checked once, so only the paths to its inputs are worth memoizing.
+  std::unordered_map<Edge*, bool>& missing_edges = missing_edges_;
+  missing_edges.clear();
   for (int i = 0; i < dep_nodes_count; ++i) {
     Node* deplog_node = dep_nodes[i];
     // Special exception: A dep on build.ninja can be used to mean "always
@@ -122,36 +194,41 @@ void MissingDependencyScanner::ProcessNodeDeps(Node* node, Node** dep_nodes,
     if (deplog_node->path() == "build.ninja")
       return;
     Edge* deplog_edge = deplog_node->in_edge();
-    if (deplog_edge) {
-      deplog_edges.insert(deplog_edge);
-    }
+    if (deplog_edge)
+      missing_edges.insert(std::make_pair(deplog_edge, false));
   }
-  std::vector<Edge*> missing_deps;
-  for (std::set<Edge*>::iterator de = deplog_edges.begin();
-       de != deplog_edges.end(); ++de) {
-    if (!PathExistsBetween(*de, edge)) {
-      missing_deps.push_back(*de);
-    }
+  bool any_missing = false;
+  for (std::unordered_map<Edge*, bool>::iterator de = missing_edges.begin();
+       de != missing_edges.end(); ++de) {
+    de->second = !PathExistsToInputs(de->first, edge);
+    any_missing = any_missing || de->second;
   }
+  if (!any_missing)
+    return;
 
-  if (!missing_deps.empty()) {
-    std::set<std::string> missing_deps_rule_names;
-    for (std::vector<Edge*>::iterator ne = missing_deps.begin();
-         ne != missing_deps.end(); ++ne) {
-      for (int i = 0; i < dep_nodes_count; ++i) {
-        if (dep_nodes[i]->in_edge() == *ne) {
-          generated_nodes_.insert(dep_nodes[i]);
-          generator_rules_.insert(&(*ne)->rule());
-          missing_deps_rule_names.insert((*ne)->rule().name());
-          delegate_->OnMissingDep(node, dep_nodes[i]->path(), (*ne)->rule());
-        }
-      }
-    }
-    missing_dep_path_count_ += missing_deps_rule_names.size();
-    nodes_missing_deps_.insert(node);
+  for (int i = 0; i < dep_nodes_count; ++i) {
+    Edge* deplog_edge = dep_nodes[i]->in_edge();
+    if (deplog_edge && missing_edges[deplog_edge])
+      node_deps->missing.push_back(dep_nodes[i]);
   }
 }
 
+void MissingDependencyScanner::ReportDeps(const NodeDeps& node_deps) {
+  if (node_deps.missing.empty())
+    return;
+  std::set<std::string> missing_deps_rule_names;
+  for (std::vector<Node*>::const_iterator dep = node_deps.missing.begin();
+       dep != node_deps.missing.end(); ++dep) {
+    const Rule& rule = (*dep)->in_edge()->rule();
+    generated_nodes_.insert(*dep);
+    generator_rules_.insert(&rule);
+    missing_deps_rule_names.insert(rule.name());
+    delegate_->OnMissingDep(node_deps.node, (*dep)->path().AsString(), rule);
+  }
+  missing_dep_path_count_ += missing_deps_rule_names.size();
+  nodes_missing_deps_.insert(node_deps.node);
+}
+
 void MissingDependencyScanner::PrintStats() {
   std::cout << "Processed " << seen_.size() << " nodes.\n";
   if (HadMissingDeps()) {
@@ -171,6 +248,10 @@ void MissingDependencyScanner::PrintStats() {
 }
 
 bool MissingDependencyScanner::PathExistsBetween(Edge* from, Edge* to) {
+  return checker_.PathExists(from, to);
+}
+
+bool MissingDependencyScanner::DepsChecker::PathExists(Edge* from, Edge* to) {
   AdjacencyMap::iterator it = adjacency_map_.find(from);
   if (it != adjacency_map_.end()) {
     InnerAdjacencyMap::iterator inner_it = it->second.find(to);
@@ -180,14 +261,17 @@ bool MissingDependencyScanner::PathExistsBetween(Edge* from, Edge* to) {
   } else {
     it = adjacency_map_.insert(std::make_pair(from, InnerAdjacencyMap())).first;
   }
-  bool found = false;
+  bool found = PathExistsToInputs(from, to);
+  it->second.insert(std::make_pair(to, found));
+  return found;
+}
+
+bool MissingDependencyScanner::DepsChecker::PathExistsToInputs(Edge* from,
+                                                               Edge* to) {
   for (size_t i = 0; i < to->inputs_.size(); ++i) {
     Edge* e = to->inputs_[i]->in_edge();
-    if (e && (e == from || PathExistsBetween(from, e))) {
-      found = true;
-      break;
-    }
+    if (e && (e == from || PathExists(from, e)))
+      return true;
   }
-  it->second.insert(std::make_pair(to, found));
-  return found;
+  return false;
 }
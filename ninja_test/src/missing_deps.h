@@ -18,8 +18,10 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <unordered_map>
+#include <unordered_set>
 
 struct DepsLog;
 struct DiskInterface;
@@ -48,6 +50,10 @@ struct MissingDependencyScanner {
                            DepsLog* deps_log, State* state,
                            DiskInterface* disk_interface);
   void ProcessNode(Node* node);
+  /// ProcessNode() for each of |nodes|, checking the deps of up to |threads|
+  /// nodes at a time.  The delegate is still called on this thread, in the
+  /// same order as by ProcessNode().
+  void ProcessNodes(const std::vector<Node*>& nodes, int threads);
   void PrintStats();
   bool HadMissingDeps() { return !nodes_missing_deps_.empty(); }
 
@@ -59,16 +65,51 @@ struct MissingDependencyScanner {
   DepsLog* deps_log_;
   State* state_;
   DiskInterface* disk_interface_;
-  std::set<Node*> seen_;
+  std::unordered_set<Node*> seen_;
   std::set<Node*> nodes_missing_deps_;
   std::set<Node*> generated_nodes_;
   std::set<const Rule*> generator_rules_;
   int missing_dep_path_count_;
 
  private:
-  using InnerAdjacencyMap = std::unordered_map<Edge*, bool>;
-  using AdjacencyMap = std::unordered_map<Edge*, InnerAdjacencyMap>;
-  AdjacencyMap adjacency_map_;
+  struct NodeDeps;
+
+  /// Checks deps against the graph, memoizing the answers to "is there a
+  /// path from one edge to another".  Each thread checking deps has its own.
+  struct DepsChecker {
+    /// Fill in |node_deps|->missing.
+    void Check(NodeDeps* node_deps);
+    bool PathExists(Edge* from, Edge* to);
+    /// PathExists(), without memoizing the answer for |to| itself.
+    bool PathExistsToInputs(Edge* from, Edge* to);
+
+    using InnerAdjacencyMap = std::unordered_map<Edge*, bool>;
+    using AdjacencyMap = std::unordered_map<Edge*, InnerAdjacencyMap>;
+    AdjacencyMap adjacency_map_;
+    /// The edges generating the deps being checked, and whether they are
+    /// missing a path.  Kept to reuse its buckets.
+    std::unordered_map<Edge*, bool> missing_edges_;
+  };
+
+  /// The deps of one node, waiting to be checked.
+  struct NodeDeps {
+    Node* node;
+    /// Points into the deps log, or is empty and |depfile_deps| is used.
+    Node** deps;
+    int count;
+    std::vector<Node*> depfile_deps;
+    /// Filled in by DepsChecker::Check(): the deps that are generated by an edge
+    /// that |node| has no path from, in the order of the deps.
+    std::vector<Node*> missing;
+  };
+
+  /// Walk the inputs of |node| like ProcessNode(), appending the deps
+  /// to check to |pending|.
+  void CollectNode(Node* node, std::vector<NodeDeps>* pending);
+  /// Record the result of DepsChecker::Check() and tell the delegate.
+  void ReportDeps(const NodeDeps& deps);
+
+  DepsChecker checker_;
 };
 
 #endif  // NINJA_MISSING_DEPS_H_
@@ -0,0 +1,170 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times "ninja -t missingdeps" over a synthetic deps log: objects that each
+// include a few source headers and generated headers, most of them with a
+// path to the generators through a phony stamp and some without.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "deps_log.h"
+#include "disk_interface.h"
+#include "graph.h"
+#include "metrics.h"
+#include "missing_deps.h"
+#include "state.h"
+#include "util.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const char kTestFilename[] = "MissingDepsPerfTest-tempfile";
+
+struct CountingDelegate : public MissingDependencyScannerDelegate {
+  CountingDelegate() : count_(0) {}
+  virtual void OnMissingDep(Node*, const string&, const Rule&) { ++count_; }
+  int count_;
+};
+
+string Name(const char* prefix, int i) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s/%d/%s%d", prefix, i % 97, prefix, i);
+  return buf;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int records = 1000000;
+  const int kGeneratedHeaders = 1000;
+  const int kSourceHeaders = 20000;
+  const int kDepsPerRecord = 12;
+  if (argc > 1)
+    records = atoi(argv[1]);
+  if (records <= 0) {
+    fprintf(stderr, "usage: missing_deps_perftest [records]\n");
+    return 1;
+  }
+
+  State state;
+  Rule gen_rule("gen");
+  Rule cc_rule("cc");
+  EvalString deps_type;
+  deps_type.AddText("gcc");
+  cc_rule.AddBinding("deps", deps_type);
+
+  // Generated headers, gathered by a phony stamp.
+  Edge* stamp = state.AddEdge(state.bindings_.LookupRule("phony"));
+  state.AddOut(stamp, "gen.stamp", 0, nullptr);
+  vector<Node*> generated;
+  for (int i = 0; i < kGeneratedHeaders; ++i) {
+    Edge* edge = state.AddEdge(&gen_rule);
+    string path = Name("gen", i) + ".h";
+    state.AddOut(edge, path, 0, nullptr);
+    state.AddIn(stamp, path, 0);
+    generated.push_back(state.LookupNode(path));
+  }
+  vector<Node*> headers;
+  for (int i = 0; i < kSourceHeaders; ++i)
+    headers.push_back(state.GetNode(Name("inc", i) + ".h", 0));
+
+  // One object in 100 misses the stamp.
+  vector<Node*> objects;
+  for (int i = 0; i < records; ++i) {
+    Edge* edge = state.AddEdge(&cc_rule);
+    state.AddIn(edge, Name("src", i) + ".cc", 0);
+    if (i % 100 != 0) {
+      state.AddIn(edge, "gen.stamp", 0);
+      edge->implicit_deps_ = 1;
+    }
+    string path = Name("obj", i) + ".o";
+    state.AddOut(edge, path, 0, nullptr);
+    objects.push_back(state.LookupNode(path));
+  }
+
+  string err;
+  platformAwareUnlink(kTestFilename);
+  int64_t start = GetTimeMillis();
+  {
+    DepsLog log;
+    if (!log.OpenForWrite(kTestFilename, &err)) {
+      fprintf(stderr, "%s\n", err.c_str());
+      return 1;
+    }
+    vector<Node*> deps(kDepsPerRecord);
+    for (int i = 0; i < records; ++i) {
+      for (int j = 0; j < kDepsPerRecord - 2; ++j)
+        deps[j] = headers[(i * 7 + j * 131) % kSourceHeaders];
+      deps[kDepsPerRecord - 2] = generated[i % kGeneratedHeaders];
+      deps[kDepsPerRecord - 1] = generated[(i * 13) % kGeneratedHeaders];
+      if (!log.RecordDeps(objects[i], 1, deps)) {
+        perror("RecordDeps");
+        return 1;
+      }
+    }
+    log.Close();
+  }
+  printf("wrote %d deps records in %dms\n", records,
+         (int)(GetTimeMillis() - start));
+
+  // Load the log into the same graph, as ninja would at startup.
+  for (State::Paths::iterator i = state.paths_.begin();
+       i != state.paths_.end(); ++i) {
+    i->second->set_id(-1);
+  }
+
+  DepsLog log;
+  start = GetTimeMillis();
+  if (log.Load(kTestFilename, &state, &err) != LOAD_SUCCESS) {
+    fprintf(stderr, "%s\n", err.c_str());
+    return 1;
+  }
+  printf("loaded in %dms\n", (int)(GetTimeMillis() - start));
+
+  vector<Node*> roots = state.RootNodes(&err);
+  if (!err.empty()) {
+    fprintf(stderr, "%s\n", err.c_str());
+    return 1;
+  }
+
+  RealDiskInterface disk_interface;
+  // Also run the threaded path on a single processor, to see its overhead.
+  int thread_counts[] = { 1, max(2, GetProcessorCount()) };
+  for (int t = 0; t < 2; ++t) {
+    CountingDelegate delegate;
+    MissingDependencyScanner scanner(&delegate, &log, &state,
+                                     &disk_interface);
+    start = GetTimeMillis();
+    scanner.ProcessNodes(roots, thread_counts[t]);
+    printf("%d thread(s): scanned %d nodes in %dms, %d missing deps on "
+           "%d targets\n",
+           thread_counts[t], (int)scanner.seen_.size(),
+           (int)(GetTimeMillis() - start), delegate.count_,
+           (int)scanner.nodes_missing_deps_.size());
+  }
+
+  platformAwareUnlink(kTestFilename);
+  return 0;
+}
@@ -165,3 +165,56 @@ TEST_F(MissingDependencyScannerTest, CycleInGraph) {
   std::vector<Node*> nodes = state_.RootNodes(&err);
   ASSERT_NE("", err);
 }
+
+class RecordingMissingDependencyDelegate
+    : public MissingDependencyScannerDelegate {
+ public:
+  void OnMissingDep(Node* node, const std::string& path,
+                    const Rule& generator) {
+    missing_.push_back(node->path().AsString() + " " + path + " " +
+                       generator.name());
+  }
+  std::vector<std::string> missing_;
+};
+
+TEST_F(MissingDependencyScannerTest, ProcessNodesThreaded) {
+  CreateInitialState();
+  Edge* other_header_edge = state_.AddEdge(&generator_rule_);
+  state_.AddOut(other_header_edge, "other_header", 0, nullptr);
+  for (int i = 0; i < 300; ++i) {
+    std::string object = "object" + std::to_string(i);
+    Edge* edge = state_.AddEdge(&compile_rule_);
+    state_.AddOut(edge, object, 0, nullptr);
+    // Every third object depends on generated_header properly.
+    if (i % 3 == 0)
+      CreateGraphDependencyBetween(object.c_str(), "generated_header");
+    Node* deps[] = { state_.LookupNode("generated_header"),
+                     state_.LookupNode("other_header"),
+                     state_.LookupNode("generated_header") };
+    deps_log_.RecordDeps(state_.LookupNode(object), 0, 3, deps);
+  }
+
+  // Scanning on several threads reports what a serial scan reports.
+  RecordingMissingDependencyDelegate serial_delegate;
+  MissingDependencyScanner serial(&serial_delegate, &deps_log_, &state_,
+                                  &filesystem_);
+  RecordingMissingDependencyDelegate threaded_delegate;
+  MissingDependencyScanner threaded(&threaded_delegate, &deps_log_, &state_,
+                                    &filesystem_);
+  std::string err;
+  std::vector<Node*> nodes = state_.RootNodes(&err);
+  ASSERT_EQ("", err);
+  for (size_t i = 0; i < nodes.size(); ++i)
+    serial.ProcessNode(nodes[i]);
+  threaded.ProcessNodes(nodes, 4);
+
+  EXPECT_EQ(serial_delegate.missing_, threaded_delegate.missing_);
+  // 100 objects miss other_header only, 200 miss both; generated_header
+  // is reported for each time it is listed.
+  EXPECT_EQ(100u + 200u * 3u, threaded_delegate.missing_.size());
+  EXPECT_EQ(300u, threaded.nodes_missing_deps_.size());
+  // Both headers come from the same rule.
+  EXPECT_EQ(300, threaded.missing_dep_path_count_);
+  EXPECT_EQ(serial.missing_dep_path_count_, threaded.missing_dep_path_count_);
+  EXPECT_EQ(2u, threaded.generated_nodes_.size());
+}
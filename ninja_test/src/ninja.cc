@@ -20,13 +20,18 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string>
+#include <thread>
 
 #ifdef _WIN32
 #include "getopt.h"
 #include <direct.h>
+#include <fcntl.h>
+#include <io.h>
 #include <windows.h>
 #elif defined(_AIX)
 #include "getopt.h"
@@ -42,15 +47,17 @@
 #include "deps_log.h"
 #include "clean.h"
 #include "command_collector.h"
+#include "compdb.h"
 #include "debug_flags.h"
 #include "disk_interface.h"
 #include "exit_status.h"
 #include "graph.h"
+#include "graph_export.h"
 #include "graphviz.h"
-#include "json.h"
 #include "manifest_parser.h"
 #include "metrics.h"
 #include "missing_deps.h"
+#include "query_server.h"
 #include "state.h"
 #include "status.h"
 #include "util.h"
@@ -111,6 +118,10 @@ struct NinjaMain : public BuildLogUser {
   BuildLog build_log_;
   DepsLog deps_log_;
 
+  /// Builder for the main build.  Created before the logs are loaded when
+  /// OpenLogsPipelined() starts edges early, otherwise by RunBuild().
+  std::unique_ptr<Builder> builder_;
+
   /// The type of functions that are the entry points to tools (subcommands).
   typedef int (NinjaMain::*ToolFunc)(const Options*, int, char**);
 
@@ -142,6 +153,8 @@ struct NinjaMain : public BuildLogUser {
   int ToolRestat(const Options* options, int argc, char* argv[]);
   int ToolUrtle(const Options* options, int argc, char** argv);
   int ToolRules(const Options* options, int argc, char* argv[]);
+  int ToolResources(const Options* options, int argc, char* argv[]);
+  int ToolServe(const Options* options, int argc, char* argv[]);
   int ToolWinCodePage(const Options* options, int argc, char* argv[]);
 
   /// Open the build log.
@@ -152,6 +165,19 @@ struct NinjaMain : public BuildLogUser {
   /// @return false on error.
   bool OpenDepsLog(bool recompact_only = false);
 
+  /// Open the build log on a background thread while edges that only read
+  /// source files start building (see BuildConfig::pipelined_startup), then
+  /// the deps log.  Falls back to opening them in sequence when that is not
+  /// safe.
+  /// @return false on error.
+  bool OpenLogsPipelined(const char* input_file, int argc, char** argv,
+                         Status* status);
+
+  /// Whether the manifest is known to be up to date from the files on disk
+  /// alone, so that nothing started before the logs are loaded can be
+  /// invalidated by regenerating it.
+  bool ManifestUpToDateWithoutLogs(const char* input_file);
+
   /// Ensure the build directory exists, creating it if necessary.
   /// @return false on error.
   bool EnsureBuildDirExists();
@@ -231,6 +257,17 @@ void Usage(const BuildConfig& config) {
 "  --version      print ninja version (\"%s\")\n"
 "  -v, --verbose  show all command lines while building\n"
 "  --quiet        don't show progress status, just command output\n"
+"  --pipeline     start building source-only edges while the build log loads\n"
+"  --memory-budget=SIZE\n"
+"                 do not start jobs whose peak memory use, as recorded in the\n"
+"                 build log, exceeds the remaining SIZE (e.g. 16G, 512M)\n"
+"  --log-durability=MODE\n"
+"                 how build and deps log records reach the disk: 'record'\n"
+"                 flushes each one [default], 'batch' writes them every few\n"
+"                 ms from a thread, 'sync' also fsyncs each batch\n"
+"  --depfile-threads=N\n"
+"                 read and parse the depfiles of deps = gcc edges on N threads\n"
+"                 instead of the build loop [default=0]\n"
 "\n"
 "  -C DIR   change to DIR before doing anything else\n"
 "  -f FILE  specify input build file [default=build.ninja]\n"
@@ -238,6 +275,8 @@ void Usage(const BuildConfig& config) {
 "  -j N     run N jobs in parallel (0 means infinity) [default=%d on this system]\n"
 "  -k N     keep going until N jobs fail (0 means infinity) [default=1]\n"
 "  -l N     do not start new jobs if the load average is greater than N\n"
+"  -l psi[:cpu=N,memory=N,io=N]\n"
+"           adapt the number of jobs to pressure stall information (Linux)\n"
 "  -n       dry run (don't run commands but act like they succeeded)\n"
 "\n"
 "  -d MODE  enable debugging (use '-d list' to list modes)\n"
@@ -368,7 +407,7 @@ Node* NinjaMain::CollectTarget(const char* cpath, string* err) {
     } else {
       Node* suggestion = state_.SpellcheckNode(path);
       if (suggestion) {
-        *err += ", did you mean '" + suggestion->path() + "'?";
+        *err += ", did you mean '" + suggestion->path().AsString() + "'?";
       }
     }
     return NULL;
@@ -393,6 +432,78 @@ bool NinjaMain::CollectTargetsFromArgs(int argc, char* argv[],
 }
 
 int NinjaMain::ToolGraph(const Options* options, int argc, char* argv[]) {
+  // The graph tool uses getopt, and expects argv[0] to contain the name of
+  // the tool, i.e. "graph".
+  argc++;
+  argv--;
+
+  enum { FORMAT_DOT, FORMAT_JSONL, FORMAT_BINARY } format = FORMAT_DOT;
+  GraphExportOptions export_options;
+
+  optind = 1;
+  int opt;
+  const option kLongOptions[] = { { "help", no_argument, NULL, 'h' },
+                                  { "format", required_argument, NULL, 'f' },
+                                  { "depth", required_argument, NULL, 'd' },
+                                  { "collapse-rules", no_argument, NULL,
+                                    'r' },
+                                  { "dirty", no_argument, NULL, 'D' },
+                                  { NULL, 0, NULL, 0 } };
+  while ((opt = getopt_long(argc, argv, "hf:d:rD", kLongOptions, NULL)) !=
+         -1) {
+    switch (opt) {
+    case 'f':
+      if (strcmp(optarg, "dot") == 0) {
+        format = FORMAT_DOT;
+      } else if (strcmp(optarg, "jsonl") == 0) {
+        format = FORMAT_JSONL;
+      } else if (strcmp(optarg, "binary") == 0) {
+        format = FORMAT_BINARY;
+      } else {
+        Error("unknown format '%s'; use dot, jsonl or binary", optarg);
+        return 1;
+      }
+      break;
+    case 'd': {
+      char* end;
+      long depth = strtol(optarg, &end, 10);
+      if (*end != '\0' || depth <= 0 || depth > INT_MAX) {
+        Error("invalid depth '%s'", optarg);
+        return 1;
+      }
+      export_options.max_depth = static_cast<int>(depth);
+      break;
+    }
+    case 'r':
+      export_options.collapse_rules = true;
+      break;
+    case 'D':
+      export_options.only_dirty = true;
+      break;
+    case 'h':
+    default:
+      // clang-format off
+      printf(
+"Usage '-t graph [options] [targets]\n"
+"\n"
+"Output the build graph leading to targets.  Without options, this is a\n"
+"graphviz .dot file.\n"
+"\n"
+"Options:\n"
+"  -h, --help            Print this message.\n"
+"  -f, --format=FORMAT   dot, jsonl (one JSON object per line), or binary\n"
+"                        (compressed sparse row arrays, see graph_export.h).\n"
+"  -d, --depth=N         Only follow edges up to N steps from the targets.\n"
+"  -r, --collapse-rules  One vertex per rule, with dependency counts.\n"
+"  -D, --dirty           Only follow edges that need to run.\n"
+      );
+      // clang-format on
+      return 1;
+    }
+  }
+  argv += optind;
+  argc -= optind;
+
   vector<Node*> nodes;
   string err;
   if (!CollectTargetsFromArgs(argc, argv, &nodes, &err)) {
@@ -400,6 +511,55 @@ int NinjaMain::ToolGraph(const Options* options, int argc, char* argv[]) {
     return 1;
   }
 
+  if (format != FORMAT_DOT || export_options.max_depth > 0 ||
+      export_options.collapse_rules || export_options.only_dirty) {
+    if (export_options.only_dirty) {
+      // Read the logs without opening them for writing, as a dry run
+      // would: the graph tool never changes them.
+      string log_path = ".ninja_log";
+      string deps_path = ".ninja_deps";
+      if (!build_dir_.empty()) {
+        log_path = build_dir_ + "/" + log_path;
+        deps_path = build_dir_ + "/" + deps_path;
+      }
+      if (build_log_.Load(log_path, &err) == LOAD_ERROR) {
+        Error("loading build log %s: %s", log_path.c_str(), err.c_str());
+        return 1;
+      }
+      err.clear();
+      if (deps_log_.Load(deps_path, &state_, &err) == LOAD_ERROR) {
+        Error("loading deps log %s: %s", deps_path.c_str(), err.c_str());
+        return 1;
+      }
+      err.clear();
+
+      DependencyScan scan(&state_, &build_log_, &deps_log_, &disk_interface_,
+                          &config_.depfile_parser_options, NULL);
+      for (vector<Node*>::iterator n = nodes.begin(); n != nodes.end(); ++n) {
+        vector<Node*> validation_nodes;
+        if (!scan.RecomputeDirty(*n, &validation_nodes, &err)) {
+          Error("%s", err.c_str());
+          return 1;
+        }
+      }
+    }
+
+    GraphExport graph(&state_, &disk_interface_, export_options);
+    graph.AddTargets(nodes);
+    if (format == FORMAT_JSONL)
+      graph.WriteJsonLines(stdout);
+    else if (format == FORMAT_BINARY) {
+#ifdef _WIN32
+      fflush(stdout);
+      _setmode(_fileno(stdout), _O_BINARY);
+#endif
+      graph.WriteBinary(stdout);
+    }
+    else
+      graph.WriteDot(stdout);
+    return 0;
+  }
+
   GraphViz graph(&state_, &disk_interface_);
   graph.Start();
   for (vector<Node*>::const_iterator n = nodes.begin(); n != nodes.end(); ++n)
@@ -425,7 +585,7 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
       return 1;
     }
 
-    printf("%s:\n", node->path().c_str());
+    printf("%s:\n", node->path().str_);
     if (Edge* edge = node->in_edge()) {
       if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
         if (!dyndep_loader.LoadDyndeps(edge->dyndep_, &err)) {
@@ -439,13 +599,13 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
           label = "| ";
         else if (edge->is_order_only(in))
           label = "|| ";
-        printf("    %s%s\n", label, edge->inputs_[in]->path().c_str());
+        printf("    %s%s\n", label, edge->inputs_[in]->path().str_);
       }
       if (!edge->validations_.empty()) {
         printf("  validations:\n");
         for (std::vector<Node*>::iterator validation = edge->validations_.begin();
              validation != edge->validations_.end(); ++validation) {
-          printf("    %s\n", (*validation)->path().c_str());
+          printf("    %s\n", (*validation)->path().str_);
         }
       }
     }
@@ -454,7 +614,7 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
          edge != node->out_edges().end(); ++edge) {
       for (vector<Node*>::iterator out = (*edge)->outputs_.begin();
            out != (*edge)->outputs_.end(); ++out) {
-        printf("    %s\n", (*out)->path().c_str());
+        printf("    %s\n", (*out)->path().str_);
       }
     }
     const std::vector<Edge*> validation_edges = node->validation_out_edges();
@@ -464,7 +624,7 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
            edge != validation_edges.end(); ++edge) {
         for (vector<Node*>::iterator out = (*edge)->outputs_.begin();
              out != (*edge)->outputs_.end(); ++out) {
-          printf("    %s\n", (*out)->path().c_str());
+          printf("    %s\n", (*out)->path().str_);
         }
       }
     }
@@ -501,7 +661,7 @@ int ToolTargetsList(const vector<Node*>& nodes, int depth, int indent) {
        ++n) {
     for (int i = 0; i < indent; ++i)
       printf("  ");
-    const char* target = (*n)->path().c_str();
+    const char* target = (*n)->path().str_;
     if ((*n)->in_edge()) {
       printf("%s: %s\n", target, (*n)->in_edge()->rule_->name().c_str());
       if (depth > 1 || depth <= 0)
@@ -519,7 +679,7 @@ int ToolTargetsSourceList(State* state) {
     for (vector<Node*>::iterator inps = (*e)->inputs_.begin();
          inps != (*e)->inputs_.end(); ++inps) {
       if (!(*inps)->in_edge())
-        printf("%s\n", (*inps)->path().c_str());
+        printf("%s\n", (*inps)->path().str_);
     }
   }
   return 0;
@@ -534,7 +694,7 @@ int ToolTargetsList(State* state, const string& rule_name) {
     if ((*e)->rule_->name() == rule_name) {
       for (vector<Node*>::iterator out_node = (*e)->outputs_.begin();
            out_node != (*e)->outputs_.end(); ++out_node) {
-        rules.insert((*out_node)->path());
+        rules.insert((*out_node)->path().AsString());
       }
     }
   }
@@ -554,7 +714,7 @@ int ToolTargetsList(State* state) {
     for (vector<Node*>::iterator out_node = (*e)->outputs_.begin();
          out_node != (*e)->outputs_.end(); ++out_node) {
       printf("%s: %s\n",
-             (*out_node)->path().c_str(),
+             (*out_node)->path().str_,
              (*e)->rule_->name().c_str());
     }
   }
@@ -577,25 +737,58 @@ int NinjaMain::ToolDeps(const Options* options, int argc, char** argv) {
     }
   }
 
-  RealDiskInterface disk_interface;
-  for (vector<Node*>::iterator it = nodes.begin(), end = nodes.end();
-       it != end; ++it) {
-    DepsLog::Deps* deps = deps_log_.GetDeps(*it);
-    if (!deps) {
-      printf("%s: deps not found\n", (*it)->path().c_str());
-      continue;
+  // Stat the outputs and format their records in chunks on several
+  // threads, then print the chunks in order.
+  const size_t kChunkSize = 1024;
+  size_t chunk_count = (nodes.size() + kChunkSize - 1) / kChunkSize;
+  vector<string> outputs(chunk_count);
+  vector<vector<string> > errors(chunk_count);
+  std::atomic<size_t> next_chunk(0);
+  auto format = [&]() {
+    RealDiskInterface disk_interface;
+    char buf[128];
+    for (size_t chunk; (chunk = next_chunk++) < chunk_count;) {
+      string* out = &outputs[chunk];
+      size_t end = min(nodes.size(), (chunk + 1) * kChunkSize);
+      for (size_t n = chunk * kChunkSize; n < end; ++n) {
+        Node* node = nodes[n];
+        out->append(node->path().str_, node->path().len_);
+        DepsLog::Deps* deps = deps_log_.GetDeps(node);
+        if (!deps) {
+          out->append(": deps not found\n");
+          continue;
+        }
+
+        string err;
+        TimeStamp mtime = disk_interface.Stat(node->path().AsString(), &err);
+        if (mtime == -1)
+          errors[chunk].push_back(err);  // Log and ignore Stat() errors;
+        snprintf(buf, sizeof(buf), ": #deps %d, deps mtime %" PRId64 " (%s)\n",
+                 deps->node_count, deps->mtime,
+                 (!mtime || mtime > deps->mtime ? "STALE":"VALID"));
+        out->append(buf);
+        for (int i = 0; i < deps->node_count; ++i) {
+          StringPiece dep = deps->nodes[i]->path();
+          out->append("    ");
+          out->append(dep.str_, dep.len_);
+          out->push_back('\n');
+        }
+        out->push_back('\n');
+      }
     }
+  };
+  int threads = static_cast<int>(min<size_t>(GetProcessorCount(), chunk_count));
+  vector<std::thread> workers;
+  for (int i = 1; i < threads; ++i)
+    workers.push_back(std::thread(format));
+  format();
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
 
-    string err;
-    TimeStamp mtime = disk_interface.Stat((*it)->path(), &err);
-    if (mtime == -1)
-      Error("%s", err.c_str());  // Log and ignore Stat() errors;
-    printf("%s: #deps %d, deps mtime %" PRId64 " (%s)\n",
-           (*it)->path().c_str(), deps->node_count, deps->mtime,
-           (!mtime || mtime > deps->mtime ? "STALE":"VALID"));
-    for (int i = 0; i < deps->node_count; ++i)
-      printf("    %s\n", deps->nodes[i]->path().c_str());
-    printf("\n");
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    for (size_t i = 0; i < errors[chunk].size(); ++i)
+      Error("%s", errors[chunk][i].c_str());
+    fwrite(outputs[chunk].data(), 1, outputs[chunk].size(), stdout);
   }
 
   return 0;
@@ -612,9 +805,7 @@ int NinjaMain::ToolMissingDeps(const Options* options, int argc, char** argv) {
   MissingDependencyPrinter printer;
   MissingDependencyScanner scanner(&printer, &deps_log_, &state_,
                                    &disk_interface);
-  for (vector<Node*>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
-    scanner.ProcessNode(*it);
-  }
+  scanner.ProcessNodes(nodes, GetProcessorCount());
   scanner.PrintStats();
   if (scanner.HadMissingDeps())
     return 3;
@@ -711,6 +902,116 @@ int NinjaMain::ToolRules(const Options* options, int argc, char* argv[]) {
   return 0;
 }
 
+/// Resource usage of a group of edges, for ToolResources().
+struct ResourceTotals {
+  int edges = 0;
+  int64_t wall_millis = 0;
+  int64_t max_peak_rss = 0;
+  ResourceUsage sum;
+
+  void Add(const BuildLog::LogEntry& entry) {
+    ++edges;
+    wall_millis += entry.end_time - entry.start_time;
+    max_peak_rss = max(max_peak_rss, entry.usage.peak_rss);
+    sum.user_millis += entry.usage.user_millis;
+    sum.system_millis += entry.usage.system_millis;
+    sum.in_blocks += entry.usage.in_blocks;
+    sum.out_blocks += entry.usage.out_blocks;
+    sum.voluntary_switches += entry.usage.voluntary_switches;
+    sum.involuntary_switches += entry.usage.involuntary_switches;
+  }
+
+  int64_t cpu_millis() const { return sum.user_millis + sum.system_millis; }
+};
+
+void PrintResourceTotals(const char* title,
+                         const map<string, ResourceTotals>& totals) {
+  // Most CPU time first.
+  vector<pair<int64_t, string> > order;
+  for (map<string, ResourceTotals>::const_iterator i = totals.begin();
+       i != totals.end(); ++i)
+    order.push_back(make_pair(-i->second.cpu_millis(), i->first));
+  sort(order.begin(), order.end());
+
+  printf("%7s %9s %9s %9s %5s %8s %10s %10s %10s %10s  %s\n", "edges",
+         "wall(s)", "user(s)", "sys(s)", "cpu%", "rss(MiB)", "in blocks",
+         "out blocks", "vol ctxsw", "inv ctxsw", title);
+  for (size_t i = 0; i < order.size(); ++i) {
+    const ResourceTotals& t = totals.find(order[i].second)->second;
+    // Well below 100% means the edges mostly waited, typically for I/O.
+    int cpu_percent = t.wall_millis > 0
+                          ? static_cast<int>(t.cpu_millis() * 100 /
+                                             t.wall_millis)
+                          : 0;
+    printf("%7d %9.1f %9.1f %9.1f %5d %8.1f %10" PRId64 " %10" PRId64
+           " %10" PRId64 " %10" PRId64 "  %s\n",
+           t.edges, t.wall_millis / 1000.0, t.sum.user_millis / 1000.0,
+           t.sum.system_millis / 1000.0, cpu_percent,
+           t.max_peak_rss / 1024.0, t.sum.in_blocks, t.sum.out_blocks,
+           t.sum.voluntary_switches, t.sum.involuntary_switches,
+           order[i].second.c_str());
+  }
+}
+
+int NinjaMain::ToolResources(const Options* options, int argc, char* argv[]) {
+  // The resources tool uses getopt, and expects argv[0] to contain the name
+  // of the tool, i.e. "resources".
+  argc++;
+  argv--;
+
+  bool by_rule = true;
+  bool by_dir = true;
+
+  optind = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, const_cast<char*>("hrd"))) != -1) {
+    switch (opt) {
+    case 'r':
+      by_dir = false;
+      break;
+    case 'd':
+      by_rule = false;
+      break;
+    case 'h':
+    default:
+      printf("usage: ninja -t resources [options]\n"
+             "\n"
+             "summarize the resource usage recorded in the build log.\n"
+             "\n"
+             "options:\n"
+             "  -r     only group by rule\n"
+             "  -d     only group by output directory\n"
+             "  -h     print this message\n"
+             );
+    return 1;
+    }
+  }
+
+  map<string, ResourceTotals> rules;
+  map<string, ResourceTotals> dirs;
+  for (vector<Edge*>::const_iterator e = state_.edges_.begin();
+       e != state_.edges_.end(); ++e) {
+    if ((*e)->is_phony() || (*e)->outputs_.empty())
+      continue;
+    // All outputs of an edge share one log entry's worth of usage.
+    string output = (*e)->outputs_[0]->path().AsString();
+    BuildLog::LogEntry* entry = build_log_.LookupByOutput(output);
+    if (!entry)
+      continue;
+    rules[(*e)->rule().name()].Add(*entry);
+    string::size_type slash = output.find_last_of("/\\");
+    dirs[slash == string::npos ? "." : output.substr(0, slash)].Add(*entry);
+  }
+
+  if (by_rule)
+    PrintResourceTotals("rule", rules);
+  if (by_rule && by_dir)
+    printf("\n");
+  if (by_dir)
+    PrintResourceTotals("directory", dirs);
+  return 0;
+}
+
 #ifdef _WIN32
 int NinjaMain::ToolWinCodePage(const Options* options, int argc, char* argv[]) {
   if (argc != 0) {
@@ -920,7 +1221,7 @@ int NinjaMain::ToolMultiInputs(const Options* options, int argc, char* argv[]) {
     std::vector<std::string> inputs = collector.GetInputsAsStrings();
 
     for (const std::string& input : inputs) {
-      printf("%s%s%s", node->path().c_str(), delimiter, input.c_str());
+      printf("%s%s%s", node->path().str_, delimiter, input.c_str());
       fputc(terminator, stdout);
     }
   }
@@ -982,57 +1283,6 @@ int NinjaMain::ToolCleanDead(const Options* options, int argc, char* argv[]) {
   return cleaner.CleanDead(build_log_.entries());
 }
 
-enum EvaluateCommandMode {
-  ECM_NORMAL,
-  ECM_EXPAND_RSPFILE
-};
-std::string EvaluateCommandWithRspfile(const Edge* edge,
-                                       const EvaluateCommandMode mode) {
-  string command = edge->EvaluateCommand();
-  if (mode == ECM_NORMAL)
-    return command;
-
-  string rspfile = edge->GetUnescapedRspfile();
-  if (rspfile.empty())
-    return command;
-
-  size_t index = command.find(rspfile);
-  if (index == 0 || index == string::npos ||
-      (command[index - 1] != '@' &&
-       command.find("--option-file=") != index - 14 &&
-       command.find("-f ") != index - 3))
-    return command;
-
-  string rspfile_content = edge->GetBinding("rspfile_content");
-  size_t newline_index = 0;
-  while ((newline_index = rspfile_content.find('\n', newline_index)) !=
-         string::npos) {
-    rspfile_content.replace(newline_index, 1, 1, ' ');
-    ++newline_index;
-  }
-  if (command[index - 1] == '@') {
-    command.replace(index - 1, rspfile.length() + 1, rspfile_content);
-  } else if (command.find("-f ") == index - 3) {
-    command.replace(index - 3, rspfile.length() + 3, rspfile_content);
-  } else {  // --option-file syntax
-    command.replace(index - 14, rspfile.length() + 14, rspfile_content);
-  }
-  return command;
-}
-
-void PrintOneCompdbObject(std::string const& directory, const Edge* const edge,
-                          const EvaluateCommandMode eval_mode) {
-  printf("\n  {\n    \"directory\": \"");
-  PrintJSONString(directory);
-  printf("\",\n    \"command\": \"");
-  PrintJSONString(EvaluateCommandWithRspfile(edge, eval_mode));
-  printf("\",\n    \"file\": \"");
-  PrintJSONString(edge->inputs_[0]->path());
-  printf("\",\n    \"output\": \"");
-  PrintJSONString(edge->outputs_[0]->path());
-  printf("\"\n  }");
-}
-
 int NinjaMain::ToolCompilationDatabase(const Options* options, int argc,
                                        char* argv[]) {
   // The compdb tool uses getopt, and expects argv[0] to contain the name of
@@ -1064,33 +1314,22 @@ int NinjaMain::ToolCompilationDatabase(const Options* options, int argc,
   argv += optind;
   argc -= optind;
 
-  bool first = true;
-
-  std::string directory = GetWorkingDirectory();
-  putchar('[');
-  for (const Edge* edge : state_.edges_) {
+  vector<Edge*> edges;
+  for (Edge* edge : state_.edges_) {
     if (edge->inputs_.empty())
       continue;
     if (argc == 0) {
-      if (!first) {
-        putchar(',');
-      }
-      PrintOneCompdbObject(directory, edge, eval_mode);
-      first = false;
+      edges.push_back(edge);
     } else {
       for (int i = 0; i != argc; ++i) {
-        if (edge->rule_->name() == argv[i]) {
-          if (!first) {
-            putchar(',');
-          }
-          PrintOneCompdbObject(directory, edge, eval_mode);
-          first = false;
-        }
+        if (edge->rule_->name() == argv[i])
+          edges.push_back(edge);
       }
     }
   }
 
-  puts("\n]");
+  WriteCompdb(stdout, GetWorkingDirectory(), edges, eval_mode,
+              GetProcessorCount());
   return 0;
 }
 
@@ -1154,6 +1393,7 @@ int NinjaMain::ToolRestat(const Options* options, int argc, char* argv[]) {
   }
 
   if (!config_.dry_run) {
+    build_log_.set_durability(config_.log_durability);
     if (!build_log_.OpenForWrite(log_path, *this, &err)) {
       Error("opening build log: %s", err.c_str());
       return EXIT_FAILURE;
@@ -1216,23 +1456,6 @@ struct CompdbTargets {
   }
 };
 
-void PrintCompdb(std::string const& directory, std::vector<Edge*> const& edges,
-                 const EvaluateCommandMode eval_mode) {
-  putchar('[');
-
-  bool first = true;
-  for (const Edge* edge : edges) {
-    if (edge->is_phony() || edge->inputs_.empty())
-      continue;
-    if (!first)
-      putchar(',');
-    PrintOneCompdbObject(directory, edge, eval_mode);
-    first = false;
-  }
-
-  puts("\n]");
-}
-
 int NinjaMain::ToolCompilationDatabaseForTargets(const Options* options,
                                                  int argc, char* argv[]) {
   auto compdb = CompdbTargets::CreateFromArgs(argc, argv);
@@ -1262,19 +1485,76 @@ int NinjaMain::ToolCompilationDatabaseForTargets(const Options* options,
         Fatal(
             "'%s' is not a target "
             "(i.e. it is not an output of any `build` statement)",
-            node->path().c_str());
+            node->path().str_);
       }
       collector.CollectFrom(node);
     }
 
-    std::string directory = GetWorkingDirectory();
-    PrintCompdb(directory, collector.in_edges, compdb.eval_mode);
+    vector<Edge*> edges;
+    for (Edge* edge : collector.in_edges) {
+      if (!edge->is_phony() && !edge->inputs_.empty())
+        edges.push_back(edge);
+    }
+    WriteCompdb(stdout, GetWorkingDirectory(), edges, compdb.eval_mode,
+                GetProcessorCount());
   } break;
   }
 
   return 0;
 }
 
+int NinjaMain::ToolServe(const Options* options, int argc, char* argv[]) {
+  // The serve tool uses getopt, and expects argv[0] to contain the name of
+  // the tool, i.e. "serve".
+  ++argc;
+  --argv;
+
+  optind = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, const_cast<char*>("h"))) != -1) {
+    switch (opt) {
+    case 'h':
+    default:
+      printf("usage: ninja -t serve [socket]\n"
+"\n"
+"Keep the manifest and logs loaded and answer JSON queries, one per line,\n"
+"on a Unix socket (default .ninja_serve.sock), reloading what changed on\n"
+"disk before each query.  For example:\n"
+"  {\"query\": \"inputs\", \"targets\": [\"foo.o\"]}\n"
+"\n"
+"queries: query, inputs, commands (\"single\": true), compdb (\"rules\"),\n"
+"         rdeps, dirty, shutdown\n"
+             );
+      return 1;
+    }
+  }
+  argv += optind;
+  argc -= optind;
+
+#ifdef _WIN32
+  Error("-t serve needs Unix domain sockets, which this platform lacks");
+  return 1;
+#else
+  string socket_path = argc > 0 ? argv[0] : ".ninja_serve.sock";
+  ManifestParserOptions parser_opts;
+  if (options->phony_cycle_should_err)
+    parser_opts.phony_cycle_action_ = kPhonyCycleActionError;
+  QueryServer server(options->input_file, &disk_interface_, parser_opts);
+
+  // Load up front, so that errors in the manifest show up right away.
+  string err;
+  if (!server.Refresh(&err)) {
+    Error("%s", err.c_str());
+    return 1;
+  }
+  if (!server.ServeUnixSocket(socket_path, &err)) {
+    Error("%s", err.c_str());
+    return 1;
+  }
+  return 0;
+#endif
+}
+
 int NinjaMain::ToolUrtle(const Options* options, int argc, char** argv) {
   // RLE encoded.
   const char* urtle =
@@ -1340,8 +1620,12 @@ const Tool* ChooseTool(const string& tool_name) {
       Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolRestat },
     { "rules",  "list all rules",
       Tool::RUN_AFTER_LOAD, &NinjaMain::ToolRules },
+    { "resources",  "summarize recorded resource usage by rule and directory",
+      Tool::RUN_AFTER_LOGS, &NinjaMain::ToolResources },
     { "cleandead",  "clean built files that are no longer produced by the manifest",
       Tool::RUN_AFTER_LOGS, &NinjaMain::ToolCleanDead },
+    { "serve",  "answer graph queries on a socket, reloading on changes",
+      Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolServe },
     { "urtle", NULL,
       Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolUrtle },
 #ifdef _WIN32
@@ -1485,6 +1769,7 @@ bool NinjaMain::OpenBuildLog(bool recompact_only) {
   }
 
   if (!config_.dry_run) {
+    build_log_.set_durability(config_.log_durability);
     if (!build_log_.OpenForWrite(log_path, *this, &err)) {
       Error("opening build log: %s", err.c_str());
       return false;
@@ -1524,6 +1809,7 @@ bool NinjaMain::OpenDepsLog(bool recompact_only) {
   }
 
   if (!config_.dry_run) {
+    deps_log_.set_durability(config_.log_durability);
     if (!deps_log_.OpenForWrite(path, &err)) {
       Error("opening deps log: %s", err.c_str());
       return false;
@@ -1533,6 +1819,75 @@ bool NinjaMain::OpenDepsLog(bool recompact_only) {
   return true;
 }
 
+bool NinjaMain::ManifestUpToDateWithoutLogs(const char* input_file) {
+  string path = input_file;
+  if (path.empty())
+    return false;
+  uint64_t slash_bits;  // Unused because this path is only used for lookup.
+  CanonicalizePath(&path, &slash_bits);
+  Node* manifest = state_.LookupNode(path);
+  if (!manifest || !manifest->in_edge())
+    return true;
+
+  // Deps, depfiles and dyndep files can only be judged with the logs.
+  Edge* edge = manifest->in_edge();
+  if (edge->dyndep_ || !edge->GetBinding("deps").empty() ||
+      !edge->GetUnescapedDepfile().empty())
+    return false;
+
+  string err;
+  if (!manifest->StatIfNecessary(&disk_interface_, &err) ||
+      !manifest->exists())
+    return false;
+  for (size_t i = 0; i < edge->inputs_.size() - edge->order_only_deps_; ++i) {
+    Node* input = edge->inputs_[i];
+    if (input->in_edge())
+      return false;
+    if (!input->StatIfNecessary(&disk_interface_, &err) || !input->exists() ||
+        input->mtime() > manifest->mtime())
+      return false;
+  }
+  return true;
+}
+
+bool NinjaMain::OpenLogsPipelined(const char* input_file, int argc,
+                                  char** argv, Status* status) {
+  // The targets are resolved before the deps log is loaded; "foo^" needs the
+  // deps log and rules this out.  Metrics are not thread-safe.
+  bool pipeline = !g_metrics && ManifestUpToDateWithoutLogs(input_file);
+  for (int i = 0; pipeline && i < argc; ++i) {
+    size_t len = strlen(argv[i]);
+    if (len > 0 && argv[i][len - 1] == '^')
+      pipeline = false;
+  }
+  vector<Node*> targets;
+  string err;
+  if (!pipeline || !CollectTargetsFromArgs(argc, argv, &targets, &err))
+    return OpenBuildLog() && OpenDepsLog();
+
+  builder_.reset(new Builder(&state_, config_, &build_log_, &deps_log_,
+                             &disk_interface_, status, start_time_millis_));
+
+  // Loading the build log only reads state_.  The deps log adds nodes to
+  // it, so it waits until the edges have been started.
+  bool build_log_loaded = false;
+  std::thread loader([this, &build_log_loaded]() {
+    build_log_loaded = OpenBuildLog();
+  });
+  bool started = builder_->StartEagerEdges(targets, &err);
+  loader.join();
+  bool logs_loaded = build_log_loaded && OpenDepsLog();
+
+  if (!started || !logs_loaded) {
+    // Stops anything that was started early.
+    builder_.reset();
+    if (!started)
+      status->Error("%s", err.c_str());
+    return false;
+  }
+  return true;
+}
+
 void NinjaMain::DumpMetrics() {
   g_metrics->Report();
 
@@ -1576,8 +1931,14 @@ ExitStatus NinjaMain::RunBuild(int argc, char** argv, Status* status) {
 
   // 初始化Builder
   profiler.start("Builder Initialization");
-  Builder builder(&state_, config_, &build_log_, &deps_log_, &disk_interface_,
-                  status, start_time_millis_);
+  // Take ownership so that the builder cleans up when this returns.
+  std::unique_ptr<Builder> builder_owner(std::move(builder_));
+  if (!builder_owner) {
+    builder_owner.reset(new Builder(&state_, config_, &build_log_, &deps_log_,
+                                    &disk_interface_, status,
+                                    start_time_millis_));
+  }
+  Builder& builder = *builder_owner;
   for (size_t i = 0; i < targets.size(); ++i) {
     if (!builder.AddTarget(targets[i], &err)) {
       if (!err.empty()) {
@@ -1614,6 +1975,13 @@ ExitStatus NinjaMain::RunBuild(int argc, char** argv, Status* status) {
   ExitStatus exit_status = builder.Build(&err);
   profiler.end();  // Build Execution
 
+  // With batched logs the last records may still be on their way, and
+  // ninja exits without destroying the logs.
+  if (!build_log_.Flush())
+    status->Error("writing build log: %s", strerror(errno));
+  if (!deps_log_.Flush())
+    status->Error("writing deps log: %s", strerror(errno));
+
   // 处理构建结果
   profiler.start("Handle Build Result");
   if (exit_status != ExitSuccess) {
@@ -1675,12 +2043,18 @@ int ReadFlags(int* argc, char*** argv,
               Options* options, BuildConfig* config) {
   DeferGuessParallelism deferGuessParallelism(config);
 
-  enum { OPT_VERSION = 1, OPT_QUIET = 2 };
+  enum { OPT_VERSION = 1, OPT_QUIET = 2, OPT_PIPELINE = 3,
+         OPT_MEMORY_BUDGET = 4, OPT_LOG_DURABILITY = 5,
+         OPT_DEPFILE_THREADS = 6 };
   const option kLongOptions[] = {
     { "help", no_argument, NULL, 'h' },
     { "version", no_argument, NULL, OPT_VERSION },
     { "verbose", no_argument, NULL, 'v' },
     { "quiet", no_argument, NULL, OPT_QUIET },
+    { "pipeline", no_argument, NULL, OPT_PIPELINE },
+    { "memory-budget", required_argument, NULL, OPT_MEMORY_BUDGET },
+    { "log-durability", required_argument, NULL, OPT_LOG_DURABILITY },
+    { "depfile-threads", required_argument, NULL, OPT_DEPFILE_THREADS },
     { NULL, 0, NULL, 0 }
   };
 
@@ -1721,6 +2095,17 @@ int ReadFlags(int* argc, char*** argv,
         break;
       }
       case 'l': {
+        if (strncmp(optarg, "psi", 3) == 0 &&
+            (optarg[3] == '\0' || optarg[3] == ':')) {
+          string err;
+          if (optarg[3] == ':' &&
+              !ParsePressureTargets(optarg + 4, &config->pressure_targets,
+                                    &err)) {
+            Fatal("-l psi: %s", err.c_str());
+          }
+          config->pressure_limit = true;
+          break;
+        }
         char* end;
         double value = strtod(optarg, &end);
         if (end == optarg)
@@ -1742,6 +2127,37 @@ int ReadFlags(int* argc, char*** argv,
       case OPT_QUIET:
         config->verbosity = BuildConfig::NO_STATUS_UPDATE;
         break;
+      case OPT_PIPELINE:
+        config->pipelined_startup = true;
+        break;
+      case OPT_MEMORY_BUDGET: {
+        char* end;
+        double value = strtod(optarg, &end);
+        double kib_per_unit = 1024;  // Megabytes without a suffix.
+        if (*end == 'K' || *end == 'k')
+          kib_per_unit = 1;
+        else if (*end == 'G' || *end == 'g')
+          kib_per_unit = 1024 * 1024;
+        else if (*end != 'M' && *end != 'm' && *end != '\0')
+          end = optarg;
+        if (end == optarg || value < 0 || (*end && end[1]))
+          Fatal("invalid --memory-budget parameter: did you mean 16G?");
+        config->memory_budget = static_cast<int64_t>(value * kib_per_unit);
+        break;
+      }
+      case OPT_LOG_DURABILITY:
+        if (!ParseLogDurability(optarg, &config->log_durability))
+          Fatal("invalid --log-durability parameter: "
+                "must be 'record', 'batch' or 'sync'");
+        break;
+      case OPT_DEPFILE_THREADS: {
+        char* end;
+        int value = strtol(optarg, &end, 10);
+        if (*end != 0 || value < 0)
+          Fatal("invalid --depfile-threads parameter");
+        config->depfile_threads = value;
+        break;
+      }
       case 'w':
         if (!WarningEnable(optarg, options))
           return 1;
@@ -1850,8 +2266,12 @@ NORETURN void real_main(int argc, char** argv) {
       exit(1);
 
     // 打开日志
-    if (!ninja.OpenBuildLog() || !ninja.OpenDepsLog())
+    if (config.pipelined_startup && !options.tool && !config.dry_run) {
+      if (!ninja.OpenLogsPipelined(options.input_file, argc, argv, status))
+        exit(1);
+    } else if (!ninja.OpenBuildLog() || !ninja.OpenDepsLog()) {
       exit(1);
+    }
 
     // RUN_AFTER_LOGS 工具
     if (options.tool && options.tool->when == Tool::RUN_AFTER_LOGS)
@@ -0,0 +1,249 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pressure.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "metrics.h"
+
+using namespace std;
+
+namespace {
+
+/// Samples closer together than this are dominated by noise.
+const int64_t kMinSampleIntervalMillis = 250;
+
+/// Memory kept free when admitting commands by their expected RSS.
+const int kMemoryReservePercent = 10;
+
+#ifdef __linux__
+bool ReadProcFile(const string& path, string* content) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f)
+    return false;
+  char buf[4096];
+  size_t len;
+  content->clear();
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+    content->append(buf, len);
+  fclose(f);
+  return true;
+}
+
+/// Add the resident set size of |pid| and all of its descendants to |rss|.
+void AddProcessTreeRss(int pid, int64_t page_size, int depth, int64_t* rss) {
+  // Guard against pid reuse creating an apparent cycle.
+  if (depth > 32)
+    return;
+  char path[64];
+  string content;
+  snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+  if (!ReadProcFile(path, &content))
+    return;
+  long long size = 0, resident = 0;
+  if (sscanf(content.c_str(), "%lld %lld", &size, &resident) == 2)
+    *rss += resident * page_size;
+
+  snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, pid);
+  if (!ReadProcFile(path, &content))
+    return;
+  const char* p = content.c_str();
+  char* end;
+  for (long child = strtol(p, &end, 10); end != p;
+       p = end, child = strtol(p, &end, 10)) {
+    AddProcessTreeRss(static_cast<int>(child), page_size, depth + 1, rss);
+  }
+}
+#endif  // __linux__
+
+}  // namespace
+
+bool ParsePressureStall(const string& content, PressureStall* stall) {
+  bool have_some = false;
+  size_t pos = 0;
+  while (pos < content.size()) {
+    size_t eol = content.find('\n', pos);
+    if (eol == string::npos)
+      eol = content.size();
+    string line = content.substr(pos, eol - pos);
+    pos = eol + 1;
+
+    uint64_t* total;
+    if (line.compare(0, 5, "some ") == 0)
+      total = &stall->some_total;
+    else if (line.compare(0, 5, "full ") == 0)
+      total = &stall->full_total;
+    else
+      continue;
+
+    size_t field = line.find(" total=");
+    if (field == string::npos)
+      return false;
+    const char* start = line.c_str() + field + 7;
+    char* end;
+    unsigned long long value = strtoull(start, &end, 10);
+    if (end == start)
+      return false;
+    *total = value;
+    if (total == &stall->some_total)
+      have_some = true;
+  }
+  return have_some;
+}
+
+bool ReadPressureSample(const vector<int>& pids, PressureSample* sample) {
+#ifdef __linux__
+  string content;
+  if (!ReadProcFile("/proc/pressure/cpu", &content) ||
+      !ParsePressureStall(content, &sample->cpu))
+    return false;
+  if (!ReadProcFile("/proc/pressure/memory", &content) ||
+      !ParsePressureStall(content, &sample->memory))
+    return false;
+  if (!ReadProcFile("/proc/pressure/io", &content) ||
+      !ParsePressureStall(content, &sample->io))
+    return false;
+  sample->time_millis = GetTimeMillis();
+
+  sample->available_memory = -1;
+  if (ReadProcFile("/proc/meminfo", &content)) {
+    size_t field = content.find("MemAvailable:");
+    if (field != string::npos) {
+      long long kb = strtoll(content.c_str() + field + 13, NULL, 10);
+      sample->available_memory = kb * 1024;
+    }
+  }
+
+  int64_t page_size = sysconf(_SC_PAGESIZE);
+  sample->running_rss = 0;
+  for (vector<int>::const_iterator pid = pids.begin(); pid != pids.end();
+       ++pid) {
+    AddProcessTreeRss(*pid, page_size, 0, &sample->running_rss);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ParsePressureTargets(const string& spec, PressureTargets* targets,
+                          string* err) {
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if (comma == string::npos)
+      comma = spec.size();
+    string item = spec.substr(pos, comma - pos);
+    pos = comma + 1;
+
+    size_t eq = item.find('=');
+    if (eq == string::npos) {
+      *err = "expected resource=percent, got '" + item + "'";
+      return false;
+    }
+    string resource = item.substr(0, eq);
+    const char* start = item.c_str() + eq + 1;
+    char* end;
+    double value = strtod(start, &end);
+    if (end == start || *end != '\0') {
+      *err = "invalid percentage for '" + resource + "'";
+      return false;
+    }
+    if (resource == "cpu") {
+      targets->cpu = value;
+    } else if (resource == "memory") {
+      targets->memory = value;
+    } else if (resource == "io") {
+      targets->io = value;
+    } else {
+      *err = "unknown resource '" + resource + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+PressureController::PressureController(const PressureTargets& targets,
+                                       int max_parallelism)
+    : targets_(targets), max_parallelism_(max(1, max_parallelism)),
+      memory_limit_(INT_MAX) {
+  // Start at one command per processor and let the pressure decide whether
+  // to go beyond it.
+  limit_ = min(max_parallelism_, max(1, GetProcessorCount()));
+}
+
+bool PressureController::WantsSample(int64_t now_millis) const {
+  return !have_last_ ||
+         now_millis - last_.time_millis >= kMinSampleIntervalMillis;
+}
+
+double PressureController::StallPercent(const PressureStall& last,
+                                        const PressureStall& now,
+                                        int64_t elapsed_millis) const {
+  if (now.some_total < last.some_total)
+    return 0;
+  return (now.some_total - last.some_total) / (elapsed_millis * 10.0);
+}
+
+void PressureController::Update(const PressureSample& sample, int running) {
+  int64_t elapsed = sample.time_millis - last_.time_millis;
+  if (have_last_ && elapsed > 0) {
+    const double stalls[] = {
+      StallPercent(last_.cpu, sample.cpu, elapsed),
+      StallPercent(last_.memory, sample.memory, elapsed),
+      StallPercent(last_.io, sample.io, elapsed),
+    };
+    const double targets[] = { targets_.cpu, targets_.memory, targets_.io };
+    bool over = false;
+    bool calm = true;
+    for (size_t i = 0; i < sizeof(stalls) / sizeof(stalls[0]); ++i) {
+      if (targets[i] < 0)
+        continue;
+      if (stalls[i] > targets[i])
+        over = true;
+      if (stalls[i] > targets[i] / 2)
+        calm = false;
+    }
+    if (over)
+      limit_ = max(1, min(limit_, max(running, 1)) * 3 / 4);
+    else if (calm && running >= limit_)
+      limit_ = min(max_parallelism_, limit_ + 1);
+  }
+
+  memory_limit_ = INT_MAX;
+  if (running > 0 && sample.running_rss > 0 && sample.available_memory >= 0) {
+    int64_t per_command = sample.running_rss / running;
+    int64_t usable =
+        sample.available_memory * (100 - kMemoryReservePercent) / 100;
+    int64_t fits = running + usable / max<int64_t>(per_command, 1);
+    memory_limit_ = static_cast<int>(min<int64_t>(fits, INT_MAX));
+  }
+
+  last_ = sample;
+  have_last_ = true;
+}
+
+int PressureController::limit() const {
+  return max(1, min(limit_, memory_limit_));
+}
@@ -0,0 +1,102 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_PRESSURE_H_
+#define NINJA_PRESSURE_H_
+
+#include <string>
+#include <vector>
+
+#include "util.h"  // int64_t
+
+/// Cumulative stall times of one resource, as reported by the Linux
+/// pressure stall information (PSI) files /proc/pressure/{cpu,memory,io}.
+struct PressureStall {
+  /// Microseconds during which at least one task stalled on the resource.
+  uint64_t some_total = 0;
+  /// Microseconds during which all non-idle tasks stalled on the resource.
+  uint64_t full_total = 0;
+};
+
+/// Parse the contents of a /proc/pressure/* file.
+/// @return false if the "some" line is missing or malformed.
+bool ParsePressureStall(const std::string& content, PressureStall* stall);
+
+/// A snapshot of the machine's state, taken by ReadPressureSample().
+struct PressureSample {
+  int64_t time_millis = 0;
+  PressureStall cpu;
+  PressureStall memory;
+  PressureStall io;
+  /// MemAvailable from /proc/meminfo in bytes, or -1 if unknown.
+  int64_t available_memory = -1;
+  /// Summed resident set size of the running commands and their
+  /// descendants, in bytes.
+  int64_t running_rss = 0;
+};
+
+/// Read the PSI files, the available memory and the resident set size of
+/// the process trees rooted at |pids|.
+/// @return false if pressure stall information is not available.
+bool ReadPressureSample(const std::vector<int>& pids, PressureSample* sample);
+
+/// Stall targets for PressureController: the share of wall time, in percent,
+/// during which some task may wait on a resource.  A negative value disables
+/// the target.
+struct PressureTargets {
+  double cpu = 90;
+  double memory = 10;
+  double io = 50;
+};
+
+/// Parse a comma separated list of "resource=percent" pairs, e.g.
+/// "memory=5,io=40", into |targets|.  Resources that are not mentioned
+/// keep their value.
+bool ParsePressureTargets(const std::string& spec, PressureTargets* targets,
+                          std::string* err);
+
+/// Adapts the number of commands to run concurrently to the pressure the
+/// machine is under.  The limit grows by one while every resource stays well
+/// below its target and the current limit is in use, and shrinks by a quarter
+/// as soon as one resource exceeds its target.  Independently of that, no
+/// more commands are admitted than the available memory can hold at the
+/// average resident set size of the commands already running.
+struct PressureController {
+  PressureController(const PressureTargets& targets, int max_parallelism);
+
+  /// Whether enough time has passed since the last sample for a new one to
+  /// be meaningful.
+  bool WantsSample(int64_t now_millis) const;
+
+  /// Take |sample| into account; |running| commands are currently running.
+  void Update(const PressureSample& sample, int running);
+
+  /// The number of commands that may run at the same time.
+  int limit() const;
+
+ private:
+  /// Percentage of the time between the last sample and |now| during which
+  /// some task stalled, given the cumulative stall times.
+  double StallPercent(const PressureStall& last, const PressureStall& now,
+                      int64_t elapsed_millis) const;
+
+  PressureTargets targets_;
+  int max_parallelism_;
+  int limit_;
+  int memory_limit_;
+  bool have_last_ = false;
+  PressureSample last_;
+};
+
+#endif  // NINJA_PRESSURE_H_
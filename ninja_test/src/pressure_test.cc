@@ -0,0 +1,121 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pressure.h"
+
+#include "test.h"
+
+using namespace std;
+
+namespace {
+
+/// A sample taken at |time_millis| where the cumulative "some" stall times
+/// are given in milliseconds.
+PressureSample Sample(int64_t time_millis, uint64_t cpu_millis,
+                      uint64_t memory_millis, uint64_t io_millis) {
+  PressureSample sample;
+  sample.time_millis = time_millis;
+  sample.cpu.some_total = cpu_millis * 1000;
+  sample.memory.some_total = memory_millis * 1000;
+  sample.io.some_total = io_millis * 1000;
+  return sample;
+}
+
+}  // namespace
+
+TEST(PressureTest, ParseStall) {
+  PressureStall stall;
+  EXPECT_TRUE(ParsePressureStall(
+      "some avg10=1.50 avg60=0.80 avg300=0.20 total=123456\n"
+      "full avg10=0.00 avg60=0.00 avg300=0.00 total=789\n", &stall));
+  EXPECT_EQ(123456u, stall.some_total);
+  EXPECT_EQ(789u, stall.full_total);
+
+  // Older kernels have no "full" line for cpu.
+  PressureStall cpu;
+  EXPECT_TRUE(ParsePressureStall(
+      "some avg10=0.00 avg60=0.00 avg300=0.00 total=42\n", &cpu));
+  EXPECT_EQ(42u, cpu.some_total);
+  EXPECT_EQ(0u, cpu.full_total);
+
+  EXPECT_FALSE(ParsePressureStall("", &stall));
+  EXPECT_FALSE(ParsePressureStall("some avg10=0.00\n", &stall));
+}
+
+TEST(PressureTest, ParseTargets) {
+  PressureTargets targets;
+  string err;
+  EXPECT_TRUE(ParsePressureTargets("memory=5,io=40", &targets, &err));
+  EXPECT_EQ(90, targets.cpu);
+  EXPECT_EQ(5, targets.memory);
+  EXPECT_EQ(40, targets.io);
+
+  EXPECT_TRUE(ParsePressureTargets("", &targets, &err));
+  EXPECT_EQ(5, targets.memory);
+
+  EXPECT_FALSE(ParsePressureTargets("disk=5", &targets, &err));
+  EXPECT_EQ("unknown resource 'disk'", err);
+  EXPECT_FALSE(ParsePressureTargets("cpu", &targets, &err));
+  EXPECT_FALSE(ParsePressureTargets("cpu=lots", &targets, &err));
+}
+
+TEST(PressureTest, ShrinksUnderPressure) {
+  PressureController controller(PressureTargets(), 64);
+  int initial = controller.limit();
+  controller.Update(Sample(0, 0, 0, 0), initial);
+  // 500ms of memory stall in one second is far beyond the 10% target.
+  controller.Update(Sample(1000, 0, 500, 0), initial);
+  EXPECT_EQ(max(1, initial * 3 / 4), controller.limit());
+
+  // The limit never drops below one command.
+  for (int i = 2; i < 20; ++i)
+    controller.Update(Sample(i * 1000, 0, i * 500, 0), controller.limit());
+  EXPECT_EQ(1, controller.limit());
+}
+
+TEST(PressureTest, GrowsWhenCalm) {
+  PressureController controller(PressureTargets(), 64);
+  int initial = controller.limit();
+  controller.Update(Sample(0, 0, 0, 0), initial);
+  controller.Update(Sample(1000, 100, 10, 10), initial);
+  EXPECT_EQ(min(64, initial + 1), controller.limit());
+
+  // An unused limit is not raised any further.
+  controller.Update(Sample(2000, 200, 20, 20), 1);
+  EXPECT_EQ(min(64, initial + 1), controller.limit());
+}
+
+TEST(PressureTest, NeverExceedsParallelism) {
+  PressureController controller(PressureTargets(), 1);
+  EXPECT_EQ(1, controller.limit());
+  controller.Update(Sample(0, 0, 0, 0), 1);
+  controller.Update(Sample(1000, 0, 0, 0), 1);
+  EXPECT_EQ(1, controller.limit());
+}
+
+TEST(PressureTest, MemoryLimit) {
+  PressureController controller(PressureTargets(), 64);
+  int initial = controller.limit();
+  PressureSample sample = Sample(0, 0, 0, 0);
+  // Two commands of 100 bytes each with room for 500 more bytes, of which
+  // 10% are kept in reserve: four more commands fit.
+  sample.running_rss = 200;
+  sample.available_memory = 500;
+  controller.Update(sample, 2);
+  EXPECT_EQ(min(6, initial), controller.limit());
+
+  sample.available_memory = 0;
+  controller.Update(sample, 2);
+  EXPECT_EQ(min(2, initial), controller.limit());
+}
@@ -0,0 +1,866 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "query_server.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "build_log.h"
+#include "command_collector.h"
+#include "deps_log.h"
+#include "dyndep.h"
+#include "graph.h"
+#include "json.h"
+#include "state.h"
+#include "util.h"
+
+using namespace std;
+
+namespace {
+
+/// The fields of a request that queries use.
+struct Request {
+  Request() : single(false) {}
+  string query;
+  vector<string> targets;
+  vector<string> rules;
+  bool single;
+};
+
+/// Parses the flat JSON objects requests are made of: string, boolean and
+/// null values, and arrays of strings.
+struct RequestParser {
+  RequestParser(const string& text) : p_(text.c_str()),
+                                      end_(text.c_str() + text.size()) {}
+
+  bool Parse(Request* request, string* err) {
+    SkipSpace();
+    if (!Expect('{', err))
+      return false;
+    SkipSpace();
+    if (p_ < end_ && *p_ == '}')
+      return Finish(err);
+    for (;;) {
+      string key;
+      SkipSpace();
+      if (!ParseString(&key, err))
+        return false;
+      SkipSpace();
+      if (!Expect(':', err))
+        return false;
+      SkipSpace();
+      if (!ParseValue(key, request, err))
+        return false;
+      SkipSpace();
+      if (p_ < end_ && *p_ == ',') {
+        ++p_;
+        continue;
+      }
+      if (!Expect('}', err))
+        return false;
+      return Finish(err);
+    }
+  }
+
+ private:
+  bool ParseValue(const string& key, Request* request, string* err) {
+    if (p_ < end_ && *p_ == '"') {
+      string value;
+      if (!ParseString(&value, err))
+        return false;
+      if (key == "query")
+        request->query = value;
+      else if (key == "targets")
+        request->targets.push_back(value);
+      else if (key == "rules")
+        request->rules.push_back(value);
+      return true;
+    }
+    if (p_ < end_ && *p_ == '[') {
+      ++p_;
+      vector<string> values;
+      SkipSpace();
+      if (p_ < end_ && *p_ == ']') {
+        ++p_;
+      } else {
+        for (;;) {
+          string value;
+          SkipSpace();
+          if (!ParseString(&value, err))
+            return false;
+          values.push_back(value);
+          SkipSpace();
+          if (p_ < end_ && *p_ == ',') {
+            ++p_;
+            continue;
+          }
+          if (!Expect(']', err))
+            return false;
+          break;
+        }
+      }
+      if (key == "targets")
+        request->targets.swap(values);
+      else if (key == "rules")
+        request->rules.swap(values);
+      return true;
+    }
+    if (Keyword("true")) {
+      if (key == "single")
+        request->single = true;
+      return true;
+    }
+    if (Keyword("false") || Keyword("null"))
+      return true;
+    *err = "unsupported value for '" + key + "'";
+    return false;
+  }
+
+  bool ParseString(string* out, string* err) {
+    if (!Expect('"', err))
+      return false;
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ != '\\') {
+        out->push_back(*p_++);
+        continue;
+      }
+      if (++p_ == end_)
+        break;
+      switch (*p_++) {
+      case '"': out->push_back('"'); break;
+      case '\\': out->push_back('\\'); break;
+      case '/': out->push_back('/'); break;
+      case 'b': out->push_back('\b'); break;
+      case 'f': out->push_back('\f'); break;
+      case 'n': out->push_back('\n'); break;
+      case 'r': out->push_back('\r'); break;
+      case 't': out->push_back('\t'); break;
+      case 'u': {
+        if (end_ - p_ < 4) {
+          *err = "bad \\u escape";
+          return false;
+        }
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i, ++p_) {
+          char c = *p_;
+          code <<= 4;
+          if (c >= '0' && c <= '9')
+            code |= c - '0';
+          else if (c >= 'a' && c <= 'f')
+            code |= c - 'a' + 10;
+          else if (c >= 'A' && c <= 'F')
+            code |= c - 'A' + 10;
+          else {
+            *err = "bad \\u escape";
+            return false;
+          }
+        }
+        // Surrogate pairs are not combined; paths outside the BMP are not
+        // worth the code.
+        if (code < 0x80) {
+          out->push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+          out->push_back(static_cast<char>(0xc0 | (code >> 6)));
+          out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+          out->push_back(static_cast<char>(0xe0 | (code >> 12)));
+          out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+          out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+        break;
+      }
+      default:
+        *err = "bad escape in string";
+        return false;
+      }
+    }
+    return Expect('"', err);
+  }
+
+  bool Keyword(const char* word) {
+    size_t len = strlen(word);
+    if ((size_t)(end_ - p_) < len || strncmp(p_, word, len) != 0)
+      return false;
+    p_ += len;
+    return true;
+  }
+
+  bool Expect(char c, string* err) {
+    if (p_ < end_ && *p_ == c) {
+      ++p_;
+      return true;
+    }
+    *err = string("expected '") + c + "'";
+    return false;
+  }
+
+  bool Finish(string* err) {
+    SkipSpace();
+    if (p_ != end_) {
+      *err = "trailing characters after request";
+      return false;
+    }
+    return true;
+  }
+
+  void SkipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' ||
+                         *p_ == '\n'))
+      ++p_;
+  }
+
+  const char* p_;
+  const char* end_;
+};
+
+void AppendString(string* out, StringPiece value) {
+  out->push_back('"');
+  AppendJSONString(value, out);
+  out->push_back('"');
+}
+
+void AppendPaths(string* out, const vector<Node*>& nodes,
+                 size_t begin, size_t end) {
+  out->push_back('[');
+  for (size_t i = begin; i < end; ++i) {
+    if (i != begin)
+      out->push_back(',');
+    AppendString(out, nodes[i]->path());
+  }
+  out->push_back(']');
+}
+
+void AppendPaths(string* out, const vector<Node*>& nodes) {
+  AppendPaths(out, nodes, 0, nodes.size());
+}
+
+string ErrorResponse(const string& err) {
+  string response = "{\"ok\":false,\"error\":";
+  AppendString(&response, err);
+  response.push_back('}');
+  return response;
+}
+
+void CollectCommands(Edge* edge, unordered_set<Edge*>* seen, bool single,
+                     vector<Edge*>* edges) {
+  if (!edge || !seen->insert(edge).second)
+    return;
+  if (!single) {
+    for (vector<Node*>::iterator in = edge->inputs_.begin();
+         in != edge->inputs_.end(); ++in)
+      CollectCommands((*in)->in_edge(), seen, single, edges);
+  }
+  if (!edge->is_phony())
+    edges->push_back(edge);
+}
+
+}  // namespace
+
+QueryServer::QueryServer(const string& manifest,
+                         DiskInterface* disk_interface,
+                         const ManifestParserOptions& parser_options)
+    : manifest_(manifest), disk_interface_(disk_interface),
+      parser_options_(parser_options), directory_(GetWorkingDirectory()),
+      deps_users_valid_(false), shutdown_requested_(false),
+      manifest_loads_(0), build_log_loads_(0), deps_log_loads_(0) {}
+
+QueryServer::~QueryServer() {
+  // The logs point into the State.
+  deps_log_.reset();
+  build_log_.reset();
+}
+
+bool QueryServer::Changed(const vector<Watched>& files) const {
+  for (vector<Watched>::const_iterator f = files.begin(); f != files.end();
+       ++f) {
+    string err;
+    if (disk_interface_->Stat(f->path, &err) != f->mtime)
+      return true;
+  }
+  return false;
+}
+
+bool QueryServer::Refresh(string* err) {
+  if (!state_ || Changed(manifest_files_)) {
+    deps_log_.reset();
+    build_log_.reset();
+    if (!LoadManifest(err))
+      return false;
+  }
+  if (!build_log_ || Changed(build_log_file_)) {
+    if (!LoadBuildLog(err))
+      return false;
+  }
+  if (!deps_log_ || Changed(deps_log_file_)) {
+    if (!LoadDepsLog(err))
+      return false;
+  }
+  return true;
+}
+
+bool QueryServer::LoadManifest(string* err) {
+  // Remember every file the parser reads (the manifest, and whatever it
+  // includes or subninjas), stat()ed before reading it.
+  struct WatchingReader : public FileReader {
+    WatchingReader(DiskInterface* disk_interface, vector<Watched>* files)
+        : disk_interface_(disk_interface), files_(files) {}
+    virtual Status ReadFile(const string& path, string* contents,
+                            string* err) {
+      Watched file;
+      file.path = path;
+      file.mtime = disk_interface_->Stat(path, err);
+      err->clear();
+      files_->push_back(file);
+      return disk_interface_->ReadFile(path, contents, err);
+    }
+    DiskInterface* disk_interface_;
+    vector<Watched>* files_;
+  };
+
+  ++manifest_loads_;
+  manifest_files_.clear();
+  base_out_edges_.clear();
+  base_edges_.clear();
+  base_scopes_.clear();
+  deps_users_.clear();
+  deps_users_valid_ = false;
+  state_.reset(new State);
+  WatchingReader reader(disk_interface_, &manifest_files_);
+  ManifestParser parser(state_.get(), &reader, parser_options_);
+  if (!parser.Load(manifest_, err)) {
+    // Parse again on the next request, whether or not the files change.
+    state_.reset();
+    return false;
+  }
+
+  for (State::Paths::iterator i = state_->paths_.begin();
+       i != state_->paths_.end(); ++i) {
+    if (!i->second->out_edges().empty())
+      base_out_edges_[i->second] = i->second->out_edges().size();
+  }
+  base_edges_.reserve(state_->edges_.size());
+  unordered_set<BindingEnv*> dyndep_scopes;
+  for (vector<Edge*>::iterator e = state_->edges_.begin();
+       e != state_->edges_.end(); ++e) {
+    EdgeBase base = { *e, (*e)->inputs_.size(), (*e)->implicit_deps_,
+                      (*e)->outputs_.size(), (*e)->implicit_outs_ };
+    base_edges_.push_back(base);
+
+    if (!(*e)->dyndep_)
+      continue;
+    BindingEnv* env = (*e)->env_;
+    if (dyndep_scopes.insert(env).second) {
+      ScopeBase scope = { env, env->HasLocalBinding("restat"),
+                          env->LookupVariable("restat") };
+      base_scopes_.push_back(scope);
+    }
+  }
+
+  string build_dir = state_->bindings_.LookupVariable("builddir");
+  build_log_path_ = ".ninja_log";
+  deps_log_path_ = ".ninja_deps";
+  if (!build_dir.empty()) {
+    build_log_path_ = build_dir + "/" + build_log_path_;
+    deps_log_path_ = build_dir + "/" + deps_log_path_;
+  }
+  return true;
+}
+
+bool QueryServer::LoadBuildLog(string* err) {
+  ++build_log_loads_;
+  build_log_file_.resize(1);
+  build_log_file_[0].path = build_log_path_;
+  build_log_file_[0].mtime = disk_interface_->Stat(build_log_path_, err);
+  err->clear();
+  build_log_.reset(new BuildLog);
+  if (build_log_->Load(build_log_path_, err) == LOAD_ERROR) {
+    *err = "loading build log " + build_log_path_ + ": " + *err;
+    build_log_.reset();
+    return false;
+  }
+  // Warnings (such as a version that will be recompacted) do not matter
+  // to queries.
+  err->clear();
+  return true;
+}
+
+bool QueryServer::LoadDepsLog(string* err) {
+  ++deps_log_loads_;
+  deps_log_file_.resize(1);
+  deps_log_file_[0].path = deps_log_path_;
+  deps_log_file_[0].mtime = disk_interface_->Stat(deps_log_path_, err);
+  err->clear();
+  deps_users_.clear();
+  deps_users_valid_ = false;
+
+  // Node ids are the deps log's record ids; a new log assigns its own.
+  if (deps_log_) {
+    deps_log_.reset();
+    for (State::Paths::iterator i = state_->paths_.begin();
+         i != state_->paths_.end(); ++i) {
+      i->second->set_id(-1);
+    }
+  }
+  deps_log_.reset(new DepsLog);
+  // A running build may be appending to the log; never repair it here.
+  if (deps_log_->Load(deps_log_path_, state_.get(), err,
+                      /*read_only=*/true) == LOAD_ERROR) {
+    *err = "loading deps log " + deps_log_path_ + ": " + *err;
+    deps_log_.reset();
+    return false;
+  }
+  err->clear();
+  return true;
+}
+
+void QueryServer::RestoreGraph() {
+  for (vector<EdgeBase>::iterator b = base_edges_.begin();
+       b != base_edges_.end(); ++b) {
+    Edge* edge = b->edge;
+    if (edge->outputs_.size() > b->outputs) {
+      for (size_t i = b->outputs; i < edge->outputs_.size(); ++i)
+        edge->outputs_[i]->set_in_edge(NULL);
+      edge->outputs_.resize(b->outputs);
+      edge->implicit_outs_ = b->implicit_outs;
+    }
+    // Deps and dyndep inputs are inserted in front of the order-only ones.
+    if (edge->inputs_.size() > b->inputs) {
+      vector<Node*>::iterator order_only =
+          edge->inputs_.end() - edge->order_only_deps_;
+      edge->inputs_.erase(order_only - (edge->inputs_.size() - b->inputs),
+                          order_only);
+      edge->implicit_deps_ = b->implicit_deps;
+    }
+    if (edge->dyndep_)
+      edge->dyndep_->set_dyndep_pending(true);
+  }
+  for (vector<ScopeBase>::iterator s = base_scopes_.begin();
+       s != base_scopes_.end(); ++s) {
+    if (s->has_restat)
+      s->env->AddBinding("restat", s->restat);
+    else
+      s->env->RemoveBinding("restat");
+  }
+  for (State::Paths::iterator i = state_->paths_.begin();
+       i != state_->paths_.end(); ++i) {
+    Node* node = i->second;
+    if (node->out_edges().empty())
+      continue;
+    unordered_map<Node*, size_t>::const_iterator base =
+        base_out_edges_.find(node);
+    node->TruncateOutEdges(base == base_out_edges_.end() ? 0 : base->second);
+  }
+  state_->Reset();
+}
+
+bool QueryServer::CollectTargets(const vector<string>& paths,
+                                 vector<Node*>* targets, string* err) {
+  if (paths.empty()) {
+    *targets = state_->DefaultNodes(err);
+    return err->empty();
+  }
+  for (vector<string>::const_iterator p = paths.begin(); p != paths.end();
+       ++p) {
+    string path = *p;
+    if (path.empty()) {
+      *err = "empty path";
+      return false;
+    }
+    uint64_t slash_bits;
+    CanonicalizePath(&path, &slash_bits);
+    Node* node = state_->LookupNode(path);
+    if (!node) {
+      *err = "unknown target '" + path + "'";
+      return false;
+    }
+    targets->push_back(node);
+  }
+  return true;
+}
+
+string QueryServer::HandleRequest(const string& line) {
+  Request request;
+  string err;
+  if (!RequestParser(line).Parse(&request, &err))
+    return ErrorResponse("bad request: " + err);
+
+  if (request.query == "shutdown") {
+    shutdown_requested_ = true;
+    return "{\"ok\":true}";
+  }
+  if (!Refresh(&err))
+    return ErrorResponse(err);
+
+  vector<Node*> targets;
+  // Without targets, compdb covers the whole manifest like -t compdb.
+  if ((request.query != "compdb" || !request.targets.empty()) &&
+      !CollectTargets(request.targets, &targets, &err)) {
+    return ErrorResponse(err);
+  }
+
+  string result;
+  if (request.query == "query") {
+    QueryTargets(targets, &result);
+  } else if (request.query == "inputs") {
+    QueryInputs(targets, &result);
+  } else if (request.query == "commands") {
+    QueryCommands(targets, request.single, &result);
+  } else if (request.query == "compdb") {
+    QueryCompdb(targets, request.rules, &result);
+  } else if (request.query == "rdeps") {
+    QueryReverseDeps(targets, &result);
+  } else if (request.query == "dirty") {
+    if (!QueryDirty(targets, &result, &err))
+      return ErrorResponse(err);
+  } else {
+    return ErrorResponse("unknown query '" + request.query + "'");
+  }
+  return "{\"ok\":true,\"result\":" + result + "}";
+}
+
+void QueryServer::QueryTargets(const vector<Node*>& targets, string* out) {
+  DyndepLoader dyndep_loader(state_.get(), disk_interface_);
+  bool loaded_dyndeps = false;
+  out->push_back('[');
+  for (vector<Node*>::const_iterator n = targets.begin(); n != targets.end();
+       ++n) {
+    Node* node = *n;
+    if (n != targets.begin())
+      out->push_back(',');
+    out->append("{\"target\":");
+    AppendString(out, node->path());
+    if (Edge* edge = node->in_edge()) {
+      if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
+        // As -t query does, go on without them if they can't be loaded.
+        string err;
+        dyndep_loader.LoadDyndeps(edge->dyndep_, &err);
+        loaded_dyndeps = true;
+      }
+      size_t explicit_end = edge->inputs_.size() - edge->implicit_deps_ -
+                            edge->order_only_deps_;
+      size_t implicit_end = explicit_end + edge->implicit_deps_;
+      out->append(",\"rule\":");
+      AppendString(out, edge->rule_->name());
+      out->append(",\"inputs\":");
+      AppendPaths(out, edge->inputs_, 0, explicit_end);
+      out->append(",\"implicit\":");
+      AppendPaths(out, edge->inputs_, explicit_end, implicit_end);
+      out->append(",\"order_only\":");
+      AppendPaths(out, edge->inputs_, implicit_end, edge->inputs_.size());
+      out->append(",\"validations\":");
+      AppendPaths(out, edge->validations_);
+    }
+    vector<Node*> outputs;
+    for (vector<Edge*>::const_iterator e = node->out_edges().begin();
+         e != node->out_edges().end(); ++e) {
+      outputs.insert(outputs.end(), (*e)->outputs_.begin(),
+                     (*e)->outputs_.end());
+    }
+    out->append(",\"outputs\":");
+    AppendPaths(out, outputs);
+    outputs.clear();
+    for (vector<Edge*>::const_iterator e =
+             node->validation_out_edges().begin();
+         e != node->validation_out_edges().end(); ++e) {
+      outputs.insert(outputs.end(), (*e)->outputs_.begin(),
+                     (*e)->outputs_.end());
+    }
+    out->append(",\"validation_for\":");
+    AppendPaths(out, outputs);
+    out->push_back('}');
+  }
+  out->push_back(']');
+  if (loaded_dyndeps)
+    RestoreGraph();
+}
+
+void QueryServer::QueryInputs(const vector<Node*>& targets, string* out) {
+  InputsCollector collector;
+  for (vector<Node*>::const_iterator n = targets.begin(); n != targets.end();
+       ++n) {
+    collector.VisitNode(*n);
+  }
+  vector<string> inputs = collector.GetInputsAsStrings();
+  sort(inputs.begin(), inputs.end());
+  out->push_back('[');
+  for (vector<string>::iterator i = inputs.begin(); i != inputs.end(); ++i) {
+    if (i != inputs.begin())
+      out->push_back(',');
+    AppendString(out, *i);
+  }
+  out->push_back(']');
+}
+
+void QueryServer::QueryCommands(const vector<Node*>& targets, bool single,
+                                string* out) {
+  unordered_set<Edge*> seen;
+  vector<Edge*> edges;
+  for (vector<Node*>::const_iterator n = targets.begin(); n != targets.end();
+       ++n) {
+    CollectCommands((*n)->in_edge(), &seen, single, &edges);
+  }
+  out->push_back('[');
+  for (vector<Edge*>::iterator e = edges.begin(); e != edges.end(); ++e) {
+    if (e != edges.begin())
+      out->push_back(',');
+    AppendString(out, (*e)->EvaluateCommand());
+  }
+  out->push_back(']');
+}
+
+void QueryServer::QueryCompdb(const vector<Node*>& targets,
+                              const vector<string>& rules, string* out) {
+  vector<Edge*> edges;
+  if (!targets.empty()) {
+    CommandCollector collector;
+    for (vector<Node*>::const_iterator n = targets.begin();
+         n != targets.end(); ++n) {
+      collector.CollectFrom(*n);
+    }
+    edges.swap(collector.in_edges);
+  } else {
+    for (vector<Edge*>::iterator e = state_->edges_.begin();
+         e != state_->edges_.end(); ++e) {
+      if (rules.empty() || find(rules.begin(), rules.end(),
+                                (*e)->rule_->name()) != rules.end()) {
+        edges.push_back(*e);
+      }
+    }
+  }
+
+  bool first = true;
+  out->push_back('[');
+  for (vector<Edge*>::iterator e = edges.begin(); e != edges.end(); ++e) {
+    Edge* edge = *e;
+    if (edge->is_phony() || edge->inputs_.empty())
+      continue;
+    if (!first)
+      out->push_back(',');
+    first = false;
+    out->append("{\"directory\":");
+    AppendString(out, directory_);
+    out->append(",\"command\":");
+    AppendString(out, edge->EvaluateCommand());
+    out->append(",\"file\":");
+    AppendString(out, edge->inputs_[0]->path());
+    out->append(",\"output\":");
+    AppendString(out, edge->outputs_[0]->path());
+    out->push_back('}');
+  }
+  out->push_back(']');
+}
+
+void QueryServer::QueryReverseDeps(const vector<Node*>& targets,
+                                   string* out) {
+  if (!deps_users_valid_) {
+    const vector<Node*>& nodes = deps_log_->nodes();
+    const vector<DepsLog::Deps*>& deps = deps_log_->deps();
+    for (size_t id = 0; id < deps.size() && id < nodes.size(); ++id) {
+      DepsLog::Deps* record = deps[id];
+      if (!record)
+        continue;
+      for (int i = 0; i < record->node_count; ++i)
+        deps_users_[record->nodes[i]].push_back(nodes[id]);
+    }
+    deps_users_valid_ = true;
+  }
+
+  out->push_back('[');
+  for (vector<Node*>::const_iterator n = targets.begin(); n != targets.end();
+       ++n) {
+    Node* node = *n;
+    if (n != targets.begin())
+      out->push_back(',');
+    out->append("{\"target\":");
+    AppendString(out, node->path());
+    vector<Node*> outputs;
+    for (vector<Edge*>::const_iterator e = node->out_edges().begin();
+         e != node->out_edges().end(); ++e) {
+      outputs.insert(outputs.end(), (*e)->outputs_.begin(),
+                     (*e)->outputs_.end());
+    }
+    out->append(",\"outputs\":");
+    AppendPaths(out, outputs);
+    out->append(",\"deps\":");
+    unordered_map<Node*, vector<Node*> >::const_iterator users =
+        deps_users_.find(node);
+    AppendPaths(out, users == deps_users_.end() ? vector<Node*>()
+                                                : users->second);
+    out->push_back('}');
+  }
+  out->push_back(']');
+}
+
+bool QueryServer::QueryDirty(const vector<Node*>& targets, string* out,
+                             string* err) {
+  // Stat everything afresh; the files may have changed since the last query.
+  state_->Reset();
+  DependencyScan scan(state_.get(), build_log_.get(), deps_log_.get(),
+                      disk_interface_, &depfile_parser_options_, NULL);
+  bool ok = true;
+  for (vector<Node*>::const_iterator n = targets.begin(); n != targets.end();
+       ++n) {
+    vector<Node*> validation_nodes;
+    if (!scan.RecomputeDirty(*n, &validation_nodes, err)) {
+      ok = false;
+      break;
+    }
+  }
+  if (ok) {
+    out->push_back('[');
+    for (vector<Node*>::const_iterator n = targets.begin();
+         n != targets.end(); ++n) {
+      if (n != targets.begin())
+        out->push_back(',');
+      out->append("{\"target\":");
+      AppendString(out, (*n)->path());
+      out->append((*n)->dirty() ? ",\"dirty\":true}" : ",\"dirty\":false}");
+    }
+    out->push_back(']');
+  }
+  RestoreGraph();
+  return ok;
+}
+
+#ifndef _WIN32
+namespace {
+
+bool SendAll(int fd, const string& data) {
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, flags);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+/// Whether a server answers on the socket at |addr|.
+bool SocketIsLive(const sockaddr_un& addr) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  bool live = connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                      sizeof(addr)) == 0;
+  close(fd);
+  return live;
+}
+
+/// The longest request line accepted; a client that sends more without a
+/// newline is answered with an error and disconnected.
+const size_t kMaxRequestLine = 16 << 20;
+
+}  // namespace
+
+bool QueryServer::ServeUnixSocket(const string& socket_path, string* err) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+    *err = "socket path '" + socket_path + "' is empty or too long";
+    return false;
+  }
+  memcpy(addr.sun_path, socket_path.c_str(), socket_path.size());
+
+  // A socket left behind by a server that did not shut down cleanly is
+  // replaced, but not one that a running server still answers on.
+  struct stat st;
+  if (lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    if (SocketIsLive(addr)) {
+      *err = socket_path + ": a server is already listening on this socket";
+      return false;
+    }
+    unlink(socket_path.c_str());
+  }
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    *err = string("socket: ") + strerror(errno);
+    return false;
+  }
+  SetCloseOnExec(listen_fd);
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(listen_fd, 16) < 0) {
+    *err = socket_path + ": " + strerror(errno);
+    close(listen_fd);
+    return false;
+  }
+
+  while (!shutdown_requested_) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      *err = string("accept: ") + strerror(errno);
+      break;
+    }
+    SetCloseOnExec(fd);
+
+    string buffer;
+    char chunk[64 << 10];
+    bool open = true;
+    while (open && !shutdown_requested_) {
+      ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+      if (len < 0 && errno == EINTR)
+        continue;
+      if (len <= 0) {
+        // A last request need not end in a newline.
+        if (len == 0 && buffer.find_first_not_of(" \t\r") != string::npos)
+          SendAll(fd, HandleRequest(buffer) + "\n");
+        break;
+      }
+      buffer.append(chunk, len);
+      size_t start = 0, newline;
+      while (open && (newline = buffer.find('\n', start)) != string::npos) {
+        string line = buffer.substr(start, newline - start);
+        start = newline + 1;
+        if (line.find_first_not_of(" \t\r") == string::npos)
+          continue;
+        open = SendAll(fd, HandleRequest(line) + "\n") &&
+               !shutdown_requested_;
+      }
+      buffer.erase(0, start);
+      if (open && buffer.size() > kMaxRequestLine) {
+        SendAll(fd, ErrorResponse("request line too long") + "\n");
+        open = false;
+      }
+    }
+    close(fd);
+  }
+
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  return err->empty();
+}
+#endif  // _WIN32
@@ -0,0 +1,158 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_QUERY_SERVER_H_
+#define NINJA_QUERY_SERVER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "depfile_parser.h"
+#include "disk_interface.h"
+#include "manifest_parser.h"
+#include "timestamp.h"
+
+struct BuildLog;
+struct DepsLog;
+struct Edge;
+struct Node;
+struct State;
+
+/// Keeps a manifest, its build log and its deps log loaded between queries,
+/// for "ninja -t serve".  Before each query the files they were read from
+/// are stat()ed, and only the parts whose files changed are read again:
+/// an edited manifest is parsed again from scratch, while a build that
+/// only appended to the logs costs reloading that log.
+///
+/// Requests and responses are JSON objects, one per line:
+///   {"query": "inputs", "targets": ["foo.o"]}
+///   {"ok": true, "result": ["foo.c", "foo.h"]}
+/// See HandleRequest() for the queries.
+struct QueryServer {
+  QueryServer(const std::string& manifest, DiskInterface* disk_interface,
+              const ManifestParserOptions& parser_options);
+  ~QueryServer();
+
+  /// Bring the graph and logs up to date with the files on disk.
+  /// Returns false and fills |err| on error.
+  bool Refresh(std::string* err);
+
+  /// Answer one request line, without the trailing newline.  Queries are
+  ///   query    the rule, inputs and outputs of each target (as -t query)
+  ///   inputs   the inputs needed to build the targets (as -t inputs)
+  ///   commands the commands that build the targets (as -t commands);
+  ///            "single": true gives only the final command of each
+  ///   compdb   compilation database entries for the edges leading to the
+  ///            targets or, without targets, for the "rules" given or all
+  ///   rdeps    the outputs that use each target, per the manifest and the
+  ///            deps log
+  ///   dirty    whether each target is out of date
+  ///   shutdown ask ServeUnixSocket() to return
+  /// "targets" defaults to the default targets of the manifest.
+  std::string HandleRequest(const std::string& request);
+
+  bool shutdown_requested() const { return shutdown_requested_; }
+
+#ifndef _WIN32
+  /// Answer requests on a Unix socket at |socket_path|, one connection at
+  /// a time, until a shutdown request.  Returns false and fills |err| if
+  /// the socket could not be set up or another server is listening on it.
+  bool ServeUnixSocket(const std::string& socket_path, std::string* err);
+#endif
+
+  /// How many times each file set was (re)loaded.
+  int manifest_loads() const { return manifest_loads_; }
+  int build_log_loads() const { return build_log_loads_; }
+  int deps_log_loads() const { return deps_log_loads_; }
+
+ private:
+  /// A file that was loaded and its mtime at the time.
+  struct Watched {
+    std::string path;
+    TimeStamp mtime;
+  };
+  bool Changed(const std::vector<Watched>& files) const;
+
+  bool LoadManifest(std::string* err);
+  bool LoadBuildLog(std::string* err);
+  bool LoadDepsLog(std::string* err);
+
+  /// Undo the deps and dyndep information that a dirty query added to the
+  /// graph, so that the next one starts from the manifest again.
+  void RestoreGraph();
+
+  bool CollectTargets(const std::vector<std::string>& paths,
+                      std::vector<Node*>* targets, std::string* err);
+
+  void QueryTargets(const std::vector<Node*>& targets, std::string* out);
+  void QueryInputs(const std::vector<Node*>& targets, std::string* out);
+  void QueryCommands(const std::vector<Node*>& targets, bool single,
+                     std::string* out);
+  void QueryCompdb(const std::vector<Node*>& targets,
+                   const std::vector<std::string>& rules, std::string* out);
+  void QueryReverseDeps(const std::vector<Node*>& targets, std::string* out);
+  bool QueryDirty(const std::vector<Node*>& targets, std::string* out,
+                  std::string* err);
+
+  std::string manifest_;
+  DiskInterface* disk_interface_;
+  ManifestParserOptions parser_options_;
+  DepfileParserOptions depfile_parser_options_;
+  std::string directory_;
+
+  std::unique_ptr<State> state_;
+  std::unique_ptr<BuildLog> build_log_;
+  std::unique_ptr<DepsLog> deps_log_;
+  std::string build_log_path_;
+  std::string deps_log_path_;
+
+  std::vector<Watched> manifest_files_;
+  std::vector<Watched> build_log_file_;
+  std::vector<Watched> deps_log_file_;
+
+  /// The size of each Node's out_edges() (when not empty) and each Edge's
+  /// inputs and outputs as the manifest left them, for RestoreGraph().
+  std::unordered_map<Node*, size_t> base_out_edges_;
+  struct EdgeBase {
+    Edge* edge;
+    size_t inputs;
+    int implicit_deps;
+    size_t outputs;
+    int implicit_outs;
+  };
+  std::vector<EdgeBase> base_edges_;
+
+  /// The scopes of the edges that have a dyndep file, with their own
+  /// "restat" binding, which loading the dyndep file may set.
+  struct ScopeBase {
+    BindingEnv* env;
+    bool has_restat;
+    std::string restat;
+  };
+  std::vector<ScopeBase> base_scopes_;
+
+  /// Outputs recorded in the deps log as depending on each node, built on
+  /// first use after the deps log is loaded.
+  std::unordered_map<Node*, std::vector<Node*> > deps_users_;
+  bool deps_users_valid_;
+
+  bool shutdown_requested_;
+  int manifest_loads_;
+  int build_log_loads_;
+  int deps_log_loads_;
+};
+
+#endif  // NINJA_QUERY_SERVER_H_
@@ -0,0 +1,297 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "query_server.h"
+
+#include "deps_log.h"
+#include "state.h"
+#include "test.h"
+#include "util.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct QueryServerTest : public testing::Test {
+  QueryServerTest()
+      : server_("build.ninja", &fs_, ManifestParserOptions()) {}
+
+  VirtualFileSystem fs_;
+  QueryServer server_;
+};
+
+TEST_F(QueryServerTest, Queries) {
+  fs_.Create("build.ninja",
+"rule cat\n"
+"  command = cat $in > $out\n"
+"build out: cat in1 in2 | imp || oo\n"
+"build final: cat out\n"
+"build all: phony final\n"
+"default final\n");
+
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"out\",\"rule\":\"cat\","
+            "\"inputs\":[\"in1\",\"in2\"],\"implicit\":[\"imp\"],"
+            "\"order_only\":[\"oo\"],\"validations\":[],"
+            "\"outputs\":[\"final\"],\"validation_for\":[]}]}",
+            server_.HandleRequest(
+                "{\"query\": \"query\", \"targets\": [\"./out\"]}"));
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"imp\",\"in1\",\"in2\",\"oo\","
+            "\"out\"]}",
+            server_.HandleRequest("{\"query\":\"inputs\"}"));
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"cat in1 in2 > out\","
+            "\"cat out > final\"]}",
+            server_.HandleRequest(
+                "{\"query\":\"commands\",\"targets\":\"all\"}"));
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"cat out > final\"]}",
+            server_.HandleRequest(
+                "{\"query\":\"commands\",\"single\":true}"));
+
+  string compdb = server_.HandleRequest("{\"query\":\"compdb\"}");
+  EXPECT_NE(string::npos, compdb.find("\"command\":\"cat in1 in2 > out\","
+                                      "\"file\":\"in1\",\"output\":\"out\""));
+  EXPECT_NE(string::npos, compdb.find("\"output\":\"final\""));
+  compdb = server_.HandleRequest(
+      "{\"query\":\"compdb\",\"targets\":[\"out\"]}");
+  EXPECT_EQ(string::npos, compdb.find("\"output\":\"final\""));
+
+  EXPECT_EQ("{\"ok\":false,\"error\":\"unknown target 'nope'\"}",
+            server_.HandleRequest(
+                "{\"query\":\"inputs\",\"targets\":[\"nope\"]}"));
+  EXPECT_EQ("{\"ok\":false,\"error\":\"unknown query 'frob'\"}",
+            server_.HandleRequest("{\"query\":\"frob\"}"));
+  EXPECT_EQ("{\"ok\":false,\"error\":\"bad request: expected '}'\"}",
+            server_.HandleRequest("{\"query\":\"inputs\""));
+
+  EXPECT_FALSE(server_.shutdown_requested());
+  EXPECT_EQ("{\"ok\":true}",
+            server_.HandleRequest("{\"query\":\"shutdown\"}"));
+  EXPECT_TRUE(server_.shutdown_requested());
+  EXPECT_EQ(1, server_.manifest_loads());
+}
+
+TEST_F(QueryServerTest, ReloadsChangedManifest) {
+  fs_.Create("build.ninja",
+"rule cat\n"
+"  command = cat $in > $out\n"
+"include rules.ninja\n");
+  fs_.Create("rules.ninja", "build out: cat in1\n");
+
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"in1\"]}",
+            server_.HandleRequest("{\"query\":\"inputs\"}"));
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"in1\"]}",
+            server_.HandleRequest("{\"query\":\"inputs\"}"));
+  EXPECT_EQ(1, server_.manifest_loads());
+
+  // An included file changing counts too.
+  fs_.Tick();
+  fs_.Create("rules.ninja", "build out: cat in1 in2\n");
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"in1\",\"in2\"]}",
+            server_.HandleRequest("{\"query\":\"inputs\"}"));
+  EXPECT_EQ(2, server_.manifest_loads());
+
+  // A broken manifest is reported, then picked up again once fixed.
+  fs_.Tick();
+  fs_.Create("rules.ninja", "build out: nosuchrule in1\n");
+  EXPECT_EQ(0u, server_.HandleRequest("{\"query\":\"inputs\"}")
+                    .find("{\"ok\":false,\"error\":\"rules.ninja:1: "
+                          "unknown build rule 'nosuchrule'"));
+  fs_.Tick();
+  fs_.Create("rules.ninja", "build out: cat in3\n");
+  EXPECT_EQ("{\"ok\":true,\"result\":[\"in3\"]}",
+            server_.HandleRequest("{\"query\":\"inputs\"}"));
+  EXPECT_EQ(4, server_.manifest_loads());
+}
+
+TEST_F(QueryServerTest, ReloadFreesGraph) {
+  // Each reload replaces the State; run under ASan or valgrind, anything
+  // the old graph leaks is reported.  Edge bindings, pools and subninja
+  // scopes are all allocated separately.
+  fs_.Create("sub.ninja",
+"build sub: cat in\n");
+  for (int i = 0; i < 3; ++i) {
+    fs_.Tick();
+    fs_.Create("build.ninja",
+"pool link\n"
+"  depth = 1\n"
+"rule cat\n"
+"  command = cat $in > $out\n"
+"build out: cat in\n"
+"  pool = link\n"
+"  extra = " + string(i + 1, 'x') + "\n"
+"subninja sub.ninja\n");
+    EXPECT_EQ("{\"ok\":true,\"result\":[\"in\"]}",
+              server_.HandleRequest(
+                  "{\"query\":\"inputs\",\"targets\":[\"out\"]}"));
+  }
+  EXPECT_EQ(3, server_.manifest_loads());
+}
+
+TEST_F(QueryServerTest, DyndepRestatDoesNotStick) {
+  // The build log is read from the real file system.
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("Ninja-QueryServerTest");
+
+  fs_.Create("build.ninja",
+"rule touch\n"
+"  command = touch $out\n"
+"  generator = 1\n"
+"build out: touch in || dd\n"
+"  dyndep = dd\n");
+  fs_.Create("out", "");
+  fs_.Tick();
+  fs_.Create("in", "");
+
+  // The log says out was last built after in changed, so only a restat
+  // edge, which trusts the log over out's mtime, is clean.
+  {
+    FILE* f = fopen(".ninja_log", "wb");
+    ASSERT_TRUE(f);
+    fprintf(f, "# ninja log v7\n0\t1\t%d\tout\t0\n", fs_.now_);
+    fclose(f);
+  }
+
+  fs_.Create("dd",
+"ninja_dyndep_version = 1\n"
+"build out: dyndep\n"
+"  restat = 1\n");
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"out\","
+            "\"dirty\":false}]}",
+            server_.HandleRequest(
+                "{\"query\":\"dirty\",\"targets\":[\"out\"]}"));
+
+  // Without restat in the dyndep file, the edge is back to the manifest's.
+  fs_.Tick();
+  fs_.Create("dd",
+"ninja_dyndep_version = 1\n"
+"build out: dyndep\n");
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"out\","
+            "\"dirty\":true}]}",
+            server_.HandleRequest(
+                "{\"query\":\"dirty\",\"targets\":[\"out\"]}"));
+  EXPECT_EQ(1, server_.manifest_loads());
+
+  temp_dir.Cleanup();
+}
+
+TEST_F(QueryServerTest, ReverseDepsAndDirty) {
+  // The deps log is read from the real file system; everything else,
+  // including the stat() that notices a changed log, goes through fs_.
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("Ninja-QueryServerTest");
+
+  fs_.Create("build.ninja",
+"rule cc\n"
+"  command = cc $in -o $out\n"
+"  deps = gcc\n"
+"  generator = 1\n"
+"build out.o: cc in.c\n"
+"build other.o: cc other.c\n");
+  fs_.Create("in.c", "");
+  fs_.Create("other.c", "");
+  fs_.Create("foo.h", "");
+  fs_.Tick();
+  fs_.Create("out.o", "");
+  fs_.Create("other.o", "");
+
+  {
+    State state;
+    DepsLog log;
+    string err;
+    EXPECT_TRUE(log.OpenForWrite(".ninja_deps", &err));
+    vector<Node*> deps(1, state.GetNode("foo.h", 0));
+    log.RecordDeps(state.GetNode("out.o", 0), fs_.now_, deps);
+    log.Close();
+  }
+
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"foo.h\","
+            "\"outputs\":[],\"deps\":[\"out.o\"]}]}",
+            server_.HandleRequest(
+                "{\"query\":\"rdeps\",\"targets\":[\"foo.h\"]}"));
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"out.o\","
+            "\"dirty\":false}]}",
+            server_.HandleRequest(
+                "{\"query\":\"dirty\",\"targets\":[\"out.o\"]}"));
+
+  // Loading deps for the dirty query does not stick to the graph.
+  fs_.Tick();
+  fs_.Create("foo.h", "");
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"out.o\","
+              "\"dirty\":true}]}",
+              server_.HandleRequest(
+                  "{\"query\":\"dirty\",\"targets\":[\"out.o\"]}"));
+  }
+  EXPECT_NE(string::npos,
+            server_.HandleRequest(
+                "{\"query\":\"query\",\"targets\":[\"out.o\"]}")
+                .find("\"implicit\":[]"));
+
+  // A build writing to the deps log reloads only the log.
+  {
+    State state;
+    DepsLog log;
+    string err;
+    platformAwareUnlink(".ninja_deps");
+    EXPECT_TRUE(log.OpenForWrite(".ninja_deps", &err));
+    vector<Node*> deps(1, state.GetNode("foo.h", 0));
+    log.RecordDeps(state.GetNode("out.o", 0), fs_.now_, deps);
+    log.RecordDeps(state.GetNode("other.o", 0), fs_.now_, deps);
+    log.Close();
+  }
+  fs_.Tick();
+  fs_.Create(".ninja_deps", "");
+  EXPECT_EQ("{\"ok\":true,\"result\":[{\"target\":\"foo.h\","
+            "\"outputs\":[],\"deps\":[\"out.o\",\"other.o\"]}]}",
+            server_.HandleRequest(
+                "{\"query\":\"rdeps\",\"targets\":[\"foo.h\"]}"));
+  EXPECT_EQ(1, server_.manifest_loads());
+  EXPECT_EQ(2, server_.deps_log_loads());
+
+  temp_dir.Cleanup();
+}
+
+#ifndef _WIN32
+TEST_F(QueryServerTest, RefusesLiveSocket) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("Ninja-QueryServerTest-Socket");
+
+  // Another server is listening on the path already.
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, "q.sock");
+  ASSERT_EQ(0, bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+  ASSERT_EQ(0, listen(fd, 1));
+
+  string err;
+  EXPECT_FALSE(server_.ServeUnixSocket("q.sock", &err));
+  EXPECT_EQ("q.sock: a server is already listening on this socket", err);
+  struct stat st;
+  EXPECT_EQ(0, lstat("q.sock", &st));
+
+  close(fd);
+  temp_dir.Cleanup();
+}
+#endif
+
+}  // namespace
@@ -13,19 +13,27 @@
 // limitations under the License.
 
 #include "build.h"
+#include "metrics.h"
+#include "pressure.h"
 #include "subprocess.h"
 
 struct RealCommandRunner : public CommandRunner {
-  explicit RealCommandRunner(const BuildConfig& config) : config_(config) {}
+  explicit RealCommandRunner(const BuildConfig& config)
+      : config_(config),
+        pressure_(config.pressure_targets, config.parallelism) {}
   size_t CanRunMore() const override;
   bool StartCommand(Edge* edge) override;
   bool WaitForCommand(Result* result) override;
+  void WakeUp() override;
   std::vector<Edge*> GetActiveEdges() override;
   void Abort() override;
 
   const BuildConfig& config_;
   SubprocessSet subprocs_;
   std::map<const Subprocess*, Edge*> subproc_to_edge_;
+  /// Only consulted when config_.pressure_limit is set.  Sampling is a
+  /// side effect of asking how many commands may be started.
+  mutable PressureController pressure_;
 };
 
 // 遍历 subproc_to_edge_ 映射，将所有当前正在执行的命令对应的 Edge 收集到一个 std::vector 中并返回
@@ -58,24 +66,37 @@ size_t RealCommandRunner::CanRunMore() const {
   // 设置了最大负载上限
   if (config_.max_load_average > 0.0f) {
     int load_capacity = config_.max_load_average - GetLoadAverage();
-    std::cout << "Load capacity: " << load_capacity << std::endl;
     // 实际的比可用的好
     if (load_capacity < capacity)
       capacity = load_capacity;
   }
 
-  if (capacity < 0) {
-    std::cout << "Capacity adjusted to 0 from: " << capacity << std::endl;
-    capacity = 0;
+  // 根据压力停顿信息（PSI）动态调整并行度
+  if (config_.pressure_limit) {
+#ifndef _WIN32
+    if (pressure_.WantsSample(GetTimeMillis())) {
+      std::vector<int> pids;
+      for (std::vector<Subprocess*>::const_iterator i =
+               subprocs_.running_.begin();
+           i != subprocs_.running_.end(); ++i)
+        pids.push_back((*i)->pid());
+      PressureSample sample;
+      if (ReadPressureSample(pids, &sample))
+        pressure_.Update(sample, subprocs_.running_.size());
+    }
+#endif
+    int64_t pressure_capacity = pressure_.limit() - subproc_number;
+    if (pressure_capacity < capacity)
+      capacity = pressure_capacity;
   }
 
-  if (capacity == 0 && subprocs_.running_.empty()) {
+  if (capacity < 0)
+    capacity = 0;
+
+  if (capacity == 0 && subprocs_.running_.empty())
     // Ensure that we make progress.
     capacity = 1;
-    std::cout << "Capacity forced to 1 when running is empty" << std::endl;
-  }
 
-  std::cout << "Final capacity: " << capacity << std::endl;
   return capacity;
 }
 
@@ -95,10 +116,15 @@ bool RealCommandRunner::WaitForCommand(Result* result) {
     bool interrupted = subprocs_.DoWork();
     if (interrupted)
       return false;
+    if (subprocs_.TakeWakeUp()) {
+      result->edge = NULL;
+      return true;
+    }
   }
 
   result->status = subproc->Finish();
   result->output = subproc->GetOutput();
+  result->usage = subproc->usage();
 
   std::map<const Subprocess*, Edge*>::iterator e =
       subproc_to_edge_.find(subproc);
@@ -109,6 +135,10 @@ bool RealCommandRunner::WaitForCommand(Result* result) {
   return true;
 }
 
+void RealCommandRunner::WakeUp() {
+  subprocs_.WakeUp();
+}
+
 CommandRunner* CommandRunner::factory(const BuildConfig& config) {
   return new RealCommandRunner(config);
 }
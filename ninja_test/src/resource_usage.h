@@ -0,0 +1,42 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_RESOURCE_USAGE_H_
+#define NINJA_RESOURCE_USAGE_H_
+
+#include "util.h"  // int64_t
+
+/// Resources consumed by a command, including the descendants it waited
+/// for, as reported by wait4().  Fields the platform does not report are 0.
+struct ResourceUsage {
+  int64_t user_millis = 0;
+  int64_t system_millis = 0;
+  /// Peak resident set size of the largest process, in KiB.
+  int64_t peak_rss = 0;
+  /// Blocks read from and written to the file system.
+  int64_t in_blocks = 0;
+  int64_t out_blocks = 0;
+  int64_t voluntary_switches = 0;
+  int64_t involuntary_switches = 0;
+
+  bool operator==(const ResourceUsage& o) const {
+    return user_millis == o.user_millis && system_millis == o.system_millis &&
+        peak_rss == o.peak_rss && in_blocks == o.in_blocks &&
+        out_blocks == o.out_blocks &&
+        voluntary_switches == o.voluntary_switches &&
+        involuntary_switches == o.involuntary_switches;
+  }
+};
+
+#endif  // NINJA_RESOURCE_USAGE_H_
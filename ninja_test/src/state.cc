@@ -17,6 +17,8 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <new>
+
 #include "edit_distance.h"
 #include "graph.h"
 #include "util.h"
@@ -95,6 +97,19 @@ State::State() {
   AddPool(&kConsolePool);
 }
 
+State::~State() {
+  for (vector<Edge*>::iterator e = edges_.begin(); e != edges_.end(); ++e)
+    delete *e;
+  for (map<string, Pool*>::iterator p = pools_.begin(); p != pools_.end();
+       ++p) {
+    if (p->second != &kDefaultPool && p->second != &kConsolePool)
+      delete p->second;
+  }
+  // The nodes live in arena_, which never runs their destructors.
+  for (Paths::iterator i = paths_.begin(); i != paths_.end(); ++i)
+    i->second->~Node();
+}
+
 void State::AddPool(Pool* pool) {
   assert(LookupPool(pool->name()) == NULL);
   pools_[pool->name()] = pool;
@@ -127,7 +142,8 @@ Node* State::GetNode(StringPiece path, uint64_t slash_bits) {
   Node* node = LookupNode(path);
   if (node)
     return node;
-  node = new Node(path.AsString(), slash_bits);
+  node = new (arena_.Allocate(sizeof(Node), alignof(Node)))
+      Node(arena_.Copy(path), slash_bits);
   paths_[node->path()] = node; // 在这个地方加的paths
   return node;
 }
@@ -244,7 +260,7 @@ void State::Dump() {
   for (Paths::iterator i = paths_.begin(); i != paths_.end(); ++i) {
     Node* node = i->second;
     printf("%s %s [id:%d]\n",
-           node->path().c_str(),
+           node->path().str_,
            node->status_known() ? (node->dirty() ? "dirty" : "clean")
                                 : "unknown",
            node->id());
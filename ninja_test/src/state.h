@@ -16,10 +16,12 @@
 #define NINJA_STATE_H_
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "arena.h"
 #include "eval_env.h"
 #include "graph.h"
 #include "hash_map.h"
@@ -107,6 +109,11 @@ struct State {
   static Pool kConsolePool;
 
   State();
+  /// Frees the edges, the pools added by the manifest and the nodes.
+  ~State();
+
+  State(const State&) = delete;
+  void operator=(const State&) = delete;
 
   void AddPool(Pool* pool);
   Pool* LookupPool(const std::string& pool_name);
@@ -162,6 +169,13 @@ struct State {
 // 干嘛用：没指定目标时，建这些。  
 // 例子：defaults_ 里有 main.o
   std::vector<Node*> defaults_;
+
+  /// Scopes the manifest parser created for edge bindings and subninjas.
+  std::vector<std::unique_ptr<BindingEnv>> scopes_;
+
+  /// Backing store for Nodes and for the text of rule bindings, which live
+  /// as long as the State.
+  Arena arena_;
 };
 
 #endif  // NINJA_STATE_H_
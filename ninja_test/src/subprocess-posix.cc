@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <spawn.h>
 
@@ -49,6 +50,46 @@ Subprocess::~Subprocess() {
     Finish();
 }
 
+bool SplitSimpleCommand(const string& command, vector<string>* args) {
+  // Words that sh treats specially when they start a command.
+  static const char* const kShellWords[] = {
+    "!", ".", ":", "[[", "alias", "bg", "break", "case", "cd", "command",
+    "continue", "do", "done", "elif", "else", "esac", "eval", "exec", "exit",
+    "export", "fc", "fg", "fi", "for", "function", "getopts", "hash", "if",
+    "jobs", "local", "read", "readonly", "return", "select", "set", "shift",
+    "source", "then", "time", "times", "trap", "type", "ulimit", "umask",
+    "unalias", "unset", "until", "wait", "while",
+  };
+
+  args->clear();
+  string::size_type pos = 0;
+  for (;;) {
+    pos = command.find_first_not_of(" \t", pos);
+    if (pos == string::npos)
+      break;
+    string::size_type end = command.find_first_of(" \t", pos);
+    if (end == string::npos)
+      end = command.size();
+    args->push_back(command.substr(pos, end - pos));
+    pos = end;
+  }
+  if (args->empty())
+    return false;
+
+  // Anything the shell would quote, expand, redirect or glob.
+  if (command.find_first_of("|&;<>()$`\\\"'*?[]#~{}\n\r") != string::npos)
+    return false;
+  // A leading assignment, as in "FOO=1 cc ...".
+  const string& program = (*args)[0];
+  if (program.find('=') != string::npos)
+    return false;
+  for (size_t i = 0; i < sizeof(kShellWords) / sizeof(kShellWords[0]); ++i) {
+    if (program == kShellWords[i])
+      return false;
+  }
+  return true;
+}
+
 bool Subprocess::Start(SubprocessSet* set, const string& command) {
   int output_pipe[2];
   if (pipe(output_pipe) < 0)
@@ -71,26 +112,7 @@ bool Subprocess::Start(SubprocessSet* set, const string& command) {
   if (err != 0)
     Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
 
-  posix_spawnattr_t attr;
-  err = posix_spawnattr_init(&attr);
-  if (err != 0)
-    Fatal("posix_spawnattr_init: %s", strerror(err));
-
-  short flags = 0;
-
-  flags |= POSIX_SPAWN_SETSIGMASK;
-  err = posix_spawnattr_setsigmask(&attr, &set->old_mask_);
-  if (err != 0)
-    Fatal("posix_spawnattr_setsigmask: %s", strerror(err));
-  // Signals which are set to be caught in the calling process image are set to
-  // default action in the new process image, so no explicit
-  // POSIX_SPAWN_SETSIGDEF parameter is needed.
-
   if (!use_console_) {
-    // Put the child in its own process group, so ctrl-c won't reach it.
-    flags |= POSIX_SPAWN_SETPGROUP;
-    // No need to posix_spawnattr_setpgroup(&attr, 0), it's the default.
-
     // Open /dev/null over stdin.
     err = posix_spawn_file_actions_addopen(&action, 0, "/dev/null", O_RDONLY,
           0);
@@ -110,23 +132,29 @@ bool Subprocess::Start(SubprocessSet* set, const string& command) {
     // In the console case, output_pipe is still inherited by the child and
     // closed when the subprocess finishes, which then notifies ninja.
   }
-#ifdef POSIX_SPAWN_USEVFORK
-  flags |= POSIX_SPAWN_USEVFORK;
-#endif
-
-  err = posix_spawnattr_setflags(&attr, flags);
-  if (err != 0)
-    Fatal("posix_spawnattr_setflags: %s", strerror(err));
-
-  const char* spawned_args[] = { "/bin/sh", "-c", command.c_str(), NULL };
-  err = posix_spawn(&pid_, "/bin/sh", &action, &attr,
-        const_cast<char**>(spawned_args), environ);
-  if (err != 0)
-    Fatal("posix_spawn: %s", strerror(err));
+  const posix_spawnattr_t* attr =
+      use_console_ ? &set->console_spawn_attr_ : &set->spawn_attr_;
+
+  // Skip the shell for plain commands.  If the direct spawn fails, e.g.
+  // because the program does not exist, let the shell run the command so
+  // that the failure is reported the usual way.
+  vector<string> args;
+  err = -1;
+  if (SplitSimpleCommand(command, &args)) {
+    vector<char*> argv;
+    for (vector<string>::iterator a = args.begin(); a != args.end(); ++a)
+      argv.push_back(const_cast<char*>(a->c_str()));
+    argv.push_back(NULL);
+    err = posix_spawnp(&pid_, argv[0], &action, attr, &argv[0], environ);
+  }
+  if (err != 0) {
+    const char* spawned_args[] = { "/bin/sh", "-c", command.c_str(), NULL };
+    err = posix_spawn(&pid_, "/bin/sh", &action, attr,
+          const_cast<char**>(spawned_args), environ);
+    if (err != 0)
+      Fatal("posix_spawn: %s", strerror(err));
+  }
 
-  err = posix_spawnattr_destroy(&attr);
-  if (err != 0)
-    Fatal("posix_spawnattr_destroy: %s", strerror(err));
   err = posix_spawn_file_actions_destroy(&action);
   if (err != 0)
     Fatal("posix_spawn_file_actions_destroy: %s", strerror(err));
@@ -151,10 +179,26 @@ void Subprocess::OnPipeReady() {
 ExitStatus Subprocess::Finish() {
   assert(pid_ != -1);
   int status;
-  if (waitpid(pid_, &status, 0) < 0)
-    Fatal("waitpid(%d): %s", pid_, strerror(errno));
+  struct rusage usage;
+  if (wait4(pid_, &status, 0, &usage) < 0)
+    Fatal("wait4(%d): %s", pid_, strerror(errno));
   pid_ = -1;
 
+  usage_.user_millis = usage.ru_utime.tv_sec * 1000LL +
+                       usage.ru_utime.tv_usec / 1000;
+  usage_.system_millis = usage.ru_stime.tv_sec * 1000LL +
+                         usage.ru_stime.tv_usec / 1000;
+#ifdef __APPLE__
+  // ru_maxrss is in bytes on macOS and in KiB elsewhere.
+  usage_.peak_rss = usage.ru_maxrss / 1024;
+#else
+  usage_.peak_rss = usage.ru_maxrss;
+#endif
+  usage_.in_blocks = usage.ru_inblock;
+  usage_.out_blocks = usage.ru_oublock;
+  usage_.voluntary_switches = usage.ru_nvcsw;
+  usage_.involuntary_switches = usage.ru_nivcsw;
+
 #ifdef _AIX
   if (WIFEXITED(status) && WEXITSTATUS(status) & 0x80) {
     // Map the shell's exit code used for signal failure (128 + signal) to the
@@ -207,7 +251,15 @@ void SubprocessSet::HandlePendingInterruption() {
     interrupted_ = SIGHUP;
 }
 
-SubprocessSet::SubprocessSet() {
+SubprocessSet::SubprocessSet() : woken_up_(false) {
+  if (pipe(wake_pipe_) < 0)
+    Fatal("pipe: %s", strerror(errno));
+  for (int i = 0; i < 2; ++i) {
+    SetCloseOnExec(wake_pipe_[i]);
+    if (fcntl(wake_pipe_[i], F_SETFL, O_NONBLOCK) < 0)
+      Fatal("fcntl: %s", strerror(errno));
+  }
+
   sigset_t set;
   sigemptyset(&set);
   sigaddset(&set, SIGINT);
@@ -225,11 +277,48 @@ SubprocessSet::SubprocessSet() {
     Fatal("sigaction: %s", strerror(errno));
   if (sigaction(SIGHUP, &act, &old_hup_act_) < 0)
     Fatal("sigaction: %s", strerror(errno));
+
+  InitSpawnAttr(&console_spawn_attr_, true);
+  InitSpawnAttr(&spawn_attr_, false);
+}
+
+void SubprocessSet::InitSpawnAttr(posix_spawnattr_t* attr, bool use_console) {
+  int err = posix_spawnattr_init(attr);
+  if (err != 0)
+    Fatal("posix_spawnattr_init: %s", strerror(err));
+
+  short flags = 0;
+
+  flags |= POSIX_SPAWN_SETSIGMASK;
+  err = posix_spawnattr_setsigmask(attr, &old_mask_);
+  if (err != 0)
+    Fatal("posix_spawnattr_setsigmask: %s", strerror(err));
+  // Signals which are set to be caught in the calling process image are set to
+  // default action in the new process image, so no explicit
+  // POSIX_SPAWN_SETSIGDEF parameter is needed.
+
+  if (!use_console) {
+    // Put the child in its own process group, so ctrl-c won't reach it.
+    flags |= POSIX_SPAWN_SETPGROUP;
+    // No need to posix_spawnattr_setpgroup(attr, 0), it's the default.
+  }
+#ifdef POSIX_SPAWN_USEVFORK
+  flags |= POSIX_SPAWN_USEVFORK;
+#endif
+
+  err = posix_spawnattr_setflags(attr, flags);
+  if (err != 0)
+    Fatal("posix_spawnattr_setflags: %s", strerror(err));
 }
 
 SubprocessSet::~SubprocessSet() {
   Clear();
 
+  posix_spawnattr_destroy(&console_spawn_attr_);
+  posix_spawnattr_destroy(&spawn_attr_);
+  close(wake_pipe_[0]);
+  close(wake_pipe_[1]);
+
   if (sigaction(SIGINT, &old_int_act_, 0) < 0)
     Fatal("sigaction: %s", strerror(errno));
   if (sigaction(SIGTERM, &old_term_act_, 0) < 0)
@@ -250,11 +339,33 @@ Subprocess *SubprocessSet::Add(const string& command, bool use_console) {
   return subprocess;
 }
 
+void SubprocessSet::WakeUp() {
+  // A full pipe already has a wake-up pending.
+  char c = 0;
+  while (write(wake_pipe_[1], &c, 1) < 0 && errno == EINTR) {}
+}
+
+bool SubprocessSet::TakeWakeUp() {
+  bool woken_up = woken_up_;
+  woken_up_ = false;
+  return woken_up;
+}
+
+/// Drain the wake-up pipe.
+static void DrainWakePipe(int fd) {
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0) {}
+}
+
 #ifdef USE_PPOLL
 bool SubprocessSet::DoWork() {
   vector<pollfd> fds;
   nfds_t nfds = 0;
 
+  pollfd wake = { wake_pipe_[0], POLLIN, 0 };
+  fds.push_back(wake);
+  ++nfds;
+
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ++i) {
     int fd = (*i)->fd_;
@@ -279,7 +390,12 @@ bool SubprocessSet::DoWork() {
   if (IsInterrupted())
     return true;
 
-  nfds_t cur_nfd = 0;
+  if (fds[0].revents) {
+    DrainWakePipe(wake_pipe_[0]);
+    woken_up_ = true;
+  }
+
+  nfds_t cur_nfd = 1;
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ) {
     int fd = (*i)->fd_;
@@ -306,6 +422,9 @@ bool SubprocessSet::DoWork() {
   int nfds = 0;
   FD_ZERO(&set);
 
+  FD_SET(wake_pipe_[0], &set);
+  nfds = wake_pipe_[0] + 1;
+
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ++i) {
     int fd = (*i)->fd_;
@@ -330,6 +449,11 @@ bool SubprocessSet::DoWork() {
   if (IsInterrupted())
     return true;
 
+  if (FD_ISSET(wake_pipe_[0], &set)) {
+    DrainWakePipe(wake_pipe_[0]);
+    woken_up_ = true;
+  }
+
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ) {
     int fd = (*i)->fd_;
@@ -196,6 +196,22 @@ ExitStatus Subprocess::Finish() {
   DWORD exit_code = 0;
   GetExitCodeProcess(child_, &exit_code);
 
+  FILETIME creation, exit, kernel, user;
+  if (GetProcessTimes(child_, &creation, &exit, &kernel, &user)) {
+    // FILETIMEs count 100ns intervals.
+    usage_.user_millis =
+        ((static_cast<int64_t>(user.dwHighDateTime) << 32) |
+         user.dwLowDateTime) / 10000;
+    usage_.system_millis =
+        ((static_cast<int64_t>(kernel.dwHighDateTime) << 32) |
+         kernel.dwLowDateTime) / 10000;
+  }
+  IO_COUNTERS io;
+  if (GetProcessIoCounters(child_, &io)) {
+    usage_.in_blocks = io.ReadOperationCount;
+    usage_.out_blocks = io.WriteOperationCount;
+  }
+
   CloseHandle(child_);
   child_ = NULL;
 
@@ -213,7 +229,10 @@ const string& Subprocess::GetOutput() const {
 
 HANDLE SubprocessSet::ioport_;
 
-SubprocessSet::SubprocessSet() {
+/// Completion key that WakeUp() posts; NULL means interrupted.
+static int wake_up_key;
+
+SubprocessSet::SubprocessSet() : woken_up_(false) {
   ioport_ = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
   if (!ioport_)
     Win32Fatal("CreateIoCompletionPort");
@@ -266,6 +285,11 @@ bool SubprocessSet::DoWork() {
                 // delivered by NotifyInterrupted above.
     return true;
 
+  if (subproc == reinterpret_cast<Subprocess*>(&wake_up_key)) {
+    woken_up_ = true;
+    return false;
+  }
+
   subproc->OnPipeReady();
 
   if (subproc->Done()) {
@@ -280,6 +304,19 @@ bool SubprocessSet::DoWork() {
   return false;
 }
 
+void SubprocessSet::WakeUp() {
+  if (!PostQueuedCompletionStatus(ioport_, 0,
+                                  reinterpret_cast<ULONG_PTR>(&wake_up_key),
+                                  NULL))
+    Win32Fatal("PostQueuedCompletionStatus");
+}
+
+bool SubprocessSet::TakeWakeUp() {
+  bool woken_up = woken_up_;
+  woken_up_ = false;
+  return woken_up;
+}
+
 Subprocess* SubprocessSet::NextFinished() {
   if (finished_.empty())
     return NULL;
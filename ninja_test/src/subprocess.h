@@ -23,6 +23,7 @@
 #include <windows.h>
 #else
 #include <signal.h>
+#include <spawn.h>
 #endif
 
 // ppoll() exists on FreeBSD, but only on newer versions.
@@ -34,6 +35,7 @@
 #endif
 
 #include "exit_status.h"
+#include "resource_usage.h"
 
 /// Subprocess wraps a single async subprocess.  It is entirely
 /// passive: it expects the caller to notify it when its fds are ready
@@ -50,12 +52,21 @@ struct Subprocess {
 
   const std::string& GetOutput() const;
 
+  /// Resources used by the command.  Only valid after Finish().
+  const ResourceUsage& usage() const { return usage_; }
+
+#ifndef _WIN32
+  /// The process id of the command, or -1 once it has been reaped.
+  pid_t pid() const { return pid_; }
+#endif
+
  private:
   Subprocess(bool use_console);
   bool Start(struct SubprocessSet* set, const std::string& command);
   void OnPipeReady();
 
   std::string buf_;
+  ResourceUsage usage_;
 
 #ifdef _WIN32
   /// Set up pipe_ as the parent-side pipe of the subprocess; return the
@@ -88,13 +99,24 @@ struct SubprocessSet {
   Subprocess* NextFinished();
   void Clear();
 
+  /// Make a DoWork() that is waiting, or the next one, return early.  May be
+  /// called from any thread.
+  void WakeUp();
+  /// @return whether DoWork() returned because of WakeUp(), and reset that.
+  bool TakeWakeUp();
+
   std::vector<Subprocess*> running_;
   std::queue<Subprocess*> finished_;
 
+  bool woken_up_;
+
 #ifdef _WIN32
   static BOOL WINAPI NotifyInterrupted(DWORD dwCtrlType);
   static HANDLE ioport_;
 #else
+  /// A pipe that WakeUp() writes to and DoWork() polls.
+  int wake_pipe_[2];
+
   static void SetInterruptedFlag(int signum);
   static void HandlePendingInterruption();
   /// Store the signal number that causes the interruption.
@@ -107,7 +129,23 @@ struct SubprocessSet {
   struct sigaction old_term_act_;
   struct sigaction old_hup_act_;
   sigset_t old_mask_;
+
+  /// Spawn attributes shared by all subprocesses, prepared once: one for
+  /// console subprocesses and one for those in their own process group.
+  posix_spawnattr_t console_spawn_attr_;
+  posix_spawnattr_t spawn_attr_;
+  void InitSpawnAttr(posix_spawnattr_t* attr, bool use_console);
 #endif
 };
 
+#ifndef _WIN32
+/// Split |command| into arguments if running it through /bin/sh -c would
+/// do nothing but split it at blanks and look up the first word in PATH,
+/// i.e. if it contains no quoting, expansions, redirections, operators or
+/// shell builtins.  Such commands are spawned directly, without a shell.
+/// @return false if the command needs a shell.
+bool SplitSimpleCommand(const std::string& command,
+                        std::vector<std::string>* args);
+#endif
+
 #endif // NINJA_SUBPROCESS_H_
@@ -0,0 +1,73 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "metrics.h"
+#include "subprocess.h"
+#include "util.h"
+
+using namespace std;
+
+namespace {
+
+/// Run |count| copies of |command|, at most |parallelism| at a time.
+/// @return the number of spawns per second.
+double SpawnRate(const string& command, int count, int parallelism) {
+  SubprocessSet subprocs;
+  int started = 0;
+  int finished = 0;
+  int64_t start = GetTimeMillis();
+  while (finished < count) {
+    while (started < count &&
+           static_cast<int>(subprocs.running_.size()) < parallelism) {
+      if (!subprocs.Add(command))
+        Fatal("failed to start '%s'", command.c_str());
+      ++started;
+    }
+    Subprocess* subproc;
+    while ((subproc = subprocs.NextFinished()) == NULL)
+      subprocs.DoWork();
+    if (subproc->Finish() != ExitSuccess)
+      Fatal("'%s' failed: %s", command.c_str(), subproc->GetOutput().c_str());
+    delete subproc;
+    ++finished;
+  }
+  int64_t delta = GetTimeMillis() - start;
+  return count * 1000.0 / max<int64_t>(delta, 1);
+}
+
+}  // anonymous namespace
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+  printf("subprocess_perftest is not supported on Windows\n");
+  return 0;
+#else
+  const int kNumCommands = argc > 1 ? atoi(argv[1]) : 2000;
+  const int parallelism = GetProcessorCount();
+
+  // "true" is spawned directly; the trailing ';' forces /bin/sh -c.
+  const char* const kCommands[] = { "true", "true ;" };
+  for (int i = 0; i < 2; ++i) {
+    const char* mode = i == 0 ? "direct" : "shell";
+    for (int j = 0; j < 3; ++j) {
+      double rate = SpawnRate(kCommands[i], kNumCommands, parallelism);
+      printf("%-6s -j%d: %.0f spawns/s\n", mode, parallelism, rate);
+    }
+  }
+  return 0;
+#endif
+}
@@ -263,4 +263,44 @@ TEST_F(SubprocessTest, ReadStdin) {
   ASSERT_EQ(ExitSuccess, subproc->Finish());
   ASSERT_EQ(1u, subprocs_.finished_.size());
 }
+
+TEST(SplitSimpleCommand, Simple) {
+  vector<string> args;
+  EXPECT_TRUE(SplitSimpleCommand("cc  -c foo.c\t-DX=1 -o foo.o", &args));
+  ASSERT_EQ(6u, args.size());
+  EXPECT_EQ("cc", args[0]);
+  EXPECT_EQ("-c", args[1]);
+  EXPECT_EQ("foo.c", args[2]);
+  EXPECT_EQ("-DX=1", args[3]);
+  EXPECT_EQ("-o", args[4]);
+  EXPECT_EQ("foo.o", args[5]);
+}
+
+TEST(SplitSimpleCommand, NeedsShell) {
+  vector<string> args;
+  EXPECT_FALSE(SplitSimpleCommand("", &args));
+  EXPECT_FALSE(SplitSimpleCommand("  ", &args));
+  EXPECT_FALSE(SplitSimpleCommand("cat in > out", &args));
+  EXPECT_FALSE(SplitSimpleCommand("cc -c $in", &args));
+  EXPECT_FALSE(SplitSimpleCommand("cc -c 'a b.c'", &args));
+  EXPECT_FALSE(SplitSimpleCommand("rm *.o", &args));
+  EXPECT_FALSE(SplitSimpleCommand("a && b", &args));
+  EXPECT_FALSE(SplitSimpleCommand("a\nb", &args));
+  EXPECT_FALSE(SplitSimpleCommand("FOO=1 cc -c a.c", &args));
+  EXPECT_FALSE(SplitSimpleCommand("cd sub", &args));
+  EXPECT_FALSE(SplitSimpleCommand("exec cc", &args));
+  EXPECT_FALSE(SplitSimpleCommand(": nothing", &args));
+}
+
+// Commands without shell syntax run without a shell and still see PATH
+// lookup and their arguments.
+TEST_F(SubprocessTest, DirectSpawn) {
+  Subprocess* subproc = subprocs_.Add("printf %s-%s  a b");
+  ASSERT_NE((Subprocess *) 0, subproc);
+  while (!subproc->Done()) {
+    subprocs_.DoWork();
+  }
+  ASSERT_EQ(ExitSuccess, subproc->Finish());
+  EXPECT_EQ("a-b", subproc->GetOutput());
+}
 #endif  // _WIN32
@@ -59,6 +59,7 @@
 #include <sys/cpuset.h>
 #endif
 
+#include "byte_scan.h"
 #include "edit_distance.h"
 
 using namespace std;
@@ -136,6 +137,27 @@ static bool IsPathSeparator(char c) {
   return c == '/';
 #endif
 }
+/// Whether CanonicalizePath() would leave [src, end) as it is, judging
+/// conservatively: an absolute path or one that starts with some "../",
+/// followed by components that are neither empty, "." nor "..", and no
+/// trailing separator.
+static bool IsSimpleCanonicalPath(const char* src, const char* end) {
+#ifdef _WIN32
+  // Backslashes need slash_bits, and leading separators are special.
+  if (::memchr(src, '\\', end - src) || IsPathSeparator(*src))
+    return false;
+#else
+  if (*src == '/')
+    ++src;
+  else
+#endif
+    while (end - src >= 3 && src[0] == '.' && src[1] == '.' && src[2] == '/')
+      src += 3;
+  if (src == end || *src == '.' || *src == '/' || end[-1] == '/')
+    return false;
+  return byte_scan::FindSlashBeforeSlashOrDot(src, end) == end;
+}
+
 // CanonicalizePath 函数的作用是将路径转换为标准形式，主要处理：
 
 // 移除冗余的路径分隔符
@@ -154,6 +176,14 @@ void CanonicalizePath(char* path, size_t* len, uint64_t* slash_bits) {
     return;
   }
 
+  // Most paths, e.g. those written by compilers into depfiles, are already
+  // canonical.  Checking for that a block at a time is much cheaper than
+  // walking the components.
+  if (IsSimpleCanonicalPath(path, path + *len)) {
+    *slash_bits = 0;
+    return;
+  }
+
   char* start = path;
   char* dst = start;
   char* dst_start = dst;
@@ -318,6 +348,14 @@ void CanonicalizePath(char* path, size_t* len, uint64_t* slash_bits) {
 #endif
 }
 
+void CanonicalizePaths(StringPiece* paths, size_t count,
+                       uint64_t* slash_bits) {
+  for (size_t i = 0; i < count; ++i) {
+    CanonicalizePath(const_cast<char*>(paths[i].str_), &paths[i].len_,
+                     &slash_bits[i]);
+  }
+}
+
 static inline bool IsKnownShellSafeCharacter(char ch) {
   if ('A' <= ch && ch <= 'Z') return true;
   if ('a' <= ch && ch <= 'z') return true;
@@ -31,6 +31,8 @@
 #include <algorithm>
 #include <iomanip>
 
+struct StringPiece;
+
 #if !defined(__has_cpp_attribute)
 #  define __has_cpp_attribute(x)  0
 #endif
@@ -71,6 +73,10 @@ void Info(const char* msg, va_list ap);
 void CanonicalizePath(std::string* path, uint64_t* slash_bits);
 void CanonicalizePath(char* path, size_t* len, uint64_t* slash_bits);
 
+/// Canonicalize |count| paths in place, e.g. all those of a depfile, which
+/// point into a mutable buffer.  |slash_bits| receives one entry per path.
+void CanonicalizePaths(StringPiece* paths, size_t count, uint64_t* slash_bits);
+
 /// Appends |input| to |*result|, escaping according to the whims of either
 /// Bash, or Win32's CommandLineToArgvW().
 /// Appends the string directly to |result| without modification if we can
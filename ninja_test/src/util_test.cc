@@ -14,6 +14,7 @@
 
 #include "util.h"
 
+#include "string_piece.h"
 #include "test.h"
 
 using namespace std;
@@ -455,6 +456,52 @@ TEST(CanonicalizePath, NotNullTerminated) {
   EXPECT_EQ("file../file bar/.", string(path));
 }
 
+// Paths long enough to be checked a block at a time, with the part that
+// needs work at every offset.
+TEST(CanonicalizePath, LongPaths) {
+  const string prefix = "third_party/WebKit/Source/WebCore/platform/";
+  for (size_t i = 1; i < prefix.size(); ++i) {
+    if (prefix[i - 1] != '/')
+      continue;
+    string head = prefix.substr(0, i);
+    string tail = prefix.substr(i) + "file.cc";
+    string path = head + "./" + tail;
+    CanonicalizePath(&path);
+    EXPECT_EQ(head + tail, path);
+    path = head + "/" + tail;
+    CanonicalizePath(&path);
+    EXPECT_EQ(head + tail, path);
+    path = head + "x/../" + tail;
+    CanonicalizePath(&path);
+    EXPECT_EQ(head + tail, path);
+    path = head + ".hidden/" + tail;
+    CanonicalizePath(&path);
+    EXPECT_EQ(head + ".hidden/" + tail, path);
+  }
+  string path = "/" + prefix + "file.cc";
+  CanonicalizePath(&path);
+  EXPECT_EQ("/" + prefix + "file.cc", path);
+  path = "../../" + prefix + "..";
+  CanonicalizePath(&path);
+  EXPECT_EQ("../../third_party/WebKit/Source/WebCore", path);
+}
+
+TEST(CanonicalizePath, Bulk) {
+  char buf[] = "foo/./bar.h ./baz.h /usr/include/stdio.h a/b/../c.h";
+  StringPiece paths[] = {
+    StringPiece(buf, 11), StringPiece(buf + 12, 7),
+    StringPiece(buf + 20, 20), StringPiece(buf + 41, 10),
+  };
+  uint64_t slash_bits[4];
+  CanonicalizePaths(paths, 4, slash_bits);
+  EXPECT_EQ("foo/bar.h", paths[0].AsString());
+  EXPECT_EQ("baz.h", paths[1].AsString());
+  EXPECT_EQ("/usr/include/stdio.h", paths[2].AsString());
+  EXPECT_EQ("a/c.h", paths[3].AsString());
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(0u, slash_bits[i]);
+}
+
 TEST(PathEscaping, TortureTest) {
   string result;
 
@@ -0,0 +1,33 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_WAIT_SLICE_H_
+#define NINJA_WAIT_SLICE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/// Wait on |cv| until it is signalled, or for at most a short slice.
+///
+/// Waits are done in slices with wait_for(): condition_variable::wait()
+/// would raise the libstdc++ version ninja needs at run time (it binds to
+/// a GLIBCXX_3.4.30 symbol).  Callers wait in a loop on their condition,
+/// which also copes with the spurious wakeups wait() allows.
+inline void WaitSlice(std::condition_variable* cv,
+                      std::unique_lock<std::mutex>* lock) {
+  cv->wait_for(*lock, std::chrono::milliseconds(100));
+}
+
+#endif  // NINJA_WAIT_SLICE_H_